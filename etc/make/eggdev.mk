@@ -30,8 +30,8 @@ eggdev_EGGSTRA_OPT_ENABLE:=$(sort $(eggdev_OPT_ENABLE) $($(EGG_NATIVE_TARGET)_OP
 eggdev_EGGSTRA_CFILES:=$(filter %.c %.m,$(filter src/eggstra/% src/util/% $(addprefix src/opt/,$(addsuffix /%,$(eggdev_EGGSTRA_OPT_ENABLE))),$(SRCFILES)))
 eggdev_EGGSTRA_OFILES:=$(patsubst src/%,mid/eggstra/%.o,$(basename $(eggdev_EGGSTRA_CFILES)))
 -include $(eggdev_EGGSTRA_OFILES:.o=.d)
-mid/eggstra/%.o:src/%.c;$(PRECMD) $($(EGG_NATIVE_TARGET)_CC) -o$@ $< $(foreach U,$(eggdev_EGGSTRA_OPT_ENABLE),-DUSE_$U=1)
-mid/eggstra/%.o:src/%.m;$(PRECMD) $($(EGG_NATIVE_TARGET)_OBJC) -o$@ $< $(foreach U,$(eggdev_EGGSTRA_OPT_ENABLE),-DUSE_$U=1)
+mid/eggstra/%.o:src/%.c;$(PRECMD) $($(EGG_NATIVE_TARGET)_CC) -o$@ $< $(foreach U,$(eggdev_EGGSTRA_OPT_ENABLE),-DUSE_$U=1) -DSYNTH_HEAP_STATS=1
+mid/eggstra/%.o:src/%.m;$(PRECMD) $($(EGG_NATIVE_TARGET)_OBJC) -o$@ $< $(foreach U,$(eggdev_EGGSTRA_OPT_ENABLE),-DUSE_$U=1) -DSYNTH_HEAP_STATS=1
 eggdev-all:$(eggdev_EGGSTRA_EXE)
 $(eggdev_EGGSTRA_EXE):$(eggdev_EGGSTRA_OFILES);$(PRECMD) $($(EGG_NATIVE_TARGET)_LD) -o$@ $^ $($(EGG_NATIVE_TARGET)_LDPOST)
 
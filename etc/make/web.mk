@@ -22,6 +22,8 @@ web-all:$(web_SYNTH_WASM)
 web_SYNTH_CFILES:=$(filter src/opt/synth/%.c,$(SRCFILES))
 web_SYNTH_OFILES:=$(patsubst src/%.c,$(web_MIDDIR)/%.o,$(web_SYNTH_CFILES))
 -include $(web_SYNTH_OFILES:.o=.d)
+# Synth's block kernels use vector extensions; let them lower to SIMD128. Only synth.wasm requires it, not the game.
+$(web_SYNTH_OFILES):$(web_MIDDIR)/opt/synth/%.o:src/opt/synth/%.c;$(PRECMD) $(web_CC) -msimd128 -o$@ $<
 $(web_SYNTH_WASM):$(web_SYNTH_OFILES);$(PRECMD) $(web_LD) -o$@ $^ $(web_LDPOST)
 
 define web_UTIL_RULES
@@ -0,0 +1,16 @@
+export EGG_SDK:=/root/repo
+export EGG_TARGETS:=linux
+export EGG_NATIVE_TARGET:=linux
+export eggdev_OPT_ENABLE:=serial fs synth zip http image real_stdlib eau midi native
+export eggdev_CC:=gcc -c -MMD -O3 -Isrc -Werror -Wimplicit
+export eggdev_LD:=gcc -z noexecstack
+export eggdev_LDPOST:=-lm -lz
+export linux_OPT_ENABLE:=fs serial synth hostio render image real_stdlib native evdev alsafd xegl
+export linux_AR:=ar
+export linux_CC:=gcc -c -MMD -O3 -Isrc -Werror -Wimplicit
+export linux_OBJC:=
+export linux_LD:=gcc -z noexecstack
+export linux_LDPOST:=-lm -lz -lX11 -lEGL -lGLESv2
+export linux_PACKAGING:=exe
+export linux_EXESFX:=
+export linux_WAMR_SDK:=
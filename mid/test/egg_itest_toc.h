@@ -0,0 +1,61 @@
+/* mid/test/egg_itest_toc.h
+ * Generated at Sat Oct 17 09:09:07 UTC 2026.
+ */
+ 
+#ifndef EGG_ITEST_TOC_H
+#define EGG_ITEST_TOC_H
+
+int reencode_image();
+int synth_polyphony_cached_per_resource();
+int synth_seek_lands_exactly_and_restores_notes();
+int synth_seek_matches_linear_voices_and_wheel();
+int synth_pipe_fused_matches_unfused();
+int synth_threads_match_serial();
+int synth_sleeping_channel_wakes_on_note();
+int synth_sleeping_channel_does_no_work();
+int synth_sleep_matches_awake_within_tolerance();
+int synth_context_independent_instances();
+int synth_event_at_is_sample_accurate();
+int synth_fm_kernels_match_scalar();
+int synth_profile_counts_song_and_channels();
+int synth_preprint_matches_on_demand();
+int synth_songpcm_streams_prerendered_song();
+int synth_cmdq_defers_and_counts_overflow();
+int synth_cmdq_play_matches_direct();
+int synth_env_fill_matches_per_frame();
+int synth_voice_steal_oldest_keeps_newest();
+int synth_quality_underrun_and_recovery();
+int synth_quality_ignores_single_spike();
+
+static const struct egg_itest {
+  int (*fn)();
+  const char *name;
+  const char *file;
+  const char *tags;
+  int line;
+  int ignore;
+} egg_itestv[]={
+  {reencode_image,"reencode_image","reencode_image.c","",50,0},
+  {synth_polyphony_cached_per_resource,"synth_polyphony_cached_per_resource","synth_polyphony.c","",11,0},
+  {synth_seek_lands_exactly_and_restores_notes,"synth_seek_lands_exactly_and_restores_notes","synth_seek.c","",26,0},
+  {synth_seek_matches_linear_voices_and_wheel,"synth_seek_matches_linear_voices_and_wheel","synth_seek.c","",74,0},
+  {synth_pipe_fused_matches_unfused,"synth_pipe_fused_matches_unfused","synth_pipe_fused.c","",89,0},
+  {synth_threads_match_serial,"synth_threads_match_serial","synth_threads.c","",41,0},
+  {synth_sleeping_channel_wakes_on_note,"synth_sleeping_channel_wakes_on_note","synth_sleep.c","",11,0},
+  {synth_sleeping_channel_does_no_work,"synth_sleeping_channel_does_no_work","synth_sleep.c","",75,0},
+  {synth_sleep_matches_awake_within_tolerance,"synth_sleep_matches_awake_within_tolerance","synth_sleep.c","",133,0},
+  {synth_context_independent_instances,"synth_context_independent_instances","synth_context.c","",21,0},
+  {synth_event_at_is_sample_accurate,"synth_event_at_is_sample_accurate","synth_event_at.c","",57,0},
+  {synth_fm_kernels_match_scalar,"synth_fm_kernels_match_scalar","synth_fm_kernels.c","",268,0},
+  {synth_profile_counts_song_and_channels,"synth_profile_counts_song_and_channels","synth_profile.c","",9,0},
+  {synth_preprint_matches_on_demand,"synth_preprint_matches_on_demand","synth_preprint.c","",45,0},
+  {synth_songpcm_streams_prerendered_song,"synth_songpcm_streams_prerendered_song","synth_songpcm.c","",72,0},
+  {synth_cmdq_defers_and_counts_overflow,"synth_cmdq_defers_and_counts_overflow","synth_cmdq.c","",8,0},
+  {synth_cmdq_play_matches_direct,"synth_cmdq_play_matches_direct","synth_cmdq.c","",68,0},
+  {synth_env_fill_matches_per_frame,"synth_env_fill_matches_per_frame","synth_env_fill.c","",74,0},
+  {synth_voice_steal_oldest_keeps_newest,"synth_voice_steal_oldest_keeps_newest","synth_voice_steal.c","",12,0},
+  {synth_quality_underrun_and_recovery,"synth_quality_underrun_and_recovery","synth_quality.c","",10,0},
+  {synth_quality_ignores_single_spike,"synth_quality_ignores_single_spike","synth_quality.c","",35,0},
+};
+
+#endif
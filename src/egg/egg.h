@@ -141,6 +141,7 @@ WASM_IMPORT("egg_store_key_by_index") int egg_store_key_by_index(char *k,int ka,
 #define EGG_TID_decalsheet 8
 #define EGG_TID_map 9
 #define EGG_TID_sprite 10
+#define EGG_TID_songpcm 11
 #define EGG_TID_FOR_EACH \
   _(metadata) \
   _(code) \
@@ -151,7 +152,8 @@ WASM_IMPORT("egg_store_key_by_index") int egg_store_key_by_index(char *k,int ka,
   _(tilesheet) \
   _(decalsheet) \
   _(map) \
-  _(sprite)
+  _(sprite) \
+  _(songpcm)
   
 /* Input.
  *******************************************************************************/
@@ -219,7 +221,7 @@ WASM_IMPORT("egg_play_sound") void egg_play_sound(int rid,float trim,float pan);
 WASM_IMPORT("egg_play_song") void egg_play_song(int songid,int rid,int repeat,float trim,float pan);
 
 /* Set properties of a running song.
- * Moving the playhead is messy. It won't try to trigger notes that you land in the middle of them.
+ * Moving the playhead is a little messy. Notes held at the new position start over from their attack.
  * If you start a song and immediately move its playhead, the first notes might trigger too.
  */
 WASM_IMPORT("egg_song_set") void egg_song_set(int songid,int chid,int prop,float v);
@@ -233,12 +235,23 @@ WASM_IMPORT("egg_song_set") void egg_song_set(int songid,int chid,int prop,float
  * Wheel (v) in -8192..8191, the same range as MIDI but signed.
  * Note that buffering interferes with timing. You can't inject events with enough precision to play music.
  * It's for user-driven events, where a few milliseconds here or there would not be noticeable.
+ * If you do need precision, see egg_song_event_at.
  */
 WASM_IMPORT("egg_song_event_note_on") void egg_song_event_note_on(int songid,int chid,int noteid,int velocity);
 WASM_IMPORT("egg_song_event_note_off") void egg_song_event_note_off(int songid,int chid,int noteid);
 WASM_IMPORT("egg_song_event_note_once") void egg_song_event_note_once(int songid,int chid,int noteid,int velocity,int durms);
 WASM_IMPORT("egg_song_event_wheel") void egg_song_event_wheel(int songid,int chid,int v);
 
+/* Inject a note event at an exact moment on the song's playhead, in seconds, eg for rhythm games.
+ * It's the same timeline as egg_song_get_playhead. Aim a little ahead of it, since events can't land in audio already buffered.
+ * Times already passed play immediately. We don't account for looping; schedule within the current pass.
+ * (durms) only for EGG_SONG_EVENT_NOTE_ONCE.
+ */
+WASM_IMPORT("egg_song_event_at") void egg_song_event_at(int songid,int chid,int event,int noteid,int velocity,int durms,double playhead);
+#define EGG_SONG_EVENT_NOTE_OFF  0x80
+#define EGG_SONG_EVENT_NOTE_ON   0x90
+#define EGG_SONG_EVENT_NOTE_ONCE 0xa0
+
 /* Estimate the playhead of a running song, in seconds.
  * Synthesizers run in their own thread and are subject to buffering, so this is always going to be somewhat fuzzy.
  * Never exactly zero if a song on this (songid) is running.
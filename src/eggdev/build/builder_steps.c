@@ -2,6 +2,40 @@
 #include "eggdev/convert/eggdev_rom.h"
 #include "builder.h"
 
+/* Prerender a song we just compiled, and add it as songpcm with the same rid.
+ */
+ 
+static int eggdev_compile_songpcm(struct builder *builder,struct eggdev_rom_writer *writer,const char *path,int rid,const void *src,int srcc) {
+  struct sr_encoder dst={0};
+  struct sr_convert_context ctx={
+    .dst=&dst,
+    .src=src,
+    .srcc=srcc,
+    .refname=path,
+    .errmsg=builder->log,
+  };
+  int err=eggdev_songpcm_from_eau(&ctx);
+  if (err<0) {
+    sr_encoder_cleanup(&dst);
+    if (err!=-2) builder_error(builder,"%s: Unspecified error prerendering song.\n",path);
+    return -2;
+  }
+  int resp=eggdev_rom_writer_search(writer,EGG_TID_songpcm,rid);
+  if (resp>=0) {
+    builder_error(builder,"%s: Duplicate resource %d:%d\n",path,EGG_TID_songpcm,rid);
+    sr_encoder_cleanup(&dst);
+    return -2;
+  }
+  resp=-resp-1;
+  struct eggdev_rw_res *res=eggdev_rom_writer_insert(writer,resp,EGG_TID_songpcm,rid);
+  if (!res) {
+    sr_encoder_cleanup(&dst);
+    return -1;
+  }
+  eggdev_rw_res_handoff_serial(res,dst.v,dst.c);
+  return 0;
+}
+
 /* Read file, compile resource, and add to ROM.
  */
  
@@ -36,6 +70,9 @@ static int eggdev_compile_data_res(struct builder *builder,struct eggdev_rom_wri
     return -1;
   }
   eggdev_rw_res_handoff_serial(res,dst.v,dst.c);
+  if ((tid==EGG_TID_song)&&eggdev_res_path_has_comment(path,"prerender")) {
+    return eggdev_compile_songpcm(builder,writer,path,rid,res->v,res->c);
+  }
   return 0;
 }
 
@@ -66,6 +66,7 @@ int eggdev_zip_from_egg(struct sr_convert_context *ctx);
 int eggdev_png_from_png(struct sr_convert_context *ctx); // Same format, but some optimizations.
 int eggdev_wav_from_eau(struct sr_convert_context *ctx); // Stands a synthesizer and records it.
 int eggdev_wav_from_mid(struct sr_convert_context *ctx);
+int eggdev_songpcm_from_eau(struct sr_convert_context *ctx); // Prerender for streaming. See etc/doc/songpcm-format.md.
 int eau_cvt_midi_eau(struct sr_convert_context *ctx); // Owned by the "eau" unit, not us.
 int eau_cvt_eau_midi(struct sr_convert_context *ctx); // ''
 int eggdev_metadata_from_metatxt(struct sr_convert_context *ctx);
@@ -100,4 +101,9 @@ int eggdev_convert_auto(
   int tid
 );
 
+/* Render every song in a directory (MIDI or EAU), or every song and sound in a ROM, to WAV files in (dstdir).
+ * Runs in parallel, one child process per file, up to (g.jobs) or one per core.
+ */
+int eggdev_convert_batch(const char *dstdir,const char *srcpath);
+
 #endif
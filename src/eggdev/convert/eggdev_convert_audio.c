@@ -80,6 +80,35 @@ static int eggdev_synth_install_song(const void *src,int srcc) {
   return 0;
 }
 
+/* Stand a synthesizer for one conversion, current on the calling thread until eggdev_synth_end().
+ * Native builds get a private context, so batch conversion can run several of these at once on different threads.
+ * Where contexts aren't available, we use the default one, and only one conversion may run at a time.
+ */
+ 
+struct eggdev_synth {
+  struct synth_context *context;
+  struct synth_context *prev;
+};
+
+static int eggdev_synth_begin(struct eggdev_synth *es,int rate,int chanc,int buffer_frames) {
+  if ((es->context=synth_context_new(rate,chanc,buffer_frames))) {
+    es->prev=synth_context_use(es->context);
+    return 0;
+  }
+  es->prev=0;
+  return synth_init(rate,chanc,buffer_frames);
+}
+
+static void eggdev_synth_end(struct eggdev_synth *es) {
+  if (es->context) {
+    synth_context_use(es->prev);
+    synth_context_del(es->context);
+    es->context=0;
+  } else {
+    synth_quit();
+  }
+}
+
 /* Quantize and interleave from synth's split float buffers into WAV's interleaved s16 buffer.
  * Appends directly to (dst).
  */
@@ -124,22 +153,23 @@ int eggdev_wav_from_eau(struct sr_convert_context *ctx) {
   
   // Stand the synthesizer and load our song.
   int err=0;
-  if (synth_init(rate,chanc,buffer_frames)<0) {
+  struct eggdev_synth es;
+  if (eggdev_synth_begin(&es,rate,chanc,buffer_frames)<0) {
     return sr_convert_error(ctx,"Failed to create synthesizer, rate=%d, chanc=%d.",rate,chanc);
   }
   float *bufl=synth_get_buffer(0);
   float *bufr=synth_get_buffer(1);
   if (!bufl||((chanc>=2)&&!bufr)) {
-    synth_quit();
+    eggdev_synth_end(&es);
     return sr_convert_error(ctx,"Failed to acquire synth buffers.");
   }
   if (eggdev_synth_install_song(ctx->src,ctx->srcc)<0) {
-    synth_quit();
+    eggdev_synth_end(&es);
     return sr_convert_error(ctx,"Failed to install song in temporary synthesizer.");
   }
   synth_play_song(1,1,0,1.0f,0.0f);
   if (synth_get(1,0xff,SYNTH_PROP_EXISTENCE)<1.0f) {
-    synth_quit();
+    eggdev_synth_end(&es);
     return sr_convert_error(ctx,"Failed to start song. Likely misencoded.");
   }
   
@@ -172,11 +202,11 @@ int eggdev_wav_from_eau(struct sr_convert_context *ctx) {
     if (synth_get(1,0xff,SYNTH_PROP_EXISTENCE)<1.0f) break; // Stopped on its own, great.
     framec_total+=buffer_frames;
     if (framec_total>framec_panic) {
-      synth_quit();
+      eggdev_synth_end(&es);
       return sr_convert_error(ctx,"Panic! Song has not completed after %d frames.",framec_total);
     }
   }
-  synth_quit();
+  eggdev_synth_end(&es);
   
   // Eliminate silent frames from the tail. We update in blocks, so we've surely produced a substantial amount of silence.
   int framelen=2*chanc; // Size of a frame in bytes.
@@ -205,3 +235,174 @@ int eggdev_wav_from_eau(struct sr_convert_context *ctx) {
   
   return sr_encoder_assert(ctx->dst);
 }
+
+/* Songpcm, ie prerendered songs.
+ * See etc/doc/songpcm-format.md.
+ */
+ 
+#define EGGDEV_SONGPCM_RATE 22050
+#define EGGDEV_SONGPCM_BLOCK_FRAMES 1024
+#define EGGDEV_SONGPCM_TAIL_S 2 /* Render so far into the second pass, for tails from the first pass to die out. */
+#define EGGDEV_SONGPCM_SIZE_LIMIT 0x400000 /* Limit for any resource, per the ROM format. */
+
+static const int eggdev_adpcm_stepv[89]={
+  7,8,9,10,11,12,13,14,16,17,19,21,23,25,28,31,34,37,41,45,50,55,60,66,73,80,88,97,107,118,130,143,
+  157,173,190,209,230,253,279,307,337,371,408,449,494,544,598,658,724,796,876,963,1060,1166,1282,1411,1552,
+  1707,1878,2066,2272,2499,2749,3024,3327,3660,4026,4428,4871,5358,5894,6484,7132,7845,8630,9493,10442,11487,
+  12635,13899,15289,16818,18500,20350,22385,24623,27086,29794,32767,
+};
+
+static const int eggdev_adpcm_indexv[16]={-1,-1,-1,-1,2,4,6,8,-1,-1,-1,-1,2,4,6,8};
+
+/* Encode one sample, updating (pred,index) exactly as the decoder will.
+ */
+ 
+static int eggdev_adpcm_encode(int *pred,int *index,int sample) {
+  int step=eggdev_adpcm_stepv[*index];
+  int diff=sample-*pred,nybble=0;
+  if (diff<0) { nybble=8; diff=-diff; }
+  if (diff>=step) { nybble|=4; diff-=step; }
+  if (diff>=step>>1) { nybble|=2; diff-=step>>1; }
+  if (diff>=step>>2) nybble|=1;
+  int dq=step>>3;
+  if (nybble&4) dq+=step;
+  if (nybble&2) dq+=step>>1;
+  if (nybble&1) dq+=step>>2;
+  if (nybble&8) { if ((*pred-=dq)<-32768) *pred=-32768; }
+  else { if ((*pred+=dq)>32767) *pred=32767; }
+  if ((*index+=eggdev_adpcm_indexv[nybble])<0) *index=0;
+  else if (*index>88) *index=88;
+  return nybble;
+}
+
+/* Encode interleaved s16 PCM as songpcm.
+ */
+ 
+static int eggdev_songpcm_encode(struct sr_encoder *dst,const int16_t *pcm,int chanc,int framec,int endframe,int loopframe) {
+  if (sr_encode_raw(dst,"\0EPC",4)<0) return -1;
+  if (sr_encode_intbe(dst,EGGDEV_SONGPCM_RATE,4)<0) return -1;
+  if (sr_encode_u8(dst,chanc)<0) return -1;
+  if (sr_encode_u8(dst,0)<0) return -1;
+  if (sr_encode_intbe(dst,EGGDEV_SONGPCM_BLOCK_FRAMES,2)<0) return -1;
+  if (sr_encode_intbe(dst,framec,4)<0) return -1;
+  if (sr_encode_intbe(dst,endframe,4)<0) return -1;
+  if (sr_encode_intbe(dst,loopframe,4)<0) return -1;
+  int indexv[2]={0,0}; // Step index carries across blocks; each block's header records it.
+  int framep=0;
+  while (framep<framec) {
+    int blockc=framec-framep;
+    if (blockc>EGGDEV_SONGPCM_BLOCK_FRAMES) blockc=EGGDEV_SONGPCM_BLOCK_FRAMES;
+    const int16_t *src=pcm+framep*chanc;
+    int predv[2],c=0;
+    for (;c<chanc;c++) {
+      predv[c]=src[c];
+      if (sr_encode_intbe(dst,src[c],2)<0) return -1;
+      if (sr_encode_u8(dst,indexv[c])<0) return -1;
+      if (sr_encode_u8(dst,0)<0) return -1;
+    }
+    int nybblec=(blockc-1)*chanc;
+    if (sr_encoder_require(dst,(nybblec+1)>>1)<0) return -1;
+    uint8_t *v=((uint8_t*)dst->v)+dst->c;
+    int k=0;
+    for (src+=chanc,c=0;k<nybblec;k++,src++) {
+      int nybble=eggdev_adpcm_encode(predv+c,indexv+c,*src);
+      if (k&1) v[k>>1]|=nybble;
+      else v[k>>1]=nybble<<4;
+      if (++c>=chanc) c=0;
+    }
+    dst->c+=(nybblec+1)>>1;
+    framep+=blockc;
+  }
+  return 0;
+}
+
+/* Render an EAU song for streaming.
+ * We play it with repeat, until we've seen it loop and played a little of the second pass.
+ */
+
+int eggdev_songpcm_from_eau(struct sr_convert_context *ctx) {
+  const int rate=EGGDEV_SONGPCM_RATE;
+  const int buffer_frames=1024;
+  int framec_panic=rate*60*60;
+  struct eggdev_synth es;
+  if (eggdev_synth_begin(&es,rate,2,buffer_frames)<0) {
+    return sr_convert_error(ctx,"Failed to create synthesizer, rate=%d, chanc=2.",rate);
+  }
+  float *bufl=synth_get_buffer(0);
+  float *bufr=synth_get_buffer(1);
+  if (!bufl||!bufr) {
+    eggdev_synth_end(&es);
+    return sr_convert_error(ctx,"Failed to acquire synth buffers.");
+  }
+  if (eggdev_synth_install_song(ctx->src,ctx->srcc)<0) {
+    eggdev_synth_end(&es);
+    return sr_convert_error(ctx,"Failed to install song in temporary synthesizer.");
+  }
+  synth_play_song(1,1,1,1.0f,0.0f);
+  if (synth_get(1,0xff,SYNTH_PROP_EXISTENCE)<1.0f) {
+    eggdev_synth_end(&es);
+    return sr_convert_error(ctx,"Failed to start song. Likely misencoded.");
+  }
+  
+  /* Render in stereo, as s16 so we can reuse the WAV quantizer.
+   * The playhead matches our output until the song repeats, then it falls behind by the loop point.
+   */
+  struct sr_encoder pcm={0};
+  int framec=0,endframe=-1,loopframe=0,stopframe=0,tailc=0;
+  for (;;) {
+    synth_update(buffer_frames);
+    eggdev_synth_emit_stereo(&pcm,bufl,bufr,buffer_frames);
+    framec+=buffer_frames;
+    if (endframe<0) {
+      int loop=0;
+      int playhead=synth_get_song_frames(1,&loop);
+      if (playhead<0) {
+        eggdev_synth_end(&es);
+        sr_encoder_cleanup(&pcm);
+        return sr_convert_error(ctx,"Song ended despite repeat.");
+      }
+      if (playhead!=framec) {
+        endframe=framec-(playhead-loop);
+        loopframe=loop;
+        if (endframe-loopframe<buffer_frames) {
+          eggdev_synth_end(&es);
+          sr_encoder_cleanup(&pcm);
+          return sr_convert_error(ctx,"Loop too short to prerender, %d frames.",endframe-loopframe);
+        }
+        tailc=rate*EGGDEV_SONGPCM_TAIL_S;
+        if (tailc>endframe-loopframe) tailc=endframe-loopframe;
+        stopframe=endframe+tailc;
+      }
+    }
+    if ((endframe>=0)&&(framec>=stopframe)) break;
+    if (framec>framec_panic) {
+      eggdev_synth_end(&es);
+      sr_encoder_cleanup(&pcm);
+      return sr_convert_error(ctx,"Panic! Song has not looped after %d frames.",framec);
+    }
+  }
+  eggdev_synth_end(&es);
+  if (pcm.c<stopframe*4) { // Quantizing fails silently if we run out of memory.
+    sr_encoder_cleanup(&pcm);
+    return -1;
+  }
+  
+  /* Encode in stereo, and if that's too big, mix down to mono and try again.
+   */
+  int dstc0=ctx->dst->c;
+  int err=eggdev_songpcm_encode(ctx->dst,pcm.v,2,stopframe,endframe,loopframe+tailc);
+  if ((err>=0)&&(ctx->dst->c-dstc0>EGGDEV_SONGPCM_SIZE_LIMIT)) {
+    ctx->dst->c=dstc0;
+    int16_t *v=pcm.v;
+    int i=0;
+    for (;i<stopframe;i++) v[i]=(v[i*2]+v[i*2+1])>>1;
+    err=eggdev_songpcm_encode(ctx->dst,v,1,stopframe,endframe,loopframe+tailc);
+    if ((err>=0)&&(ctx->dst->c-dstc0>EGGDEV_SONGPCM_SIZE_LIMIT)) {
+      sr_encoder_cleanup(&pcm);
+      return sr_convert_error(ctx,"Too long to prerender, %d s. Limit is about %d s.",stopframe/rate,(EGGDEV_SONGPCM_SIZE_LIMIT*2)/rate);
+    }
+  }
+  sr_encoder_cleanup(&pcm);
+  if (err<0) return err;
+  return sr_encoder_assert(ctx->dst);
+}
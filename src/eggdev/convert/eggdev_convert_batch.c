@@ -0,0 +1,235 @@
+/* eggdev_convert_batch.c
+ * Render a directory of songs, or every song and sound in a ROM, to WAV files.
+ * Each conversion stands its own synth context, so we run them on up to (g.jobs) threads, default one per core.
+ * Workers pull the next job off a shared counter, same as synth's own song threads.
+ */
+
+#include "eggdev/eggdev_internal.h"
+#include "eggdev/convert/eggdev_rom.h"
+#include <unistd.h>
+#include <pthread.h>
+
+#define EGGDEV_BATCH_THREAD_LIMIT 64
+
+struct eggdev_batch {
+  const char *dstdir;
+  struct eggdev_batch_job {
+    char *srcpath; // Read by the worker. Null if (src) is set.
+    const void *src; // WEAK, into the ROM.
+    int srcc;
+    int srcfmt;
+    char *dstname;
+    int err; // Set by the worker.
+  } *jobv;
+  int jobc,joba;
+  int jobp; // Next job index. Accessed atomically.
+  void *rom;
+};
+
+static void eggdev_batch_cleanup(struct eggdev_batch *batch) {
+  if (batch->jobv) {
+    struct eggdev_batch_job *job=batch->jobv;
+    int i=batch->jobc;
+    for (;i-->0;job++) {
+      if (job->srcpath) free(job->srcpath);
+      if (job->dstname) free(job->dstname);
+    }
+    free(batch->jobv);
+  }
+  if (batch->rom) free(batch->rom);
+}
+
+static struct eggdev_batch_job *eggdev_batch_add(struct eggdev_batch *batch,const char *dstname,int dstnamec) {
+  if (batch->jobc>=batch->joba) {
+    int na=batch->joba+32;
+    if (na>INT_MAX/sizeof(struct eggdev_batch_job)) return 0;
+    void *nv=realloc(batch->jobv,sizeof(struct eggdev_batch_job)*na);
+    if (!nv) return 0;
+    batch->jobv=nv;
+    batch->joba=na;
+  }
+  struct eggdev_batch_job *job=batch->jobv+batch->jobc++;
+  memset(job,0,sizeof(struct eggdev_batch_job));
+  if (!(job->dstname=malloc(dstnamec+1))) {
+    batch->jobc--;
+    return 0;
+  }
+  memcpy(job->dstname,dstname,dstnamec);
+  job->dstname[dstnamec]=0;
+  return job;
+}
+
+/* Collect jobs from a directory: Every MIDI or EAU file directly in it.
+ */
+
+static int eggdev_batch_cb_dir(const char *path,const char *base,char type,void *userdata) {
+  struct eggdev_batch *batch=userdata;
+  int srcfmt=eggdev_fmt_by_path(path,-1);
+  if ((srcfmt!=EGGDEV_FMT_mid)&&(srcfmt!=EGGDEV_FMT_eau)) return 0;
+  int basec=0;
+  while (base[basec]) basec++;
+  int stemc=basec;
+  while (stemc&&(base[stemc-1]!='.')) stemc--;
+  if (stemc) stemc--; else stemc=basec;
+  char dstname[256];
+  int dstnamec=snprintf(dstname,sizeof(dstname),"%.*s.wav",stemc,base);
+  if ((dstnamec<1)||(dstnamec>=sizeof(dstname))) return 0;
+  struct eggdev_batch_job *job=eggdev_batch_add(batch,dstname,dstnamec);
+  if (!job) return -1;
+  if (!(job->srcpath=strdup(path))) return -1;
+  job->srcfmt=srcfmt;
+  return 0;
+}
+
+/* Collect jobs from a ROM: Every song and sound, named by type and rid.
+ */
+
+static int eggdev_batch_add_rom(struct eggdev_batch *batch,const char *srcpath) {
+  int romc=file_read(&batch->rom,srcpath);
+  if (romc<0) {
+    fprintf(stderr,"%s: Failed to read file.\n",srcpath);
+    return -2;
+  }
+  struct eggdev_rom_reader reader;
+  if (eggdev_rom_reader_init(&reader,batch->rom,romc)<0) {
+    fprintf(stderr,"%s: Not a ROM.\n",srcpath);
+    return -2;
+  }
+  struct eggdev_res res;
+  while (eggdev_rom_reader_next(&res,&reader)>0) {
+    const char *tname;
+    switch (res.tid) {
+      case EGG_TID_song: tname="song"; break;
+      case EGG_TID_sound: tname="sound"; break;
+      default: continue;
+    }
+    if (res.c<1) continue;
+    char dstname[64];
+    int dstnamec=snprintf(dstname,sizeof(dstname),"%s-%d.wav",tname,res.rid);
+    struct eggdev_batch_job *job=eggdev_batch_add(batch,dstname,dstnamec);
+    if (!job) return -1;
+    job->src=res.v;
+    job->srcc=res.c;
+    job->srcfmt=EGGDEV_FMT_eau;
+  }
+  return 0;
+}
+
+/* Convert one file and write it, on any thread.
+ * Errors are logged as they happen, and returned so the main thread can count them.
+ */
+
+static int eggdev_batch_run_job(struct eggdev_batch *batch,struct eggdev_batch_job *job) {
+  char dstpath[1024];
+  int dstpathc=path_join(dstpath,sizeof(dstpath),batch->dstdir,-1,job->dstname,-1);
+  if ((dstpathc<1)||(dstpathc>=sizeof(dstpath))) {
+    fprintf(stderr,"%s: Output path too long.\n",job->dstname);
+    return -2;
+  }
+  void *src=(void*)job->src;
+  int srcc=job->srcc;
+  const char *refname=job->srcpath?job->srcpath:job->dstname;
+  if (job->srcpath) {
+    src=0;
+    if ((srcc=file_read(&src,job->srcpath))<0) {
+      fprintf(stderr,"%s: Failed to read file.\n",job->srcpath);
+      return -2;
+    }
+  }
+  struct sr_encoder dst={0};
+  int err=eggdev_convert_auto(&dst,src,srcc,EGGDEV_FMT_wav,job->srcfmt,dstpath,refname,0);
+  if (job->srcpath) free(src);
+  if (err<0) {
+    if (err!=-2) fprintf(stderr,"%s: Unspecified error during conversion.\n",refname);
+    sr_encoder_cleanup(&dst);
+    return -2;
+  }
+  err=file_write(dstpath,dst.v,dst.c);
+  sr_encoder_cleanup(&dst);
+  if (err<0) {
+    fprintf(stderr,"%s: Failed to write file.\n",dstpath);
+    return -2;
+  }
+  return 0;
+}
+
+/* Worker thread: Run jobs until there aren't any.
+ */
+
+static void *eggdev_batch_thread(void *arg) {
+  struct eggdev_batch *batch=arg;
+  for (;;) {
+    int p=__atomic_fetch_add(&batch->jobp,1,__ATOMIC_ACQ_REL);
+    if (p>=batch->jobc) return 0;
+    struct eggdev_batch_job *job=batch->jobv+p;
+    job->err=eggdev_batch_run_job(batch,job);
+  }
+}
+
+/* Run all jobs, (jobs) at a time.
+ * The calling thread works too, so if threads can't be created, we still finish, just slower.
+ * Returns the count of failures.
+ */
+
+static int eggdev_batch_run(struct eggdev_batch *batch,int jobs) {
+  if (jobs>batch->jobc) jobs=batch->jobc;
+  if (jobs>EGGDEV_BATCH_THREAD_LIMIT) jobs=EGGDEV_BATCH_THREAD_LIMIT;
+  pthread_t thdv[EGGDEV_BATCH_THREAD_LIMIT];
+  int thdc=0;
+  batch->jobp=0;
+  while (thdc<jobs-1) {
+    if (pthread_create(thdv+thdc,0,eggdev_batch_thread,batch)) break;
+    thdc++;
+  }
+  eggdev_batch_thread(batch);
+  while (thdc-->0) pthread_join(thdv[thdc],0);
+  int failc=0;
+  const struct eggdev_batch_job *job=batch->jobv;
+  int i=batch->jobc;
+  for (;i-->0;job++) {
+    if (job->err<0) failc++;
+  }
+  return failc;
+}
+
+/* Batch conversion, entry point.
+ */
+
+int eggdev_convert_batch(const char *dstdir,const char *srcpath) {
+  if (!dstdir) {
+    fprintf(stderr,"%s: Output directory required, eg '-oout/wav'.\n",srcpath);
+    return -2;
+  }
+  struct eggdev_batch batch={.dstdir=dstdir};
+  int err;
+  if (file_get_type(srcpath)=='d') err=dir_read(srcpath,eggdev_batch_cb_dir,&batch);
+  else err=eggdev_batch_add_rom(&batch,srcpath);
+  if (err<0) {
+    if (err!=-2) fprintf(stderr,"%s: Failed to list songs.\n",srcpath);
+    eggdev_batch_cleanup(&batch);
+    return -2;
+  }
+  if (!batch.jobc) {
+    fprintf(stderr,"%s: No songs found.\n",srcpath);
+    eggdev_batch_cleanup(&batch);
+    return 0;
+  }
+  if (dir_mkdirp(dstdir)<0) {
+    fprintf(stderr,"%s: Failed to create directory.\n",dstdir);
+    eggdev_batch_cleanup(&batch);
+    return -2;
+  }
+  int jobs=g.jobs;
+  if (jobs<1) {
+    #ifdef _SC_NPROCESSORS_ONLN
+      long n=sysconf(_SC_NPROCESSORS_ONLN);
+      jobs=(n>0)?(int)n:1;
+    #else
+      jobs=1;
+    #endif
+  }
+  int failc=eggdev_batch_run(&batch,jobs);
+  fprintf(stderr,"%s: Wrote %d of %d WAV files to %s.\n",srcpath,batch.jobc-failc,batch.jobc,dstdir);
+  eggdev_batch_cleanup(&batch);
+  return failc?-2:0;
+}
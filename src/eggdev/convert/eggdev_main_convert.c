@@ -13,6 +13,15 @@ int eggdev_main_convert() {
   }
   if (g.dstpath) dstpath=g.dstpath;
   else dstpath="<stdout>";
+  
+  // Directories, and ROMs headed for WAV, convert in batch.
+  if (g.srcpathc==1) {
+    if (file_get_type(srcpath)=='d') return eggdev_convert_batch(g.dstpath,srcpath);
+    if ((eggdev_fmt_eval(g.dstfmt,-1)==EGGDEV_FMT_wav)&&(eggdev_fmt_by_path(srcpath,-1)==EGGDEV_FMT_egg)) {
+      return eggdev_convert_batch(g.dstpath,srcpath);
+    }
+  }
+  
   void *src=0;
   int srcc=eggdev_read_input(&src,srcpath);
   int err=-1;
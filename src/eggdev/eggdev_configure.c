@@ -199,6 +199,7 @@ static int eggdev_argv_kv(const char *k,int kc,const char *v,int vc) {
   if ((kc==5)&&!memcmp(k,"strip",5)) { g.strip=vn; return 0; }
   if ((kc==4)&&!memcmp(k,"rate",4)) { g.rate=vn; return 0; }
   if ((kc==5)&&!memcmp(k,"chanc",5)) { g.chanc=vn; return 0; }
+  if ((kc==4)&&!memcmp(k,"jobs",4)) { g.jobs=vn; return 0; }
   
   fprintf(stderr,"%s: Unexpected option '%.*s' = '%.*s'\n",g.exename,kc,k,vc,v);
   return -2;
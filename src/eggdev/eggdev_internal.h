@@ -24,6 +24,7 @@ extern struct g {
   int srcpathc,srcpatha;
   char *dstfmt,*srcfmt; // convert
   int strip,rate,chanc; // convert
+  int jobs; // convert, batch mode
   char **htdocsv;
   int htdocsc,htdocsa;
   int port;
@@ -151,6 +152,7 @@ int eggdev_write_stdout(const void *src,int srcc);
 int eggdev_lineno(const char *src,int srcc);
 int eggdev_relative_path(char *dst,int dsta,const char *ref,int refc,const char *sub,int subc);
 int eggdev_res_ids_from_path(int *tid,int *rid,const char *path);
+int eggdev_res_path_has_comment(const char *path,const char *word); // Nonzero if (word) is one of COMMENT's dot-delimited tokens.
 
 // The meat and potatoes of `eggdev dump`, also available programmatically.
 void eggdev_dump_serial(const uint8_t *src,int srcc);
@@ -99,3 +99,26 @@ int eggdev_res_ids_from_path(int *tid,int *rid,const char *path) {
   }
   return 0;
 }
+
+/* Resource path comment.
+ */
+ 
+int eggdev_res_path_has_comment(const char *path,const char *word) {
+  const char *base=path;
+  int pathp=0;
+  for (;path[pathp];pathp++) if (path[pathp]=='/') base=path+pathp+1;
+  int wordc=0;
+  while (word[wordc]) wordc++;
+  // Skip "RID[-NAME]", then every dot-delimited token except the last (FORMAT) is part of COMMENT.
+  while (*base&&(*base!='.')) base++;
+  while (*base=='.') {
+    base++;
+    const char *token=base;
+    int tokenc=0;
+    while (base[tokenc]&&(base[tokenc]!='.')) tokenc++;
+    base+=tokenc;
+    if (!*base) break;
+    if ((tokenc==wordc)&&!memcmp(token,word,wordc)) return 1;
+  }
+  return 0;
+}
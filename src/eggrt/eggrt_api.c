@@ -72,9 +72,13 @@ int egg_prefs_set(int k,int v) {
     case EGG_PREF_MUSIC: {
         if (v<0) v=0; else if (v>99) v=99;
         if (v==eggrt.music_level) return 0;
-        if (hostio_audio_lock(eggrt.hostio)<0) return -1;
-        synth_set(0,0,SYNTH_PROP_MUSIC_TRIM,v/99.0f);
-        hostio_audio_unlock(eggrt.hostio);
+        if (eggrt.audio_queue>0) {
+          if (synth_queue_set(0,0,SYNTH_PROP_MUSIC_TRIM,v/99.0f)<0) return -1;
+        } else {
+          if (hostio_audio_lock(eggrt.hostio)<0) return -1;
+          synth_set(0,0,SYNTH_PROP_MUSIC_TRIM,v/99.0f);
+          hostio_audio_unlock(eggrt.hostio);
+        }
         eggrt.music_level=v;
         eggrt_call_client_notify(k,v);
       } return 0;
@@ -82,9 +86,13 @@ int egg_prefs_set(int k,int v) {
     case EGG_PREF_SOUND: {
         if (v<0) v=0; else if (v>99) v=99;
         if (v==eggrt.sound_level) return 0;
-        if (hostio_audio_lock(eggrt.hostio)<0) return -1;
-        synth_set(0,0,SYNTH_PROP_SOUND_TRIM,v/99.0f);
-        hostio_audio_unlock(eggrt.hostio);
+        if (eggrt.audio_queue>0) {
+          if (synth_queue_set(0,0,SYNTH_PROP_SOUND_TRIM,v/99.0f)<0) return -1;
+        } else {
+          if (hostio_audio_lock(eggrt.hostio)<0) return -1;
+          synth_set(0,0,SYNTH_PROP_SOUND_TRIM,v/99.0f);
+          hostio_audio_unlock(eggrt.hostio);
+        }
         eggrt.sound_level=v;
         eggrt_call_client_notify(k,v);
       } return 0;
@@ -198,7 +206,10 @@ int egg_input_get_mouse(int *x,int *y) {
  
 void egg_play_sound(int soundid,float trim,float pan) {
   //if (!eggrt.sound_enable) return;//XXX
+  // If the queue is full or can't take it, lock instead. Flush first so it lands after anything already queued.
+  if ((eggrt.audio_queue>0)&&(synth_queue_play_sound(soundid,trim,pan)>=0)) return;
   if (hostio_audio_lock(eggrt.hostio)<0) return;
+  synth_flush_queue();
   synth_play_sound(soundid,trim,pan);
   hostio_audio_unlock(eggrt.hostio);
 }
@@ -207,7 +218,9 @@ void egg_play_song(int songid,int rid,int repeat,float trim,float pan) {
   eggrt.songid=rid;//XXX eggrt needs to track multiple songs. (or none, do we need to track at all anymore?)
   eggrt.songrepeat=repeat;
   //if (!eggrt.music_enable) return;//XXX
+  if ((eggrt.audio_queue>0)&&(synth_queue_play_song(songid,rid,repeat,trim,pan)>=0)) return;
   if (hostio_audio_lock(eggrt.hostio)<0) return;
+  synth_flush_queue();
   synth_play_song(songid,rid,repeat,trim,pan);
   hostio_audio_unlock(eggrt.hostio);
 }
@@ -222,24 +235,42 @@ void egg_song_set(int songid,int chid,int prop,float v) {
       break;
     default: return;
   }
+  // Seeking stays behind the lock. It can build the seek index, which we don't want on the audio thread.
+  if ((eggrt.audio_queue>0)&&(prop!=EGG_SONG_PROP_PLAYHEAD)) {
+    synth_queue_set(songid,chid,prop,v);
+    return;
+  }
   if (hostio_audio_lock(eggrt.hostio)<0) return;
+  synth_flush_queue();
   synth_set(songid,chid,prop,v);
   hostio_audio_unlock(eggrt.hostio);
 }
 
 void egg_song_event_note_on(int songid,int chid,int noteid,int velocity) {
+  if (eggrt.audio_queue>0) {
+    synth_queue_note_on(songid,chid,noteid,velocity);
+    return;
+  }
   if (hostio_audio_lock(eggrt.hostio)<0) return;
   synth_event_note_on(songid,chid,noteid,velocity);
   hostio_audio_unlock(eggrt.hostio);
 }
 
 void egg_song_event_note_off(int songid,int chid,int noteid) {
+  if (eggrt.audio_queue>0) {
+    synth_queue_note_off(songid,chid,noteid,0x40);
+    return;
+  }
   if (hostio_audio_lock(eggrt.hostio)<0) return;
   synth_event_note_off(songid,chid,noteid,0x40);
   hostio_audio_unlock(eggrt.hostio);
 }
 
 void egg_song_event_note_once(int songid,int chid,int noteid,int velocity,int durms) {
+  if (eggrt.audio_queue>0) {
+    synth_queue_note_once(songid,chid,noteid,velocity,durms);
+    return;
+  }
   if (hostio_audio_lock(eggrt.hostio)<0) return;
   synth_event_note_once(songid,chid,noteid,velocity,durms);
   hostio_audio_unlock(eggrt.hostio);
@@ -250,13 +281,26 @@ void egg_song_event_wheel(int songid,int chid,int v) {
   if (v<=-8192) vf=-1.0f;
   else if (v>=8192) vf=1.0f;
   else vf=(float)v/8192.0f;
+  if (eggrt.audio_queue>0) {
+    synth_queue_set(songid,chid,SYNTH_PROP_WHEEL,vf);
+    return;
+  }
   if (hostio_audio_lock(eggrt.hostio)<0) return;
   synth_set(songid,chid,SYNTH_PROP_WHEEL,vf);
   hostio_audio_unlock(eggrt.hostio);
 }
 
+void egg_song_event_at(int songid,int chid,int event,int noteid,int velocity,int durms,double playhead) {
+  if ((eggrt.audio_queue>0)&&(synth_queue_event_at(songid,chid,event,noteid,velocity,durms,SYNTH_TIME_PLAYHEAD,playhead)>=0)) return;
+  if (hostio_audio_lock(eggrt.hostio)<0) return;
+  synth_flush_queue();
+  synth_event_at(songid,chid,event,noteid,velocity,durms,SYNTH_TIME_PLAYHEAD,playhead);
+  hostio_audio_unlock(eggrt.hostio);
+}
+
 float egg_song_get_playhead(int songid) {
   if (hostio_audio_lock(eggrt.hostio)<0) return 0.0;
+  synth_flush_queue(); // Observe anything queued before us, eg a song stopped.
   double p=synth_get(songid,0xff,SYNTH_PROP_PLAYHEAD);
   if (p<=0.0) {
     hostio_audio_unlock(eggrt.hostio);
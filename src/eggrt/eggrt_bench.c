@@ -0,0 +1,285 @@
+/* eggrt_bench.c
+ * Repeatable runs for performance measurement: Scripted input, and a per-frame timing report.
+ * Typically with --video=headless --audio=dummy --clock=redline --frames=COUNT.
+ *
+ * Input script, --input-script=PATH: Line-oriented text. '#' begins a line comment.
+ *   FRAME PLAYERID [BUTTON...]
+ * From update FRAME (counting from 1), player PLAYERID holds exactly the named buttons and nothing else.
+ * BUTTON per inmgr_btnid_eval, eg "LEFT SOUTH". Signals like "MENU" fire once. Extended buttons are not supported.
+ * FRAME must not decrease.
+ *
+ * Frame report, --frame-report=PATH: Written at quit, one line per rendered frame:
+ *   FRAME UPDATE_US RENDER_US DRAWS VERTICES [HASH]
+ * HASH only with --frame-hash, and only if the renderer exposes its output (softrender).
+ * It's 64-bit FNV-1a of the final RGBA image, good for spotting that a change altered the picture.
+ */
+
+#include "eggrt_internal.h"
+#include "opt/fs/fs.h"
+#include "opt/serial/serial.h"
+#include <stddef.h>
+#include <time.h>
+
+static double eggrt_bench_update_time=0.0;
+static double eggrt_bench_render_time=0.0;
+static double eggrt_bench_update_us=0.0;
+
+/* Primitives.
+ */
+
+static double eggrt_bench_now() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_MONOTONIC,&tv);
+  return (double)tv.tv_sec+(double)tv.tv_nsec/1000000000.0;
+}
+
+static uint64_t eggrt_bench_hash(const uint8_t *src,int w,int h,int stride) {
+  uint64_t hash=0xcbf29ce484222325ull;
+  int rowlen=w<<2;
+  for (;h-->0;src+=stride) {
+    const uint8_t *p=src;
+    int i=rowlen;
+    for (;i-->0;p++) {
+      hash^=*p;
+      hash*=0x100000001b3ull;
+    }
+  }
+  return hash;
+}
+
+/* Add a script event.
+ */
+
+static int eggrt_script_add(int frame,int playerid,int btnid,int value) {
+  if (eggrt.scriptc>=eggrt.scripta) {
+    int na=eggrt.scripta+64;
+    if (na>INT_MAX/sizeof(struct eggrt_script_event)) return -1;
+    void *nv=realloc(eggrt.scriptv,sizeof(struct eggrt_script_event)*na);
+    if (!nv) return -1;
+    eggrt.scriptv=nv;
+    eggrt.scripta=na;
+  }
+  struct eggrt_script_event *event=eggrt.scriptv+eggrt.scriptc++;
+  event->frame=frame;
+  event->playerid=playerid;
+  event->btnid=btnid;
+  event->value=value;
+  return 0;
+}
+
+/* Decode input script.
+ * Each line becomes events for the buttons that changed, per player.
+ */
+
+static int eggrt_script_decode(const char *src,int srcc,const char *path) {
+  int statev[1+INMGR_PLAYER_LIMIT]={0};
+  struct sr_decoder decoder={.v=src,.c=srcc};
+  const char *line;
+  int linec,lineno=0,frame=0;
+  while ((linec=sr_decode_line(&line,&decoder))>0) {
+    lineno++;
+    int linep=0;
+    const char *tokenv[3+32];
+    int tokenlv[3+32];
+    int tokenc=0;
+    while (linep<linec) {
+      if ((unsigned char)line[linep]<=0x20) { linep++; continue; }
+      if (line[linep]=='#') break;
+      if (tokenc>=sizeof(tokenv)/sizeof(tokenv[0])) {
+        fprintf(stderr,"%s:%d: Too many buttons.\n",path,lineno);
+        return -2;
+      }
+      tokenv[tokenc]=line+linep;
+      tokenlv[tokenc]=0;
+      while ((linep<linec)&&((unsigned char)line[linep]>0x20)) { linep++; tokenlv[tokenc]++; }
+      tokenc++;
+    }
+    if (!tokenc) continue;
+
+    int nframe,playerid;
+    if ((tokenc<2)||(sr_int_eval(&nframe,tokenv[0],tokenlv[0])<2)||(sr_int_eval(&playerid,tokenv[1],tokenlv[1])<2)) {
+      fprintf(stderr,"%s:%d: Expected 'FRAME PLAYERID [BUTTON...]'.\n",path,lineno);
+      return -2;
+    }
+    if (nframe<frame) {
+      fprintf(stderr,"%s:%d: Frame %d is before the previous line's %d.\n",path,lineno,nframe,frame);
+      return -2;
+    }
+    if ((playerid<1)||(playerid>INMGR_PLAYER_LIMIT)) {
+      fprintf(stderr,"%s:%d: Invalid player id %d.\n",path,lineno,playerid);
+      return -2;
+    }
+    frame=nframe;
+
+    int state=0,i=2;
+    for (;i<tokenc;i++) {
+      int btnid=0;
+      if (inmgr_btnid_eval(&btnid,tokenv[i],tokenlv[i])<0) {
+        fprintf(stderr,"%s:%d: Unknown button '%.*s'.\n",path,lineno,tokenlv[i],tokenv[i]);
+        return -2;
+      }
+      if (btnid&0xff000000) {
+        if (eggrt_script_add(frame,playerid,btnid,1)<0) return -1;
+      } else if (btnid&~0xffff) {
+        fprintf(stderr,"%s:%d: Extended button '%.*s' not supported in input scripts.\n",path,lineno,tokenlv[i],tokenv[i]);
+        return -2;
+      } else {
+        state|=btnid;
+      }
+    }
+    int bit=1;
+    for (;bit<0x10000;bit<<=1) {
+      if ((state&bit)==(statev[playerid]&bit)) continue;
+      if (eggrt_script_add(frame,playerid,bit,(state&bit)?1:0)<0) return -1;
+    }
+    statev[playerid]=state;
+  }
+  return 0;
+}
+
+/* Init.
+ */
+
+int eggrt_bench_init() {
+  if (eggrt.input_script) {
+    void *src=0;
+    int srcc=file_read(&src,eggrt.input_script);
+    if (srcc<0) {
+      fprintf(stderr,"%s: Failed to read input script.\n",eggrt.input_script);
+      return -2;
+    }
+    int err=eggrt_script_decode(src,srcc,eggrt.input_script);
+    free(src);
+    if (err<0) {
+      if (err!=-2) fprintf(stderr,"%s: Failed to decode input script.\n",eggrt.input_script);
+      return -2;
+    }
+  }
+  if (eggrt.frame_hash) {
+    if (!eggrt.frame_report) {
+      fprintf(stderr,"%s: --frame-hash has no effect without --frame-report.\n",eggrt.exename);
+      eggrt.frame_hash=0;
+    } else if (!render_get_output(0,0,0,eggrt.render)) {
+      fprintf(stderr,"%s: Renderer does not expose its output. Frame hashes require 'softrender'.\n",eggrt.exename);
+      eggrt.frame_hash=0;
+    }
+  }
+  return 0;
+}
+
+/* Quit, and write the report.
+ */
+
+static int eggrt_bench_cmp_int(const void *a,const void *b) {
+  return *(const int*)a-*(const int*)b;
+}
+
+struct eggrt_bench_summary {
+  double average;
+  int median,p99,max;
+};
+
+static int eggrt_bench_summarize(struct eggrt_bench_summary *summary,const struct eggrt_frame_record *recordv,int recordc,int offset) {
+  if (recordc<1) return -1;
+  int *v=malloc(sizeof(int)*recordc);
+  if (!v) return -1;
+  int64_t sum=0;
+  int i=0; for (;i<recordc;i++) {
+    v[i]=*(const int*)((const char*)(recordv+i)+offset);
+    sum+=v[i];
+  }
+  qsort(v,recordc,sizeof(int),eggrt_bench_cmp_int);
+  summary->average=(double)sum/recordc;
+  summary->median=v[recordc/2];
+  summary->p99=v[(int)((int64_t)recordc*99/100)];
+  summary->max=v[recordc-1];
+  free(v);
+  return 0;
+}
+
+static void eggrt_bench_print_summary(const char *label,int offset) {
+  struct eggrt_bench_summary summary;
+  if (eggrt_bench_summarize(&summary,eggrt.framerecv,eggrt.framerecc,offset)<0) return;
+  fprintf(stderr,
+    "  %s us: average %.01f, median %d, 99th %d, max %d\n",
+    label,summary.average,summary.median,summary.p99,summary.max
+  );
+}
+
+void eggrt_bench_quit() {
+  if (eggrt.frame_report&&eggrt.framerecc) {
+    struct sr_encoder dst={0};
+    sr_encode_fmt(&dst,"# FRAME UPDATE_US RENDER_US DRAWS VERTICES%s\n",eggrt.frame_hash?" HASH":"");
+    const struct eggrt_frame_record *record=eggrt.framerecv;
+    int i=eggrt.framerecc;
+    for (;i-->0;record++) {
+      sr_encode_fmt(&dst,"%d %d %d %d %d",record->frame,record->update_us,record->render_us,record->drawc,record->vtxc);
+      if (eggrt.frame_hash) sr_encode_fmt(&dst," %08x%08x",(unsigned)(record->hash>>32),(unsigned)record->hash);
+      sr_encode_raw(&dst,"\n",1);
+    }
+    if (file_write(eggrt.frame_report,dst.v,dst.c)<0) {
+      fprintf(stderr,"%s: Failed to write frame report.\n",eggrt.frame_report);
+    } else {
+      fprintf(stderr,"Frame report: %d frames, wrote %s\n",eggrt.framerecc,eggrt.frame_report);
+      eggrt_bench_print_summary("Update",(int)offsetof(struct eggrt_frame_record,update_us));
+      eggrt_bench_print_summary("Render",(int)offsetof(struct eggrt_frame_record,render_us));
+    }
+    sr_encoder_cleanup(&dst);
+  }
+  if (eggrt.scriptv) free(eggrt.scriptv);
+  if (eggrt.framerecv) free(eggrt.framerecv);
+  eggrt.scriptv=0;
+  eggrt.scriptc=eggrt.scripta=eggrt.scriptp=0;
+  eggrt.framerecv=0;
+  eggrt.framerecc=eggrt.framereca=0;
+}
+
+/* Per-frame hooks.
+ */
+
+void eggrt_bench_input() {
+  while (eggrt.scriptp<eggrt.scriptc) {
+    const struct eggrt_script_event *event=eggrt.scriptv+eggrt.scriptp;
+    if (event->frame>eggrt.updframec) break;
+    eggrt.scriptp++;
+    inmgr_artificial_event(event->playerid,event->btnid,event->value);
+  }
+}
+
+void eggrt_bench_update_begin() {
+  if (!eggrt.frame_report) return;
+  eggrt_bench_update_time=eggrt_bench_now();
+}
+
+void eggrt_bench_render_begin() {
+  if (!eggrt.frame_report) return;
+  eggrt_bench_render_time=eggrt_bench_now();
+  eggrt_bench_update_us=(eggrt_bench_render_time-eggrt_bench_update_time)*1000000.0;
+}
+
+void eggrt_bench_frame_end() {
+  if (!eggrt.frame_report) return;
+  double render_us=(eggrt_bench_now()-eggrt_bench_render_time)*1000000.0;
+  if (eggrt.framerecc>=eggrt.framereca) {
+    int na=eggrt.framereca+1024;
+    if (na>INT_MAX/sizeof(struct eggrt_frame_record)) return;
+    void *nv=realloc(eggrt.framerecv,sizeof(struct eggrt_frame_record)*na);
+    if (!nv) return;
+    eggrt.framerecv=nv;
+    eggrt.framereca=na;
+  }
+  struct eggrt_frame_record *record=eggrt.framerecv+eggrt.framerecc++;
+  struct render_stats stats;
+  render_get_stats(&stats,eggrt.render);
+  record->frame=eggrt.updframec;
+  record->update_us=(int)eggrt_bench_update_us;
+  record->render_us=(int)render_us;
+  record->drawc=stats.drawc_last;
+  record->vtxc=stats.vtxc_last;
+  record->hash=0;
+  if (eggrt.frame_hash) {
+    int w=0,h=0,stride=0;
+    const void *rgba=render_get_output(&w,&h,&stride,eggrt.render);
+    if (rgba) record->hash=eggrt_bench_hash(rgba,w,h,stride);
+  }
+}
@@ -28,6 +28,17 @@ static void eggrt_sleep(double s) {
   usleep(us);
 }
 
+/* Evaluate clock mode name.
+ */
+ 
+int eggrt_clockmode_eval(const char *src) {
+  if (!src||!src[0]) return EGGRT_CLOCKMODE_NORMAL;
+  if (!strcmp(src,"normal")) return EGGRT_CLOCKMODE_NORMAL;
+  if (!strcmp(src,"uniform")) return EGGRT_CLOCKMODE_UNIFORM;
+  if (!strcmp(src,"redline")) return EGGRT_CLOCKMODE_REDLINE;
+  return -1;
+}
+
 /* Init.
  */
  
@@ -124,3 +135,66 @@ void eggrt_clock_report() {
     eggrt.updframec,elapsed_real,avgrate,cpuload,eggrt.clockfaultc,eggrt.clockclampc
   );
 }
+
+/* Audio profile report.
+ * Times are shown in ms and as a fraction of the audio they produced, ie 100% means it can't keep up.
+ */
+ 
+static void eggrt_audio_profile_report_song(const struct synth_profile_song *song,double rate) {
+  double playtime=(double)song->framec/rate;
+  if (playtime<=0.0) return;
+  fprintf(stderr,"  song:%d: %.03f ms, %.02f%% of %.03f s\n",song->rid,song->ns/1000000.0,(song->ns*100.0)/(playtime*1000000000.0),playtime);
+  const struct synth_profile_channel *channel=song->channelv;
+  int chid=0;
+  for (;chid<16;chid++,channel++) {
+    if (!channel->ns&&!channel->post_ns) continue;
+    fprintf(stderr,"    ch %2d: %.03f ms + post %.03f ms, voices %d\n",chid,channel->ns/1000000.0,channel->post_ns/1000000.0,channel->voicec_max);
+  }
+}
+ 
+void eggrt_audio_profile_report() {
+  if (!eggrt.audio_profile) return;
+  if (hostio_audio_lock(eggrt.hostio)<0) return;
+  struct synth_profile profile={0};
+  struct synth_profile_song songv[64];
+  int songc=0;
+  if (synth_get_profile(&profile)>=0) {
+    songc=synth_get_song_profiles(songv,sizeof(songv)/sizeof(songv[0]));
+  }
+  hostio_audio_unlock(eggrt.hostio);
+  if (profile.framec<1) return;
+  
+  double outtime=(double)profile.framec/(double)synth_get_output_rate();
+  fprintf(stderr,
+    "Audio profile: %.03f ms for %.03f s of output, %.02f%%. Printers %.03f ms, sounds %.03f ms.\n",
+    profile.update_ns/1000000.0,outtime,(profile.update_ns*100.0)/(outtime*1000000000.0),
+    profile.printer_ns/1000000.0,profile.pcmplay_ns/1000000.0
+  );
+  double rate=(double)synth_get_rate();
+  if (songc>(int)(sizeof(songv)/sizeof(songv[0]))) songc=sizeof(songv)/sizeof(songv[0]);
+  int i=0; for (;i<songc;i++) eggrt_audio_profile_report_song(songv+i,rate);
+  
+  static const char *stage_names[SYNTH_PROFILE_STAGE_LIMIT]={
+    "noop","gain","delay","tremolo","detune","waveshaper","lopass","hipass","bpass","notch",
+  };
+  for (i=0;i<SYNTH_PROFILE_STAGE_LIMIT;i++) {
+    if (!profile.stage_ns[i]) continue;
+    if (stage_names[i]) fprintf(stderr,"  post %s: %.03f ms\n",stage_names[i],profile.stage_ns[i]/1000000.0);
+    else fprintf(stderr,"  post 0x%02x: %.03f ms\n",i,profile.stage_ns[i]/1000000.0);
+  }
+}
+
+/* Video profile report.
+ */
+ 
+void eggrt_video_profile_report() {
+  if (!eggrt.video_profile) return;
+  struct render_stats stats;
+  render_get_stats(&stats,eggrt.render);
+  if (stats.framec<1) return;
+  fprintf(stderr,
+    "Video profile: %d frames. GL calls per frame: average %.01f, max %d. Draws per frame: average %.01f, max %d. Vertices per frame: average %.01f, max %d.\n",
+    stats.framec,(double)stats.glcallc/stats.framec,stats.glcallc_max,(double)stats.drawc/stats.framec,stats.drawc_max,
+    (double)stats.vtxc/stats.framec,stats.vtxc_max
+  );
+}
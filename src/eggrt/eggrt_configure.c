@@ -13,6 +13,7 @@ void eggrt_print_help(const char *topic,int topicc) {
     "  --video=DRIVER             Select driver manually (see below).\n"
     "  --fullscreen               Start in fullscreen mode.\n"
     "  --video-device=NAME        Depends on driver.\n"
+    "  --video-profile            Log GL calls and draws per frame at quit.\n"
     "  --audio=DRIVER             Select driver manually (see below).\n"
     "  --audio-rate=HZ            Suggest audio output rate.\n"
     "  --audio-chanc=1|2          Suggest audio channel count.\n"
@@ -20,8 +21,20 @@ void eggrt_print_help(const char *topic,int topicc) {
     "  --mono                     --audio-chanc=1\n"
     "  --audio-buffer=FRAMES      Suggest audio buffer size in frames.\n"
     "  --audio-device=NAME        Depends on driver.\n"
+    "  --audio-threads=COUNT      Render songs in parallel on so many extra threads. Default 0.\n"
+    "  --audio-internal-rate=HZ   Synthesize at a lower rate, eg 22050, and upsample. Saves CPU. Default 0, same as output.\n"
+    "  --audio-queue=DEPTH        Commands to the synthesizer go thru a lock-free queue. Default 256, zero to lock instead.\n"
+    "  --audio-profile            Log synthesizer CPU usage per song, channel, and post stage at quit, or on SIGUSR1.\n"
+    "  --audio-adaptive=PERCENT   Reduce music quality when synthesis takes more than so much of real time, eg 70. Default 0, disabled.\n"
+    "  --preprint-sounds          Print all sound effects at startup, instead of each the first time it plays.\n"
+    "  --sound-cache=default|none|DIR  Keep printed sounds on disk. Default under $XDG_CACHE_HOME or ~/.cache.\n"
     "  --input=DRIVER             Select driver manually (see below).\n"
     "  --store=default|none|PATH  Disable saving, or save to specific file.\n"
+    "  --clock=normal|uniform|redline  'uniform' reports a constant frame time, 'redline' also never sleeps.\n"
+    "  --frames=COUNT             Quit after so many updates.\n"
+    "  --input-script=PATH        Play scripted input, see src/eggrt/eggrt_bench.c.\n"
+    "  --frame-report=PATH        Write per-frame update and render times, draws, and vertices at quit.\n"
+    "  --frame-hash               With --frame-report, include a hash of each frame. Requires softrender.\n"
     "\n"
   );
   int i;
@@ -101,13 +114,26 @@ static int eggrt_arg_kv(const char *k,int kc,const char *v,int vc) {
   STROPT(video_driver,"video")
   INTOPT(fullscreen,"fullscreen")
   STROPT(video_device,"video-device")
+  INTOPT(video_profile,"video-profile")
   STROPT(audio_driver,"audio")
   INTOPT(audio_rate,"audio-rate")
   INTOPT(audio_chanc,"audio-chanc")
   INTOPT(audio_buffer,"audio-buffer")
+  INTOPT(audio_threads,"audio-threads")
+  INTOPT(audio_internal_rate,"audio-internal-rate")
+  INTOPT(audio_queue,"audio-queue")
+  INTOPT(audio_profile,"audio-profile")
+  INTOPT(audio_adaptive,"audio-adaptive")
+  INTOPT(preprint_sounds,"preprint-sounds")
   STROPT(audio_device,"audio-device")
+  STROPT(sound_cache,"sound-cache")
   STROPT(input_driver,"input")
   STROPT(store_req,"store-req")
+  STROPT(clock_req,"clock")
+  INTOPT(frame_limit,"frames")
+  STROPT(input_script,"input-script")
+  STROPT(frame_report,"frame-report")
+  INTOPT(frame_hash,"frame-hash")
   #undef STROPT
   #undef INTOPT
   
@@ -144,6 +170,8 @@ static int eggrt_arg_positional(const char *src,int srcc) {
 int eggrt_configure(int argc,char **argv) {
 
   eggrt.exename="egg";
+  eggrt.audio_queue=-1;
+  eggrt.audio_adaptive=-1;
   if ((argc>=1)&&argv&&argv[0]&&argv[0][0]) eggrt.exename=argv[0];
   
   int argi=1,err;
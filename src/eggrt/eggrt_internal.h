@@ -27,13 +27,26 @@ extern struct eggrt {
   char *video_driver;
   int fullscreen;
   char *video_device;
+  int video_profile;
   char *audio_driver;
   int audio_rate;
   int audio_chanc;
   int audio_buffer;
+  int audio_threads;
+  int audio_internal_rate;
+  int audio_queue; // <0 for default. After init, 0 if not using the queue.
+  int audio_profile;
+  int audio_adaptive; // Percent of real time. <0 for default.
+  int preprint_sounds;
+  char *sound_cache;
   char *audio_device;
   char *input_driver;
   char *store_req;
+  char *clock_req;
+  int frame_limit; // Quit after so many updates. <=0 to run forever.
+  char *input_script;
+  char *frame_report;
+  int frame_hash;
   struct param {
     const char *k,*v;
     int kc,vc;
@@ -54,6 +67,8 @@ extern struct eggrt {
   int input_mode; // EGG_INPUT_MODE_GAMEPAD by default.
   int mousex,mousey; // In framebuffer coords as reported to client. Updates only when in MOUSE mode.
   int mouse_motionc; // Counts frames while moving.
+  int preprinting; // Nonzero while synth is printing sounds ahead of time, until we report it.
+  volatile int audio_profile_requested; // Set by SIGUSR1.
   
 // eggrt_rom.c:
   void *rom;
@@ -81,6 +96,18 @@ extern struct eggrt {
     int paramsc;
   } metadata;
   
+// eggrt_soundcache.c:
+  char *soundcache_dir; // Null if cache not in play.
+  struct eggrt_soundcache_entry {
+    int rid;
+    uint64_t hash;
+    int serialc;
+    void *map; // From mmap, if we loaded it. Synth is borrowing the samples.
+    int mapc;
+    int saved; // Nonzero if the file is known good, no need to write it.
+  } *soundcachev;
+  int soundcachec,soundcachea;
+  
 // eggrt_clock.c:
   int clockmode;
   int updframec;
@@ -90,6 +117,17 @@ extern struct eggrt {
   double starttime_real;
   double starttime_cpu;
   
+// eggrt_bench.c:
+  struct eggrt_script_event {
+    int frame,playerid,btnid,value;
+  } *scriptv;
+  int scriptc,scripta,scriptp;
+  struct eggrt_frame_record {
+    int frame,update_us,render_us,drawc,vtxc;
+    uint64_t hash;
+  } *framerecv;
+  int framerecc,framereca;
+  
 // eggrt_store.c:
   struct eggrt_store_field {
     char *k,*v;
@@ -121,9 +159,30 @@ int eggrt_string_get(void *dstpp,int rid,int strix);
 
 int eggrt_prefs_init();
 
+int eggrt_clockmode_eval(const char *src); // "normal", "uniform", "redline". Null or empty is NORMAL.
 void eggrt_clock_init(); // Caller sets eggrt.clockmode first.
 double eggrt_clock_update(); // May sleep, and returns adjusted time for client consumption.
 void eggrt_clock_report(); // Noop if insufficient data.
+void eggrt_audio_profile_report(); // Noop unless --audio-profile.
+void eggrt_video_profile_report(); // Noop unless --video-profile.
+
+/* Scripted input and the per-frame report, for benchmarking. All noop unless configured.
+ * eggrt_bench_init() after the renderer exists, and eggrt_bench_quit() before it's deleted.
+ */
+int eggrt_bench_init();
+void eggrt_bench_quit();
+void eggrt_bench_input(); // After driver updates, before the client's.
+void eggrt_bench_update_begin();
+void eggrt_bench_render_begin();
+void eggrt_bench_frame_end();
+
+/* Sound cache must init after synth has its ROM, and before anything prints.
+ * Save whenever it's convenient; we only write sounds that are printed and not cached yet.
+ * Quit only after synth_quit().
+ */
+int eggrt_soundcache_init();
+void eggrt_soundcache_save();
+void eggrt_soundcache_quit();
 
 void eggrt_store_quit();
 int eggrt_store_init();
@@ -134,6 +193,12 @@ int eggrt_store_key_by_index(char *k,int ka,int p);
 
 void eggrt_language_changed();
 
+/* Convert synth's output for the audio driver: Clamp, interleave, and quantize if it's int16_t.
+ * (r) may be null. With 3 or more channels, the extras are silent.
+ */
+void eggrt_quantize_pcm(int16_t *dst,const float *l,const float *r,int framec,int dstchanc);
+void eggrt_interleave_pcm(float *dst,const float *l,const float *r,int framec,int dstchanc);
+
 /* Don't call the egg_client_* functions directly.
  * Technically today you could. But eventually I expect to include a Wasm runtime.
  * It's ok to call quit from here no matter what. Wrapper will prevent it going to the client if you hadn't called init.
@@ -148,6 +213,8 @@ void eggrt_cb_close(struct hostio_video *driver);
 void eggrt_cb_focus(struct hostio_video *driver,int focus);
 void eggrt_cb_resize(struct hostio_video *driver,int w,int h);
 void eggrt_cb_pcm_out(int16_t *v,int c,struct hostio_audio *driver);
+void eggrt_cb_pcm_out_float(float *v,int c,struct hostio_audio *driver);
+void eggrt_cb_underrun(struct hostio_audio *driver);
 void eggrt_cb_mmotion(struct hostio_video *driver,int x,int y);
 void eggrt_cb_mbutton(struct hostio_video *driver,int btnid,int value);
 int eggrt_cb_key(struct hostio_video *driver,int keycode,int value);
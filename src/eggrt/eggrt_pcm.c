@@ -0,0 +1,107 @@
+/* eggrt_pcm.c
+ * Quantizing and interleaving synth's output for the audio driver.
+ * This is the only per-sample work we do on the audio thread outside the synth, so do it 4 at a time.
+ * GCC vector extensions rather than intrinsics, same as synth. It becomes SSE or NEON without our help.
+ * Output is exactly what the old per-sample QSAMPLE produced: Truncate toward zero, and -1 and below is -32768.
+ */
+
+#include "eggrt_internal.h"
+
+typedef float eggrt_v4f __attribute__((vector_size(16),aligned(4)));
+typedef int32_t eggrt_v4i __attribute__((vector_size(16),aligned(4)));
+
+static inline eggrt_v4f eggrt_clamp_v4(eggrt_v4f v) {
+  const eggrt_v4f lo={-1.0f,-1.0f,-1.0f,-1.0f};
+  const eggrt_v4f hi={1.0f,1.0f,1.0f,1.0f};
+  eggrt_v4i m=(v<lo);
+  v=(eggrt_v4f)(((eggrt_v4i)v&~m)|((eggrt_v4i)lo&m));
+  m=(v>hi);
+  v=(eggrt_v4f)(((eggrt_v4i)v&~m)|((eggrt_v4i)hi&m));
+  return v;
+}
+
+/* Clamped to -1 scales to -32767. Comparisons yield -1 for true, so adding (v<=-1) takes the bottom rail one further.
+ */
+static inline eggrt_v4i eggrt_quantize_v4(eggrt_v4f v) {
+  const eggrt_v4f lo={-1.0f,-1.0f,-1.0f,-1.0f};
+  const eggrt_v4f scale={32767.0f,32767.0f,32767.0f,32767.0f};
+  v=eggrt_clamp_v4(v);
+  return __builtin_convertvector(v*scale,eggrt_v4i)+(v<=lo);
+}
+
+static inline float eggrt_clamp_1(float v) {
+  return (v<-1.0f)?-1.0f:(v>1.0f)?1.0f:v;
+}
+
+static inline int16_t eggrt_quantize_1(float v) {
+  return (v<=-1.0f)?-32768:(v>=1.0f)?32767:(int16_t)(v*32767.0f);
+}
+
+/* Quantize.
+ */
+
+void eggrt_quantize_pcm(int16_t *dst,const float *l,const float *r,int framec,int dstchanc) {
+  if (dstchanc==1) { // mono...
+    for (;framec>=4;framec-=4,l+=4,dst+=4) {
+      eggrt_v4i q=eggrt_quantize_v4(*(const eggrt_v4f*)l);
+      dst[0]=q[0]; dst[1]=q[1]; dst[2]=q[2]; dst[3]=q[3];
+    }
+    for (;framec-->0;l++,dst++) *dst=eggrt_quantize_1(*l);
+  } else if ((dstchanc==2)&&r) { // regular stereo...
+    for (;framec>=4;framec-=4,l+=4,r+=4,dst+=8) {
+      eggrt_v4i ql=eggrt_quantize_v4(*(const eggrt_v4f*)l);
+      eggrt_v4i qr=eggrt_quantize_v4(*(const eggrt_v4f*)r);
+      dst[0]=ql[0]; dst[1]=qr[0]; dst[2]=ql[1]; dst[3]=qr[1];
+      dst[4]=ql[2]; dst[5]=qr[2]; dst[6]=ql[3]; dst[7]=qr[3];
+    }
+    for (;framec-->0;l++,r++,dst+=2) {
+      dst[0]=eggrt_quantize_1(*l);
+      dst[1]=eggrt_quantize_1(*r);
+    }
+  } else { // generic...
+    int extrac=dstchanc-2;
+    for (;framec-->0;l++) {
+      *dst++=eggrt_quantize_1(*l);
+      if (dstchanc>=2) {
+        if (r) *dst++=eggrt_quantize_1(*r);
+        else *dst++=0;
+        int i=extrac; while (i-->0) *dst++=0;
+      }
+      if (r) r++;
+    }
+  }
+}
+
+/* Same thing for drivers that take float directly: Only clamp and interleave.
+ */
+
+void eggrt_interleave_pcm(float *dst,const float *l,const float *r,int framec,int dstchanc) {
+  if (dstchanc==1) {
+    for (;framec>=4;framec-=4,l+=4,dst+=4) {
+      *(eggrt_v4f*)dst=eggrt_clamp_v4(*(const eggrt_v4f*)l);
+    }
+    for (;framec-->0;l++,dst++) *dst=eggrt_clamp_1(*l);
+  } else if ((dstchanc==2)&&r) {
+    for (;framec>=4;framec-=4,l+=4,r+=4,dst+=8) {
+      eggrt_v4f cl=eggrt_clamp_v4(*(const eggrt_v4f*)l);
+      eggrt_v4f cr=eggrt_clamp_v4(*(const eggrt_v4f*)r);
+      dst[0]=cl[0]; dst[1]=cr[0]; dst[2]=cl[1]; dst[3]=cr[1];
+      dst[4]=cl[2]; dst[5]=cr[2]; dst[6]=cl[3]; dst[7]=cr[3];
+    }
+    for (;framec-->0;l++,r++,dst+=2) {
+      dst[0]=eggrt_clamp_1(*l);
+      dst[1]=eggrt_clamp_1(*r);
+    }
+  } else {
+    int extrac=dstchanc-2;
+    for (;framec-->0;l++) {
+      *dst++=eggrt_clamp_1(*l);
+      if (dstchanc>=2) {
+        if (r) *dst++=eggrt_clamp_1(*r);
+        else *dst++=0.0f;
+        int i=extrac; while (i-->0) *dst++=0.0f;
+      }
+      if (r) r++;
+    }
+  }
+}
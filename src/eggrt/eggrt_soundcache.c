@@ -0,0 +1,275 @@
+/* eggrt_soundcache.c
+ * Keeps printed sound effects on disk, so we don't have to synthesize them again at the next launch.
+ * One file per sound, named for a hash of its serial, the output rate, and SYNTH_VERSION.
+ * So games can share a cache directory, and a sound that changes simply misses.
+ * Valid files are memory-mapped and handed to synth as is; the samples are never copied.
+ * Anything stale or malformed is ignored, and rewritten when we save.
+ *
+ * File format, native byte order since it never leaves this machine:
+ *   0000   4 Signature: "\0ESC"
+ *   0004   4 SYNTH_VERSION
+ *   0008   4 Rate, hz.
+ *   000c   4 Serial length.
+ *   0010   8 Serial hash.
+ *   0018   4 Sample count.
+ *   001c   4 Reserved, zero.
+ *   0020 ... f32 samples, mono.
+ */
+
+#include "eggrt_internal.h"
+#include "opt/fs/fs.h"
+
+#if USE_mswin
+
+int eggrt_soundcache_init() { return 0; }
+void eggrt_soundcache_save() {}
+void eggrt_soundcache_quit() {}
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define EGGRT_SOUNDCACHE_HEADER_SIZE 32
+
+struct eggrt_soundcache_header {
+  char signature[4];
+  uint32_t version;
+  uint32_t rate;
+  uint32_t serialc;
+  uint64_t hash;
+  uint32_t samplec;
+  uint32_t reserved;
+};
+
+/* 64-bit FNV-1a over the serial, then rate and version.
+ */
+
+static uint64_t eggrt_soundcache_hash(const void *src,int srcc,int rate) {
+  uint64_t h=0xcbf29ce484222325ull;
+  const uint8_t *v=src;
+  for (;srcc-->0;v++) {
+    h^=*v;
+    h*=0x100000001b3ull;
+  }
+  uint32_t extra[2]={rate,SYNTH_VERSION};
+  for (v=(uint8_t*)extra,srcc=sizeof(extra);srcc-->0;v++) {
+    h^=*v;
+    h*=0x100000001b3ull;
+  }
+  return h;
+}
+
+/* Compose path for one entry.
+ */
+
+static int eggrt_soundcache_path(char *dst,int dsta,uint64_t hash) {
+  char base[32];
+  int basec=snprintf(base,sizeof(base),"%016llx.pcm",(unsigned long long)hash);
+  if ((basec<1)||(basec>=sizeof(base))) return -1;
+  int dstc=path_join(dst,dsta,eggrt.soundcache_dir,-1,base,basec);
+  if ((dstc<1)||(dstc>=dsta)) return -1;
+  return dstc;
+}
+
+/* Default directory.
+ */
+
+static char *eggrt_soundcache_default_dir() {
+  char tmp[1024];
+  int tmpc=0;
+  const char *xdg=getenv("XDG_CACHE_HOME");
+  const char *home=getenv("HOME");
+  if (xdg&&xdg[0]) tmpc=snprintf(tmp,sizeof(tmp),"%s/egg/sound",xdg);
+  else if (home&&home[0]) tmpc=snprintf(tmp,sizeof(tmp),"%s/.cache/egg/sound",home);
+  else return 0;
+  if ((tmpc<1)||(tmpc>=sizeof(tmp))) return 0;
+  return strdup(tmp);
+}
+
+/* Add an entry.
+ */
+
+static struct eggrt_soundcache_entry *eggrt_soundcache_add(int rid,uint64_t hash,int serialc) {
+  if (eggrt.soundcachec>=eggrt.soundcachea) {
+    int na=eggrt.soundcachea+32;
+    if (na>INT_MAX/sizeof(struct eggrt_soundcache_entry)) return 0;
+    void *nv=realloc(eggrt.soundcachev,sizeof(struct eggrt_soundcache_entry)*na);
+    if (!nv) return 0;
+    eggrt.soundcachev=nv;
+    eggrt.soundcachea=na;
+  }
+  struct eggrt_soundcache_entry *entry=eggrt.soundcachev+eggrt.soundcachec++;
+  memset(entry,0,sizeof(struct eggrt_soundcache_entry));
+  entry->rid=rid;
+  entry->hash=hash;
+  entry->serialc=serialc;
+  return entry;
+}
+
+/* Map one file and validate it.
+ * Returns sample count, or <0 if missing or stale.
+ */
+
+static int eggrt_soundcache_map(struct eggrt_soundcache_entry *entry,const char *path) {
+  int fd=open(path,O_RDONLY);
+  if (fd<0) return -1;
+  struct stat st;
+  if ((fstat(fd,&st)<0)||(st.st_size<EGGRT_SOUNDCACHE_HEADER_SIZE)||(st.st_size>INT_MAX)) {
+    close(fd);
+    return -1;
+  }
+  void *map=mmap(0,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (map==MAP_FAILED) return -1;
+  const struct eggrt_soundcache_header *hdr=map;
+  if (
+    memcmp(hdr->signature,"\0ESC",4)||
+    (hdr->version!=SYNTH_VERSION)||
+    (hdr->rate!=synth_get_rate())||
+    (hdr->serialc!=entry->serialc)||
+    (hdr->hash!=entry->hash)||
+    (hdr->samplec<2)||
+    (st.st_size!=EGGRT_SOUNDCACHE_HEADER_SIZE+(off_t)hdr->samplec*sizeof(float))
+  ) {
+    munmap(map,st.st_size);
+    return -1;
+  }
+  entry->map=map;
+  entry->mapc=st.st_size;
+  return hdr->samplec;
+}
+
+/* Init.
+ */
+
+int eggrt_soundcache_init() {
+  if (eggrt.sound_cache&&!strcmp(eggrt.sound_cache,"none")) return 0;
+  if (!eggrt.sound_cache||!strcmp(eggrt.sound_cache,"default")) {
+    if (!(eggrt.soundcache_dir=eggrt_soundcache_default_dir())) return 0;
+  } else {
+    if (!(eggrt.soundcache_dir=strdup(eggrt.sound_cache))) return -1;
+  }
+  int rate=synth_get_rate();
+  int hitc=0,missc=0;
+  const struct rom_entry *res=eggrt.resv;
+  int i=eggrt.resc;
+  for (;i-->0;res++) {
+    if (res->tid<EGG_TID_sound) continue;
+    if (res->tid>EGG_TID_sound) break;
+    uint64_t hash=eggrt_soundcache_hash(res->v,res->c,rate);
+    struct eggrt_soundcache_entry *entry=eggrt_soundcache_add(res->rid,hash,res->c);
+    if (!entry) return -1;
+    char path[1024];
+    if (eggrt_soundcache_path(path,sizeof(path),hash)<0) continue;
+    int samplec=eggrt_soundcache_map(entry,path);
+    if (samplec<0) {
+      missc++;
+      continue;
+    }
+    const float *v=(float*)((char*)entry->map+EGGRT_SOUNDCACHE_HEADER_SIZE);
+    if (synth_set_sound_pcm(res->rid,v,samplec)<0) {
+      munmap(entry->map,entry->mapc);
+      entry->map=0;
+      entry->mapc=0;
+      missc++;
+      continue;
+    }
+    entry->saved=1;
+    hitc++;
+  }
+  if (hitc||missc) {
+    fprintf(stderr,"%s: Sound cache %s: %d hit, %d miss.\n",eggrt.exename,eggrt.soundcache_dir,hitc,missc);
+  }
+  return 0;
+}
+
+/* Write one file. Through a temporary and rename, so a concurrent reader never sees it partial.
+ */
+
+static int eggrt_soundcache_write(const struct eggrt_soundcache_entry *entry,const float *v,int c) {
+  char path[1024],tmppath[1040];
+  int pathc=eggrt_soundcache_path(path,sizeof(path),entry->hash);
+  if (pathc<0) return -1;
+  snprintf(tmppath,sizeof(tmppath),"%.*s.%d",pathc,path,(int)getpid());
+  if (c>(INT_MAX-EGGRT_SOUNDCACHE_HEADER_SIZE)/sizeof(float)) return -1;
+  int serialc=EGGRT_SOUNDCACHE_HEADER_SIZE+c*sizeof(float);
+  char *serial=malloc(serialc);
+  if (!serial) return -1;
+  struct eggrt_soundcache_header hdr={
+    .signature="\0ESC",
+    .version=SYNTH_VERSION,
+    .rate=synth_get_rate(),
+    .serialc=entry->serialc,
+    .hash=entry->hash,
+    .samplec=c,
+  };
+  memcpy(serial,&hdr,sizeof(hdr));
+  memcpy(serial+EGGRT_SOUNDCACHE_HEADER_SIZE,v,sizeof(float)*c);
+  int err=file_write(tmppath,serial,serialc);
+  free(serial);
+  if (err<0) return -1;
+  if (rename(tmppath,path)<0) {
+    unlink(tmppath);
+    return -1;
+  }
+  return 0;
+}
+
+/* Save.
+ */
+
+void eggrt_soundcache_save() {
+  if (!eggrt.soundcache_dir) return;
+  int dirok=0,savec=0;
+  struct eggrt_soundcache_entry *entry=eggrt.soundcachev;
+  int i=eggrt.soundcachec;
+  for (;i-->0;entry++) {
+    if (entry->saved) continue;
+    int c=0;
+    if (eggrt.hostio&&(hostio_audio_lock(eggrt.hostio)<0)) return;
+    const float *v=synth_get_sound_pcm(&c,entry->rid);
+    if (eggrt.hostio) hostio_audio_unlock(eggrt.hostio);
+    if (!v) continue;
+    // (v) stays valid unlocked; synth only drops printed sounds when the ROM changes.
+    if (!dirok) {
+      if (dir_mkdirp(eggrt.soundcache_dir)<0) {
+        fprintf(stderr,"%s: Failed to create sound cache directory. Disabling cache.\n",eggrt.soundcache_dir);
+        free(eggrt.soundcache_dir);
+        eggrt.soundcache_dir=0;
+        return;
+      }
+      dirok=1;
+    }
+    if (eggrt_soundcache_write(entry,v,c)<0) continue;
+    entry->saved=1;
+    savec++;
+  }
+  if (savec) fprintf(stderr,"%s: Saved %d sounds to cache.\n",eggrt.soundcache_dir,savec);
+}
+
+/* Quit.
+ * Synth must be dropped first; it's borrowing our maps.
+ */
+
+void eggrt_soundcache_quit() {
+  if (eggrt.soundcachev) {
+    struct eggrt_soundcache_entry *entry=eggrt.soundcachev;
+    int i=eggrt.soundcachec;
+    for (;i-->0;entry++) {
+      if (entry->map) munmap(entry->map,entry->mapc);
+    }
+    free(eggrt.soundcachev);
+  }
+  eggrt.soundcachev=0;
+  eggrt.soundcachec=0;
+  eggrt.soundcachea=0;
+  if (eggrt.soundcache_dir) {
+    free(eggrt.soundcache_dir);
+    eggrt.soundcache_dir=0;
+  }
+}
+
+#endif
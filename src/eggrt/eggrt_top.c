@@ -13,17 +13,26 @@ void eggrt_quit(int status) {
   eggrt_call_client_quit(status);
   
   if (!status) eggrt_clock_report();
+  eggrt_audio_profile_report();
+  eggrt_video_profile_report();
+  eggrt_bench_quit();
   
   umenu_del(eggrt.umenu);
   render_del(eggrt.render);
   inmgr_quit();
   eggrt_store_quit();
   
+  eggrt_soundcache_save();
+  if (eggrt.audio_queue>0) {
+    int overflowc=synth_get_queue_overflow();
+    if (overflowc>0) fprintf(stderr,"%s: Dropped %d audio commands due to queue overflow. Consider --audio-queue=%d\n",eggrt.exename,overflowc,eggrt.audio_queue<<1);
+  }
   hostio_audio_play(eggrt.hostio,0);
   hostio_del(eggrt.hostio);
   eggrt.hostio=0;
   
   synth_quit();
+  eggrt_soundcache_quit();
   
   eggrt_rom_quit();
   
@@ -33,8 +42,12 @@ void eggrt_quit(int status) {
   if (eggrt.video_device) free(eggrt.video_device);
   if (eggrt.audio_driver) free(eggrt.audio_driver);
   if (eggrt.audio_device) free(eggrt.audio_device);
+  if (eggrt.sound_cache) free(eggrt.sound_cache);
   if (eggrt.input_driver) free(eggrt.input_driver);
   if (eggrt.store_req) free(eggrt.store_req);
+  if (eggrt.clock_req) free(eggrt.clock_req);
+  if (eggrt.input_script) free(eggrt.input_script);
+  if (eggrt.frame_report) free(eggrt.frame_report);
   memset(&eggrt,0,sizeof(eggrt));
 }
 
@@ -110,14 +123,19 @@ static int eggrt_populate_video_setup(struct hostio_video_setup *setup) {
 }
 
 /* Deliver songs and sounds to the new synthesizer.
+ * Prerendered songs (songpcm) are further along, after some types synth doesn't want.
+ * If there are any, we return them separately, and caller splices them on with a TID command of (*pcmtid).
  */
  
-static int eggrt_slice_rom(void *dstpp) {
+static int eggrt_slice_rom(void *dstpp,void *pcmpp,int *pcmc,int *pcmtid) {
+  *pcmc=0;
   // Alas we really can't use rom_reader for this. We need to definitely know positions in the encoded ROM.
   if (eggrt.rom&&(eggrt.romc>=4)&&!memcmp(eggrt.rom,"\0ERM",4)) {
     const uint8_t *src=eggrt.rom;
     int srcc=eggrt.romc,srcp=4,tid=1;
     int songp=0,soundp=0,hip=srcc; // Start of type 5, type 6, and the next higher type.
+    int hitid=0; // Type in effect at (hip).
+    int pcmp=0,pcmhip=srcc; // Start of songpcm, and the next higher type.
     while (srcp<srcc) {
       int cmdp=srcp;
       uint8_t lead=src[srcp++];
@@ -130,8 +148,16 @@ static int eggrt_slice_rom(void *dstpp) {
             } else if (next_tid==6) {
               soundp=srcp;
             } else if (next_tid>=7) {
-              hip=cmdp;
-              srcp=srcc;
+              if (!hitid) {
+                hip=cmdp;
+                hitid=tid;
+              }
+              if (next_tid==EGG_TID_songpcm) {
+                pcmp=srcp;
+              } else if (next_tid>EGG_TID_songpcm) {
+                if (pcmp) pcmhip=cmdp;
+                srcp=srcc;
+              }
             }
             tid=next_tid;
           } break;
@@ -148,6 +174,11 @@ static int eggrt_slice_rom(void *dstpp) {
       }
     }
     if (songp) {
+      if (pcmp&&(pcmhip>pcmp)) {
+        *(const void**)pcmpp=src+pcmp;
+        *pcmc=pcmhip-pcmp;
+        *pcmtid=EGG_TID_songpcm-hitid;
+      }
       *(const void**)dstpp=src+songp;
       return hip-songp;
     } else if (soundp) {
@@ -163,11 +194,18 @@ static int eggrt_slice_rom(void *dstpp) {
 }
  
 static int eggrt_load_synth_resources() {
-  const void *src=0;
-  int srcc=eggrt_slice_rom(&src);
-  void *dst=synth_get_rom(srcc);
+  const void *src=0,*pcm=0;
+  int pcmc=0,pcmtid=0;
+  int srcc=eggrt_slice_rom(&src,&pcm,&pcmc,&pcmtid);
+  int dstc=srcc;
+  if (pcmc) dstc+=1+pcmc;
+  uint8_t *dst=synth_get_rom(dstc);
   if (!dst) return -1;
   memcpy(dst,src,srcc);
+  if (pcmc) {
+    dst[srcc]=pcmtid;
+    memcpy(dst+srcc+1,pcm,pcmc);
+  }
   return 0;
 }
 
@@ -185,11 +223,20 @@ static int eggrt_init_video() {
     fprintf(stderr,"%s: Failed to initialize any video driver.\n",eggrt.exename);
     return -2;
   }
-  if (!eggrt.hostio->video->type->gx_begin||!eggrt.hostio->video->type->gx_end) {
-    fprintf(stderr,"%s: Video driver '%s' does not appear to support OpenGL.\n",eggrt.exename,eggrt.hostio->video->type->name);
+  const struct hostio_video_type *type=eggrt.hostio->video->type;
+  int gx=type->gx_begin&&type->gx_end;
+  if (!gx&&!type->fb_present) {
+    fprintf(stderr,"%s: Video driver '%s' does not appear to support OpenGL.\n",eggrt.exename,type->name);
+    return -2;
+  }
+  if (!(eggrt.render=render_new())) {
+    fprintf(stderr,"%s: Failed to initialize renderer.\n",eggrt.exename);
+    return -2;
+  }
+  if (!gx&&!render_get_output(0,0,0,eggrt.render)) {
+    fprintf(stderr,"%s: Video driver '%s' needs a software renderer. Build with 'softrender' instead of 'render'.\n",eggrt.exename,type->name);
     return -2;
   }
-  if (!(eggrt.render=render_new())) return -1;
   render_set_size(eggrt.render,eggrt.hostio->video->w,eggrt.hostio->video->h);
   render_set_scale(eggrt.render,eggrt.hostio->video->scale);
   if (render_set_framebuffer_size(eggrt.render,setup.fbw,setup.fbh)<0) return -1;
@@ -212,8 +259,46 @@ static int eggrt_init_audio() {
     fprintf(stderr,"%s: Failed to initialize synthesizer. rate=%d chanc=%d\n",eggrt.exename,eggrt.hostio->audio->rate,eggrt.hostio->audio->chanc);
     return -2;
   }
+  if (eggrt.audio_internal_rate>0) {
+    if (synth_set_internal_rate(eggrt.audio_internal_rate)<0) {
+      fprintf(stderr,"%s: Failed to set synthesizer internal rate %d. Proceeding at %d.\n",eggrt.exename,eggrt.audio_internal_rate,synth_get_rate());
+    }
+  }
+  if (eggrt.audio_threads>0) {
+    if (synth_set_threads(eggrt.audio_threads)<0) {
+      fprintf(stderr,"%s: Failed to start %d synthesizer threads. Proceeding single-threaded.\n",eggrt.exename,eggrt.audio_threads);
+    }
+  }
+  if (eggrt.audio_profile) {
+    if (synth_set_profiling(1)<0) {
+      fprintf(stderr,"%s: Synthesizer profiling not available.\n",eggrt.exename);
+      eggrt.audio_profile=0;
+    }
+  }
+  if (eggrt.audio_adaptive<0) eggrt.audio_adaptive=0; // Opt-in. Degrading the music is the game's call, not ours.
+  if (eggrt.audio_adaptive>0) {
+    float degrade=eggrt.audio_adaptive/100.0f;
+    synth_set_adaptive_quality(degrade,degrade*0.5f);
+  }
+  if (eggrt.audio_queue<0) eggrt.audio_queue=256;
+  if (eggrt.audio_queue>0) {
+    if ((eggrt.audio_queue=synth_set_queue_depth(eggrt.audio_queue))<0) {
+      fprintf(stderr,"%s: Failed to create synthesizer command queue. Proceeding with locks.\n",eggrt.exename);
+      eggrt.audio_queue=0;
+    }
+  }
   int err=eggrt_load_synth_resources();
   if (err<0) return err;
+  if (eggrt_soundcache_init()<0) {
+    fprintf(stderr,"%s: Failed to load sound cache. Some sounds will print on demand.\n",eggrt.exename);
+  }
+  if (eggrt.preprint_sounds) {
+    if ((err=synth_preprint_sounds())<0) {
+      fprintf(stderr,"%s: Failed to begin printing sounds. They'll print on demand instead.\n",eggrt.exename);
+    } else if (err>0) {
+      eggrt.preprinting=1;
+    }
+  }
   return 0;
 }
 
@@ -254,6 +339,8 @@ static int eggrt_init_drivers() {
   };
   struct hostio_audio_delegate adelegate={
     .cb_pcm_out=eggrt_cb_pcm_out,
+    .cb_pcm_out_float=eggrt_cb_pcm_out_float,
+    .cb_underrun=eggrt_cb_underrun,
   };
   struct hostio_input_delegate idelegate={
     .cb_connect=eggrt_cb_connect,
@@ -318,6 +405,10 @@ int eggrt_init() {
   
   eggrt.focus=1;
   eggrt.input_mode=EGG_INPUT_MODE_GAMEPAD;
+  if ((eggrt.clockmode=eggrt_clockmode_eval(eggrt.clock_req))<0) {
+    fprintf(stderr,"%s: Unknown clock mode '%s'. Expected 'normal', 'uniform', or 'redline'.\n",eggrt.exename,eggrt.clock_req);
+    return -2;
+  }
   
   // ROM must initialize before drivers, drivers before prefs, and prefs before client.
   if ((err=eggrt_rom_init())<0) {
@@ -352,14 +443,36 @@ int eggrt_init() {
     return -2;
   }
   
+  // Scripted input and frame report, if requested.
+  if ((err=eggrt_bench_init())<0) {
+    if (err!=-2) fprintf(stderr,"%s: Unspecified error initializing benchmark.\n",eggrt.exename);
+    return -2;
+  }
+  
   // Start clock and audio.
   hostio_audio_play(eggrt.hostio,1);
-  eggrt.clockmode=EGGRT_CLOCKMODE_NORMAL;
   eggrt_clock_init();
   
   return 0;
 }
 
+/* Advance sound preprinting, if it's in progress.
+ * Synth usually does this on a background thread, and we only collect the results.
+ * Report once it's done.
+ */
+ 
+static void eggrt_preprint_update() {
+  if (hostio_audio_lock(eggrt.hostio)<0) return;
+  int err=synth_preprint_update(8192);
+  int soundc=0,size=0;
+  if (!err) size=synth_get_pcm_size(&soundc);
+  hostio_audio_unlock(eggrt.hostio);
+  if (err) return;
+  eggrt.preprinting=0;
+  fprintf(stderr,"%s: Printed %d sounds, %d bytes of PCM.\n",eggrt.exename,soundc,size);
+  eggrt_soundcache_save();
+}
+
 /* Update.
  */
  
@@ -369,6 +482,11 @@ int eggrt_update() {
   // Tick clock.
   double elapsed=eggrt_clock_update();
   
+  if (eggrt.audio_profile_requested) {
+    eggrt.audio_profile_requested=0;
+    eggrt_audio_profile_report();
+  }
+  
   // Update drivers.
   if ((err=hostio_update(eggrt.hostio))<0) {
     if (err!=-2) fprintf(stderr,"%s: Error updating platform drivers.\n",eggrt.exename);
@@ -403,23 +521,36 @@ int eggrt_update() {
   }
   
   // Update client.
+  eggrt_bench_input();
+  eggrt_bench_update_begin();
   if (eggrt.umenu) {
     if ((err=umenu_update(eggrt.umenu,elapsed))<0) return err;
   } else {
     if ((err=eggrt_call_client_update(elapsed))<0) return err;
   }
   if ((err=eggrt_store_update())<0) return err;
+  if (eggrt.preprinting) eggrt_preprint_update();
   if (eggrt.terminate) return 0;
   
   // Render.
-  if ((err=eggrt.hostio->video->type->gx_begin(eggrt.hostio->video))<0) return err;
+  eggrt_bench_render_begin();
+  const struct hostio_video_type *type=eggrt.hostio->video->type;
+  if (type->gx_begin&&((err=type->gx_begin(eggrt.hostio->video))<0)) return err;
   render_begin(eggrt.render);
   if ((err=eggrt_call_client_render())<0) return err; // Render the client even when umenu open; it may show in the background.
   if (eggrt.umenu) {
     if ((err=umenu_render(eggrt.umenu))<0) return err;
   }
   render_commit(eggrt.render);
-  if ((err=eggrt.hostio->video->type->gx_end(eggrt.hostio->video))<0) return err;
+  if (type->fb_present) {
+    int w=0,h=0,stride=0;
+    const void *rgba=render_get_output(&w,&h,&stride,eggrt.render);
+    if (rgba&&((err=type->fb_present(eggrt.hostio->video,rgba,w,h,stride))<0)) return err;
+  }
+  if (type->gx_end&&((err=type->gx_end(eggrt.hostio->video))<0)) return err;
+  eggrt_bench_frame_end();
+  
+  if ((eggrt.frame_limit>0)&&(eggrt.updframec>=eggrt.frame_limit)) eggrt.terminate=1;
   
   return 0;
 }
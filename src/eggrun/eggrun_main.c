@@ -29,6 +29,9 @@ static void eggrt_signal(int sigid) {
         fprintf(stderr,"%s: Too many unprocessed signals.\n",eggrt.exename);
         exit(1);
       } break;
+    #ifdef SIGUSR1
+      case SIGUSR1: eggrt.audio_profile_requested=1; break;
+    #endif
   }
 }
 
@@ -87,6 +90,9 @@ int main(int argc,char **argv) {
   if (eggrt.terminate) return 0;
   
   signal(SIGINT,eggrt_signal);
+  #ifdef SIGUSR1
+    if (eggrt.audio_profile) signal(SIGUSR1,eggrt_signal);
+  #endif
 
   /* MacOS has its own IoC concept.
    */
@@ -132,6 +132,10 @@ static void egg_wasm_song_event_wheel(wasm_exec_env_t ee,int songid,int chid,int
   egg_song_event_wheel(songid,chid,v);
 }
 
+static void egg_wasm_song_event_at(wasm_exec_env_t ee,int songid,int chid,int event,int noteid,int velocity,int durms,double playhead) {
+  egg_song_event_at(songid,chid,event,noteid,velocity,durms,playhead);
+}
+
 static float egg_wasm_song_get_playhead(wasm_exec_env_t ee,int songid) {
   return egg_song_get_playhead(songid);
 }
@@ -197,6 +201,7 @@ static NativeSymbol eggrun_wasm_exports[]={
   {"egg_song_event_note_off",egg_wasm_song_event_note_off,"(iii)"},
   {"egg_song_event_note_once",egg_wasm_song_event_note_once,"(iiiii)"},
   {"egg_song_event_wheel",egg_wasm_song_event_wheel,"(iii)"},
+  {"egg_song_event_at",egg_wasm_song_event_at,"(iiiiiiF)"},
   {"egg_song_get_playhead",egg_wasm_song_get_playhead,"(i)f"},
   {"egg_texture_del",egg_wasm_texture_del,"(i)"},
   {"egg_texture_new",egg_wasm_texture_new,"()i"},
@@ -48,5 +48,6 @@ double eggstra_now_cpu();
 int eggstra_get_chdr(void *dstpp,int fqpid);
 
 int eggstra_main_play();
+int eggstra_main_bench();
 
 #endif
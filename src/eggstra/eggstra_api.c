@@ -84,6 +84,9 @@ void egg_song_event_note_once(int songid,int chid,int noteid,int velocity,int du
 void egg_song_event_wheel(int songid,int chid,int v) {
 }
 
+void egg_song_event_at(int songid,int chid,int event,int noteid,int velocity,int durms,double playhead) {
+}
+
 float egg_song_get_playhead(int songid) {
   return 0.0f;
 }
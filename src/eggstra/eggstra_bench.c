@@ -0,0 +1,419 @@
+/* eggstra_bench.c
+ * Render every song and sound in a ROM offline, as fast as we can, and report how long it took.
+ * No audio driver involved, so it runs anywhere, eg CI.
+ * Output is JSON on stdout. Give it a previous run as --baseline and we fail if anything got too much slower.
+ */
+
+#include "eggstra.h"
+#include "opt/synth/synth.h"
+#include "util/res/res.h"
+#include "egg/egg.h"
+
+#define BENCH_CONFIG_LIMIT 16
+
+/* Context.
+ */
+
+struct bench_result {
+  int tid,rid,rate,buffer;
+  int framec;
+  double audio_s; // Duration of the output.
+  double render_s; // CPU time to produce it.
+  double peak_s; // Longest single synth_update().
+  int voicec; // Sum of each channel's most voices. <0 if unknown, eg sounds.
+  int heap_peak; // Bytes. <0 if synth can't tell us.
+  int allocc; // Allocations from synth_init() to the end, including setup. <0 if synth can't tell us.
+  int render_allocc; // Allocations inside synth_update() only.
+};
+
+static struct bench {
+  const char *srcpath;
+  void *rom;
+  int romc;
+  int ratev[BENCH_CONFIG_LIMIT];
+  int ratec;
+  int bufferv[BENCH_CONFIG_LIMIT];
+  int bufferc;
+  int chanc;
+  double limit_s;
+  struct bench_result *resultv;
+  int resultc,resulta;
+} bench={0};
+
+static void bench_quit() {
+  synth_quit();
+  if (bench.rom) free(bench.rom);
+  if (bench.resultv) free(bench.resultv);
+  memset(&bench,0,sizeof(bench));
+}
+
+/* Read a comma-delimited list of integers from an option.
+ */
+
+static int bench_read_int_list(int *dst,int dsta,const char *k,int fallback) {
+  const char *src=eggstra_opt(k,-1);
+  if (!src||!src[0]) {
+    dst[0]=fallback;
+    return 1;
+  }
+  int dstc=0,srcp=0;
+  while (src[srcp]) {
+    if (src[srcp]==',') { srcp++; continue; }
+    const char *token=src+srcp;
+    int tokenc=0;
+    while (src[srcp]&&(src[srcp]!=',')) { srcp++; tokenc++; }
+    int v;
+    if ((sr_int_eval(&v,token,tokenc)<2)||(v<1)) {
+      fprintf(stderr,"%s: Expected positive integer in --%s, found '%.*s'.\n",eggstra.exename,k,tokenc,token);
+      return -2;
+    }
+    if (dstc>=dsta) {
+      fprintf(stderr,"%s: Too many values for --%s, limit %d.\n",eggstra.exename,k,dsta);
+      return -2;
+    }
+    dst[dstc++]=v;
+  }
+  if (!dstc) dst[dstc++]=fallback;
+  return dstc;
+}
+
+/* Add result.
+ */
+
+static struct bench_result *bench_add_result() {
+  if (bench.resultc>=bench.resulta) {
+    int na=bench.resulta+32;
+    if (na>INT_MAX/sizeof(struct bench_result)) return 0;
+    void *nv=realloc(bench.resultv,sizeof(struct bench_result)*na);
+    if (!nv) return 0;
+    bench.resultv=nv;
+    bench.resulta=na;
+  }
+  struct bench_result *result=bench.resultv+bench.resultc++;
+  memset(result,0,sizeof(struct bench_result));
+  return result;
+}
+
+/* Fresh synthesizer with our ROM.
+ */
+
+static int bench_init_synth(int rate,int buffer) {
+  synth_quit();
+  if (synth_init(rate,bench.chanc,buffer)<0) {
+    fprintf(stderr,"%s: Failed to initialize synthesizer, rate=%d chanc=%d buffer=%d.\n",eggstra.exename,rate,bench.chanc,buffer);
+    return -2;
+  }
+  void *dst=synth_get_rom(bench.romc);
+  if (!dst) return -1;
+  memcpy(dst,bench.rom,bench.romc);
+  return 0;
+}
+
+/* Run one update and track timing.
+ */
+
+static void bench_update(struct bench_result *result,int framec) {
+  int allocc0=0,allocc=0;
+  synth_get_heap_stats(0,0,0,&allocc0);
+  double then=eggstra_now_cpu();
+  synth_update(framec);
+  double elapsed=eggstra_now_cpu()-then;
+  synth_get_heap_stats(0,0,0,&allocc);
+  result->render_s+=elapsed;
+  if (elapsed>result->peak_s) result->peak_s=elapsed;
+  result->framec+=framec;
+  result->render_allocc+=allocc-allocc0;
+}
+
+/* Fill in the stats that come from synth rather than our clock.
+ */
+
+static void bench_finish_result(struct bench_result *result) {
+  result->audio_s=(double)result->framec/(double)result->rate;
+  int peak=0,allocc=0;
+  if (synth_get_heap_stats(0,&peak,0,&allocc)>=0) {
+    result->heap_peak=peak;
+    result->allocc=allocc;
+  } else {
+    result->heap_peak=-1;
+    result->allocc=-1;
+    result->render_allocc=-1;
+  }
+  result->voicec=-1;
+}
+
+/* Count a song's voices: Play it again, just as far, with profiling on.
+ * Separate from the timed run because profiling reads the clock around every song and channel, and we don't want to time that.
+ */
+
+static int bench_song_voices(struct bench_result *result) {
+  int err=bench_init_synth(result->rate,result->buffer);
+  if (err<0) return err;
+  if (synth_set_profiling(1)<0) return 0; // Not available, fine, (voicec) stays unknown.
+  if (synth_play_song(1,result->rid,0,1.0f,0.0f)<0) return 0;
+  int framec=0;
+  while (!eggstra.sigc&&(framec<result->framec)) {
+    synth_update(result->buffer);
+    framec+=result->buffer;
+  }
+  struct synth_profile_song songv[4];
+  int songc=synth_get_song_profiles(songv,4);
+  if (songc>4) songc=4;
+  int i=0; for (;i<songc;i++) {
+    if (songv[i].rid!=result->rid) continue;
+    result->voicec=0;
+    int chid=0; for (;chid<16;chid++) result->voicec+=songv[i].channelv[chid].voicec_max;
+  }
+  return 0;
+}
+
+/* Bench one song, start to finish, no repeat.
+ */
+
+static int bench_song(int rid,int rate,int buffer) {
+  int err=bench_init_synth(rate,buffer);
+  if (err<0) return err;
+  struct bench_result *result=bench_add_result();
+  if (!result) return -1;
+  result->tid=EGG_TID_song;
+  result->rid=rid;
+  result->rate=rate;
+  result->buffer=buffer;
+  if (synth_play_song(1,rid,0,1.0f,0.0f)<0) {
+    fprintf(stderr,"%s:song:%d: Failed to play song.\n",bench.srcpath,rid);
+    return -2;
+  }
+  int limit=(int)(bench.limit_s*rate);
+  while (!eggstra.sigc&&(result->framec<limit)) {
+    if (synth_get(1,0xff,SYNTH_PROP_EXISTENCE)<1.0f) break;
+    bench_update(result,buffer);
+  }
+  bench_finish_result(result);
+  return bench_song_voices(result);
+}
+
+/* Bench one sound, until it's printed.
+ */
+
+static int bench_sound(int rid,int rate,int buffer) {
+  int err=bench_init_synth(rate,buffer);
+  if (err<0) return err;
+  struct bench_result *result=bench_add_result();
+  if (!result) return -1;
+  result->tid=EGG_TID_sound;
+  result->rid=rid;
+  result->rate=rate;
+  result->buffer=buffer;
+  synth_play_sound(rid,1.0f,0.0f);
+  if (synth_get_pcm_size(0)<=(int)sizeof(float)) { // Empty or invalid sound, synth leaves a one-sample marker.
+    bench_finish_result(result);
+    return 0;
+  }
+  int limit=(int)(bench.limit_s*rate);
+  while (!eggstra.sigc&&(result->framec<limit)) {
+    int pcmc=0;
+    if (synth_get_sound_pcm(&pcmc,rid)) break;
+    bench_update(result,buffer);
+  }
+  bench_finish_result(result);
+  return 0;
+}
+
+/* Run all benchmarks.
+ */
+
+static int bench_run() {
+  struct rom_reader reader;
+  if (rom_reader_init(&reader,bench.rom,bench.romc)<0) {
+    fprintf(stderr,"%s: Not an Egg ROM.\n",bench.srcpath);
+    return -2;
+  }
+  struct rom_entry entry;
+  while (!eggstra.sigc&&(rom_reader_next(&entry,&reader)>0)) {
+    if (entry.tid<EGG_TID_song) continue;
+    if (entry.tid>EGG_TID_sound) break;
+    int ri=0; for (;ri<bench.ratec;ri++) {
+      int bi=0; for (;bi<bench.bufferc;bi++) {
+        int err;
+        if (entry.tid==EGG_TID_song) err=bench_song(entry.rid,bench.ratev[ri],bench.bufferv[bi]);
+        else err=bench_sound(entry.rid,bench.ratev[ri],bench.bufferv[bi]);
+        if (err<0) return err;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Encode results.
+ */
+
+static int bench_encode(struct sr_encoder *dst) {
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  sr_encode_json_string(dst,"rom",3,bench.srcpath,-1);
+  sr_encode_json_int(dst,"chanc",5,bench.chanc);
+  int arrayctx=sr_encode_json_array_start(dst,"results",7);
+  const struct bench_result *result=bench.resultv;
+  int i=bench.resultc;
+  for (;i-->0;result++) {
+    int resctx=sr_encode_json_object_start(dst,0,0);
+    sr_encode_json_string(dst,"type",4,(result->tid==EGG_TID_song)?"song":"sound",-1);
+    sr_encode_json_int(dst,"rid",3,result->rid);
+    sr_encode_json_int(dst,"rate",4,result->rate);
+    sr_encode_json_int(dst,"buffer",6,result->buffer);
+    sr_encode_json_int(dst,"frames",6,result->framec);
+    sr_encode_json_double(dst,"audio_s",7,result->audio_s);
+    sr_encode_json_double(dst,"render_s",8,result->render_s);
+    sr_encode_json_double(dst,"realtime",8,(result->render_s>0.0)?(result->audio_s/result->render_s):0.0);
+    sr_encode_json_double(dst,"peak_buffer_s",13,result->peak_s);
+    sr_encode_json_double(dst,"peak_buffer_load",16,(result->peak_s*result->rate)/result->buffer);
+    if (result->voicec>=0) sr_encode_json_int(dst,"voices",6,result->voicec);
+    else sr_encode_json_null(dst,"voices",6);
+    if (result->heap_peak>=0) sr_encode_json_int(dst,"heap_peak",9,result->heap_peak);
+    else sr_encode_json_null(dst,"heap_peak",9);
+    if (result->allocc>=0) {
+      sr_encode_json_int(dst,"allocs",6,result->allocc);
+      sr_encode_json_int(dst,"render_allocs",13,result->render_allocc);
+    } else {
+      sr_encode_json_null(dst,"allocs",6);
+      sr_encode_json_null(dst,"render_allocs",13);
+    }
+    sr_encode_json_end(dst,resctx);
+  }
+  sr_encode_json_end(dst,arrayctx);
+  if (sr_encode_json_end(dst,jsonctx)<0) return -1;
+  sr_encode_u8(dst,0x0a);
+  return 0;
+}
+
+/* Compare against a previous run.
+ * Fails if any result's render time per second of audio grew by more than (tolerance) percent.
+ * Results missing on either side are ignored, and so are those too quick to time reliably: Under (floor) seconds both times.
+ */
+
+static const struct bench_result *bench_find_result(int tid,int rid,int rate,int buffer) {
+  const struct bench_result *result=bench.resultv;
+  int i=bench.resultc;
+  for (;i-->0;result++) {
+    if (result->tid!=tid) continue;
+    if (result->rid!=rid) continue;
+    if (result->rate!=rate) continue;
+    if (result->buffer!=buffer) continue;
+    return result;
+  }
+  return 0;
+}
+
+static int bench_compare_result(struct sr_decoder *decoder,const char *path,int tolerance,double floor,int *regressc) {
+  int tid=0,rid=0,rate=0,buffer=0;
+  double audio_s=0.0,render_s=0.0;
+  int jsonctx=sr_decode_json_object_start(decoder);
+  if (jsonctx<0) return -1;
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,decoder))>0) {
+    if ((kc==4)&&!memcmp(k,"type",4)) {
+      char type[8];
+      int typec=sr_decode_json_string(type,sizeof(type),decoder);
+      if ((typec==4)&&!memcmp(type,"song",4)) tid=EGG_TID_song;
+      else if ((typec==5)&&!memcmp(type,"sound",5)) tid=EGG_TID_sound;
+      else if (typec>(int)sizeof(type)) sr_decode_json_skip(decoder);
+    }
+    else if ((kc==3)&&!memcmp(k,"rid",3)) sr_decode_json_int(&rid,decoder);
+    else if ((kc==4)&&!memcmp(k,"rate",4)) sr_decode_json_int(&rate,decoder);
+    else if ((kc==6)&&!memcmp(k,"buffer",6)) sr_decode_json_int(&buffer,decoder);
+    else if ((kc==7)&&!memcmp(k,"audio_s",7)) sr_decode_json_double(&audio_s,decoder);
+    else if ((kc==8)&&!memcmp(k,"render_s",8)) sr_decode_json_double(&render_s,decoder);
+    else sr_decode_json_skip(decoder);
+  }
+  if (sr_decode_json_end(decoder,jsonctx)<0) return -1;
+
+  const struct bench_result *result=bench_find_result(tid,rid,rate,buffer);
+  if (!result) return 0;
+  if ((audio_s<=0.0)||(result->audio_s<=0.0)) return 0;
+  if ((render_s<floor)&&(result->render_s<floor)) return 0;
+  double before=render_s/audio_s;
+  double after=result->render_s/result->audio_s;
+  if (after>before*(1.0+tolerance/100.0)) {
+    fprintf(stderr,
+      "%s: %s:%d at rate=%d buffer=%d: %.03f ms per second of audio, was %.03f in %s (+%.01f%%).\n",
+      bench.srcpath,(tid==EGG_TID_song)?"song":"sound",rid,rate,buffer,after*1000.0,before*1000.0,path,((after/before)-1.0)*100.0
+    );
+    (*regressc)++;
+  }
+  return 0;
+}
+
+static int bench_compare(const char *path,int tolerance,double floor) {
+  char *src=0;
+  int srcc=file_read(&src,path);
+  if (srcc<0) {
+    fprintf(stderr,"%s: Failed to read baseline.\n",path);
+    return -2;
+  }
+  int regressc=0,err=0;
+  struct sr_decoder decoder={.v=src,.c=srcc};
+  int jsonctx=sr_decode_json_object_start(&decoder);
+  if (jsonctx<0) err=-1;
+  const char *k;
+  int kc;
+  while ((err>=0)&&((kc=sr_decode_json_next(&k,&decoder))>0)) {
+    if ((kc==7)&&!memcmp(k,"results",7)) {
+      int arrayctx=sr_decode_json_array_start(&decoder);
+      if (arrayctx<0) { err=-1; break; }
+      while (sr_decode_json_next(0,&decoder)>0) {
+        if ((err=bench_compare_result(&decoder,path,tolerance,floor,&regressc))<0) break;
+      }
+      if ((err>=0)&&(sr_decode_json_end(&decoder,arrayctx)<0)) err=-1;
+    } else {
+      sr_decode_json_skip(&decoder);
+    }
+  }
+  free(src);
+  if (err<0) {
+    fprintf(stderr,"%s: Malformed baseline.\n",path);
+    return -2;
+  }
+  if (regressc) {
+    fprintf(stderr,"%s: %d result%s more than %d%% slower than baseline.\n",bench.srcpath,regressc,(regressc==1)?"":"s",tolerance);
+    return -2;
+  }
+  return 0;
+}
+
+/* Benchmark synthesizer, main entry point.
+ */
+
+int eggstra_main_bench() {
+  int err;
+  if ((bench.romc=eggstra_single_input(&bench.rom))<0) return bench.romc;
+  if (eggstra.srcpathc>=1) bench.srcpath=eggstra.srcpathv[0];
+  else bench.srcpath="<stdin>";
+  if ((bench.ratec=bench_read_int_list(bench.ratev,BENCH_CONFIG_LIMIT,"rates",44100))<0) { bench_quit(); return bench.ratec; }
+  if ((bench.bufferc=bench_read_int_list(bench.bufferv,BENCH_CONFIG_LIMIT,"buffers",1024))<0) { bench_quit(); return bench.bufferc; }
+  bench.chanc=eggstra_opti("chanc",5,2);
+  if (bench.chanc<1) bench.chanc=1; else if (bench.chanc>2) bench.chanc=2;
+  bench.limit_s=eggstra_opti("limit",5,600);
+  if (bench.limit_s<1.0) bench.limit_s=1.0;
+
+  if ((err=bench_run())<0) {
+    if (err!=-2) fprintf(stderr,"%s: Unspecified error running benchmarks.\n",bench.srcpath);
+    bench_quit();
+    return -2;
+  }
+  synth_quit();
+
+  struct sr_encoder dst={0};
+  if (bench_encode(&dst)<0) {
+    sr_encoder_cleanup(&dst);
+    bench_quit();
+    return -1;
+  }
+  fwrite(dst.v,1,dst.c,stdout);
+  sr_encoder_cleanup(&dst);
+
+  const char *baseline=eggstra_opt("baseline",8);
+  if (baseline&&baseline[0]) err=bench_compare(baseline,eggstra_opti("tolerance",9,20),eggstra_opti("floor-ms",8,10)/1000.0);
+  else err=0;
+  bench_quit();
+  return err;
+}
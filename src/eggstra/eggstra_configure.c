@@ -19,6 +19,10 @@ void eggstra_print_help(const char *topic,int topicc) {
       "\n"
       "COMMANDS:\n"
       "  play SOUNDFILE [--repeat] [--rate=HZ] [--chanc=1|2] [--driver=NAME] [--device=NAME] [--buffer=INT]\n"
+      "  bench ROMFILE [--rates=HZ,...] [--buffers=FRAMES,...] [--chanc=1|2] [--limit=SECONDS] [--baseline=JSON] [--tolerance=PERCENT] [--floor-ms=MS]\n"
+      "    Render every song and sound offline and print timing as JSON.\n"
+      "    With --baseline, fail if anything takes (tolerance, default 20) percent more CPU than in that previous output.\n"
+      "    Results under (floor-ms, default 10) both times are too quick to judge, and we ignore them.\n"
       "\n"
     );
     /* TODO Possible other commands:
@@ -32,6 +32,7 @@ int main(int argc,char **argv) {
     return 1;
   }
        if (!strcmp(eggstra.command,"play")) err=eggstra_main_play();
+  else if (!strcmp(eggstra.command,"bench")) err=eggstra_main_bench();
   //else if (!strcmp(eggstra.command,"show")) err=eggstra_main_show();
   //else if (!strcmp(eggstra.command,"input")) err=eggstra_main_input();
   else {
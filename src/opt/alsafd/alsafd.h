@@ -33,6 +33,15 @@ struct alsafd_delegate {
    * (c) is in samples as usual -- not frames, not bytes.
    */
   void (*pcm_out)(int16_t *v,int c,void *userdata);
+  
+  /* Optional. If present and the device supports native-endian float32, we call this instead of (pcm_out).
+   * Otherwise we fall back to s16 and (pcm_out), so that one is still required.
+   */
+  void (*pcm_out_float)(float *v,int c,void *userdata);
+  
+  /* Optional. Called after we recover from an underrun, on the I/O thread with the lock held.
+   */
+  void (*underrun)(void *userdata);
 };
 
 /* You will not necessarily get the rate or channel count you ask for.
@@ -98,6 +107,7 @@ int alsafd_get_rate(const struct alsafd *alsafd);
 int alsafd_get_chanc(const struct alsafd *alsafd);
 const char *alsafd_get_device(const struct alsafd *alsafd);
 int alsafd_get_running(const struct alsafd *alsafd);
+int alsafd_get_float(const struct alsafd *alsafd); // Nonzero if we're calling (pcm_out_float).
 
 /* A new context is stopped until you explicitly set_running(1).
  */
@@ -12,16 +12,18 @@ static void *alsafd_iothd(void *arg) {
       usleep(1000);
       continue;
     }
-    if (alsafd->running) {
-      alsafd->delegate.pcm_out(alsafd->buf,alsafd->bufa,alsafd->delegate.userdata);
+    if (!alsafd->running) {
+      memset(alsafd->buf,0,alsafd->samplesize*alsafd->bufa);
+    } else if (alsafd->samplesize==sizeof(float)) {
+      alsafd->delegate.pcm_out_float(alsafd->buf,alsafd->bufa,alsafd->delegate.userdata);
     } else {
-      memset(alsafd->buf,0,alsafd->bufa<<1);
+      alsafd->delegate.pcm_out(alsafd->buf,alsafd->bufa,alsafd->delegate.userdata);
     }
     pthread_mutex_unlock(&alsafd->iomtx);
     alsafd->buffer_time_us=alsafd_now();
     
     const uint8_t *src=(uint8_t*)alsafd->buf;
-    int srcc=alsafd->bufa<<1; // bytes (from samples)
+    int srcc=alsafd->samplesize*alsafd->bufa; // bytes (from samples)
     int srcp=0;
     while (srcp<srcc) {
       pthread_testcancel();
@@ -41,6 +43,10 @@ static void *alsafd_iothd(void *arg) {
             return 0;
           }
           alsafd_error(alsafd,"io","Recovered from underrun");
+          if (alsafd->delegate.underrun&&!pthread_mutex_lock(&alsafd->iomtx)) {
+            alsafd->delegate.underrun(alsafd->delegate.userdata);
+            pthread_mutex_unlock(&alsafd->iomtx);
+          }
         } else {
           alsafd_error(alsafd,"write",0);
           alsafd->ioerror=-1;
@@ -146,14 +152,17 @@ static int alsafd_configure_device(
 
   /* Refine hw params against the broadest set of criteria, anything we can technically handle.
    * (we impose a hard requirement for s16 interleaved; that's about it).
+   * If the delegate can produce float, offer that too, and prefer it if the device agrees.
    */
+  int tryfloat=alsafd->delegate.pcm_out_float?1:0;
   struct snd_pcm_hw_params hwparams;
   alsafd_hw_params_none(&hwparams);
   hwparams.flags=SNDRV_PCM_HW_PARAMS_NORESAMPLE;
   alsafd_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_ACCESS,SNDRV_PCM_ACCESS_RW_INTERLEAVED,1);
   alsafd_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_S16,1);
+  if (tryfloat) alsafd_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_FLOAT,1);
   alsafd_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_SUBFORMAT,SNDRV_PCM_SUBFORMAT_STD,1);
-  alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_SAMPLE_BITS,16,16);
+  alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_SAMPLE_BITS,16,tryfloat?32:16);
   alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_FRAME_BITS,0,UINT_MAX);
   alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_CHANNELS,ALSAFD_CHANC_MIN,ALSAFD_CHANC_MAX);
   alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_RATE,ALSAFD_RATE_MIN,ALSAFD_RATE_MAX);
@@ -169,6 +178,17 @@ static int alsafd_configure_device(
   if (ioctl(alsafd->fd,SNDRV_PCM_IOCTL_HW_REFINE,&hwparams)<0) {
     return alsafd_error(alsafd,"SNDRV_PCM_IOCTL_HW_REFINE",0);
   }
+  
+  // Settle on one format.
+  if (tryfloat&&(alsafd_hw_params_get_mask(&hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_FLOAT)>0)) {
+    alsafd_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_S16,0);
+    alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_SAMPLE_BITS,32,32);
+    alsafd->samplesize=sizeof(float);
+  } else {
+    alsafd_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_FLOAT,0);
+    alsafd_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_SAMPLE_BITS,16,16);
+    alsafd->samplesize=sizeof(int16_t);
+  }
 
   if (setup) {
     if (setup->rate>0) alsafd_hw_params_set_nearest_interval(&hwparams,SNDRV_PCM_HW_PARAM_RATE,setup->rate);
@@ -203,7 +223,7 @@ static int alsafd_configure_device(
   
   alsafd->bufa=(alsafd->hwbufframec*alsafd->chanc)>>1;
   if (alsafd->buf) free(alsafd->buf);
-  if (!(alsafd->buf=malloc(alsafd->bufa<<1))) return -1;
+  if (!(alsafd->buf=malloc(alsafd->samplesize*alsafd->bufa))) return -1;
   alsafd->buftime_s=(double)alsafd->hwbufframec/(double)alsafd->rate;
   
   /* Now set some driver software parameters.
@@ -321,6 +341,11 @@ int alsafd_get_running(const struct alsafd *alsafd) {
   return alsafd->running;
 }
 
+int alsafd_get_float(const struct alsafd *alsafd) {
+  if (!alsafd) return 0;
+  return (alsafd->samplesize==sizeof(float));
+}
+
 void alsafd_set_running(struct alsafd *alsafd,int run) {
   if (!alsafd) return;
   alsafd->running=run?1:0;
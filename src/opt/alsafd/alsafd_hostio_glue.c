@@ -25,6 +25,8 @@ static int _alsafd_init(struct hostio_audio *driver,const struct hostio_audio_se
   struct alsafd_delegate delegate={
     .userdata=driver,
     .pcm_out=(void*)driver->delegate.cb_pcm_out,
+    .pcm_out_float=(void*)driver->delegate.cb_pcm_out_float,
+    .underrun=(void*)driver->delegate.cb_underrun,
   };
   struct alsafd_setup asetup={
     .rate=setup->rate,
@@ -35,6 +37,7 @@ static int _alsafd_init(struct hostio_audio *driver,const struct hostio_audio_se
   if (!(DRIVER->alsafd=alsafd_new(&delegate,&asetup))) return -1;
   driver->rate=DRIVER->alsafd->rate;
   driver->chanc=DRIVER->alsafd->chanc;
+  driver->float_out=alsafd_get_float(DRIVER->alsafd);
   return 0;
 }
 
@@ -37,8 +37,9 @@ struct alsafd {
   pthread_t iothd;
   pthread_mutex_t iomtx;
   int ioerror;
-  int16_t *buf;
+  void *buf;
   int bufa; // samples
+  int samplesize; // bytes; 2 for s16 or 4 for float
   int64_t buffer_time_us;
   double buftime_s;
 };
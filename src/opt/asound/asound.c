@@ -30,6 +30,10 @@ static void *asound_iothd(void *arg) {
       pthread_setcancelstate(pvcancel,0);
       if (err<=0) {
         if (snd_pcm_recover(asound->alsa,err,0)<0) return 0;
+        if ((err==-EPIPE)&&asound->delegate.cb_underrun&&!pthread_mutex_lock(&asound->iomtx)) {
+          asound->delegate.cb_underrun(asound->delegate.userdata);
+          pthread_mutex_unlock(&asound->iomtx);
+        }
         break;
       }
       framep+=err;
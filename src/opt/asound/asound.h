@@ -17,6 +17,7 @@ struct asound;
 struct asound_delegate {
   void *userdata;
   void (*cb_pcm_out)(int16_t *v,int c,void *userdata);
+  void (*cb_underrun)(void *userdata); // Optional. I/O thread, with the lock held.
 };
 
 struct asound_setup {
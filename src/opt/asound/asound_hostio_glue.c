@@ -25,6 +25,7 @@ static int _asound_init(struct hostio_audio *driver,const struct hostio_audio_se
   struct asound_delegate delegate={
     .userdata=driver,
     .cb_pcm_out=(void*)driver->delegate.cb_pcm_out,
+    .cb_underrun=(void*)driver->delegate.cb_underrun,
   };
   struct asound_setup asetup={
     .rate=setup->rate,
@@ -14,6 +14,13 @@ struct hostio_audio_setup;
 struct hostio_audio_delegate {
   void *userdata;
   void (*cb_pcm_out)(int16_t *v,int c,struct hostio_audio *driver);
+  /* Optional. Drivers that can take float32 natively will call this instead of (cb_pcm_out), and set (float_out).
+   * Drivers are free to ignore it, so (cb_pcm_out) is still required.
+   */
+  void (*cb_pcm_out_float)(float *v,int c,struct hostio_audio *driver);
+  /* Optional. Drivers that can tell call this when the device ran dry, on the I/O thread, with the driver locked.
+   */
+  void (*cb_underrun)(struct hostio_audio *driver);
 };
 
 struct hostio_audio {
@@ -21,6 +28,7 @@ struct hostio_audio {
   struct hostio_audio_delegate delegate;
   int rate,chanc;
   int playing;
+  int float_out; // Nonzero if the driver calls (cb_pcm_out_float). Set by the driver at init.
 };
 
 struct hostio_audio_setup {
@@ -12,6 +12,7 @@ extern const struct hostio_video_type hostio_video_type_x11fb;
 extern const struct hostio_video_type hostio_video_type_drmfb;
 extern const struct hostio_video_type hostio_video_type_macwm;
 extern const struct hostio_video_type hostio_video_type_mswm;
+extern const struct hostio_video_type hostio_video_type_headless;
 
 extern const struct hostio_audio_type hostio_audio_type_dummy;
 extern const struct hostio_audio_type hostio_audio_type_alsafd;
@@ -49,6 +50,7 @@ static const struct hostio_video_type *hostio_video_typev[]={
 #if USE_mswin
   &hostio_video_type_mswm,
 #endif
+  &hostio_video_type_headless,
 };
 
 static const struct hostio_audio_type *hostio_audio_typev[]={
@@ -60,6 +60,11 @@ struct hostio_video_type {
   
   int (*gx_begin)(struct hostio_video *driver);
   int (*gx_end)(struct hostio_video *driver);
+  
+  /* Software drivers implement this instead of (gx_begin,gx_end).
+   * Called once per frame after render_commit, with the RGBA output of a software renderer.
+   */
+  int (*fb_present)(struct hostio_video *driver,const void *rgba,int w,int h,int stride);
 };
 
 void hostio_video_del(struct hostio_video *driver);
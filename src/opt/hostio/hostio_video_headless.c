@@ -0,0 +1,61 @@
+/* hostio_video_headless.c
+ * Video driver with no window and no GPU. Accepts finished frames from a software renderer and discards them.
+ * Build with "softrender" instead of "render" to use it.
+ * Meant for benchmarks and automated runs; see eggrt's --clock=redline and --frame-report.
+ */
+
+#include "hostio_internal.h"
+
+// If neither window nor framebuffer size is provided, use this.
+#define HEADLESS_DEFAULT_W 640
+#define HEADLESS_DEFAULT_H 360
+
+/* Object definition.
+ */
+
+struct hostio_video_headless {
+  struct hostio_video hdr;
+  int framec;
+};
+
+#define DRIVER ((struct hostio_video_headless*)driver)
+
+/* Init.
+ * Window size defaults to the framebuffer size, so the renderer's final scale is a straight copy.
+ */
+
+static int _headless_init(struct hostio_video *driver,const struct hostio_video_setup *setup) {
+  if ((setup->w>0)&&(setup->h>0)) {
+    driver->w=setup->w;
+    driver->h=setup->h;
+  } else if ((setup->fbw>0)&&(setup->fbh>0)) {
+    driver->w=setup->fbw;
+    driver->h=setup->fbh;
+  } else {
+    driver->w=HEADLESS_DEFAULT_W;
+    driver->h=HEADLESS_DEFAULT_H;
+  }
+  driver->fullscreen=0;
+  return 0;
+}
+
+/* Receive frame.
+ */
+
+static int _headless_fb_present(struct hostio_video *driver,const void *rgba,int w,int h,int stride) {
+  DRIVER->framec++;
+  return 0;
+}
+
+/* Type definition.
+ */
+
+const struct hostio_video_type hostio_video_type_headless={
+  .name="headless",
+  .desc="No window. Requires the software renderer. For benchmarks and automation.",
+  .objlen=sizeof(struct hostio_video_headless),
+  .appointment_only=1,
+  .provides_input=0,
+  .init=_headless_init,
+  .fb_present=_headless_fb_present,
+};
@@ -17,6 +17,16 @@ struct pulse_delegate {
    * (c) is in samples as usual -- not frames, not bytes.
    */
   void (*pcm_out)(int16_t *v,int c,void *userdata);
+  
+  /* Optional. If present, we ask Pulse for native float32 and call this instead of (pcm_out).
+   * Same rules as (pcm_out), but you don't need to quantize. Pulse clamps anything outside -1..1.
+   */
+  void (*pcm_out_float)(float *v,int c,void *userdata);
+  
+  /* Optional. Called when the server's buffer ran dry since our last write, on the I/O thread with the lock held.
+   * Pulse doesn't tell us directly; we notice when the latency is zero just before writing.
+   */
+  void (*underrun)(void *userdata);
 };
 
 struct pulse_setup {
@@ -40,6 +50,7 @@ void *pulse_get_userdata(const struct pulse *pulse);
 int pulse_get_rate(const struct pulse *pulse);
 int pulse_get_chanc(const struct pulse *pulse);
 int pulse_get_running(const struct pulse *pulse);
+int pulse_get_float(const struct pulse *pulse); // Nonzero if we're calling (pcm_out_float).
 
 void pulse_set_running(struct pulse *pulse,int running);
 
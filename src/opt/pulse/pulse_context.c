@@ -8,14 +8,24 @@ static void *pulse_iothd(void *arg) {
   while (1) {
     pthread_testcancel();
     
+    int underrun=0;
+    if (pulse->delegate.underrun&&pulse->primed) {
+      int err=0;
+      pa_usec_t latency=pa_simple_get_latency(pulse->pa,&err);
+      if (!latency) underrun=1;
+    }
+    
     if (pthread_mutex_lock(&pulse->iomtx)) {
       usleep(1000);
       continue;
     }
-    if (pulse->running) {
-      pulse->delegate.pcm_out(pulse->buf,pulse->bufa,pulse->delegate.userdata);
+    if (underrun&&pulse->running) pulse->delegate.underrun(pulse->delegate.userdata);
+    if (!pulse->running) {
+      memset(pulse->buf,0,pulse->samplesize*pulse->bufa);
+    } else if (pulse->samplesize==sizeof(float)) {
+      pulse->delegate.pcm_out_float(pulse->buf,pulse->bufa,pulse->delegate.userdata);
     } else {
-      memset(pulse->buf,0,pulse->bufa<<1);
+      pulse->delegate.pcm_out(pulse->buf,pulse->bufa,pulse->delegate.userdata);
     }
     pulse->buffer_time_us=pulse_now();
     pthread_mutex_unlock(&pulse->iomtx);
@@ -24,12 +34,13 @@ static void *pulse_iothd(void *arg) {
     pthread_testcancel();
     int pvcancel;
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,&pvcancel);
-    result=pa_simple_write(pulse->pa,pulse->buf,sizeof(int16_t)*pulse->bufa,&err);
+    result=pa_simple_write(pulse->pa,pulse->buf,pulse->samplesize*pulse->bufa,&err);
     pthread_setcancelstate(pvcancel,0);
     if (result<0) {
       pulse->ioerror=-1;
       return 0;
     }
+    pulse->primed=1;
   }
 }
 
@@ -72,18 +83,27 @@ static int pulse_init_pa(struct pulse *pulse,const struct pulse_setup *setup) {
   if (buffersize<1) buffersize=pulse->rate/20;
   if (buffersize<20) buffersize=20;
 
+  /* Float if the client can take it, so the conversion happens (if at all) in Pulse's mixer, not twice.
+   * Pulse accepts any sample format from any client, so no need for a fallback.
+   */
   pa_sample_spec sample_spec={
-    #if BYTE_ORDER==BIG_ENDIAN
-      .format=PA_SAMPLE_S16BE,
-    #else
-      .format=PA_SAMPLE_S16LE,
-    #endif
     .rate=pulse->rate,
     .channels=pulse->chanc,
   };
+  if (pulse->delegate.pcm_out_float) {
+    sample_spec.format=PA_SAMPLE_FLOAT32NE;
+    pulse->samplesize=sizeof(float);
+  } else {
+    #if BYTE_ORDER==BIG_ENDIAN
+      sample_spec.format=PA_SAMPLE_S16BE;
+    #else
+      sample_spec.format=PA_SAMPLE_S16LE;
+    #endif
+    pulse->samplesize=sizeof(int16_t);
+  }
   pa_buffer_attr buffer_attr={
-    .maxlength=pulse->chanc*sizeof(int16_t)*buffersize,
-    .tlength=pulse->chanc*sizeof(int16_t)*buffersize,
+    .maxlength=pulse->chanc*pulse->samplesize*buffersize,
+    .tlength=pulse->chanc*pulse->samplesize*buffersize,
     .prebuf=0xffffffff,
     .minreq=0xffffffff,
   };
@@ -128,7 +148,7 @@ static int pulse_init_buffer(struct pulse *pulse,const struct pulse_setup *setup
   // Reduce to next multiple of channel count.
   pulse->bufa-=pulse->bufa%pulse->chanc;
   
-  if (!(pulse->buf=malloc(sizeof(int16_t)*pulse->bufa))) {
+  if (!(pulse->buf=malloc(pulse->samplesize*pulse->bufa))) {
     return -1;
   }
   pulse->buftime_s=(double)(pulse->bufa/pulse->chanc)/(double)pulse->rate;
@@ -198,6 +218,11 @@ int pulse_get_running(const struct pulse *pulse) {
   return pulse->running;
 }
 
+int pulse_get_float(const struct pulse *pulse) {
+  if (!pulse) return 0;
+  return (pulse->samplesize==sizeof(float));
+}
+
 void pulse_set_running(struct pulse *pulse,int running) {
   if (!pulse) return;
   pulse->running=running?1:0;
@@ -25,6 +25,8 @@ static int _pulse_init(struct hostio_audio *driver,const struct hostio_audio_set
   struct pulse_delegate delegate={
     .userdata=driver,
     .pcm_out=(void*)driver->delegate.cb_pcm_out,
+    .pcm_out_float=(void*)driver->delegate.cb_pcm_out_float,
+    .underrun=(void*)driver->delegate.cb_underrun,
   };
   struct pulse_setup psetup={
     .rate=setup->rate,
@@ -37,6 +39,7 @@ static int _pulse_init(struct hostio_audio *driver,const struct hostio_audio_set
   driver->rate=DRIVER->pulse->rate;
   driver->chanc=DRIVER->pulse->chanc;
   driver->playing=DRIVER->pulse->running;
+  driver->float_out=pulse_get_float(DRIVER->pulse);
   return 0;
 }
 
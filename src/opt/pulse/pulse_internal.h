@@ -18,11 +18,13 @@ struct pulse {
   pthread_t iothd;
   pthread_mutex_t iomtx;
   int ioerror;
-  int16_t *buf;
+  void *buf;
   int bufa; // samples
+  int samplesize; // bytes; 2 for s16 or 4 for float
   pa_simple *pa;
   int64_t buffer_time_us;
   double buftime_s;
+  int primed; // Nonzero once we've written something, so an empty server buffer means an underrun.
 };
 
 int64_t pulse_now();
@@ -7,6 +7,8 @@
 #ifndef RENDER_H
 #define RENDER_H
 
+#include <stdint.h>
+
 struct render;
 struct egg_render_uniform;
 
@@ -45,7 +47,25 @@ void render_texture_clear(struct render *render,int texid);
 
 /* We DO allow (uniform->dsttexid==0) to render to the real main output; we use that internally.
  * Calls from the client must never have (dsttexid==0).
+ * We record calls and draw them at render_commit(), or sooner if some texture operation needs them done.
+ * Consecutive calls with the same uniform merge into one draw where the primitive allows.
  */
 void render_render(struct render *render,const struct egg_render_uniform *uniform,const void *vtxv,int vtxc);
 
+/* Software renderers only: The finished image from the last render_commit(), RGBA, at the size from render_set_size().
+ * The GL renderer returns null; its output is already on the GPU.
+ */
+const void *render_get_output(int *w,int *h,int *stride,struct render *render);
+
+/* Counts of GL calls and draws we issued, for performance reports.
+ * Frames end at render_commit().
+ */
+struct render_stats {
+  int framec;
+  int64_t glcallc,drawc,vtxc; // Total, across (framec). (vtxc) counts vertices as submitted, before merging.
+  int glcallc_max,drawc_max,vtxc_max; // Highest in any one frame.
+  int glcallc_last,drawc_last,vtxc_last; // Most recent frame.
+};
+void render_get_stats(struct render_stats *stats,const struct render *render);
+
 #endif
@@ -10,6 +10,9 @@ void render_del(struct render *render) {
     free(render->texturev);
   }
   if (render->scratch) free(render->scratch);
+  if (render->cmdv) free(render->cmdv);
+  if (render->vtxv) free(render->vtxv);
+  if (render->vbo) glDeleteBuffers(1,&render->vbo);
   struct render_program *program=render->programv;
   int i=RENDER_PROGRAM_COUNT;
   for (;i-->0;program++) render_program_cleanup(render,program);
@@ -45,6 +48,8 @@ struct render *render_new() {
     return 0;
   }
   
+  glGenBuffers(1,&render->vbo);
+  
   glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
   glEnable(0x8642); // GL_PROGRAM_POINT_SIZE, on my Mac it's required but not declared.
   glEnable(GL_BLEND);
@@ -79,29 +84,66 @@ int render_scratch_require(struct render *render,int c) {
  */
 
 void render_begin(struct render *render) {
-  render->current_dsttexid=0;
+  render_flush(render); // Anything recorded between frames, eg during init.
+  render->current_dsttexid=-1;
   render->current_srctexid=0;
   render->current_programid=0;
-  glEnable(GL_BLEND);
+  RENDER_GL(render,glEnable(GL_BLEND))
+}
+
+/* Close out the frame's counters.
+ */
+ 
+static void render_stats_frame(struct render *render) {
+  struct render_stats *stats=&render->stats;
+  if (stats->framec<INT_MAX) stats->framec++;
+  stats->glcallc+=render->frame_glcallc;
+  stats->drawc+=render->frame_drawc;
+  stats->vtxc+=render->frame_vtxc;
+  if (render->frame_glcallc>stats->glcallc_max) stats->glcallc_max=render->frame_glcallc;
+  if (render->frame_drawc>stats->drawc_max) stats->drawc_max=render->frame_drawc;
+  if (render->frame_vtxc>stats->vtxc_max) stats->vtxc_max=render->frame_vtxc;
+  stats->glcallc_last=render->frame_glcallc;
+  stats->drawc_last=render->frame_drawc;
+  stats->vtxc_last=render->frame_vtxc;
+  render->frame_glcallc=0;
+  render->frame_drawc=0;
+  render->frame_vtxc=0;
+}
+
+const void *render_get_output(int *w,int *h,int *stride,struct render *render) {
+  return 0;
+}
+
+void render_get_stats(struct render_stats *stats,const struct render *render) {
+  if (!render) {
+    memset(stats,0,sizeof(struct render_stats));
+    return;
+  }
+  *stats=render->stats;
 }
 
 /* End frame, and draw the main.
  */
  
 void render_commit(struct render *render) {
+  render_flush(render);
   render_require_projection(render);
   render_to_texture(render,0);
   
   /* If the framebuffer doesn't fill the output, black out.
    */
   if ((render->dstx>0)||(render->dsty>0)) {
-    glClearColor(0.0f,0.0f,0.0f,1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    RENDER_GL(render,glClearColor(0.0f,0.0f,0.0f,1.0f))
+    RENDER_GL(render,glClear(GL_COLOR_BUFFER_BIT))
   }
   
   /* Render with the public API.
    */
-  if ((render->texturec<1)||(render->texturev[0].texid!=1)) return;
+  if ((render->texturec<1)||(render->texturev[0].texid!=1)) {
+    render_stats_frame(render);
+    return;
+  }
   int srcw=render->texturev[0].w;
   int srch=render->texturev[0].h;
   struct egg_render_uniform uniform={
@@ -117,9 +159,11 @@ void render_commit(struct render *render) {
     {render->dstx+render->dstw,render->dsty             ,srcw,srch},
     {render->dstx+render->dstw,render->dsty+render->dsth,srcw,0   },
   };
-  glDisable(GL_BLEND);
+  RENDER_GL(render,glDisable(GL_BLEND))
   render_render(render,&uniform,vtxv,sizeof(vtxv));
-  glEnable(GL_BLEND);
+  render_flush(render);
+  RENDER_GL(render,glEnable(GL_BLEND))
+  render_stats_frame(render);
 }
 
 /* Final projection.
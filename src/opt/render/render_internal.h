@@ -26,6 +26,10 @@
   #endif
 #endif
 
+/* Wrap GL calls made while rendering, so they count toward render_get_stats().
+ */
+#define RENDER_GL(render,call) { (render)->frame_glcallc++; call; }
+
 #define RENDER_FB_LIMIT 4096
 #define RENDER_WIN_LIMIT 4096
 
@@ -45,6 +49,7 @@ struct render_texture {
   int gltexid;
   int fbid; // Zero if read-only.
   int border; // Extra border on all sides to dodge MacOS point-sprite culling problems. Not included in (w,h).
+  int filter; // GL_NEAREST or GL_LINEAR if we've set both min and mag to it, otherwise zero.
 };
 
 struct render_program {
@@ -57,6 +62,17 @@ struct render_program {
   int u_alpha; // float
   int u_sampler; // int
   const char *name; // static
+  // Last values we set, to skip redundant glUniform calls.
+  GLfloat screensize[2],srcsize[2],dstborder,srcborder,tint[4],alpha;
+  int sampler;
+};
+
+/* Deferred egg_render calls.
+ * Vertices live in (render->vtxv), we only record their position.
+ */
+struct render_cmd {
+  struct egg_render_uniform uniform;
+  int vtxp,vtxc; // Bytes, in (render->vtxv).
 };
 
 struct render {
@@ -75,8 +91,23 @@ struct render {
   
   struct render_program programv[RENDER_PROGRAM_COUNT];
   
-  // Current selected textures and programs (GL IDs).
+  // Current selected textures and programs (GL IDs). Dst -1 if unknown (zero is the main output).
   int current_dsttexid,current_srctexid,current_programid;
+  int attribc; // Vertex attribute arrays 0..attribc-1 are enabled, the rest disabled.
+  
+  // Counters for render_get_stats().
+  int frame_glcallc,frame_drawc,frame_vtxc;
+  struct render_stats stats;
+  
+  // Render calls pending for the next flush.
+  struct render_cmd *cmdv;
+  int cmdc,cmda;
+  void *vtxv;
+  int vtxc,vtxa;
+  
+  // Streaming vertex buffer, refilled from (vtxv) at each flush. Zero to use client arrays instead.
+  GLuint vbo;
+  int vboa;
 };
 
 // Populates (dstx,dsty,dstw,dsth) if needed.
@@ -93,6 +124,12 @@ int render_texture_require_fb(struct render *render,struct render_texture *textu
  */
 int render_to_texture(struct render *render,struct render_texture *texture);
 
+/* Draw everything recorded by render_render(), and empty the command buffer.
+ * Anything that touches GL outside render_render() must flush first.
+ */
+void render_flush(struct render *render);
+
+void render_program_forget_uniforms(struct render_program *program);
 void render_program_cleanup(struct render *render,struct render_program *program);
 int render_programs_init(struct render *render);
 
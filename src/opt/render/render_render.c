@@ -217,6 +217,20 @@ void render_program_cleanup(struct render *render,struct render_program *program
   }
 }
 
+/* Invalidate the shadowed uniforms, so each gets set on its next use.
+ * GLSL initializes uniforms to zero, but the impossible -1 is easier than knowing which are in use.
+ */
+ 
+void render_program_forget_uniforms(struct render_program *program) {
+  program->screensize[0]=program->screensize[1]=-1.0f;
+  program->srcsize[0]=program->srcsize[1]=-1.0f;
+  program->dstborder=-1.0f;
+  program->srcborder=-1.0f;
+  program->tint[0]=program->tint[1]=program->tint[2]=program->tint[3]=-1.0f;
+  program->alpha=-1.0f;
+  program->sampler=-1;
+}
+
 /* Compile half of one program.
  * <0 for error.
  */
@@ -306,6 +320,7 @@ static int render_program_init(
     program->u_tint=glGetUniformLocation(program->programid,"utint");
     program->u_alpha=glGetUniformLocation(program->programid,"ualpha");
     program->u_sampler=glGetUniformLocation(program->programid,"usampler");
+    render_program_forget_uniforms(program);
     return 0;
   }
   
@@ -351,11 +366,20 @@ int render_programs_init(struct render *render) {
   return 0;
 }
 
-/* Render.
+/* Enable the first (c) vertex attribute arrays and disable the rest.
  */
+ 
+static void render_attribs_enable(struct render *render,int c) {
+  for (;render->attribc<c;render->attribc++) RENDER_GL(render,glEnableVertexAttribArray(render->attribc))
+  while (render->attribc>c) RENDER_GL(render,glDisableVertexAttribArray(--(render->attribc)))
+}
 
-void render_render(struct render *render,const struct egg_render_uniform *uniform,const void *vtxv,int vtxc) {
-  if (!uniform||!vtxv) return;
+/* Draw one call.
+ * (vtxv) is an offset into the bound vertex buffer, or a real pointer if we don't have one.
+ */
+
+static void render_draw(struct render *render,const struct egg_render_uniform *uniform,const void *vtxv,int vtxc) {
+  if (!uniform||(vtxc<1)) return;
   
   /* Select program and finalize vertex count.
    */
@@ -409,122 +433,246 @@ void render_render(struct render *render,const struct egg_render_uniform *unifor
   
   /* Bind to the output texture if it's not currently bound.
    */
-  GLfloat screenw,screenh;
+  GLfloat screenw,screenh,dstborder;
   if (dsttex) {
     if (dsttex->gltexid!=render->current_dsttexid) {
-      glBindFramebuffer(GL_FRAMEBUFFER,dsttex->fbid);
-      glViewport(0,0,dsttex->w+dsttex->border*2,dsttex->h+dsttex->border*2);
+      RENDER_GL(render,glBindFramebuffer(GL_FRAMEBUFFER,dsttex->fbid))
+      RENDER_GL(render,glViewport(0,0,dsttex->w+dsttex->border*2,dsttex->h+dsttex->border*2))
       render->current_dsttexid=dsttex->gltexid;
     }
     screenw=dsttex->w;
     screenh=dsttex->h;
+    dstborder=dsttex->border;
   } else {
     if (render->current_dsttexid) {
-      glBindFramebuffer(GL_FRAMEBUFFER,0);
-      glViewport(0,0,render->winw*render->scale,render->winh*render->scale);
+      RENDER_GL(render,glBindFramebuffer(GL_FRAMEBUFFER,0))
+      RENDER_GL(render,glViewport(0,0,render->winw*render->scale,render->winh*render->scale))
       render->current_dsttexid=0;
     }
     screenw=render->winw;
     screenh=render->winh;
+    dstborder=0.0f;
   }
   
-  /* Bind to the program if it's not currently bound, and set uniforms.
+  /* Bind to the program if it's not currently bound, and set uniforms that changed since its last use.
    */
   if (program->programid!=render->current_programid) {
-    glUseProgram(program->programid);
+    RENDER_GL(render,glUseProgram(program->programid))
     render->current_programid=program->programid;
   }
-  glUniform2f(program->u_screensize,screenw,screenh);
-  if (dsttex) {
-    glUniform1f(program->u_dstborder,dsttex->border);
-  } else {
-    glUniform1f(program->u_dstborder,0.0f);
+  if ((screenw!=program->screensize[0])||(screenh!=program->screensize[1])) {
+    RENDER_GL(render,glUniform2f(program->u_screensize,screenw,screenh))
+    program->screensize[0]=screenw;
+    program->screensize[1]=screenh;
+  }
+  if (dstborder!=program->dstborder) {
+    RENDER_GL(render,glUniform1f(program->u_dstborder,dstborder))
+    program->dstborder=dstborder;
   }
   if (srctex) {
-    glUniform2f(program->u_srcsize,srctex->w,srctex->h);
-    glUniform1f(program->u_srcborder,srctex->border);
-    glUniform1i(program->u_sampler,0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D,srctex->gltexid);
-    if (uniform->filter) {
-      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    } else {
-      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-      glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    if ((srctex->w!=program->srcsize[0])||(srctex->h!=program->srcsize[1])) {
+      RENDER_GL(render,glUniform2f(program->u_srcsize,srctex->w,srctex->h))
+      program->srcsize[0]=srctex->w;
+      program->srcsize[1]=srctex->h;
+    }
+    if (srctex->border!=program->srcborder) {
+      RENDER_GL(render,glUniform1f(program->u_srcborder,srctex->border))
+      program->srcborder=srctex->border;
+    }
+    if (program->sampler) {
+      RENDER_GL(render,glUniform1i(program->u_sampler,0))
+      program->sampler=0;
+    }
+    if (srctex->gltexid!=render->current_srctexid) {
+      RENDER_GL(render,glBindTexture(GL_TEXTURE_2D,srctex->gltexid))
+      render->current_srctexid=srctex->gltexid;
+    }
+    int filter=uniform->filter?GL_LINEAR:GL_NEAREST;
+    if (filter!=srctex->filter) {
+      RENDER_GL(render,glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,filter))
+      RENDER_GL(render,glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,filter))
+      srctex->filter=filter;
     }
   }
+  GLfloat tint[4]={0.0f,0.0f,0.0f,0.0f};
   if (uniform->tint) {
     const uint8_t r=uniform->tint>>24,g=uniform->tint>>16,b=uniform->tint>>8,a=uniform->tint;
-    glUniform4f(program->u_tint,r/255.0f,g/255.0f,b/255.0f,a/255.0f);
-  } else {
-    glUniform4f(program->u_tint,0.0f,0.0f,0.0f,0.0f);
+    tint[0]=r/255.0f;
+    tint[1]=g/255.0f;
+    tint[2]=b/255.0f;
+    tint[3]=a/255.0f;
+  }
+  if (memcmp(tint,program->tint,sizeof(tint))) {
+    RENDER_GL(render,glUniform4f(program->u_tint,tint[0],tint[1],tint[2],tint[3]))
+    memcpy(program->tint,tint,sizeof(tint));
+  }
+  GLfloat alpha=uniform->alpha/255.0f;
+  if (alpha!=program->alpha) {
+    RENDER_GL(render,glUniform1f(program->u_alpha,alpha))
+    program->alpha=alpha;
   }
-  glUniform1f(program->u_alpha,uniform->alpha/255.0f);
   
   /* Prepare vertex pointers, and do it.
+   * Attribute arrays stay enabled between draws; each program uses a prefix of them.
    */
   switch ((int)(program-render->programv)) {
     case RENDER_PROGRAM_RAW: {
         const struct egg_render_raw *V=vtxv;
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_raw),&V->x);
-        glVertexAttribPointer(1,4,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_raw),&V->r);
-        glDrawArrays(glmode,0,vtxc);
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
+        render_attribs_enable(render,2);
+        RENDER_GL(render,glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_raw),&V->x))
+        RENDER_GL(render,glVertexAttribPointer(1,4,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_raw),&V->r))
+        RENDER_GL(render,glDrawArrays(glmode,0,vtxc))
       } break;
       
     case RENDER_PROGRAM_TEX: {
         const struct egg_render_raw *V=vtxv;
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_raw),&V->x);
-        glVertexAttribPointer(1,2,GL_SHORT,0,sizeof(struct egg_render_raw),&V->tx);
-        glDrawArrays(glmode,0,vtxc);
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
+        render_attribs_enable(render,2);
+        RENDER_GL(render,glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_raw),&V->x))
+        RENDER_GL(render,glVertexAttribPointer(1,2,GL_SHORT,0,sizeof(struct egg_render_raw),&V->tx))
+        RENDER_GL(render,glDrawArrays(glmode,0,vtxc))
       } break;
       
     case RENDER_PROGRAM_TILE: {
         const struct egg_render_tile *V=vtxv;
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_tile),&V->x);
-        glVertexAttribPointer(1,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_tile),&V->tileid);
-        glVertexAttribPointer(2,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_tile),&V->xform);
-        glDrawArrays(GL_POINTS,0,vtxc);
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
+        render_attribs_enable(render,3);
+        RENDER_GL(render,glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_tile),&V->x))
+        RENDER_GL(render,glVertexAttribPointer(1,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_tile),&V->tileid))
+        RENDER_GL(render,glVertexAttribPointer(2,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_tile),&V->xform))
+        RENDER_GL(render,glDrawArrays(GL_POINTS,0,vtxc))
       } break;
       
     case RENDER_PROGRAM_FANCY: {
         const struct egg_render_fancy *V=vtxv;
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
-        glEnableVertexAttribArray(3);
-        glEnableVertexAttribArray(4);
-        glEnableVertexAttribArray(5);
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_fancy),&V->x);
-        glVertexAttribPointer(1,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_fancy),&V->tileid);
-        glVertexAttribPointer(2,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_fancy),&V->xform);
-        glVertexAttribPointer(3,1,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_fancy),&V->rotation);
-        glVertexAttribPointer(4,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_fancy),&V->size);
-        glVertexAttribPointer(5,4,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_fancy),&V->tr);
-        glVertexAttribPointer(6,4,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_fancy),&V->pr);
-        glDrawArrays(GL_POINTS,0,vtxc);
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
-        glDisableVertexAttribArray(3);
-        glDisableVertexAttribArray(4);
-        glDisableVertexAttribArray(5);
-        glDisableVertexAttribArray(6);
+        render_attribs_enable(render,7);
+        RENDER_GL(render,glVertexAttribPointer(0,2,GL_SHORT,0,sizeof(struct egg_render_fancy),&V->x))
+        RENDER_GL(render,glVertexAttribPointer(1,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_fancy),&V->tileid))
+        RENDER_GL(render,glVertexAttribPointer(2,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_fancy),&V->xform))
+        RENDER_GL(render,glVertexAttribPointer(3,1,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_fancy),&V->rotation))
+        RENDER_GL(render,glVertexAttribPointer(4,1,GL_UNSIGNED_BYTE,0,sizeof(struct egg_render_fancy),&V->size))
+        RENDER_GL(render,glVertexAttribPointer(5,4,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_fancy),&V->tr))
+        RENDER_GL(render,glVertexAttribPointer(6,4,GL_UNSIGNED_BYTE,1,sizeof(struct egg_render_fancy),&V->pr))
+        RENDER_GL(render,glDrawArrays(GL_POINTS,0,vtxc))
       } break;
   }
+  render->frame_drawc++;
+}
+
+/* Vertex size for a render mode, or zero if invalid.
+ */
+ 
+static int render_vertex_size(int mode) {
+  switch (mode) {
+    case EGG_RENDER_POINTS:
+    case EGG_RENDER_LINES:
+    case EGG_RENDER_LINE_STRIP:
+    case EGG_RENDER_TRIANGLES:
+    case EGG_RENDER_TRIANGLE_STRIP: return sizeof(struct egg_render_raw);
+    case EGG_RENDER_TILE: return sizeof(struct egg_render_tile);
+    case EGG_RENDER_FANCY: return sizeof(struct egg_render_fancy);
+  }
+  return 0;
+}
+
+/* Nonzero if two calls would draw the same with their vertices concatenated.
+ * Strips can't simply concatenate, but TRIANGLE_STRIP can with a pair of degenerate triangles between.
+ */
+ 
+static int render_uniform_mergeable(const struct egg_render_uniform *a,const struct egg_render_uniform *b) {
+  if (a->mode!=b->mode) return 0;
+  if (a->mode==EGG_RENDER_LINE_STRIP) return 0;
+  if (a->dsttexid!=b->dsttexid) return 0;
+  if (a->srctexid!=b->srctexid) return 0;
+  if (a->tint!=b->tint) return 0;
+  if (a->alpha!=b->alpha) return 0;
+  if (a->srctexid&&(a->filter!=b->filter)) return 0;
+  return 1;
+}
+
+/* Grow vertex and command buffers.
+ */
+ 
+static int render_vtxv_require(struct render *render,int addc) {
+  if (addc>INT_MAX-render->vtxc) return -1;
+  int na=render->vtxc+addc;
+  if (na<=render->vtxa) return 0;
+  if (na<INT_MAX-0xffff) na=(na+0xffff)&~0xffff;
+  void *nv=realloc(render->vtxv,na);
+  if (!nv) return -1;
+  render->vtxv=nv;
+  render->vtxa=na;
+  return 0;
+}
+
+static struct render_cmd *render_cmdv_add(struct render *render) {
+  if (render->cmdc>=render->cmda) {
+    int na=render->cmda+256;
+    if (na>INT_MAX/sizeof(struct render_cmd)) return 0;
+    void *nv=realloc(render->cmdv,sizeof(struct render_cmd)*na);
+    if (!nv) return 0;
+    render->cmdv=nv;
+    render->cmda=na;
+  }
+  return render->cmdv+render->cmdc++;
+}
+
+/* Render: Record the call for the next flush, merging into the previous call if we can.
+ */
+
+void render_render(struct render *render,const struct egg_render_uniform *uniform,const void *vtxv,int vtxc) {
+  if (!uniform||!vtxv) return;
+  int vtxsize=render_vertex_size(uniform->mode);
+  if (!vtxsize) return;
+  vtxc-=vtxc%vtxsize;
+  if (vtxc<1) return;
+  render->frame_vtxc+=vtxc/vtxsize;
+  
+  struct render_cmd *cmd=render->cmdc?(render->cmdv+render->cmdc-1):0;
+  if (cmd&&render_uniform_mergeable(&cmd->uniform,uniform)) {
+    if (uniform->mode==EGG_RENDER_TRIANGLE_STRIP) {
+      if (render_vtxv_require(render,vtxsize*2+vtxc)<0) return;
+      uint8_t *dst=(uint8_t*)render->vtxv+render->vtxc;
+      memcpy(dst,dst-vtxsize,vtxsize);
+      memcpy(dst+vtxsize,vtxv,vtxsize);
+      memcpy(dst+vtxsize*2,vtxv,vtxc);
+      render->vtxc+=vtxsize*2+vtxc;
+      cmd->vtxc+=vtxsize*2+vtxc;
+    } else {
+      if (render_vtxv_require(render,vtxc)<0) return;
+      memcpy((uint8_t*)render->vtxv+render->vtxc,vtxv,vtxc);
+      render->vtxc+=vtxc;
+      cmd->vtxc+=vtxc;
+    }
+    return;
+  }
+  
+  if (render_vtxv_require(render,vtxc)<0) return;
+  if (!(cmd=render_cmdv_add(render))) return;
+  cmd->uniform=*uniform;
+  cmd->vtxp=render->vtxc;
+  cmd->vtxc=vtxc;
+  memcpy((uint8_t*)render->vtxv+render->vtxc,vtxv,vtxc);
+  render->vtxc+=vtxc;
+}
+
+/* Flush.
+ */
+ 
+static uintptr_t render_vbo_upload(struct render *render) {
+  if (!render->vbo) return (uintptr_t)render->vtxv;
+  RENDER_GL(render,glBindBuffer(GL_ARRAY_BUFFER,render->vbo))
+  if (render->vtxc>render->vboa) render->vboa=render->vtxa;
+  // Respecify the whole store each time, so the driver can hand us fresh memory instead of waiting on draws in flight.
+  RENDER_GL(render,glBufferData(GL_ARRAY_BUFFER,render->vboa,0,GL_STREAM_DRAW))
+  RENDER_GL(render,glBufferSubData(GL_ARRAY_BUFFER,0,render->vtxc,render->vtxv))
+  return 0;
+}
+ 
+void render_flush(struct render *render) {
+  if (!render->cmdc) return;
+  uintptr_t base=render_vbo_upload(render);
+  const struct render_cmd *cmd=render->cmdv;
+  int i=render->cmdc;
+  for (;i-->0;cmd++) render_draw(render,&cmd->uniform,(const void*)(base+cmd->vtxp),cmd->vtxc);
+  render->cmdc=0;
+  render->vtxc=0;
 }
@@ -16,6 +16,9 @@ static int render_texture_border_size(struct render *render) {
  */
  
 static void render_texture_cleanup(struct render *render,struct render_texture *texture) {
+  // Deleting a bound texture or framebuffer unbinds it.
+  if (texture->gltexid==render->current_srctexid) render->current_srctexid=0;
+  if (texture->gltexid==render->current_dsttexid) render->current_dsttexid=-1;
   glDeleteTextures(1,(GLuint*)&texture->gltexid);
   if (texture->fbid) {
     glDeleteFramebuffers(1,(GLuint*)&texture->fbid);
@@ -27,6 +30,7 @@ static void render_texture_cleanup(struct render *render,struct render_texture *
  
 static void render_texture_drop_fb(struct render *render,struct render_texture *texture) {
   if (!texture->fbid) return;
+  if (texture->gltexid==render->current_dsttexid) render->current_dsttexid=-1;
   glDeleteFramebuffers(1,(GLuint*)&texture->fbid);
   texture->fbid=0;
 }
@@ -41,9 +45,10 @@ int render_texture_require_fb(struct render *render,struct render_texture *textu
     glGenFramebuffers(1,&texture->fbid);
     if (!texture->fbid) return -1;
   }
-  glBindFramebuffer(GL_FRAMEBUFFER,texture->fbid);
-  glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,texture->gltexid,0);
-  glBindFramebuffer(GL_FRAMEBUFFER,0);
+  RENDER_GL(render,glBindFramebuffer(GL_FRAMEBUFFER,texture->fbid))
+  RENDER_GL(render,glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,texture->gltexid,0))
+  RENDER_GL(render,glBindFramebuffer(GL_FRAMEBUFFER,0))
+  render->current_dsttexid=-1;
   return 0;
 }
 
@@ -99,6 +104,7 @@ struct render_texture *render_texturev_insert(struct render *render,int p,int te
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  render->current_srctexid=gltexid;
   
   // Create our wrapper object.
   struct render_texture *texture=render->texturev+p;
@@ -116,6 +122,7 @@ struct render_texture *render_texturev_insert(struct render *render,int p,int te
 
 void render_texture_del(struct render *render,int texid) {
   if (texid<=1) return; // Not allowed to delete texture 1, and <=0 are illegal.
+  render_flush(render);
   int p=render_texturev_search(render,texid);
   if (p<0) return;
   render_texturev_remove(render,p,1);
@@ -150,8 +157,11 @@ static void render_image_copy(uint8_t *dst,int dststride,const uint8_t *src,int
  */
  
 static int render_texture_upload(struct render *render,struct render_texture *texture,int w,int h,const void *src) {
-  glBindTexture(GL_TEXTURE_2D,texture->gltexid);
-  glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,w,h,0,GL_RGBA,GL_UNSIGNED_BYTE,src);
+  if (texture->gltexid!=render->current_srctexid) {
+    RENDER_GL(render,glBindTexture(GL_TEXTURE_2D,texture->gltexid))
+    render->current_srctexid=texture->gltexid;
+  }
+  RENDER_GL(render,glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,w,h,0,GL_RGBA,GL_UNSIGNED_BYTE,src))
   texture->w=w;
   texture->h=h;
   return 0;
@@ -162,6 +172,7 @@ static int render_texture_upload(struct render *render,struct render_texture *te
 
 int render_texture_load_raw(struct render *render,int texid,int w,int h,int stride,const void *src,int srcc) {
   if (!srcc) src=0;
+  render_flush(render);
   if ((w<1)||(w>RENDER_FB_LIMIT)) return -1;
   if ((h<1)||(h>RENDER_FB_LIMIT)) return -1;
   int p=render_texturev_search(render,texid);
@@ -257,10 +268,14 @@ int render_texture_get_pixels(void *dst,int dsta,struct render *render,int texid
   int dstc=stride*texture->h;
   if (dstc>dsta) return -1;
 
+  render_flush(render);
   if (render_texture_require_fb(render,texture)<0) return -1;
-  glFlush();
-  glBindFramebuffer(GL_FRAMEBUFFER,texture->fbid);
-  glReadPixels(texture->border,texture->border,texture->w,texture->h,GL_RGBA,GL_UNSIGNED_BYTE,dst);
+  RENDER_GL(render,glFlush())
+  if (texture->gltexid!=render->current_dsttexid) {
+    // Bind it as the output, for reading. Viewport too, so it's consistent for the next render.
+    render_to_texture(render,texture);
+  }
+  RENDER_GL(render,glReadPixels(texture->border,texture->border,texture->w,texture->h,GL_RGBA,GL_UNSIGNED_BYTE,dst))
 
   return dstc;
 }
@@ -270,14 +285,14 @@ int render_texture_get_pixels(void *dst,int dsta,struct render *render,int texid
  */
 
 void render_texture_clear(struct render *render,int texid) {
+  render_flush(render);
   int p=render_texturev_search(render,texid);
   if (p<0) return;
   struct render_texture *texture=render->texturev+p;
   if (render_texture_require_fb(render,texture)<0) return;
-  glBindFramebuffer(GL_FRAMEBUFFER,texture->fbid);
-  glViewport(0,0,texture->w+texture->border*2,texture->h+texture->border*2);
-  glClearColor(0.0f,0.0f,0.0f,0.0f);
-  glClear(GL_COLOR_BUFFER_BIT);
+  if (texture->gltexid!=render->current_dsttexid) render_to_texture(render,texture);
+  RENDER_GL(render,glClearColor(0.0f,0.0f,0.0f,0.0f))
+  RENDER_GL(render,glClear(GL_COLOR_BUFFER_BIT))
 }
 
 /* Set current target.
@@ -285,11 +300,13 @@ void render_texture_clear(struct render *render,int texid) {
  
 int render_to_texture(struct render *render,struct render_texture *texture) {
   if (texture) {
-    glBindFramebuffer(GL_FRAMEBUFFER,texture->fbid);
-    glViewport(0,0,texture->w+texture->border*2,texture->h+texture->border*2);
+    RENDER_GL(render,glBindFramebuffer(GL_FRAMEBUFFER,texture->fbid))
+    RENDER_GL(render,glViewport(0,0,texture->w+texture->border*2,texture->h+texture->border*2))
+    render->current_dsttexid=texture->gltexid;
   } else {
-    glBindFramebuffer(GL_FRAMEBUFFER,0);
-    glViewport(0,0,render->winw,render->winh);
+    RENDER_GL(render,glBindFramebuffer(GL_FRAMEBUFFER,0))
+    RENDER_GL(render,glViewport(0,0,render->winw,render->winh))
+    render->current_dsttexid=-1; // Viewport differs from render_draw's, so let the next draw rebind.
   }
   return 0;
 }
@@ -0,0 +1,224 @@
+#include "softrender_internal.h"
+
+/* Delete.
+ */
+ 
+void render_del(struct render *render) {
+  if (!render) return;
+  if (render->texturev) {
+    render_texturev_remove(render,0,render->texturec);
+    free(render->texturev);
+  }
+  if (render->output) free(render->output);
+  free(render);
+}
+
+/* New.
+ */
+ 
+struct render *render_new() {
+  struct render *render=calloc(1,sizeof(struct render));
+  if (!render) return 0;
+  
+  // Don't let either dimensions be zero.
+  render->fbw=1;
+  render->fbh=1;
+  render->winw=1;
+  render->winh=1;
+  render->dstdirty=1;
+  
+  // Output always exists, so render_get_output() is how the host tells us apart from the GL renderer.
+  if (!(render->output=calloc(1,4))) {
+    render_del(render);
+    return 0;
+  }
+  render->outputa=4;
+  
+  // Reserve texid 1 for the framebuffer.
+  render->texid_next=2;
+  if (!render_texturev_insert(render,0,1)) {
+    render_del(render);
+    return 0;
+  }
+  
+  return render;
+}
+
+/* Trivial accessors.
+ */
+
+void render_set_scale(struct render *render,double scale) {
+  // Only meaningful to OpenGL.
+}
+
+void render_get_stats(struct render_stats *stats,const struct render *render) {
+  if (!render) {
+    memset(stats,0,sizeof(struct render_stats));
+    return;
+  }
+  *stats=render->stats;
+}
+
+const void *render_get_output(int *w,int *h,int *stride,struct render *render) {
+  if (!render||!render->output) return 0;
+  if (w) *w=render->winw;
+  if (h) *h=render->winh;
+  if (stride) *stride=render->winw<<2;
+  return render->output;
+}
+
+/* Begin frame.
+ */
+
+void render_begin(struct render *render) {
+}
+
+/* Scale the framebuffer into the output with nearest-neighbor, same as the GL renderer.
+ * Integer scales, the usual case, expand each source row once and copy it down.
+ */
+ 
+static void render_output_scale(uint32_t *dst,int dststride,int dstw,int dsth,const uint32_t *src,int srcw,int srch) {
+  if (!(dstw%srcw)&&!(dsth%srch)&&(dstw/srcw==dsth/srch)) {
+    int scale=dstw/srcw;
+    int yi=srch;
+    for (;yi-->0;src+=srcw) {
+      uint32_t *dstrow=dst;
+      const uint32_t *srcp=src;
+      int xi=srcw;
+      if (scale==1) {
+        memcpy(dstrow,srcp,srcw<<2);
+      } else for (;xi-->0;srcp++) {
+        int i=scale;
+        for (;i-->0;dstrow++) *dstrow=*srcp;
+      }
+      int i=scale;
+      for (dst+=dststride;--i>0;dst+=dststride) memcpy(dst,dst-dststride,dstw<<2);
+    }
+    return;
+  }
+  int yi=0;
+  for (;yi<dsth;yi++,dst+=dststride) {
+    const uint32_t *srcrow=src+(((yi*2+1)*srch)/(dsth*2))*srcw;
+    int xi=0;
+    for (;xi<dstw;xi++) dst[xi]=srcrow[((xi*2+1)*srcw)/(dstw*2)];
+  }
+}
+
+/* End frame, and draw the main.
+ */
+ 
+void render_commit(struct render *render) {
+  render_require_projection(render);
+  int outputc=render->winw*render->winh*4;
+  if (outputc>render->outputa) {
+    void *nv=realloc(render->output,outputc);
+    if (!nv) return;
+    render->output=nv;
+    render->outputa=outputc;
+    memset(render->output,0,outputc);
+  }
+  
+  /* If the framebuffer doesn't fill the output, black out.
+   */
+  if ((render->dstx>0)||(render->dsty>0)) {
+    uint32_t *p=(uint32_t*)render->output;
+    const uint8_t black[4]={0,0,0,0xff};
+    uint32_t pixel;
+    memcpy(&pixel,black,4);
+    int i=render->winw*render->winh;
+    for (;i-->0;p++) *p=pixel;
+  }
+  
+  /* Copy in the framebuffer, cropping if it overflows.
+   */
+  const struct render_texture *fb=render->texturev;
+  if ((render->texturec>=1)&&(fb->texid==1)&&fb->v&&(render->dstw>0)&&(render->dsth>0)) {
+    if ((render->dstx>=0)&&(render->dsty>=0)&&(render->dstx+render->dstw<=render->winw)&&(render->dsty+render->dsth<=render->winh)) {
+      render_output_scale(
+        (uint32_t*)render->output+render->dsty*render->winw+render->dstx,render->winw,render->dstw,render->dsth,
+        (uint32_t*)fb->v,fb->w,fb->h
+      );
+    } else {
+      uint32_t *dst=(uint32_t*)render->output;
+      const uint32_t *src=(uint32_t*)fb->v;
+      int yi=0;
+      for (;yi<render->winh;yi++,dst+=render->winw) {
+        int sy=(((yi-render->dsty)*2+1)*fb->h)/(render->dsth*2);
+        if ((yi<render->dsty)||(sy>=fb->h)) continue;
+        const uint32_t *srcrow=src+sy*fb->w;
+        int xi=0;
+        for (;xi<render->winw;xi++) {
+          int sx=(((xi-render->dstx)*2+1)*fb->w)/(render->dstw*2);
+          if ((xi<render->dstx)||(sx>=fb->w)) continue;
+          dst[xi]=srcrow[sx];
+        }
+      }
+    }
+  }
+  
+  struct render_stats *stats=&render->stats;
+  if (stats->framec<INT_MAX) stats->framec++;
+  stats->drawc+=render->frame_drawc;
+  stats->vtxc+=render->frame_vtxc;
+  if (render->frame_drawc>stats->drawc_max) stats->drawc_max=render->frame_drawc;
+  if (render->frame_vtxc>stats->vtxc_max) stats->vtxc_max=render->frame_vtxc;
+  stats->drawc_last=render->frame_drawc;
+  stats->vtxc_last=render->frame_vtxc;
+  render->frame_drawc=0;
+  render->frame_vtxc=0;
+}
+
+/* Final projection.
+ */
+ 
+int render_set_framebuffer_size(struct render *render,int fbw,int fbh) {
+  return render_texture_load_raw(render,1,fbw,fbh,0,0,0);
+}
+
+void render_set_size(struct render *render,int winw,int winh) {
+  if ((winw==render->winw)&&(winh==render->winh)) return;
+  if ((winw<1)||(winw>RENDER_WIN_LIMIT)) return;
+  if ((winh<1)||(winh>RENDER_WIN_LIMIT)) return;
+  render->winw=winw;
+  render->winh=winh;
+  render->dstdirty=1;
+}
+
+void render_require_projection(struct render *render) {
+  if (!render->dstdirty) return;
+  render->dstdirty=0;
+  
+  int xscale=render->winw/render->fbw;
+  int yscale=render->winh/render->fbh;
+  int scale=(xscale<yscale)?xscale:yscale;
+  
+  // Same rules as the GL renderer: Integer scale up to 4x, and fit to one axis beyond that or below 1x.
+  if ((scale<1)||(scale>=4)) {
+    int wforh=(render->fbw*render->winh)/render->fbh;
+    if (wforh<=render->winw) {
+      render->dstw=wforh;
+      render->dsth=render->winh;
+    } else {
+      render->dstw=render->winw;
+      render->dsth=(render->fbh*render->winw)/render->fbw;
+    }
+  } else {
+    render->dstw=render->fbw*scale;
+    render->dsth=render->fbh*scale;
+  }
+  
+  render->dstx=(render->winw>>1)-(render->dstw>>1);
+  render->dsty=(render->winh>>1)-(render->dsth>>1);
+}
+
+void render_coords_win_from_fb(struct render *render,int *x,int *y) {
+  render_require_projection(render);
+  *x=((*x)*render->dstw)/render->fbw+render->dstx;
+  *y=((*y)*render->dsth)/render->fbh+render->dsty;
+}
+
+void render_coords_fb_from_win(struct render *render,int *x,int *y) {
+  render_require_projection(render);
+  *x=(((*x)-render->dstx)*render->fbw)/render->dstw;
+  *y=(((*y)-render->dsty)*render->fbh)/render->dsth;
+}
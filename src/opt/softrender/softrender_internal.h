@@ -0,0 +1,50 @@
+/* softrender_internal.h
+ * Software implementation of render.h, for hosts without a GPU.
+ * Enable exactly one of "render" and "softrender". Video drivers get our output via render_get_output().
+ * Everything is straight RGBA, row 0 first, same as the texture API. No borders.
+ */
+
+#ifndef SOFTRENDER_INTERNAL_H
+#define SOFTRENDER_INTERNAL_H
+
+#include "opt/render/render.h"
+#include "egg/egg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+
+#define RENDER_FB_LIMIT 4096
+#define RENDER_WIN_LIMIT 4096
+
+struct render_texture {
+  int texid; // As exposed to clients.
+  int w,h; // Stride is always (w*4).
+  uint8_t *v; // Null until loaded.
+};
+
+struct render {
+  int fbw,fbh,winw,winh;
+  int dstdirty;
+  int dstx,dsty,dstw,dsth; // Framebuffer position in window space.
+  
+  struct render_texture *texturev;
+  int texturec,texturea;
+  int texid_next;
+  
+  uint8_t *output; // (winw*winh*4), refreshed at each render_commit().
+  int outputa;
+  
+  int frame_drawc,frame_vtxc;
+  struct render_stats stats;
+};
+
+// Populates (dstx,dsty,dstw,dsth) if needed.
+void render_require_projection(struct render *render);
+
+int render_texturev_search(const struct render *render,int texid);
+struct render_texture *render_texturev_insert(struct render *render,int p,int texid);
+void render_texturev_remove(struct render *render,int p,int c);
+struct render_texture *render_texture_get(const struct render *render,int texid);
+
+#endif
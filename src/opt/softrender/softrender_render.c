@@ -0,0 +1,525 @@
+#include "softrender_internal.h"
+#include <math.h>
+
+/* Everything one call needs to plot a pixel.
+ */
+
+struct softrender_call {
+  struct render_texture *dst,*src;
+  int tr,tg,tb,ta; // Uniform tint.
+  int alpha;
+  int filter;
+};
+
+/* Blend one pixel, as glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA).
+ * That applies to the alpha channel too, so output alpha is not simply additive.
+ */
+
+static inline void softrender_blend(uint8_t *d,int r,int g,int b,int a) {
+  if (a<=0) return;
+  if (a>=0xff) {
+    d[0]=r;
+    d[1]=g;
+    d[2]=b;
+    d[3]=0xff;
+    return;
+  }
+  int ia=0xff-a;
+  d[0]=(r*a+d[0]*ia+0x7f)/0xff;
+  d[1]=(g*a+d[1]*ia+0x7f)/0xff;
+  d[2]=(b*a+d[2]*ia+0x7f)/0xff;
+  d[3]=(a*a+d[3]*ia+0x7f)/0xff;
+}
+
+/* Apply uniform tint and alpha, then blend.
+ */
+
+static inline void softrender_plot(uint8_t *d,const struct softrender_call *call,int r,int g,int b,int a) {
+  if (call->ta) {
+    r+=((call->tr-r)*call->ta)/0xff;
+    g+=((call->tg-g)*call->ta)/0xff;
+    b+=((call->tb-b)*call->ta)/0xff;
+  }
+  if (call->alpha<0xff) a=(a*call->alpha+0x7f)/0xff;
+  softrender_blend(d,r,g,b,a);
+}
+
+/* Read one pixel from a texture, at (x,y) in texels, clamping to the edge.
+ */
+
+static inline const uint8_t *softrender_texel(const struct render_texture *src,int x,int y) {
+  if (x<0) x=0; else if (x>=src->w) x=src->w-1;
+  if (y<0) y=0; else if (y>=src->h) y=src->h-1;
+  return src->v+((y*src->w+x)<<2);
+}
+
+static void softrender_sample(uint8_t *dst,const struct render_texture *src,float x,float y,int filter) {
+  if (!filter) {
+    memcpy(dst,softrender_texel(src,(int)floorf(x),(int)floorf(y)),4);
+    return;
+  }
+  x-=0.5f;
+  y-=0.5f;
+  float x0=floorf(x),y0=floorf(y);
+  float fx=x-x0,fy=y-y0;
+  int ix=(int)x0,iy=(int)y0;
+  const uint8_t *a=softrender_texel(src,ix,iy);
+  const uint8_t *b=softrender_texel(src,ix+1,iy);
+  const uint8_t *c=softrender_texel(src,ix,iy+1);
+  const uint8_t *d=softrender_texel(src,ix+1,iy+1);
+  int i=0; for (;i<4;i++) {
+    float top=a[i]+(b[i]-a[i])*fx;
+    float bottom=c[i]+(d[i]-c[i])*fx;
+    dst[i]=(uint8_t)(top+(bottom-top)*fy+0.5f);
+  }
+}
+
+/* Fill a horizontal span with one color.
+ * This is most of what rectangles and backgrounds cost, so keep it tight enough to vectorize.
+ */
+
+static void softrender_span_fill(uint8_t *d,int c,const struct softrender_call *call,int r,int g,int b,int a) {
+  if (call->ta) {
+    r+=((call->tr-r)*call->ta)/0xff;
+    g+=((call->tg-g)*call->ta)/0xff;
+    b+=((call->tb-b)*call->ta)/0xff;
+  }
+  if (call->alpha<0xff) a=(a*call->alpha+0x7f)/0xff;
+  if (a<=0) return;
+  if (a>=0xff) {
+    uint8_t pixel[4]={r,g,b,0xff};
+    uint32_t word;
+    memcpy(&word,pixel,4);
+    uint32_t *p=(uint32_t*)d;
+    for (;c-->0;p++) *p=word;
+    return;
+  }
+  int ia=0xff-a;
+  int ra=r*a+0x7f,ga=g*a+0x7f,ba=b*a+0x7f,aa=a*a+0x7f;
+  for (;c-->0;d+=4) {
+    d[0]=(ra+d[0]*ia)/0xff;
+    d[1]=(ga+d[1]*ia)/0xff;
+    d[2]=(ba+d[2]*ia)/0xff;
+    d[3]=(aa+d[3]*ia)/0xff;
+  }
+}
+
+/* Triangles, for RAW and TEX.
+ * Attributes are (r,g,b,a) without a source texture, or (tx,ty) with.
+ */
+
+struct softrender_vertex {
+  float x,y;
+  float v[4];
+};
+
+static void softrender_vertex_from_raw(struct softrender_vertex *dst,const struct egg_render_raw *src) {
+  dst->x=src->x;
+  dst->y=src->y;
+  dst->v[0]=src->r;
+  dst->v[1]=src->g;
+  dst->v[2]=src->b;
+  dst->v[3]=src->a;
+}
+
+static void softrender_vertex_from_tex(struct softrender_vertex *dst,const struct egg_render_raw *src) {
+  dst->x=src->x;
+  dst->y=src->y;
+  dst->v[0]=src->tx;
+  dst->v[1]=src->ty;
+  dst->v[2]=0.0f;
+  dst->v[3]=0.0f;
+}
+
+/* Plot one fragment of a RAW or TEX primitive, with its interpolated attributes.
+ */
+
+static inline void softrender_fragment(uint8_t *d,const struct softrender_call *call,const float *v) {
+  if (call->src) {
+    uint8_t texel[4];
+    softrender_sample(texel,call->src,v[0],v[1],call->filter);
+    softrender_plot(d,call,texel[0],texel[1],texel[2],texel[3]);
+  } else {
+    softrender_plot(d,call,(int)(v[0]+0.5f),(int)(v[1]+0.5f),(int)(v[2]+0.5f),(int)(v[3]+0.5f));
+  }
+}
+
+/* Triangle, sampling at pixel centers.
+ * Pixels exactly on an edge belong to the triangle on its left or top, so adjacent triangles don't double-blend.
+ */
+
+static void softrender_triangle(
+  const struct softrender_call *call,
+  const struct softrender_vertex *a,
+  const struct softrender_vertex *b,
+  const struct softrender_vertex *c
+) {
+  double area=((double)b->x-a->x)*((double)c->y-a->y)-((double)b->y-a->y)*((double)c->x-a->x);
+  if (area==0.0) return;
+  if (area<0.0) {
+    const struct softrender_vertex *tmp=b;
+    b=c;
+    c=tmp;
+    area=-area;
+  }
+
+  // Edge functions A*x+B*y+C, positive inside.
+  double ea[3],eb[3],ec[3];
+  const struct softrender_vertex *pv[3]={a,b,c};
+  int i=0; for (;i<3;i++) {
+    const struct softrender_vertex *p=pv[i],*q=pv[(i+1)%3];
+    ea[i]=(double)p->y-q->y;
+    eb[i]=(double)q->x-p->x;
+    ec[i]=-(ea[i]*p->x+eb[i]*p->y);
+  }
+
+  // Attribute planes.
+  float dvdx[4],dvdy[4];
+  int flat=1;
+  for (i=0;i<4;i++) {
+    double vb=b->v[i]-a->v[i],vc=c->v[i]-a->v[i];
+    dvdx[i]=(float)((vb*((double)c->y-a->y)-vc*((double)b->y-a->y))/area);
+    dvdy[i]=(float)((vc*((double)b->x-a->x)-vb*((double)c->x-a->x))/area);
+    if ((dvdx[i]!=0.0f)||(dvdy[i]!=0.0f)) flat=0;
+  }
+  if (call->src) flat=0;
+
+  float miny=a->y,maxy=a->y;
+  if (b->y<miny) miny=b->y; else if (b->y>maxy) maxy=b->y;
+  if (c->y<miny) miny=c->y; else if (c->y>maxy) maxy=c->y;
+  int ya=(int)ceilf(miny-0.5f),yz=(int)ceilf(maxy-0.5f)-1;
+  if (ya<0) ya=0;
+  if (yz>=call->dst->h) yz=call->dst->h-1;
+  const int stride=call->dst->w<<2;
+  uint8_t *row=call->dst->v+ya*stride;
+  int y=ya;
+  for (;y<=yz;y++,row+=stride) {
+    double yc=y+0.5;
+    int xa=0,xz=call->dst->w-1;
+    for (i=0;i<3;i++) {
+      double r=eb[i]*yc+ec[i];
+      int incl=(ea[i]>0.0)||((ea[i]==0.0)&&(eb[i]>0.0));
+      if (ea[i]==0.0) {
+        if ((r<0.0)||((r==0.0)&&!incl)) { xz=-1; break; }
+        continue;
+      }
+      double t=-r/ea[i]-0.5;
+      if (ea[i]>0.0) {
+        int lo=(int)ceil(t);
+        if (lo>xa) xa=lo;
+      } else {
+        int hi=(int)ceil(t)-1;
+        if (hi<xz) xz=hi;
+      }
+    }
+    if (xa>xz) continue;
+    if (flat) {
+      softrender_span_fill(row+(xa<<2),xz-xa+1,call,(int)(a->v[0]+0.5f),(int)(a->v[1]+0.5f),(int)(a->v[2]+0.5f),(int)(a->v[3]+0.5f));
+      continue;
+    }
+    float v[4];
+    float fx=xa+0.5f-a->x,fy=(float)yc-a->y;
+    for (i=0;i<4;i++) v[i]=a->v[i]+dvdx[i]*fx+dvdy[i]*fy;
+    uint8_t *d=row+(xa<<2);
+    int x=xa;
+    for (;x<=xz;x++,d+=4) {
+      softrender_fragment(d,call,v);
+      for (i=0;i<4;i++) v[i]+=dvdx[i];
+    }
+  }
+}
+
+/* Points and lines, one pixel wide.
+ */
+
+static void softrender_point(const struct softrender_call *call,const struct softrender_vertex *a) {
+  int x=(int)floorf(a->x),y=(int)floorf(a->y);
+  if ((x<0)||(y<0)||(x>=call->dst->w)||(y>=call->dst->h)) return;
+  softrender_fragment(call->dst->v+((y*call->dst->w+x)<<2),call,a->v);
+}
+
+// Like GL, we don't draw the last pixel, so strips don't hit their joints twice.
+static void softrender_line(const struct softrender_call *call,const struct softrender_vertex *a,const struct softrender_vertex *b) {
+  float dx=b->x-a->x,dy=b->y-a->y;
+  float adx=(dx<0.0f)?-dx:dx,ady=(dy<0.0f)?-dy:dy;
+  int n=(int)((adx>ady)?adx:ady);
+  if (n<1) return;
+  float v[4],dv[4];
+  int i=0; for (;i<4;i++) {
+    v[i]=a->v[i];
+    dv[i]=(b->v[i]-a->v[i])/n;
+  }
+  float x=a->x,y=a->y,stepx=dx/n,stepy=dy/n;
+  // Sample the pixel each step lands in, nudged half a pixel along the minor axis so axis-aligned lines are stable.
+  if (adx>ady) y+=0.5f; else x+=0.5f;
+  for (;n-->0;x+=stepx,y+=stepy) {
+    int px=(int)floorf(x),py=(int)floorf(y);
+    if ((px>=0)&&(py>=0)&&(px<call->dst->w)&&(py<call->dst->h)) {
+      softrender_fragment(call->dst->v+((py*call->dst->w+px)<<2),call,v);
+    }
+    for (i=0;i<4;i++) v[i]+=dv[i];
+  }
+}
+
+/* RAW and TEX primitives.
+ */
+
+static void softrender_raw(const struct softrender_call *call,int mode,const struct egg_render_raw *src,int vtxc) {
+  void (*cvt)(struct softrender_vertex *dst,const struct egg_render_raw *src)=call->src?softrender_vertex_from_tex:softrender_vertex_from_raw;
+  struct softrender_vertex vv[3];
+  int i;
+  switch (mode) {
+    case EGG_RENDER_POINTS: {
+        for (i=0;i<vtxc;i++) {
+          cvt(vv,src+i);
+          softrender_point(call,vv);
+        }
+      } break;
+    case EGG_RENDER_LINES: {
+        for (i=0;i<vtxc-1;i+=2) {
+          cvt(vv,src+i);
+          cvt(vv+1,src+i+1);
+          softrender_line(call,vv,vv+1);
+        }
+      } break;
+    case EGG_RENDER_LINE_STRIP: {
+        if (vtxc<2) return;
+        cvt(vv,src);
+        for (i=1;i<vtxc;i++) {
+          cvt(vv+(i&1),src+i);
+          softrender_line(call,vv+((i-1)&1),vv+(i&1));
+        }
+      } break;
+    case EGG_RENDER_TRIANGLES: {
+        for (i=0;i<vtxc-2;i+=3) {
+          cvt(vv,src+i);
+          cvt(vv+1,src+i+1);
+          cvt(vv+2,src+i+2);
+          softrender_triangle(call,vv,vv+1,vv+2);
+        }
+      } break;
+    case EGG_RENDER_TRIANGLE_STRIP: {
+        if (vtxc<3) return;
+        cvt(vv,src);
+        cvt(vv+1,src+1);
+        for (i=2;i<vtxc;i++) {
+          cvt(vv+(i%3),src+i);
+          softrender_triangle(call,vv,vv+1,vv+2);
+        }
+      } break;
+  }
+}
+
+/* Sprite transform, as the TILE and FANCY shaders do it.
+ * (m) is column-major 2x2, mapping point-sprite coordinates (-0.5..0.5) to tile coordinates.
+ */
+
+static void softrender_xform_matrix(float *m,int xform) {
+  float a=m[0],b=m[1],c=m[2],d=m[3];
+  switch (xform) {
+    case 0: break;
+    case EGG_XFORM_XREV: m[0]=-a; m[1]=-b; break;
+    case EGG_XFORM_YREV: m[2]=-c; m[3]=-d; break;
+    case EGG_XFORM_XREV|EGG_XFORM_YREV: m[0]=-a; m[1]=-b; m[2]=-c; m[3]=-d; break;
+    case EGG_XFORM_SWAP: m[0]=b; m[1]=a; m[2]=d; m[3]=c; break;
+    case EGG_XFORM_SWAP|EGG_XFORM_XREV: m[0]=-b; m[1]=a; m[2]=-d; m[3]=c; break;
+    case EGG_XFORM_SWAP|EGG_XFORM_YREV: m[0]=b; m[1]=-a; m[2]=d; m[3]=-c; break;
+    case EGG_XFORM_SWAP|EGG_XFORM_XREV|EGG_XFORM_YREV: m[0]=b; m[1]=-a; m[2]=-d; m[3]=c; break;
+  }
+}
+
+/* Generic point sprite: Any size, any matrix, optional FANCY coloring.
+ */
+
+struct softrender_fancy_color {
+  int tr,tg,tb,ta; // Per-vertex tint.
+  int pr,pg,pb,pa; // Primary color replacement, and alpha.
+};
+
+static void softrender_sprite(
+  const struct softrender_call *call,
+  float x,float y,float size,const float *m,int tileid,
+  const struct softrender_fancy_color *fancy
+) {
+  if (size<=0.0f) return;
+  float half=size*0.5f;
+  int xa=(int)ceilf(x-half-0.5f),xz=(int)ceilf(x+half-0.5f)-1;
+  int ya=(int)ceilf(y-half-0.5f),yz=(int)ceilf(y+half-0.5f)-1;
+  if (xa<0) xa=0;
+  if (ya<0) ya=0;
+  if (xz>=call->dst->w) xz=call->dst->w-1;
+  if (yz>=call->dst->h) yz=call->dst->h-1;
+  if ((xa>xz)||(ya>yz)) return;
+  const struct render_texture *src=call->src;
+  float tilew=src->w/16.0f,tileh=src->h/16.0f;
+  float tilex=(tileid&15)*tilew,tiley=(tileid>>4)*tileh;
+  float usize=1.0f/size;
+  const int stride=call->dst->w<<2;
+  uint8_t *row=call->dst->v+ya*stride+(xa<<2);
+  int py=ya;
+  for (;py<=yz;py++,row+=stride) {
+    float v=(py+0.5f-y)*usize;
+    uint8_t *d=row;
+    int px=xa;
+    for (;px<=xz;px++,d+=4) {
+      float u=(px+0.5f-x)*usize;
+      float tx=m[0]*u+m[2]*v+0.5f;
+      float ty=m[1]*u+m[3]*v+0.5f;
+      if (fancy&&((tx<0.0f)||(ty<0.0f)||(tx>=1.0f)||(ty>=1.0f))) continue;
+      uint8_t texel[4];
+      softrender_sample(texel,src,tilex+tx*tilew,tiley+ty*tileh,call->filter);
+      int r=texel[0],g=texel[1],b=texel[2],a=texel[3];
+      if (fancy) {
+        if ((r==g)&&(g==b)) {
+          if (r<0x80) {
+            r=(fancy->pr*r*2+0x7f)/0xff;
+            g=(fancy->pg*g*2+0x7f)/0xff;
+            b=(fancy->pb*b*2+0x7f)/0xff;
+          } else {
+            int w=r*2-0xff;
+            r=fancy->pr+((0xff-fancy->pr)*w)/0xff;
+            g=fancy->pg+((0xff-fancy->pg)*w)/0xff;
+            b=fancy->pb+((0xff-fancy->pb)*w)/0xff;
+          }
+        }
+        if (fancy->ta) {
+          r+=((fancy->tr-r)*fancy->ta)/0xff;
+          g+=((fancy->tg-g)*fancy->ta)/0xff;
+          b+=((fancy->tb-b)*fancy->ta)/0xff;
+        }
+        a=(a*fancy->pa+0x7f)/0xff;
+      }
+      softrender_plot(d,call,r,g,b,a);
+    }
+  }
+}
+
+/* TILE.
+ * Square tiles at integer positions are the common case, and we do them as a straight blit,
+ * walking the source in whichever direction the transform says.
+ */
+
+static void softrender_tiles(const struct softrender_call *call,const struct egg_render_tile *vtx,int vtxc) {
+  const struct render_texture *src=call->src;
+  int ts=src->w>>4;
+  if ((src->w!=src->h)||(src->w&15)||call->filter) {
+    float size=src->w/16.0f;
+    for (;vtxc-->0;vtx++) {
+      float m[4]={1.0f,0.0f,0.0f,1.0f};
+      softrender_xform_matrix(m,(vtx->xform<8)?vtx->xform:0);
+      softrender_sprite(call,vtx->x,vtx->y,size,m,vtx->tileid,0);
+    }
+    return;
+  }
+  /* Source position for destination (dx,dy) in the tile is (ax*dx+bx*dy+cx*(ts-1),ay*dx+by*dy+cy*(ts-1)).
+   */
+  static const struct softrender_tile_xform { int ax,bx,cx,ay,by,cy; } xformv[8]={
+    { 1, 0,0, 0, 1,0},
+    {-1, 0,1, 0, 1,0}, // XREV
+    { 1, 0,0, 0,-1,1}, // YREV
+    {-1, 0,1, 0,-1,1}, // XREV|YREV
+    { 0, 1,0, 1, 0,0}, // SWAP
+    { 0,-1,1, 1, 0,0}, // SWAP|XREV
+    { 0, 1,0,-1, 0,1}, // SWAP|YREV
+    { 0,-1,1,-1, 0,1}, // SWAP|XREV|YREV
+  };
+  const int dststride=call->dst->w<<2,srcstride=src->w<<2;
+  const int plain=!call->ta&&(call->alpha>=0xff);
+  for (;vtxc-->0;vtx++) {
+    int x0=vtx->x-((ts+1)>>1),y0=vtx->y-((ts+1)>>1);
+    int dxa=0,dya=0,dxz=ts,dyz=ts;
+    if (x0<0) dxa=-x0;
+    if (y0<0) dya=-y0;
+    if (x0+dxz>call->dst->w) dxz=call->dst->w-x0;
+    if (y0+dyz>call->dst->h) dyz=call->dst->h-y0;
+    if ((dxa>=dxz)||(dya>=dyz)) continue;
+    const struct softrender_tile_xform *xf=xformv+((vtx->xform<8)?vtx->xform:0);
+    const uint8_t *tile=src->v+(vtx->tileid>>4)*ts*srcstride+(vtx->tileid&15)*ts*4;
+    int sxstep=xf->ax*4+xf->ay*srcstride;
+    uint8_t *dstrow=call->dst->v+(y0+dya)*dststride+((x0+dxa)<<2);
+    int dy=dya;
+    for (;dy<dyz;dy++,dstrow+=dststride) {
+      int sx=xf->ax*dxa+xf->bx*dy+xf->cx*(ts-1);
+      int sy=xf->ay*dxa+xf->by*dy+xf->cy*(ts-1);
+      const uint8_t *s=tile+sy*srcstride+(sx<<2);
+      uint8_t *d=dstrow;
+      int dx=dxa;
+      if (plain) {
+        for (;dx<dxz;dx++,d+=4,s+=sxstep) {
+          if (s[3]>=0xff) memcpy(d,s,4);
+          else softrender_blend(d,s[0],s[1],s[2],s[3]);
+        }
+      } else {
+        for (;dx<dxz;dx++,d+=4,s+=sxstep) softrender_plot(d,call,s[0],s[1],s[2],s[3]);
+      }
+    }
+  }
+}
+
+/* FANCY.
+ */
+
+static void softrender_fancies(const struct softrender_call *call,const struct egg_render_fancy *vtx,int vtxc) {
+  for (;vtxc-->0;vtx++) {
+    float m[4]={1.0f,0.0f,0.0f,1.0f};
+    float size=vtx->size;
+    if (vtx->rotation) {
+      float t=(vtx->rotation/255.0f)*-3.14159f*2.0f;
+      switch (vtx->xform) {
+        case 1: case 2: case 5: case 6: case 7: t=-t; break; // These transforms reverse the rotation.
+      }
+      float cost=cosf(t)*sqrtf(2.0f),sint=sinf(t)*sqrtf(2.0f);
+      m[0]=cost; m[1]=sint; m[2]=-sint; m[3]=cost;
+      size*=sqrtf(2.0f);
+    }
+    softrender_xform_matrix(m,vtx->xform);
+    struct softrender_fancy_color fancy={
+      .tr=vtx->tr,.tg=vtx->tg,.tb=vtx->tb,.ta=vtx->ta,
+      .pr=vtx->pr,.pg=vtx->pg,.pb=vtx->pb,.pa=vtx->a,
+    };
+    softrender_sprite(call,vtx->x,vtx->y,size,m,vtx->tileid,&fancy);
+  }
+}
+
+/* Render, main entry point.
+ */
+
+void render_render(struct render *render,const struct egg_render_uniform *uniform,const void *vtxv,int vtxc) {
+  if (!render||!uniform||!vtxv) return;
+  struct softrender_call call={
+    .tr=uniform->tint>>24,
+    .tg=(uniform->tint>>16)&0xff,
+    .tb=(uniform->tint>>8)&0xff,
+    .ta=uniform->tint&0xff,
+    .alpha=uniform->alpha,
+    .filter=uniform->filter,
+  };
+  if (!(call.dst=render_texture_get(render,uniform->dsttexid))||!call.dst->v) return;
+  if (uniform->srctexid) {
+    if (!(call.src=render_texture_get(render,uniform->srctexid))||!call.src->v) return;
+  }
+  int n;
+  switch (uniform->mode) {
+    case EGG_RENDER_POINTS:
+    case EGG_RENDER_LINES:
+    case EGG_RENDER_LINE_STRIP:
+    case EGG_RENDER_TRIANGLES:
+    case EGG_RENDER_TRIANGLE_STRIP: {
+        n=vtxc/sizeof(struct egg_render_raw);
+        softrender_raw(&call,uniform->mode,vtxv,n);
+      } break;
+    case EGG_RENDER_TILE: {
+        if (!call.src) return;
+        n=vtxc/sizeof(struct egg_render_tile);
+        softrender_tiles(&call,vtxv,n);
+      } break;
+    case EGG_RENDER_FANCY: {
+        if (!call.src) return;
+        n=vtxc/sizeof(struct egg_render_fancy);
+        softrender_fancies(&call,vtxv,n);
+      } break;
+    default: return;
+  }
+  render->frame_drawc++;
+  render->frame_vtxc+=n;
+}
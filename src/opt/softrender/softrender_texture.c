@@ -0,0 +1,141 @@
+#include "softrender_internal.h"
+
+/* Texture list.
+ */
+ 
+int render_texturev_search(const struct render *render,int texid) {
+  int lo=0,hi=render->texturec;
+  while (lo<hi) {
+    int ck=(lo+hi)>>1;
+    const struct render_texture *q=render->texturev+ck;
+         if (texid<q->texid) hi=ck;
+    else if (texid>q->texid) lo=ck+1;
+    else return ck;
+  }
+  return -lo-1;
+}
+
+struct render_texture *render_texture_get(const struct render *render,int texid) {
+  int p=render_texturev_search(render,texid);
+  if (p<0) return 0;
+  return render->texturev+p;
+}
+
+void render_texturev_remove(struct render *render,int p,int c) {
+  if ((p<0)||(c<1)||(p>render->texturec-c)) return;
+  struct render_texture *texture=render->texturev+p;
+  int i=c;
+  for (;i-->0;texture++) if (texture->v) free(texture->v);
+  render->texturec-=c;
+  memmove(render->texturev+p,render->texturev+p+c,sizeof(struct render_texture)*(render->texturec-p));
+}
+
+struct render_texture *render_texturev_insert(struct render *render,int p,int texid) {
+  if ((p<0)||(p>render->texturec)) return 0;
+  if (p&&(texid<=render->texturev[p-1].texid)) return 0;
+  if ((p<render->texturec)&&(texid>=render->texturev[p].texid)) return 0;
+  if (render->texturec>=render->texturea) {
+    int na=render->texturea+16;
+    if (na>INT_MAX/sizeof(struct render_texture)) return 0;
+    void *nv=realloc(render->texturev,sizeof(struct render_texture)*na);
+    if (!nv) return 0;
+    render->texturev=nv;
+    render->texturea=na;
+  }
+  struct render_texture *texture=render->texturev+p;
+  memmove(texture+1,texture,sizeof(struct render_texture)*(render->texturec-p));
+  render->texturec++;
+  memset(texture,0,sizeof(struct render_texture));
+  texture->texid=texid;
+  return texture;
+}
+
+/* Texture objects.
+ */
+
+void render_texture_del(struct render *render,int texid) {
+  if (texid<=1) return; // Not allowed to delete texture 1, and <=0 are illegal.
+  int p=render_texturev_search(render,texid);
+  if (p<0) return;
+  render_texturev_remove(render,p,1);
+}
+
+int render_texture_new(struct render *render) {
+  if (!render||(render->texid_next<=1)||(render->texid_next>=INT_MAX)) return -1;
+  int texid=render->texid_next++;
+  struct render_texture *texture=render_texturev_insert(render,render->texturec,texid);
+  if (!texture) return -1;
+  return texid;
+}
+
+void render_texture_get_size(int *w,int *h,struct render *render,int texid) {
+  const struct render_texture *texture=render_texture_get(render,texid);
+  if (!texture) return;
+  if (w) *w=texture->w;
+  if (h) *h=texture->h;
+}
+
+/* Load texture.
+ * Same rules as the GL renderer, see render_texture.c.
+ */
+
+int render_texture_load_raw(struct render *render,int texid,int w,int h,int stride,const void *src,int srcc) {
+  if (!srcc) src=0;
+  if ((w<1)||(w>RENDER_FB_LIMIT)) return -1;
+  if ((h<1)||(h>RENDER_FB_LIMIT)) return -1;
+  struct render_texture *texture=render_texture_get(render,texid);
+  if (!texture) return -1;
+  if (texid==1) {
+    if (!src&&(texture->w||texture->h)) return -1;
+    if (src&&((w!=texture->w)||(h!=texture->h))) return -1;
+  }
+  int minstride=w<<2;
+  if (src) {
+    if (stride<1) stride=minstride;
+    else if (stride<minstride) return -1;
+    if (srcc<stride*h) return -1;
+  }
+  if ((w!=texture->w)||(h!=texture->h)||!texture->v) {
+    void *nv=calloc(minstride,h);
+    if (!nv) return -1;
+    if (texture->v) free(texture->v);
+    texture->v=nv;
+    texture->w=w;
+    texture->h=h;
+  } else if (!src) {
+    memset(texture->v,0,minstride*h);
+  }
+  if (src) {
+    uint8_t *dst=texture->v;
+    const uint8_t *srcp=src;
+    int yi=h;
+    for (;yi-->0;dst+=minstride,srcp+=stride) memcpy(dst,srcp,minstride);
+  }
+  if (texid==1) {
+    render->fbw=w;
+    render->fbh=h;
+    render->dstdirty=1;
+  }
+  return 0;
+}
+
+/* Read pixels off texture.
+ */
+
+int render_texture_get_pixels(void *dst,int dsta,struct render *render,int texid) {
+  const struct render_texture *texture=render_texture_get(render,texid);
+  if (!texture) return -1;
+  int dstc=(texture->w<<2)*texture->h;
+  if (dstc>dsta) return -1;
+  if (texture->v) memcpy(dst,texture->v,dstc);
+  return dstc;
+}
+
+/* Clear texture.
+ */
+
+void render_texture_clear(struct render *render,int texid) {
+  struct render_texture *texture=render_texture_get(render,texid);
+  if (!texture||!texture->v) return;
+  memset(texture->v,0,(texture->w<<2)*texture->h);
+}
@@ -32,15 +32,169 @@ WASM_EXPORT("synth_init") int synth_init(int rate,int chanc,int buffer_frames);
  */
 WASM_EXPORT("synth_get_rom") void *synth_get_rom(int len);
 
-/* Trivial accessors. (rate,chanc,buffer_frames) were provided by you, so you shouldn't need these.
+/* Synthesize at a lower rate than the output, eg 22050 or 24000, and upsample after mixing.
+ * Our music has next to nothing above 10 kHz, so this roughly halves the CPU cost at 44.1 or 48 kHz, for a slight dulling of the top end.
+ * Call right after synth_init(), before synth_get_rom() or synth_set_threads().
+ * Zero, or anything at or above the output rate, to render directly at the output rate, which is the default.
+ * Returns the new internal rate, or <0 on errors.
+ */
+WASM_EXPORT("synth_set_internal_rate") int synth_set_internal_rate(int rate);
+
+/* Trivial accessors. (chanc,buffer_frames) were provided by you, so you shouldn't need these.
+ * synth_get_rate() is the internal rate, which is also the rate of printed sound PCM.
+ * synth_get_output_rate() is what you gave synth_init().
  * synth_get_buffer() returns our output, which we will reuse at each update.
  * (chan) (0,1) = (left or mono,right).
  */
 int synth_get_rate();
+int synth_get_output_rate();
 int synth_get_chanc();
 int synth_get_buffer_size_frames();
 WASM_EXPORT("synth_get_buffer") float *synth_get_buffer(int chan);
 
+/* Native only: Independent synthesizers.
+ * Everything else in this API operates on the calling thread's current context, which is initially the default one.
+ * synth_init() and synth_quit() are for the default context; contexts you create come up initialized and go down on delete.
+ * synth_context_use() makes a context current on the calling thread, null for the default, and returns the previous one.
+ * Two threads may run different contexts concurrently. One context must only be used by one thread at a time,
+ * except that synth_queue_*() may be called from a second thread if that thread also uses it.
+ * synth_context_update() is synth_update() on a given context, leaving the current one alone.
+ * In web builds, and native builds with our own allocator, there is only the default context, and synth_context_new() returns null.
+ */
+struct synth_context;
+struct synth_context *synth_context_new(int rate,int chanc,int buffer_frames);
+void synth_context_del(struct synth_context *context);
+struct synth_context *synth_context_use(struct synth_context *context);
+void synth_context_update(struct synth_context *context,int framec);
+float *synth_context_get_buffer(struct synth_context *context,int chan);
+
+/* Native only: Render songs in parallel on (threadc) worker threads, in addition to the thread calling synth_update().
+ * Output is identical to the serial path. Zero to return to serial.
+ * Returns the thread count, or <0 if unavailable, eg in web builds. We fall back to serial in that case.
+ * Call only when synth_update() isn't running, eg right after synth_init().
+ */
+int synth_set_threads(int threadc);
+
+/* Print every sound resource now, instead of each the first time it plays.
+ * Call after synth_get_rom(). Replacing the ROM or quitting cancels it.
+ * Native builds print on a background thread and return immediately.
+ * Elsewhere, you must drive it with synth_preprint_update(), eg a little after each synth_update().
+ * Sounds played before their turn print on demand as usual, and the preprint skips them.
+ * Returns >0 if printing is under way, 0 if there's nothing to print, or <0 for errors.
+ */
+WASM_EXPORT("synth_preprint_sounds") int synth_preprint_sounds();
+
+/* Print up to (framec) frames of sound, if preprinting without a background thread.
+ * With a background thread, (framec) is ignored and we only collect the finished ones.
+ * Returns >0 if there's more to do, or 0 if complete or never started.
+ * Never call during synth_update(). Same as all the others, except synth_get_rom().
+ */
+WASM_EXPORT("synth_preprint_update") int synth_preprint_update(int framec);
+
+/* Bump whenever printed output could change for the same input, eg to invalidate caches.
+ * 2: Block FM kernels. 3: Block envelopes. 4: Voice pools and stealing. 5: Internal rate and upsampler.
+ */
+#define SYNTH_VERSION 5
+
+/* Provide a sound's PCM from elsewhere, eg a disk cache, so we never print it.
+ * (v) is borrowed: Keep it alive and unchanged until synth_quit() or synth_get_rom().
+ * Fails if the sound is already printed or printing, or doesn't exist.
+ */
+int synth_set_sound_pcm(int rid,const float *v,int c);
+
+/* Fully printed PCM for one sound, or null if it isn't printed yet or still printing.
+ * Valid until synth_quit() or synth_get_rom().
+ */
+const float *synth_get_sound_pcm(int *c,int rid);
+
+/* Total bytes of PCM held by sound resources, whether preprinted or printed on demand.
+ * (soundc) optional, gets the count of printed sounds.
+ */
+int synth_get_pcm_size(int *soundc);
+
+/* Allocator statistics in bytes, for debugging. All outputs are optional.
+ * (peak) is the most live at once since the last synth_init().
+ * (fragmentation) is the percentage of the heap's used extent that's idle: Freed small blocks, and holes between large ones.
+ * (allocc) counts blocks allocated since the last synth_init(), including reallocs that had to move. Not bytes.
+ * Native builds normally allocate from libc and fail here, unless built with SYNTH_HEAP_STATS.
+ * Then the counts cover every synth context, and (fragmentation) is -1.
+ */
+WASM_EXPORT("synth_get_heap_stats") int synth_get_heap_stats(int *live,int *peak,int *fragmentation,int *allocc);
+
+/* Lock-free command queue, for a single producer on some thread other than synth_update()'s.
+ * With a queue, call the synth_queue_* functions instead of their namesakes, and you don't need to lock around them.
+ * Commands take effect at the start of the next synth_update(), in the order you made them.
+ * If the queue is full, we drop the command, count it, and return <0.
+ * Sounds print and songs decode in synth_queue_play_sound() and synth_queue_play_song(), on the caller's thread, so draining doesn't allocate.
+ * Those two fail in native builds with our own allocator. Use the lock there.
+ * Setting SYNTH_PROP_PLAYHEAD must still go thru the caller's lock; seeking can build an index.
+ * Everything else, eg synth_get(), still needs the caller's lock too.
+ * synth_flush_queue() applies pending commands immediately. Call it while holding the lock, before reading state or
+ * before a locked command that must land after the queued ones.
+ * (depth) rounds up to a power of two, and one slot is always empty. Zero to drop the queue.
+ * Call only when nothing is using synth, eg right after synth_init(). Returns the actual length or <0.
+ */
+int synth_set_queue_depth(int depth);
+int synth_get_queue_overflow();
+void synth_flush_queue();
+int synth_queue_set(int songid,int chid,int prop,float v); // Not SYNTH_PROP_PLAYHEAD.
+int synth_queue_note_off(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity);
+int synth_queue_note_on(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity);
+int synth_queue_note_once(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity,int durms);
+int synth_queue_play_sound(int rid,float trim,float pan);
+int synth_queue_play_song(int songid,int rid,int repeat,float trim,float pan);
+int synth_queue_event_at(int songid,uint8_t chid,int event,uint8_t noteid,uint8_t velocity,int durms,int timebase,double when);
+
+/* CPU profiling, so composers can keep songs within a budget. Native only; elsewhere synth_set_profiling() fails and the rest report nothing.
+ * Off by default. When off, it costs one branch per song, channel and pipe per update.
+ * Times are nanoseconds of monotonic wall time on whichever thread did the work.
+ * With worker threads, song times add up across threads and can exceed (update_ns).
+ * Songs are tallied by resource id, across every play of that song. Printers' songs are only counted in (printer_ns).
+ * Enabling, or enabling again, resets all counters.
+ */
+#define SYNTH_PROFILE_STAGE_LIMIT 16 /* Pipe stages by opcode. Higher opcodes count in the last slot. */
+struct synth_profile {
+  int64_t framec; // Frames of output since profiling began, at the output rate.
+  int64_t update_ns; // All of synth_update().
+  int64_t printer_ns; // Printing sounds. Part of (update_ns).
+  int64_t pcmplay_ns; // Mixing printed sounds. Part of (update_ns).
+  int64_t stage_ns[SYNTH_PROFILE_STAGE_LIMIT]; // Pipe stages by opcode, all songs. Part of the songs' (post_ns).
+};
+struct synth_profile_song {
+  int rid;
+  int64_t framec; // Frames this song has been running, at the internal rate.
+  int64_t ns; // All of synth_song_update(), including channels.
+  struct synth_profile_channel {
+    int64_t ns; // Channel's own update, not including post.
+    int64_t post_ns;
+    int voicec_max; // Most voices running at the end of any update.
+  } channelv[16];
+  int64_t stage_ns[SYNTH_PROFILE_STAGE_LIMIT];
+};
+int synth_set_profiling(int enable);
+int synth_get_profile(struct synth_profile *dst);
+
+/* Fills up to (dsta) songs in (dst), ordered by rid, and returns the total count.
+ */
+int synth_get_song_profiles(struct synth_profile_song *dst,int dsta);
+
+/* Adaptive quality, for hosts that can't always keep up.
+ * When enabled, we measure each synth_update() against the real time it produced.
+ * Load above (degrade) for several buffers in a row steps quality down; staying below (restore) for a couple seconds steps it back up.
+ * Both are fractions of real time, eg (0.7,0.4). Zero (the default) disables measurement, and resets to full quality.
+ * Measurement is native only, but synth_report_underrun() works everywhere: Call it when your driver reports an underrun,
+ * from the audio thread or while holding the lock you hold around synth_update(). It steps down even with measurement disabled.
+ * Reduced quality caps polyphony per channel, drops LFOs, and bypasses expendable pipe stages (detune).
+ * Minimal quality also drops FM and pitch envelopes, and caps polyphony further.
+ * Sound effects are never degraded.
+ */
+#define SYNTH_QUALITY_FULL    0
+#define SYNTH_QUALITY_REDUCED 1
+#define SYNTH_QUALITY_MINIMAL 2
+void synth_set_adaptive_quality(float degrade,float restore);
+int synth_get_quality();
+WASM_EXPORT("synth_report_underrun") void synth_report_underrun();
+
 /* Playback and such.
  ***********************************************************************/
 
@@ -58,7 +212,9 @@ WASM_EXPORT("synth_play_sound") void synth_play_sound(int rid,float trim,float p
 
 /* Begin playing a "song" resource.
  * Multiple songs may run at once.
- * Songs always synthesize on the fly, and may be arbitrarily long.
+ * Songs synthesize on the fly, and may be arbitrarily long.
+ * Except if the ROM has a songpcm with the same rid: Then we stream that instead, and the song has no channels.
+ * See etc/doc/songpcm-format.md.
  * It is unusual to play a song at nonzero pan. Individual channels may ignore it.
  * Caller must provide a positive (songid) for later addressing. We fail quickly if you give <=0.
  * If you call this with a (songid) already in use, we gracefully stop the old one first.
@@ -82,13 +238,20 @@ float synth_get(int songid,int chid,int prop);
 WASM_EXPORT("synth_set") void synth_set(int songid,int chid,int prop,float v);
 #define SYNTH_PROP_EXISTENCE  1 /* (chid) optional, readonly if present. Value 0.0 or 1.0. Set a song's existence to zero to end it. */
 #define SYNTH_PROP_TEMPO      2 /* (songid) only, readonly, constant per song. */
-#define SYNTH_PROP_PLAYHEAD   3 /* (songid) only, value in seconds. Setting is messy; we don't try to catch up earlier tails or anything, and LFOs will go out of whack. */
+#define SYNTH_PROP_PLAYHEAD   3 /* (songid) only, value in seconds. Setting restarts the notes held there, but not their tails, and LFOs will go out of whack. */
 #define SYNTH_PROP_TRIM       4 /* (chid) optional, value 0..1. There's trim per channel and per song, they multiply. */
 #define SYNTH_PROP_PAN        5 /* (chid) optional, value -1..0..1 = left..center..right. Channel and song pans combine by simple clamping addition. */
 #define SYNTH_PROP_WHEEL      6 /* (chid) required, value -1..0..1. Arguably should be an "event" function, implemented as "prop" just to reduce API size. */
 #define SYNTH_PROP_MUSIC_TRIM 7 /* No (songid) or (chid), applies to all songs. */
 #define SYNTH_PROP_SOUND_TRIM 8 /* '' sounds. */
 
+/* Exact playhead in frames, for tools that render songs offline, eg eggdev prerendering.
+ * (loopframe) optional, gets the playhead where repeat resumes. Zero until the song passes its Loop Point, or if it has none.
+ * Frames are at the internal rate, or the songpcm's rate for prerendered songs.
+ * Returns <0 if no such song.
+ */
+int synth_get_song_frames(int songid,int *loopframe);
+
 /* Inject events into a song.
  * If your events conflict with the song's, that's your own problem.
  * Events happen at the next available moment. We don't provide for precise timing.
@@ -97,6 +260,35 @@ WASM_EXPORT("synth_event_note_off") void synth_event_note_off(int songid,uint8_t
 WASM_EXPORT("synth_event_note_on") void synth_event_note_on(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity);
 WASM_EXPORT("synth_event_note_once") void synth_event_note_once(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity,int durms);
 
+/* Inject an event at a precise time instead, down to the frame, regardless of buffer size.
+ * (event) is one of SYNTH_EVENT_*. (durms) only matters for NOTE_ONCE.
+ * SYNTH_TIME_PLAYHEAD: (when) in seconds on the song's playhead as of when we receive it. We don't account for looping.
+ * SYNTH_TIME_CLOCK: (when) in frames per synth_get_clock(). Prefer this when commands are queued or buffered.
+ * Times already passed happen at the start of the next update, same as the untimed events.
+ * Each song holds at most SYNTH_SCHEDULE_LIMIT pending events. Returns <0 if full, or no such song.
+ */
+WASM_EXPORT("synth_event_at") int synth_event_at(int songid,uint8_t chid,int event,uint8_t noteid,uint8_t velocity,int durms,int timebase,double when);
+#define SYNTH_EVENT_NOTE_OFF  0x80
+#define SYNTH_EVENT_NOTE_ON   0x90
+#define SYNTH_EVENT_NOTE_ONCE 0xa0
+#define SYNTH_TIME_PLAYHEAD 1
+#define SYNTH_TIME_CLOCK    2
+#define SYNTH_SCHEDULE_LIMIT 256
+
+/* Frames generated since synth_init(), at the internal rate.
+ * Same as the sum of all (framec) given to synth_update(), unless you've set a lower internal rate.
+ */
+WASM_EXPORT("synth_get_clock") double synth_get_clock();
+
+/* How channels choose a voice to cut off, when a note starts and all their voices are busy.
+ * Channels allocate voices when the song starts, enough for the song's own busiest moment, and never more after.
+ * So this mostly matters for events you inject. Applies to songs and sounds started after the call.
+ */
+WASM_EXPORT("synth_set_voice_stealing") void synth_set_voice_stealing(int policy);
+#define SYNTH_STEAL_OLDEST    0 /* Default. */
+#define SYNTH_STEAL_QUIETEST  1
+#define SYNTH_STEAL_RETRIGGER 2 /* The oldest voice on the same note if there is one, otherwise the oldest. */
+
 /* A weird dance to expose the wave compiler, needed for Egg Editor but not for the runtime.
  * Call synth_wave_prepare() with the serial length, then write your serial there.
  * Then call synth_wave_preview() and it will return a pointer 1024 floats, which will be overwritten by the next preview.
@@ -3,6 +3,7 @@
  * We manage trim, pan, and post.
  * We massage events for dispatch to the typed implementation.
  * We have no concept of voices or notes; that belongs to the implementation.
+ * But we do notice when the implementation goes idle, and once our output has gone quiet too, we stop updating until the next note.
  */
 
 #include "synth_internal.h"
@@ -29,6 +30,8 @@ void synth_channel_del(struct synth_channel *channel) {
   synth_pipe_del(channel->post);
   if (channel->bufl) synth_free(channel->bufl);
   if (channel->bufr) synth_free(channel->bufr);
+  if (channel->capl) synth_free(channel->capl);
+  if (channel->capr) synth_free(channel->capr);
   synth_free(channel);
 }
 
@@ -50,6 +53,7 @@ struct synth_channel *synth_channel_new(
   channel->chid=chid; // Advisory only.
   channel->mode=mode;
   channel->song=owner;
+  channel->steal=synth.voice_steal;
   synth_channel_set_trim(channel,channel->trim0=(float)trim/255.0f);
   synth_channel_set_pan(channel,channel->pan0=(float)(pan-0x80)/127.0f);
   if ((type->init(channel,modecfg,modecfgc)<0)||!channel->update_mono) {
@@ -61,6 +65,10 @@ struct synth_channel *synth_channel_new(
       synth_channel_del(channel);
       return 0;
     }
+    if (!channel->post->stagec) { // All noops. Don't bother.
+      synth_pipe_del(channel->post);
+      channel->post=0;
+    }
   }
   if (!(channel->bufl=synth_malloc(sizeof(float)*synth.buffer_frames))) {
     synth_channel_del(channel);
@@ -124,6 +132,8 @@ void synth_channel_note_off(struct synth_channel *channel,uint8_t noteid,uint8_t
  
 void synth_channel_note_on(struct synth_channel *channel,uint8_t noteid,uint8_t velocity) {
   if (channel->defunct) return;
+  channel->asleep=0;
+  channel->quietc=0;
   float fvel;
   if (velocity<=0x00) fvel=0.0f;
   else if (velocity>=0x7f) fvel=1.0f;
@@ -140,6 +150,8 @@ void synth_channel_note_on(struct synth_channel *channel,uint8_t noteid,uint8_t
  
 void synth_channel_note_once(struct synth_channel *channel,uint8_t noteid,uint8_t velocity,int durms) {
   if (channel->defunct) return;
+  channel->asleep=0;
+  channel->quietc=0;
   float fvel;
   if (velocity<=0x00) fvel=0.0f;
   else if (velocity>=0x7f) fvel=1.0f;
@@ -166,23 +178,110 @@ void synth_channel_fade_out(struct synth_channel *channel,int framec) {
   channel->fadeoutd=-1.0f/(float)framec;
 }
 
+/* Apply trim and add to output.
+ */
+ 
+static inline void synth_channel_mix_stereo(float *dstl,float *dstr,const float *srcl,const float *srcr,float trim,int framec) {
+  for (;framec-->0;srcl++,srcr++,dstl++,dstr++) {
+    (*dstl)+=(*srcl)*trim;
+    (*dstr)+=(*srcr)*trim;
+  }
+}
+
+static inline void synth_channel_mix_mono(float *dst,const float *src,float trim,int framec) {
+  for (;framec-->0;dst++,src++) (*dst)+=(*src)*trim;
+}
+
+/* Sleep.
+ * synth_channel_sleep() runs instead of a regular update while asleep. It keeps LFOs and fades moving, and fills capture with silence.
+ * synth_channel_check_sleep() runs after a regular update, with its final output.
+ * Sleeping is not perfectly transparent: Whatever is left in post below SYNTH_SLEEP_LEVEL gets dropped.
+ */
+ 
+static void synth_channel_sleep(struct synth_channel *channel,int framec) {
+  if (channel->type->skip) channel->type->skip(channel,framec);
+  if (channel->post) synth_pipe_skip(channel->post,framec);
+  if (channel->fadeout>0.0f) {
+    if ((channel->fadeout+=channel->fadeoutd*(float)framec)<=0.0f) {
+      channel->fadeout=0.0f;
+      channel->defunct=1;
+    }
+  }
+  if (channel->capl) {
+    __builtin_memset(channel->capl+channel->capc,0,sizeof(float)*framec);
+    if (channel->capr) __builtin_memset(channel->capr+channel->capc,0,sizeof(float)*framec);
+    channel->capc+=framec;
+  }
+}
+
+static int synth_channel_buffer_is_quiet(const float *v,int c) {
+  for (;c-->0;v++) {
+    if ((*v>SYNTH_SLEEP_LEVEL)||(*v<-SYNTH_SLEEP_LEVEL)) return 0;
+  }
+  return 1;
+}
+ 
+static void synth_channel_check_sleep(struct synth_channel *channel,const float *bufl,const float *bufr,int framec) {
+  if (synth.sleep_disable) return;
+  if (!channel->type->is_idle||!channel->type->is_idle(channel)) {
+    channel->quietc=0;
+    return;
+  }
+  if (!synth_channel_buffer_is_quiet(bufl,framec)||(bufr&&!synth_channel_buffer_is_quiet(bufr,framec))) {
+    channel->quietc=0;
+    return;
+  }
+  channel->quietc+=framec;
+  if (channel->post) {
+    if (channel->quietc<channel->post->tail) return;
+    synth_pipe_clear(channel->post); // Drop the sub-threshold residue, so it doesn't resume stale when we wake.
+  }
+  channel->asleep=1;
+}
+
 /* Update.
+ * When capturing, we generate directly into the capture buffers, and skip the final mix.
  */
 
+/* Profiling, after the type's update. Returns the current time.
+ */
+ 
+static int64_t synth_channel_profile_update(struct synth_profile_song *prof,struct synth_channel *channel,int64_t then) {
+  int64_t now=synth_profile_now();
+  struct synth_profile_channel *pch=prof->channelv+channel->chid;
+  pch->ns+=now-then;
+  if (channel->type->get_voicec) {
+    int voicec=channel->type->get_voicec(channel);
+    if (voicec>pch->voicec_max) pch->voicec_max=voicec;
+  }
+  return now;
+}
+
 void synth_channel_update_stereo(float *dstl,float *dstr,struct synth_channel *channel,int framec) {
   if (channel->defunct) return;
+  if (channel->asleep) {
+    synth_channel_sleep(channel,framec);
+    return;
+  }
 
   // Zero buffers.
   if (!channel->bufr) return;
-  __builtin_memset(channel->bufl,0,sizeof(float)*framec);
-  __builtin_memset(channel->bufr,0,sizeof(float)*framec);
+  float *bufl=channel->bufl,*bufr=channel->bufr;
+  if (channel->capl) {
+    bufl=channel->capl+channel->capc;
+    bufr=channel->capr+channel->capc;
+  }
+  __builtin_memset(bufl,0,sizeof(float)*framec);
+  __builtin_memset(bufr,0,sizeof(float)*framec);
+  struct synth_profile_song *prof=channel->song->prof;
+  int64_t then=prof?synth_profile_now():0;
   
   // Generate the full-level signal, and if mono, expand to stereo. Do not apply trim yet.
   if (channel->update_stereo) {
-    channel->update_stereo(channel->bufl,channel->bufr,channel,framec);
+    channel->update_stereo(bufl,bufr,channel,framec);
   } else {
-    channel->update_mono(channel->bufl,channel,framec);
-    float *lp=channel->bufl,*rp=channel->bufr;
+    channel->update_mono(bufl,channel,framec);
+    float *lp=bufl,*rp=bufr;
     int i=framec;
     if (channel->pan<0.0f) {
       float trimr=1.0f+channel->pan;
@@ -198,14 +297,17 @@ void synth_channel_update_stereo(float *dstl,float *dstr,struct synth_channel *c
     }
   }
   
+  if (prof) then=synth_channel_profile_update(prof,channel,then);
+  
   // Run post.
   if (channel->post) {
-    synth_pipe_update_stereo(channel->bufl,channel->bufr,channel->post,framec);
+    synth_pipe_update_stereo(bufl,bufr,channel->post,framec);
+    if (prof) prof->channelv[channel->chid].post_ns+=synth_profile_now()-then;
   }
   
   // If fading out, apply that.
   if (channel->fadeout>0.0f) {
-    float *vl=channel->bufl,*vr=channel->bufr;
+    float *vl=bufl,*vr=bufr;
     int i=framec;
     for (;i-->0;vl++,vr++) {
       (*vl)*=channel->fadeout;
@@ -217,30 +319,38 @@ void synth_channel_update_stereo(float *dstl,float *dstr,struct synth_channel *c
     }
   }
   
+  synth_channel_check_sleep(channel,bufl,bufr,framec);
+  
   // Apply trim and add to output.
-  const float *srcl=channel->bufl,*srcr=channel->bufr;
-  int i=framec;
-  for (;i-->0;srcl++,srcr++,dstl++,dstr++) {
-    (*dstl)+=(*srcl)*channel->trim;
-    (*dstr)+=(*srcr)*channel->trim;
-  }
+  if (channel->capl) channel->capc+=framec;
+  else synth_channel_mix_stereo(dstl,dstr,bufl,bufr,channel->trim,framec);
 }
 
 void synth_channel_update_mono(float *dst,struct synth_channel *channel,int framec) {
   if (channel->defunct) return;
+  if (channel->asleep) {
+    synth_channel_sleep(channel,framec);
+    return;
+  }
 
   // Generate the initial signal.
-  __builtin_memset(channel->bufl,0,sizeof(float)*framec);
-  channel->update_mono(channel->bufl,channel,framec);
+  float *bufl=channel->bufl;
+  if (channel->capl) bufl=channel->capl+channel->capc;
+  __builtin_memset(bufl,0,sizeof(float)*framec);
+  struct synth_profile_song *prof=channel->song->prof;
+  int64_t then=prof?synth_profile_now():0;
+  channel->update_mono(bufl,channel,framec);
+  if (prof) then=synth_channel_profile_update(prof,channel,then);
   
   // Run post.
   if (channel->post) {
-    synth_pipe_update_mono(channel->bufl,channel->post,framec);
+    synth_pipe_update_mono(bufl,channel->post,framec);
+    if (prof) prof->channelv[channel->chid].post_ns+=synth_profile_now()-then;
   }
   
   // If fading out, apply that.
   if (channel->fadeout>0.0f) {
-    float *vl=channel->bufl;
+    float *vl=bufl;
     int i=framec;
     for (;i-->0;vl++) {
       (*vl)*=channel->fadeout;
@@ -251,8 +361,42 @@ void synth_channel_update_mono(float *dst,struct synth_channel *channel,int fram
     }
   }
   
+  synth_channel_check_sleep(channel,bufl,0,framec);
+  
   // Apply trim and add to output.
-  const float *src=channel->bufl;
-  int i=framec;
-  for (;i-->0;dst++,src++) (*dst)+=(*src)*channel->trim;
+  if (channel->capl) channel->capc+=framec;
+  else synth_channel_mix_mono(dst,bufl,channel->trim,framec);
+}
+
+/* Mix capture.
+ */
+ 
+void synth_channel_mix_capture(float *dstl,float *dstr,struct synth_channel *channel) {
+  if (!channel->capl) return;
+  if (dstr&&channel->capr) synth_channel_mix_stereo(dstl,dstr,channel->capl,channel->capr,channel->trim,channel->capc);
+  else synth_channel_mix_mono(dstl,channel->capl,channel->trim,channel->capc);
+  channel->capc=0;
+}
+
+/* Voice arena size.
+ */
+ 
+int synth_channel_count_voices(const struct synth_channel *channel,int tailframes) {
+  int tailms=(int)(((int64_t)tailframes*1000)/synth.rate);
+  int voicec=synth_song_measure_polyphony(channel->song,channel->chid,tailms,SYNTH_VOICE_LIMIT);
+  voicec+=2; // Slop for rounding, and the odd injected note.
+  if (voicec<SYNTH_VOICE_MIN) return SYNTH_VOICE_MIN;
+  if (voicec>SYNTH_VOICE_LIMIT) return SYNTH_VOICE_LIMIT;
+  return voicec;
+}
+
+/* Rate a voice for stealing.
+ */
+ 
+float synth_channel_steal_score(const struct synth_channel *channel,uint8_t noteid,uint8_t voicenoteid,int age,float level) {
+  switch (channel->steal) {
+    case SYNTH_STEAL_QUIETEST: return (level<0.0f)?-level:level;
+    case SYNTH_STEAL_RETRIGGER: if (voicenoteid==noteid) return -(float)age-16777216.0f; break;
+  }
+  return -(float)age;
 }
@@ -8,6 +8,8 @@
 // No cleanup necessary; pcmplay is all weak.
 struct synth_voice_drum {
   struct synth_pcmplay pcmplay;
+  uint8_t noteid;
+  int seq;
 };
 
 struct synth_drum {
@@ -19,8 +21,9 @@ struct synth_drum {
 
 struct synth_channel_drum {
   struct synth_channel hdr;
-  struct synth_voice_drum *voicev;
+  struct synth_voice_drum *voicev; // Allocated at init and never resized. Packed, oldest first.
   int voicec,voicea;
+  int seq_next;
   struct synth_drum drumv[128];
 };
 
@@ -89,6 +92,13 @@ static int _drum_init(struct synth_channel *channel,const uint8_t *src,int srcc)
     drum->serial=serial;
     drum->serialc=serialc;
   }
+  
+  /* Drums usually play until their PCM runs out, no matter the event's duration.
+   * We don't know PCM lengths until they print, so assume the longest a sound can be.
+   */
+  CHANNEL->voicea=synth_channel_count_voices(channel,synth_frames_from_ms(5000));
+  if (!(CHANNEL->voicev=synth_calloc(CHANNEL->voicea,sizeof(struct synth_voice_drum)))) return -1;
+  
   channel->update_mono=_drum_update_mono;
   channel->update_stereo=_drum_update_stereo;
   return 0;
@@ -111,16 +121,27 @@ static void _drum_note_on(struct synth_channel *channel,uint8_t noteid,float vel
   }
   if (drum->pcm->c<=1) return;
   
-  // Acquire a voice. We keep the voice list packed.
-  if (CHANNEL->voicec>=CHANNEL->voicea) {
-    int na=CHANNEL->voicea+16;
-    if (na>INT_MAX/sizeof(struct synth_voice_drum)) return;
-    void *nv=synth_realloc(CHANNEL->voicev,sizeof(struct synth_voice_drum)*na);
-    if (!nv) return;
-    CHANNEL->voicev=nv;
-    CHANNEL->voicea=na;
+  /* Acquire a voice. We keep the voice list packed.
+   * If they're all busy, drop one per the stealing policy and shuffle the rest down, so the new one is still last.
+   */
+  if (CHANNEL->voicec>=synth_channel_voice_limit(channel,CHANNEL->voicea)) {
+    if (CHANNEL->voicec<1) return;
+    struct synth_voice_drum *q=CHANNEL->voicev;
+    int i=0,besti=0;
+    float bestscore=0.0f;
+    for (;i<CHANNEL->voicec;i++,q++) {
+      float score=synth_channel_steal_score(channel,noteid,q->noteid,CHANNEL->seq_next-q->seq,q->pcmplay.triml+q->pcmplay.trimr);
+      if (!i||(score<bestscore)) {
+        besti=i;
+        bestscore=score;
+      }
+    }
+    CHANNEL->voicec--;
+    __builtin_memmove(CHANNEL->voicev+besti,CHANNEL->voicev+besti+1,sizeof(struct synth_voice_drum)*(CHANNEL->voicec-besti));
   }
   struct synth_voice_drum *voice=CHANNEL->voicev+CHANNEL->voicec++;
+  voice->noteid=noteid;
+  voice->seq=CHANNEL->seq_next++;
   
   // Determine trim, and start playing.
   float trim=drum->trimlo*(1.0f-velocity)+drum->trimhi*velocity;
@@ -130,6 +151,17 @@ static void _drum_note_on(struct synth_channel *channel,uint8_t noteid,float vel
   }
 }
 
+/* Idle.
+ */
+ 
+static int _drum_is_idle(struct synth_channel *channel) {
+  return !CHANNEL->voicec;
+}
+
+static int _drum_get_voicec(struct synth_channel *channel) {
+  return CHANNEL->voicec;
+}
+
 /* Type definition.
  */
  
@@ -139,4 +171,6 @@ const struct synth_channel_type synth_channel_type_drum={
   .del=_drum_del,
   .init=_drum_init,
   .note_on=_drum_note_on,
+  .is_idle=_drum_is_idle,
+  .get_voicec=_drum_get_voicec,
 };
@@ -5,11 +5,19 @@
  
 #include "synth_internal.h"
 
-// We'll artificially refuse to create more than so many voices.
-#define FM_VOICE_LIMIT 32
+// Per-channel scratch buffers for the block kernels, each (scratch_frames) long.
+#define FM_SCRATCH_LEVEL   0
+#define FM_SCRATCH_MIX     1
+#define FM_SCRATCH_RANGE   2
+#define FM_SCRATCH_PITCH   3
+#define FM_SCRATCH_MOD     4
+#define FM_SCRATCH_SAMPLEA 5
+#define FM_SCRATCH_SAMPLEB 6
+#define FM_SCRATCH_COUNT   7
 
 struct synth_voice_fm {
   uint8_t noteid;
+  int seq;
   uint32_t carp;
   uint32_t cardp;
   uint32_t carpredp;
@@ -22,8 +30,9 @@ struct synth_voice_fm {
 
 struct synth_channel_fm {
   struct synth_channel hdr;
-  struct synth_voice_fm *voicev;
+  struct synth_voice_fm *voicev; // Allocated at init and never resized.
   int voicec,voicea;
+  int seq_next;
   
   // Per modecfg:
   struct synth_env levelenv;
@@ -50,9 +59,12 @@ struct synth_channel_fm {
   uint32_t rangelfop,rangelfodp;
   float *mixlfo;
   uint32_t mixlfop,mixlfodp;
+  float *scratch;
+  int scratch_frames; // Copy of (synth.buffer_frames), so kernels don't touch the context to find their scratch.
 };
 
 #define CHANNEL ((struct synth_channel_fm*)channel)
+#define FM_SCRATCH(tag) (CHANNEL->scratch+FM_SCRATCH_##tag*CHANNEL->scratch_frames)
 
 /* Cleanup.
  */
@@ -66,18 +78,33 @@ static void _fm_del(struct synth_channel *channel) {
   synth_wave_del(CHANNEL->mixlfowave);
   if (CHANNEL->rangelfo) synth_free(CHANNEL->rangelfo);
   if (CHANNEL->mixlfo) synth_free(CHANNEL->mixlfo);
+  if (CHANNEL->scratch) synth_free(CHANNEL->scratch);
 }
 
+/* Block kernels.
+ * Each voice update runs in stages over the channel's scratch buffers:
+ *  - Fill envelopes a whole leg at a time.
+ *  - Walk the oscillators and look up waves. Phase is a running sum so this part is inherently serial.
+ *  - Everything else, wave mixing and level, runs 4 frames at a time.
+ * Output is the same as a straightforward per-frame loop, operation for operation.
+ */
+
 /* "waveaonly": No FM, pitch bend, or LFOs, and we only use wave A. This is as simple as we get.
  */
  
 static void synth_voice_fm_update_waveaonly(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
-  for (;framec-->0;dst++) {
-    voice->carp+=voice->cardp;
-    float sample=CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT];
-    float level=synth_env_update(voice->levelenv);
-    (*dst)+=sample*level;
+  float *levelv=FM_SCRATCH(LEVEL),*samplea=FM_SCRATCH(SAMPLEA);
+  synth_env_fill(levelv,&voice->levelenv,framec);
+  const float *wavea=CHANNEL->wavea->v;
+  uint32_t carp=voice->carp,cardp=voice->cardp;
+  float *sa=samplea;
+  int i=framec;
+  for (;i-->0;sa++) {
+    carp+=cardp;
+    *sa=wavea[carp>>SYNTH_WAVE_SHIFT];
   }
+  voice->carp=carp;
+  synth_block_mlt_add(dst,samplea,levelv,framec);
 }
  
 static void _fm_update_mono_waveaonly(float *dst,struct synth_channel *channel,int framec) {
@@ -91,16 +118,21 @@ static void _fm_update_mono_waveaonly(float *dst,struct synth_channel *channel,i
  */
  
 static void synth_voice_fm_update_waveonly(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
-  for (;framec-->0;dst++) {
-    voice->carp+=voice->cardp;
-    float mix=synth_env_update(voice->mixenv);
-    float sample=
-      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
-      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
-      
-    float level=synth_env_update(voice->levelenv);
-    (*dst)+=sample*level;
+  float *levelv=FM_SCRATCH(LEVEL),*mixv=FM_SCRATCH(MIX),*samplea=FM_SCRATCH(SAMPLEA),*sampleb=FM_SCRATCH(SAMPLEB);
+  synth_env_fill(mixv,&voice->mixenv,framec);
+  synth_env_fill(levelv,&voice->levelenv,framec);
+  const float *wavea=CHANNEL->wavea->v,*waveb=CHANNEL->waveb->v;
+  uint32_t carp=voice->carp,cardp=voice->cardp;
+  float *sa=samplea,*sb=sampleb;
+  int i=framec;
+  for (;i-->0;sa++,sb++) {
+    carp+=cardp;
+    *sa=wavea[carp>>SYNTH_WAVE_SHIFT];
+    *sb=waveb[carp>>SYNTH_WAVE_SHIFT];
   }
+  voice->carp=carp;
+  synth_block_mix(samplea,sampleb,mixv,framec);
+  synth_block_mlt_add(dst,samplea,levelv,framec);
 }
  
 static void _fm_update_mono_waveonly(float *dst,struct synth_channel *channel,int framec) {
@@ -110,27 +142,45 @@ static void _fm_update_mono_waveonly(float *dst,struct synth_channel *channel,in
   while (CHANNEL->voicec&&CHANNEL->voicev[CHANNEL->voicec-1].levelenv.finished) CHANNEL->voicec--;
 }
 
+/* Walk the modulator at a constant rate, into (modv), and scale by (rangev) in place.
+ * Shared by "fmonly" and "nobend".
+ */
+ 
+static void synth_voice_fm_modulate_constant(float *modv,const float *rangev,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  const float *modulator=CHANNEL->modulator->v;
+  int32_t moddp=(int32_t)((float)voice->cardp*CHANNEL->modrate);
+  uint32_t modp=voice->modp;
+  float *mp=modv;
+  int i=framec;
+  for (;i-->0;mp++) {
+    modp+=moddp;
+    *mp=modulator[modp>>SYNTH_WAVE_SHIFT];
+  }
+  voice->modp=modp;
+  synth_block_mlt(modv,rangev,framec);
+}
+
 /* "fmonly": Relative modulation. No pitchenv, LFOs, or wave mixer.
  */
  
 static void synth_voice_fm_update_fmonly(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
-  for (;framec-->0;dst++) {
-  
-    float fdp=(float)voice->cardp;
-    
-    voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
-    
-    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
-    float range=synth_env_update(voice->rangeenv);
-    mod*=range;
-    int32_t dp=voice->cardp+(fdp*mod);
-    voice->carp+=dp;
-    
-    float sample=CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT];
-      
-    float level=synth_env_update(voice->levelenv);
-    (*dst)+=sample*level;
+  float *levelv=FM_SCRATCH(LEVEL),*rangev=FM_SCRATCH(RANGE),*modv=FM_SCRATCH(MOD),*samplea=FM_SCRATCH(SAMPLEA);
+  synth_env_fill(rangev,&voice->rangeenv,framec);
+  synth_env_fill(levelv,&voice->levelenv,framec);
+  synth_voice_fm_modulate_constant(modv,rangev,voice,channel,framec);
+  const float *wavea=CHANNEL->wavea->v;
+  float fdp=(float)voice->cardp;
+  uint32_t carp=voice->carp;
+  const float *mp=modv;
+  float *sa=samplea;
+  int i=framec;
+  for (;i-->0;mp++,sa++) {
+    int32_t dp=fdp+(fdp*(*mp));
+    carp+=dp;
+    *sa=wavea[carp>>SYNTH_WAVE_SHIFT];
   }
+  voice->carp=carp;
+  synth_block_mlt_add(dst,samplea,levelv,framec);
 }
  
 static void _fm_update_mono_fmonly(float *dst,struct synth_channel *channel,int framec) {
@@ -145,26 +195,27 @@ static void _fm_update_mono_fmonly(float *dst,struct synth_channel *channel,int
  */
  
 static void synth_voice_fm_update_nobend(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
-  for (;framec-->0;dst++) {
-  
-    float fdp=(float)voice->cardp;
-    
-    voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
-    
-    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
-    float range=synth_env_update(voice->rangeenv);
-    mod*=range;
-    int32_t dp=voice->cardp+(fdp*mod);
-    voice->carp+=dp;
-    
-    float mix=synth_env_update(voice->mixenv);
-    float sample=
-      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
-      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
-      
-    float level=synth_env_update(voice->levelenv);
-    (*dst)+=sample*level;
+  float *levelv=FM_SCRATCH(LEVEL),*mixv=FM_SCRATCH(MIX),*rangev=FM_SCRATCH(RANGE),*modv=FM_SCRATCH(MOD);
+  float *samplea=FM_SCRATCH(SAMPLEA),*sampleb=FM_SCRATCH(SAMPLEB);
+  synth_env_fill(rangev,&voice->rangeenv,framec);
+  synth_env_fill(mixv,&voice->mixenv,framec);
+  synth_env_fill(levelv,&voice->levelenv,framec);
+  synth_voice_fm_modulate_constant(modv,rangev,voice,channel,framec);
+  const float *wavea=CHANNEL->wavea->v,*waveb=CHANNEL->waveb->v;
+  float fdp=(float)voice->cardp;
+  uint32_t carp=voice->carp;
+  const float *mp=modv;
+  float *sa=samplea,*sb=sampleb;
+  int i=framec;
+  for (;i-->0;mp++,sa++,sb++) {
+    int32_t dp=fdp+(fdp*(*mp));
+    carp+=dp;
+    *sa=wavea[carp>>SYNTH_WAVE_SHIFT];
+    *sb=waveb[carp>>SYNTH_WAVE_SHIFT];
   }
+  voice->carp=carp;
+  synth_block_mix(samplea,sampleb,mixv,framec);
+  synth_block_mlt_add(dst,samplea,levelv,framec);
 }
  
 static void _fm_update_mono_nobend(float *dst,struct synth_channel *channel,int framec) {
@@ -174,79 +225,107 @@ static void _fm_update_mono_nobend(float *dst,struct synth_channel *channel,int
   while (CHANNEL->voicec&&CHANNEL->voicev[CHANNEL->voicec-1].levelenv.finished) CHANNEL->voicec--;
 }
 
+/* Convert (pitchv) from cents to a float carrier step in place, and walk the modulator into (modv).
+ * Modulator is relative to the bent carrier, or absolute if (CHANNEL->modabs).
+ * Shared by "nolfo" and "full".
+ */
+ 
+static void synth_voice_fm_modulate_bent(float *pitchv,float *modv,struct synth_voice_fm *voice,struct synth_channel *channel,const struct synth_context *ctx,int framec) {
+  const float *modulator=CHANNEL->modulator->v;
+  float cardpf=(float)voice->cardp;
+  uint32_t modp=voice->modp;
+  float *pp=pitchv,*mp=modv;
+  int i=framec;
+  if (CHANNEL->modabs) {
+    for (;i-->0;pp++,mp++) {
+      *pp=cardpf*synth_bend_from_cents_ctx(ctx,(int)(*pp));
+      modp+=CHANNEL->modabs;
+      *mp=modulator[modp>>SYNTH_WAVE_SHIFT];
+    }
+  } else {
+    for (;i-->0;pp++,mp++) {
+      float fdp=cardpf*synth_bend_from_cents_ctx(ctx,(int)(*pp));
+      *pp=fdp;
+      modp+=(int32_t)(fdp*CHANNEL->modrate);
+      *mp=modulator[modp>>SYNTH_WAVE_SHIFT];
+    }
+  }
+  voice->modp=modp;
+}
+
 /* "nolfo": All options except LFOs and absolute modulators.
  */
  
-static void synth_voice_fm_update_nolfo(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
-  for (;framec-->0;dst++) {
-  
-    float fdp=(float)voice->cardp;
-    int cents=(int)synth_env_update(voice->pitchenv);
-    fdp*=synth_bend_from_cents(cents);
-    
-    voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
-    
-    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
-    float range=synth_env_update(voice->rangeenv);
-    mod*=range;
-    int32_t dp=(int32_t)(fdp+(fdp*mod));
-    voice->carp+=dp;
-    
-    float mix=synth_env_update(voice->mixenv);
-    float sample=
-      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
-      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
-      
-    float level=synth_env_update(voice->levelenv);
-    (*dst)+=sample*level;
+static void synth_voice_fm_update_nolfo(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,const struct synth_context *ctx,int framec) {
+  float *levelv=FM_SCRATCH(LEVEL),*mixv=FM_SCRATCH(MIX),*rangev=FM_SCRATCH(RANGE),*pitchv=FM_SCRATCH(PITCH),*modv=FM_SCRATCH(MOD);
+  float *samplea=FM_SCRATCH(SAMPLEA),*sampleb=FM_SCRATCH(SAMPLEB);
+  synth_env_fill(pitchv,&voice->pitchenv,framec);
+  synth_env_fill(rangev,&voice->rangeenv,framec);
+  synth_env_fill(mixv,&voice->mixenv,framec);
+  synth_env_fill(levelv,&voice->levelenv,framec);
+  synth_voice_fm_modulate_bent(pitchv,modv,voice,channel,ctx,framec);
+  synth_block_mlt(modv,rangev,framec);
+  const float *wavea=CHANNEL->wavea->v,*waveb=CHANNEL->waveb->v;
+  uint32_t carp=voice->carp;
+  const float *pp=pitchv,*mp=modv;
+  float *sa=samplea,*sb=sampleb;
+  int i=framec;
+  for (;i-->0;pp++,mp++,sa++,sb++) {
+    int32_t dp=(int32_t)((*pp)+((*pp)*(*mp)));
+    carp+=dp;
+    *sa=wavea[carp>>SYNTH_WAVE_SHIFT];
+    *sb=waveb[carp>>SYNTH_WAVE_SHIFT];
   }
+  voice->carp=carp;
+  synth_block_mix(samplea,sampleb,mixv,framec);
+  synth_block_mlt_add(dst,samplea,levelv,framec);
 }
  
 static void _fm_update_mono_nolfo(float *dst,struct synth_channel *channel,int framec) {
+  const struct synth_context *ctx=&synth;
   struct synth_voice_fm *voice=CHANNEL->voicev;
   int i=CHANNEL->voicec;
-  for (;i-->0;voice++) synth_voice_fm_update_nolfo(dst,voice,channel,framec);
+  for (;i-->0;voice++) synth_voice_fm_update_nolfo(dst,voice,channel,ctx,framec);
   while (CHANNEL->voicec&&CHANNEL->voicev[CHANNEL->voicec-1].levelenv.finished) CHANNEL->voicec--;
 }
 
 /* "full": All options enabled, and modulator may be absolute or relative.
  */
  
-static void synth_voice_fm_update_full(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
-  const float *rangelfo=CHANNEL->rangelfo;
-  const float *mixlfo=CHANNEL->mixlfo;
-  for (;framec-->0;dst++) {
-  
-    float fdp=(float)voice->cardp;
-    int cents=(int)synth_env_update(voice->pitchenv);
-    fdp*=synth_bend_from_cents(cents);
-    
-    if (CHANNEL->modabs) voice->modp+=CHANNEL->modabs;
-    else voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
-    
-    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
-    float range=synth_env_update(voice->rangeenv);
-    if (rangelfo) {
-      range*=*rangelfo;
-      rangelfo++;
-    }
-    mod*=range;
-    int32_t dp=voice->cardp+(fdp*mod);
-    voice->carp+=dp;
-    
-    float mix=synth_env_update(voice->mixenv);
-    if (mixlfo) {
-      mix+=*mixlfo;
+static void synth_voice_fm_update_full(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,const struct synth_context *ctx,int framec) {
+  float *levelv=FM_SCRATCH(LEVEL),*mixv=FM_SCRATCH(MIX),*rangev=FM_SCRATCH(RANGE),*pitchv=FM_SCRATCH(PITCH),*modv=FM_SCRATCH(MOD);
+  float *samplea=FM_SCRATCH(SAMPLEA),*sampleb=FM_SCRATCH(SAMPLEB);
+  synth_env_fill(pitchv,&voice->pitchenv,framec);
+  synth_env_fill(rangev,&voice->rangeenv,framec);
+  synth_env_fill(mixv,&voice->mixenv,framec);
+  synth_env_fill(levelv,&voice->levelenv,framec);
+  synth_voice_fm_modulate_bent(pitchv,modv,voice,channel,ctx,framec);
+  if (CHANNEL->rangelfo) synth_block_mlt(rangev,CHANNEL->rangelfo,framec);
+  synth_block_mlt(modv,rangev,framec);
+  if (CHANNEL->mixlfo) {
+    float *mixp=mixv;
+    const float *lfo=CHANNEL->mixlfo;
+    int i=framec;
+    for (;i-->0;mixp++,lfo++) {
+      float mix=(*mixp)+(*lfo);
       if (mix<0.0f) mix=0.0f; else if (mix>1.0f) mix=1.0f;
-      mixlfo++;
+      *mixp=mix;
     }
-    float sample=
-      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
-      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
-      
-    float level=synth_env_update(voice->levelenv);
-    (*dst)+=sample*level;
   }
+  const float *wavea=CHANNEL->wavea->v,*waveb=CHANNEL->waveb->v;
+  uint32_t carp=voice->carp,cardp=voice->cardp;
+  const float *pp=pitchv,*mp=modv;
+  float *sa=samplea,*sb=sampleb;
+  int i=framec;
+  for (;i-->0;pp++,mp++,sa++,sb++) {
+    int32_t dp=cardp+((*pp)*(*mp));
+    carp+=dp;
+    *sa=wavea[carp>>SYNTH_WAVE_SHIFT];
+    *sb=waveb[carp>>SYNTH_WAVE_SHIFT];
+  }
+  voice->carp=carp;
+  synth_block_mix(samplea,sampleb,mixv,framec);
+  synth_block_mlt_add(dst,samplea,levelv,framec);
 }
  
 static void _fm_update_mono_full(float *dst,struct synth_channel *channel,int framec) {
@@ -270,9 +349,10 @@ static void _fm_update_mono_full(float *dst,struct synth_channel *channel,int fr
       *lfodst=lfosrc[CHANNEL->mixlfop>>SYNTH_WAVE_SHIFT]*CHANNEL->mixlfodepth;
     }
   }
+  const struct synth_context *ctx=&synth;
   struct synth_voice_fm *voice=CHANNEL->voicev;
   int i=CHANNEL->voicec;
-  for (;i-->0;voice++) synth_voice_fm_update_full(dst,voice,channel,framec);
+  for (;i-->0;voice++) synth_voice_fm_update_full(dst,voice,channel,ctx,framec);
   while (CHANNEL->voicec&&CHANNEL->voicev[CHANNEL->voicec-1].levelenv.finished) CHANNEL->voicec--;
 }
 
@@ -316,6 +396,36 @@ static int synth_channel_fm_decode(struct synth_channel *channel,const uint8_t *
   return 0;
 }
 
+/* Select the lightest update regime that performs all the operations we're configured for.
+ * Under CPU pressure, drop to lighter ones even if they lose something: LFOs first, then FM and pitch envelope too.
+ */
+ 
+static void _fm_select_update(struct synth_channel *channel) {
+  int quality=synth_channel_quality(channel);
+  if (quality>=SYNTH_QUALITY_MINIMAL) {
+    if (CHANNEL->mixenv.flags&SYNTH_ENV_PRESENT) channel->update_mono=_fm_update_mono_waveonly;
+    else channel->update_mono=_fm_update_mono_waveaonly;
+    return;
+  }
+  // Only "full" does LFOs and absolute modulator rates. Those are all kind of unusual, so we don't bother splitting them out with more specific optimization.
+  // "nolfo" does absolute modulators too, so at reduced quality that's where they go.
+  if (CHANNEL->rangelfo||CHANNEL->mixlfo||CHANNEL->modabs) {
+    if (quality>=SYNTH_QUALITY_REDUCED) channel->update_mono=_fm_update_mono_nolfo;
+    else channel->update_mono=_fm_update_mono_full;
+  }
+  // If we have a pitch envelope, we need "nolfo".
+  else if (CHANNEL->pitchenv.flags&SYNTH_ENV_PRESENT) channel->update_mono=_fm_update_mono_nolfo;
+  // If the wave mixer is defaulted, we can use "fmonly" or "waveaonly".
+  else if (!(CHANNEL->mixenv.flags&SYNTH_ENV_PRESENT)) {
+    if ((CHANNEL->modrate>0.0f)&&(CHANNEL->modrange>0.0f)) channel->update_mono=_fm_update_mono_fmonly;
+    else channel->update_mono=_fm_update_mono_waveaonly;
+  }
+  // If FM rate or range is zero, we can use "waveonly".
+  else if ((CHANNEL->modrate<=0.0f)&&(CHANNEL->modrange<=0.0f)) channel->update_mono=_fm_update_mono_waveonly;
+  // No LFO, absmod, or pitchenv: We can use "nobend".
+  else channel->update_mono=_fm_update_mono_nobend;
+}
+
 /* Initialize.
  */
  
@@ -347,24 +457,17 @@ static int _fm_init(struct synth_channel *channel,const uint8_t *src,int srcc) {
     }
   }
   
+  CHANNEL->scratch_frames=synth.buffer_frames;
+  if (!(CHANNEL->scratch=synth_malloc(sizeof(float)*CHANNEL->scratch_frames*FM_SCRATCH_COUNT))) return -1;
+  
+  // Voices live as long as the level envelope, or the note plus its release, whichever is longer. Count generously.
+  CHANNEL->voicea=synth_channel_count_voices(channel,synth_env_get_duration(&CHANNEL->levelenv));
+  if (!(CHANNEL->voicev=synth_calloc(CHANNEL->voicea,sizeof(struct synth_voice_fm)))) return -1;
+  
   CHANNEL->wheelbend=1.0f;
   CHANNEL->longdurframes=SYNTH_DEFAULT_HOLD_TIME_S*synth.rate;
   
-  /* Select the lightest update regime that performs all the operations we're configured for.
-   */
-  // Only "full" does LFOs and absolute modulator rates. Those are all kind of unusual, so we don't bother splitting them out with more specific optimization.
-  if (CHANNEL->rangelfo||CHANNEL->mixlfo||CHANNEL->modabs) channel->update_mono=_fm_update_mono_full;
-  // If we have a pitch envelope, we need "nolfo".
-  else if (CHANNEL->pitchenv.flags&SYNTH_ENV_PRESENT) channel->update_mono=_fm_update_mono_nolfo;
-  // If the wave mixer is defaulted, we can use "fmonly" or "waveaonly".
-  else if (!(CHANNEL->mixenv.flags&SYNTH_ENV_PRESENT)) {
-    if ((CHANNEL->modrate>0.0f)&&(CHANNEL->modrange>0.0f)) channel->update_mono=_fm_update_mono_fmonly;
-    else channel->update_mono=_fm_update_mono_waveaonly;
-  }
-  // If FM rate or range is zero, we can use "waveonly".
-  else if ((CHANNEL->modrate<=0.0f)&&(CHANNEL->modrange<=0.0f)) channel->update_mono=_fm_update_mono_waveonly;
-  // No LFO, absmod, or pitchenv: We can use "nobend".
-  else channel->update_mono=_fm_update_mono_nobend;
+  _fm_select_update(channel);
   
   return 0;
 }
@@ -404,31 +507,30 @@ static void _fm_wheel_changed(struct synth_channel *channel) {
 static void _fm_note_once(struct synth_channel *channel,uint8_t noteid,float velocity,int durframes) {
   if (noteid&0x80) return;
   
-  // Find a voice. If we're at the limit and nothing is available, discard the event.
+  // Find a voice. If they're all busy, steal one.
   struct synth_voice_fm *voice=0;
-  if (CHANNEL->voicec<CHANNEL->voicea) {
+  if (CHANNEL->voicec<synth_channel_voice_limit(channel,CHANNEL->voicea)) {
     voice=CHANNEL->voicev+CHANNEL->voicec++;
   } else {
     struct synth_voice_fm *q=CHANNEL->voicev;
+    float bestscore=0.0f;
     int i=CHANNEL->voicec;
     for (;i-->0;q++) {
       if (q->levelenv.finished) {
         voice=q;
         break;
       }
+      float score=synth_channel_steal_score(channel,noteid,q->noteid,CHANNEL->seq_next-q->seq,q->levelenv.v);
+      if (!voice||(score<bestscore)) {
+        voice=q;
+        bestscore=score;
+      }
     }
-    if (!voice) {
-      if (CHANNEL->voicea>=FM_VOICE_LIMIT) return;
-      int na=CHANNEL->voicea+8;
-      void *nv=synth_realloc(CHANNEL->voicev,sizeof(struct synth_voice_fm)*na);
-      if (!nv) return;
-      CHANNEL->voicev=nv;
-      CHANNEL->voicea=na;
-      voice=CHANNEL->voicev+CHANNEL->voicec++;
-    }
+    if (!voice) return;
   }
   
   voice->noteid=noteid;
+  voice->seq=CHANNEL->seq_next++;
   voice->carp=0;
   voice->carpredp=synth.iratev[noteid];
   voice->cardp=(int32_t)((float)voice->carpredp*CHANNEL->wheelbend);
@@ -459,6 +561,22 @@ static void _fm_note_off(struct synth_channel *channel,uint8_t noteid) {
   }
 }
 
+/* Idle and skip.
+ */
+ 
+static int _fm_is_idle(struct synth_channel *channel) {
+  return !CHANNEL->voicec;
+}
+
+static int _fm_get_voicec(struct synth_channel *channel) {
+  return CHANNEL->voicec;
+}
+
+static void _fm_skip(struct synth_channel *channel,int framec) {
+  CHANNEL->rangelfop+=CHANNEL->rangelfodp*(uint32_t)framec;
+  CHANNEL->mixlfop+=CHANNEL->mixlfodp*(uint32_t)framec;
+}
+
 /* Type definition.
  */
  
@@ -472,4 +590,8 @@ const struct synth_channel_type synth_channel_type_fm={
   .note_once=_fm_note_once,
   .note_on=_fm_note_on,
   .note_off=_fm_note_off,
+  .is_idle=_fm_is_idle,
+  .get_voicec=_fm_get_voicec,
+  .skip=_fm_skip,
+  .quality_changed=_fm_select_update,
 };
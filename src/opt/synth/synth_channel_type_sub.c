@@ -6,9 +6,6 @@
  
 #include "synth_internal.h"
 
-// We'll artificially refuse to create more than so many voices.
-#define SUB_VOICE_LIMIT 32
-
 #define SUB_STAGE_LIMIT 10
 
 struct synth_voice_sub {
@@ -20,9 +17,10 @@ struct synth_voice_sub {
 
 struct synth_channel_sub {
   struct synth_channel hdr;
-  struct synth_voice_sub *voicev;
+  struct synth_voice_sub *voicev; // Allocated at init and never resized.
   int voicec,voicea;
   float *noise; // synth.buffer_limit. Generated at the start of each update and shared across voices.
+  float *levelv; // synth.buffer_limit. Scratch for each voice's level envelope.
   struct synth_env levelenv;
   int stagec; // 0..SUB_STAGE_LIMIT
   float widthlo,widthhi; // Normalized.
@@ -40,20 +38,22 @@ struct synth_channel_sub {
 static void _sub_del(struct synth_channel *channel) {
   if (CHANNEL->voicev) synth_free(CHANNEL->voicev);
   if (CHANNEL->noise) synth_free(CHANNEL->noise);
+  if (CHANNEL->levelv) synth_free(CHANNEL->levelv);
 }
 
 /* Update.
  */
  
 static void synth_voice_sub_update(float *dst,struct synth_voice_sub *voice,struct synth_channel *channel,int framec) {
-  const float *src=CHANNEL->noise;
-  for (;framec-->0;dst++,src++) {
+  synth_env_fill(CHANNEL->levelv,&voice->levelenv,framec);
+  const float *src=CHANNEL->noise,*level=CHANNEL->levelv;
+  for (;framec-->0;dst++,src++,level++) {
     float sample=*src;
     struct synth_iir3 *iir3=voice->iir3v;
     int i=CHANNEL->stagec;
     for (;i-->0;iir3++) sample=synth_iir3_update(iir3,sample);
     sample*=CHANNEL->gain;
-    sample*=synth_env_update(voice->levelenv);
+    sample*=*level;
     (*dst)+=sample;
   }
 }
@@ -88,10 +88,14 @@ static int _sub_init(struct synth_channel *channel,const uint8_t *src,int srcc)
   if (CHANNEL->widthlo<0.000001f) CHANNEL->widthlo=0.000001f; else if (CHANNEL->widthlo>0.499f) CHANNEL->widthlo=0.499f;
   if (CHANNEL->widthhi<0.000001f) CHANNEL->widthhi=0.000001f; else if (CHANNEL->widthhi>0.499f) CHANNEL->widthhi=0.499f;
   
-  // Allocate noise buffer.
+  // Allocate noise and envelope buffers.
   if (!(CHANNEL->noise=synth_malloc(sizeof(float)*synth.buffer_frames))) return -1;
+  if (!(CHANNEL->levelv=synth_malloc(sizeof(float)*synth.buffer_frames))) return -1;
   CHANNEL->randstate=0xaaaaaaaa;
   
+  CHANNEL->voicea=synth_channel_count_voices(channel,synth_env_get_duration(&CHANNEL->levelenv));
+  if (!(CHANNEL->voicev=synth_calloc(CHANNEL->voicea,sizeof(struct synth_voice_sub)))) return -1;
+  
   CHANNEL->longdurframes=SYNTH_DEFAULT_HOLD_TIME_S*synth.rate;
   
   channel->update_mono=_sub_update_mono;
@@ -118,31 +122,27 @@ static void _sub_note_once(struct synth_channel *channel,uint8_t noteid,float ve
   if (noteid&0x80) return;
   
   struct synth_voice_sub *voice=0;
-  if (CHANNEL->voicec<CHANNEL->voicea) {
+  if (CHANNEL->voicec<synth_channel_voice_limit(channel,CHANNEL->voicea)) {
     voice=CHANNEL->voicev+CHANNEL->voicec++;
   } else {
     struct synth_voice_sub *q=CHANNEL->voicev;
+    float bestscore=0.0f;
     int i=CHANNEL->voicec;
     for (;i-->0;q++) {
       if (q->levelenv.finished) {
         voice=q;
         break;
       }
+      float score=synth_channel_steal_score(channel,noteid,q->noteid,CHANNEL->seq_next-q->seq,q->levelenv.v);
+      if (!voice||(score<bestscore)) {
+        voice=q;
+        bestscore=score;
+      }
     }
-    if (!voice) {
-      if (CHANNEL->voicea>=SUB_VOICE_LIMIT) return;
-      int na=CHANNEL->voicea+8;
-      if (na>INT_MAX/sizeof(struct synth_voice_sub)) return;
-      void *nv=synth_realloc(CHANNEL->voicev,sizeof(struct synth_voice_sub)*na);
-      if (!nv) return;
-      CHANNEL->voicev=nv;
-      CHANNEL->voicea=na;
-      voice=CHANNEL->voicev+CHANNEL->voicec++;
-    }
+    if (!voice) return;
   }
   
   voice->noteid=noteid;
-  if (CHANNEL->seq_next<1) CHANNEL->seq_next=1;
   voice->seq=CHANNEL->seq_next++;
   synth_env_apply(&voice->levelenv,&CHANNEL->levelenv,velocity,durframes);
   
@@ -173,6 +173,17 @@ static void _sub_note_off(struct synth_channel *channel,uint8_t noteid) {
   }
 }
 
+/* Idle.
+ */
+ 
+static int _sub_is_idle(struct synth_channel *channel) {
+  return !CHANNEL->voicec;
+}
+
+static int _sub_get_voicec(struct synth_channel *channel) {
+  return CHANNEL->voicec;
+}
+
 /* Type definition.
  */
  
@@ -185,4 +196,6 @@ const struct synth_channel_type synth_channel_type_sub={
   .note_once=_sub_note_once,
   .note_on=_sub_note_on,
   .note_off=_sub_note_off,
+  .is_idle=_sub_is_idle,
+  .get_voicec=_sub_get_voicec,
 };
@@ -5,9 +5,6 @@
  
 #include "synth_internal.h"
 
-// We'll artificially refuse to create more than so many voices.
-#define TRIVIAL_VOICE_LIMIT 32
-
 struct synth_voice_trivial {
   uint8_t noteid; // 0xff if unaddressable. Not necessarily unique.
   uint32_t p;
@@ -17,12 +14,14 @@ struct synth_voice_trivial {
   int ttl0; // TTL at start, so we can validate holdtime on manual releases.
   float level;
   float dlevel; // Per frame during release; always negative.
+  int seq;
 };
 
 struct synth_channel_trivial {
   struct synth_channel hdr;
-  struct synth_voice_trivial *voicev;
+  struct synth_voice_trivial *voicev; // Allocated at init and never resized.
   int voicec,voicea;
+  int seq_next;
   int wheelrange; // cents
   float minlevel,maxlevel;
   int holdtime,releasetime; // frames, >0
@@ -43,18 +42,31 @@ static void _trivial_del(struct synth_channel *channel) {
  */
  
 static void synth_voice_trivial_update(float *dst,struct synth_voice_trivial *voice,struct synth_channel *channel,int framec) {
-  for (;framec-->0;dst++) {
+
+  // Hold: Constant level until (ttl) reaches (releasetime).
+  int holdc=voice->ttl-CHANNEL->releasetime;
+  if (holdc>0) {
+    if (holdc>framec) holdc=framec;
+    voice->ttl-=holdc;
+    framec-=holdc;
+    uint32_t p=voice->p,dp=voice->dp;
+    float level=voice->level;
+    for (;holdc-->0;dst++) {
+      p+=dp;
+      if (p&0x80000000) (*dst)+=level;
+      else (*dst)-=level;
+    }
+    voice->p=p;
+  }
   
-    // TTL and fadeout.
+  // Release: Linear ramp until (ttl) or (level) runs out.
+  for (;framec-->0;dst++) {
     if (voice->ttl<=0) break;
     voice->ttl--;
-    if (voice->ttl<CHANNEL->releasetime) {
-      if ((voice->level+=voice->dlevel)<=0.0f) {
-        voice->ttl=0;
-        break;
-      }
+    if ((voice->level+=voice->dlevel)<=0.0f) {
+      voice->ttl=0;
+      break;
     }
-    
     voice->p+=voice->dp;
     if (voice->p&0x80000000) {
       (*dst)+=voice->level;
@@ -105,6 +117,9 @@ static int _trivial_init(struct synth_channel *channel,const uint8_t *src,int sr
   CHANNEL->wheelbend=1.0f;
   CHANNEL->longdurframes=SYNTH_DEFAULT_HOLD_TIME_S*synth.rate;
   
+  CHANNEL->voicea=synth_channel_count_voices(channel,CHANNEL->holdtime+CHANNEL->releasetime);
+  if (!(CHANNEL->voicev=synth_calloc(CHANNEL->voicea,sizeof(struct synth_voice_trivial)))) return -1;
+  
   channel->update_mono=_trivial_update_mono;
   
   return 0;
@@ -155,32 +170,31 @@ static void _trivial_note_once(struct synth_channel *channel,uint8_t noteid,floa
   if (durframes<1) return;
 
   /* Find an available voice.
-   * Do not evict living voices.
-   * If we don't have a free one, and can't allocate more, discard the event.
+   * Prefer defunct ones. If they're all living, steal one per the channel's policy.
    */
   struct synth_voice_trivial *voice=0;
-  if (CHANNEL->voicec<CHANNEL->voicea) {
+  if (CHANNEL->voicec<synth_channel_voice_limit(channel,CHANNEL->voicea)) {
     voice=CHANNEL->voicev+CHANNEL->voicec++;
   } else {
     struct synth_voice_trivial *q=CHANNEL->voicev;
+    float bestscore=0.0f;
     int i=CHANNEL->voicec;
     for (;i-->0;q++) {
-      if (q->ttl>0) continue;
-      voice=q;
-      break;
-    }
-    if (!voice) {
-      if (CHANNEL->voicea>=TRIVIAL_VOICE_LIMIT) return; // Too many voices.
-      int na=CHANNEL->voicea+8;
-      void *nv=synth_realloc(CHANNEL->voicev,sizeof(struct synth_voice_trivial)*na);
-      if (!nv) return;
-      CHANNEL->voicev=nv;
-      CHANNEL->voicea=na;
-      voice=CHANNEL->voicev+CHANNEL->voicec++;
+      if (q->ttl<=0) {
+        voice=q;
+        break;
+      }
+      float score=synth_channel_steal_score(channel,noteid,q->noteid,CHANNEL->seq_next-q->seq,q->level);
+      if (!voice||(score<bestscore)) {
+        voice=q;
+        bestscore=score;
+      }
     }
+    if (!voice) return;
   }
   
   // Initialize voice.
+  voice->seq=CHANNEL->seq_next++;
   voice->p=0;
   voice->noteid=noteid;
   voice->predp=synth.iratev[noteid];
@@ -210,6 +224,17 @@ static void _trivial_note_off(struct synth_channel *channel,uint8_t noteid) {
   }
 }
 
+/* Idle.
+ */
+ 
+static int _trivial_is_idle(struct synth_channel *channel) {
+  return !CHANNEL->voicec;
+}
+
+static int _trivial_get_voicec(struct synth_channel *channel) {
+  return CHANNEL->voicec;
+}
+
 /* Type definition.
  */
  
@@ -223,4 +248,6 @@ const struct synth_channel_type synth_channel_type_trivial={
   .note_once=_trivial_note_once,
   .note_on=_trivial_note_on,
   .note_off=_trivial_note_off,
+  .is_idle=_trivial_is_idle,
+  .get_voicec=_trivial_get_voicec,
 };
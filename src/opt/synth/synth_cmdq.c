@@ -0,0 +1,215 @@
+/* synth_cmdq.c
+ * Optional lock-free command queue, for a producer on some thread other than synth_update()'s.
+ * Single producer, single consumer. The producer only writes (cmdhead) and the consumer only writes (cmdtail).
+ * synth_update() drains it before doing anything else, so commands land at the start of the next buffer.
+ * The drain runs on the audio thread, so it must not allocate.
+ * Sounds print and songs decode on the producer's side, and the command carries the finished object.
+ * Songs started while the queue exists get their whole schedule up front, so queued synth_event_at() doesn't grow it.
+ * Only the song and sound lists can still grow during a drain, and we reserve enough that they normally don't.
+ */
+
+#include "synth_internal.h"
+
+#define SYNTH_CMDQ_LIMIT 0x10000
+#define SYNTH_CMDQ_SONG_RESERVE 16
+#define SYNTH_CMDQ_SOUND_RESERVE 64
+
+// Producer-side allocation needs a thread-safe heap.
+#if USE_native && USE_FAKE_MALLOC
+  #define SYNTH_CMDQ_CAN_PREPARE 0
+#else
+  #define SYNTH_CMDQ_CAN_PREPARE 1
+#endif
+
+#define SYNTH_CMD_SET        1
+#define SYNTH_CMD_NOTE_OFF   2
+#define SYNTH_CMD_NOTE_ON    3
+#define SYNTH_CMD_NOTE_ONCE  4
+#define SYNTH_CMD_PLAY_SOUND 5
+#define SYNTH_CMD_PLAY_SONG  6
+#define SYNTH_CMD_EVENT_AT   7
+
+struct synth_cmd {
+  uint8_t opcode;
+  uint8_t chid,noteid,velocity;
+  int songid;
+  int n; // SET: prop, NOTE_ONCE and EVENT_AT: durms
+  float v; // SET: value, PLAY_SOUND: trim
+  float pan; // PLAY_SOUND only.
+  uint8_t event; // EVENT_AT only. SYNTH_EVENT_*
+  int timebase; // EVENT_AT only. SYNTH_TIME_*
+  double when; // EVENT_AT only.
+  void *obj; // PLAY_SOUND: WEAK (struct synth_pcm*), its resource holds it. PLAY_SONG: STRONG (struct synth_song*) or null.
+};
+
+/* Grow the song and sound lists, if they're smaller than we'd like.
+ */
+ 
+static int synth_cmdq_reserve() {
+  if (synth.songa<SYNTH_CMDQ_SONG_RESERVE) {
+    void *nv=synth_realloc(synth.songv,sizeof(void*)*SYNTH_CMDQ_SONG_RESERVE);
+    if (!nv) return -1;
+    synth.songv=nv;
+    synth.songa=SYNTH_CMDQ_SONG_RESERVE;
+  }
+  if (synth.pcmplaya<SYNTH_CMDQ_SOUND_RESERVE) {
+    void *nv=synth_realloc(synth.pcmplayv,sizeof(struct synth_pcmplay)*SYNTH_CMDQ_SOUND_RESERVE);
+    if (!nv) return -1;
+    synth.pcmplayv=nv;
+    synth.pcmplaya=SYNTH_CMDQ_SOUND_RESERVE;
+  }
+  return 0;
+}
+
+/* Resize, public entry point.
+ */
+
+int synth_set_queue_depth(int depth) {
+  if (synth.framec_in_progress) return -1;
+  if (!synth.rate) return -1;
+  if (depth<=0) {
+    synth_cmdq_drain();
+    if (synth.cmdv) synth_free(synth.cmdv);
+    synth.cmdv=0;
+    synth.cmdmask=0;
+    return 0;
+  }
+  if (depth>SYNTH_CMDQ_LIMIT) return -1;
+  if (synth_cmdq_reserve()<0) return -1;
+  int na=2; // One slot is always empty, so two is the minimum useful size.
+  while (na<depth) na<<=1;
+  void *nv=synth_calloc(na,sizeof(struct synth_cmd));
+  if (!nv) return -1;
+  synth_cmdq_drain();
+  if (synth.cmdv) synth_free(synth.cmdv);
+  synth.cmdv=nv;
+  synth.cmdmask=na-1;
+  synth.cmdhead=0;
+  synth.cmdtail=0;
+  return na;
+}
+
+int synth_get_queue_overflow() {
+  return __atomic_load_n(&synth.cmd_overflowc,__ATOMIC_RELAXED);
+}
+
+/* Push one command. Producer side.
+ */
+
+static int synth_cmdq_push(const struct synth_cmd *cmd) {
+  if (!synth.cmdv) return -1;
+  int head=synth.cmdhead; // Only we write it.
+  int next=(head+1)&synth.cmdmask;
+  if (next==__atomic_load_n(&synth.cmdtail,__ATOMIC_ACQUIRE)) {
+    __atomic_fetch_add(&synth.cmd_overflowc,1,__ATOMIC_RELAXED);
+    return -1;
+  }
+  synth.cmdv[head]=*cmd;
+  __atomic_store_n(&synth.cmdhead,next,__ATOMIC_RELEASE);
+  return 0;
+}
+
+/* Drain. Consumer side.
+ */
+
+void synth_cmdq_drain() {
+  if (!synth.cmdv) return;
+  int tail=synth.cmdtail; // Only we write it.
+  int head=__atomic_load_n(&synth.cmdhead,__ATOMIC_ACQUIRE);
+  while (tail!=head) {
+    const struct synth_cmd *cmd=synth.cmdv+tail;
+    switch (cmd->opcode) {
+      case SYNTH_CMD_SET: synth_set(cmd->songid,cmd->chid,cmd->n,cmd->v); break;
+      case SYNTH_CMD_NOTE_OFF: synth_event_note_off(cmd->songid,cmd->chid,cmd->noteid,cmd->velocity); break;
+      case SYNTH_CMD_NOTE_ON: synth_event_note_on(cmd->songid,cmd->chid,cmd->noteid,cmd->velocity); break;
+      case SYNTH_CMD_NOTE_ONCE: synth_event_note_once(cmd->songid,cmd->chid,cmd->noteid,cmd->velocity,cmd->n); break;
+      case SYNTH_CMD_PLAY_SOUND: synth_sound_start(cmd->obj,cmd->v,cmd->pan); break;
+      case SYNTH_CMD_PLAY_SONG: synth_song_start(cmd->obj,cmd->songid); break;
+      case SYNTH_CMD_EVENT_AT: synth_event_at(cmd->songid,cmd->chid,cmd->event,cmd->noteid,cmd->velocity,cmd->n,cmd->timebase,cmd->when); break;
+    }
+    tail=(tail+1)&synth.cmdmask;
+  }
+  __atomic_store_n(&synth.cmdtail,tail,__ATOMIC_RELEASE);
+}
+
+/* Flush, public entry point.
+ * The caller holds the lock that keeps synth_update() out, so we're the only consumer for now.
+ */
+
+void synth_flush_queue() {
+  if (synth.framec_in_progress) return;
+  synth_cmdq_drain();
+}
+
+/* Queued commands, public entry points.
+ */
+
+int synth_queue_set(int songid,int chid,int prop,float v) {
+  if (prop==SYNTH_PROP_PLAYHEAD) return -1; // Seeking may build the seek index.
+  if ((chid<0)||(chid>0xff)) chid=0xff; // Anything else addresses the song; 0xff does too.
+  struct synth_cmd cmd={.opcode=SYNTH_CMD_SET,.songid=songid,.chid=chid,.n=prop,.v=v};
+  return synth_cmdq_push(&cmd);
+}
+
+int synth_queue_note_off(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity) {
+  struct synth_cmd cmd={.opcode=SYNTH_CMD_NOTE_OFF,.songid=songid,.chid=chid,.noteid=noteid,.velocity=velocity};
+  return synth_cmdq_push(&cmd);
+}
+
+int synth_queue_note_on(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity) {
+  struct synth_cmd cmd={.opcode=SYNTH_CMD_NOTE_ON,.songid=songid,.chid=chid,.noteid=noteid,.velocity=velocity};
+  return synth_cmdq_push(&cmd);
+}
+
+int synth_queue_note_once(int songid,uint8_t chid,uint8_t noteid,uint8_t velocity,int durms) {
+  struct synth_cmd cmd={.opcode=SYNTH_CMD_NOTE_ONCE,.songid=songid,.chid=chid,.noteid=noteid,.velocity=velocity,.n=durms};
+  return synth_cmdq_push(&cmd);
+}
+
+/* Queued sounds and songs, public entry points.
+ * These do the printing or decoding right here, on the producer's thread.
+ * Native builds with our own allocator can't, so they fail and the caller should use the lock instead.
+ */
+
+int synth_queue_play_sound(int rid,float trim,float pan) {
+  if (!SYNTH_CMDQ_CAN_PREPARE) return -1;
+  if (!synth.cmdv) return -1;
+  // Print completely, now. Installing a printer would hand the work to the audio thread.
+  synth_print_immediate++;
+  struct synth_pcm *pcm=synth_sound_prepare(rid);
+  synth_print_immediate--;
+  if (!pcm) return 0;
+  struct synth_cmd cmd={.opcode=SYNTH_CMD_PLAY_SOUND,.v=trim,.pan=pan,.obj=pcm};
+  return synth_cmdq_push(&cmd);
+}
+
+int synth_queue_play_song(int songid,int rid,int repeat,float trim,float pan) {
+  if (!SYNTH_CMDQ_CAN_PREPARE) return -1;
+  if (!synth.cmdv) return -1;
+  if (songid<=0) return -1;
+  // If it fails, queue it anyway with no song, so the old one still stops.
+  struct synth_song *song=0;
+  synth_song_prepare(&song,songid,rid,repeat,trim,pan);
+  struct synth_cmd cmd={.opcode=SYNTH_CMD_PLAY_SONG,.songid=songid,.obj=song};
+  if (synth_cmdq_push(&cmd)<0) {
+    synth_song_del(song);
+    return -1;
+  }
+  return 0;
+}
+
+int synth_queue_event_at(int songid,uint8_t chid,int event,uint8_t noteid,uint8_t velocity,int durms,int timebase,double when) {
+  if ((timebase!=SYNTH_TIME_PLAYHEAD)&&(timebase!=SYNTH_TIME_CLOCK)) return -1;
+  struct synth_cmd cmd={
+    .opcode=SYNTH_CMD_EVENT_AT,
+    .songid=songid,
+    .chid=chid,
+    .noteid=noteid,
+    .velocity=velocity,
+    .n=durms,
+    .event=event,
+    .timebase=timebase,
+    .when=when,
+  };
+  return synth_cmdq_push(&cmd);
+}
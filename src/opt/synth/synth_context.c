@@ -0,0 +1,96 @@
+/* synth_context.c
+ * The default context, and optional extra ones for native builds.
+ * Everything else works on (synth), which is the calling thread's current context.
+ * Worker threads belonging to a context adopt it when they start.
+ */
+
+#include "synth_internal.h"
+
+struct synth_context synth_default={0};
+
+#if SYNTH_CONTEXTS_AVAILABLE
+
+SYNTH_THREAD_LOCAL struct synth_context *synth_current=&synth_default;
+
+/* Delete.
+ */
+
+void synth_context_del(struct synth_context *context) {
+  if (!context||(context==&synth_default)) return;
+  struct synth_context *prev=synth_current;
+  synth_current=context;
+  synth_quit();
+  synth_current=(prev==context)?&synth_default:prev;
+  synth_free(context);
+}
+
+/* New.
+ */
+
+struct synth_context *synth_context_new(int rate,int chanc,int buffer_frames) {
+  struct synth_context *context=synth_calloc(1,sizeof(struct synth_context));
+  if (!context) return 0;
+  struct synth_context *prev=synth_current;
+  synth_current=context;
+  int err=synth_init(rate,chanc,buffer_frames);
+  synth_current=prev;
+  if (err<0) {
+    synth_free(context);
+    return 0;
+  }
+  return context;
+}
+
+/* Switch.
+ */
+
+struct synth_context *synth_context_use(struct synth_context *context) {
+  struct synth_context *prev=synth_current;
+  synth_current=context?context:&synth_default;
+  return (prev==&synth_default)?0:prev;
+}
+
+/* Update and buffers, explicitly.
+ */
+
+void synth_context_update(struct synth_context *context,int framec) {
+  if (!context) context=&synth_default;
+  struct synth_context *prev=synth_current;
+  synth_current=context;
+  synth_update(framec);
+  synth_current=prev;
+}
+
+float *synth_context_get_buffer(struct synth_context *context,int chan) {
+  if (!context) context=&synth_default;
+  struct synth_context *prev=synth_current;
+  synth_current=context;
+  float *buf=synth_get_buffer(chan);
+  synth_current=prev;
+  return buf;
+}
+
+#else
+
+void synth_context_del(struct synth_context *context) {
+}
+
+struct synth_context *synth_context_new(int rate,int chanc,int buffer_frames) {
+  return 0;
+}
+
+struct synth_context *synth_context_use(struct synth_context *context) {
+  return 0;
+}
+
+void synth_context_update(struct synth_context *context,int framec) {
+  if (context&&(context!=&synth_default)) return;
+  synth_update(framec);
+}
+
+float *synth_context_get_buffer(struct synth_context *context,int chan) {
+  if (context&&(context!=&synth_default)) return 0;
+  return synth_get_buffer(chan);
+}
+
+#endif
@@ -184,6 +184,20 @@ void synth_env_apply(struct synth_env *runner,const struct synth_env *config,flo
   }
 }
 
+/* Duration of config.
+ */
+ 
+int synth_env_get_duration(const struct synth_env *config) {
+  int framec=0;
+  const struct synth_env_point *point=config->pointv;
+  int i=config->pointc;
+  for (;i-->0;point++) {
+    if (point->tlo>point->thi) framec+=point->tlo;
+    else framec+=point->thi;
+  }
+  return framec;
+}
+
 /* Release runner.
  */
 
@@ -214,3 +228,33 @@ void synth_env_advance(struct synth_env *env) {
     env->dv=(dst->vlo-env->v)/env->c;
   }
 }
+
+/* Fill a buffer from runner.
+ * On each frame, we emit the current value, then step it.
+ * At the end of a leg, emit the final value once more and advance to the next leg.
+ */
+ 
+void synth_env_fill(float *dst,struct synth_env *env,int framec) {
+  while (framec>0) {
+    if (env->c<=0) {
+      *(dst++)=env->v;
+      framec--;
+      synth_env_advance(env);
+      continue;
+    }
+    int updc=(env->c<framec)?env->c:framec;
+    env->c-=updc;
+    framec-=updc;
+    if (env->dv==0.0f) {
+      float v=env->v;
+      for (;updc-->0;dst++) *dst=v;
+    } else {
+      float v=env->v,dv=env->dv;
+      for (;updc-->0;dst++) {
+        *dst=v;
+        v+=dv;
+      }
+      env->v=v;
+    }
+  }
+}
@@ -1,25 +1,31 @@
 #include "synth_internal.h"
 
-struct synth synth={0};
-
 /* Cleanup rseource.
  */
  
 static void synth_res_cleanup(struct synth_res *res) {
   synth_pcm_del(res->pcm);
+  synth_seek_del(res->seek);
 }
 
 /* Quit.
  */
  
 void synth_quit() {
+  synth_cmdq_drain(); // Queued songs belong to the queue until then.
+  synth_preprint_del(synth.preprint);
+  synth_threads_del(synth.threads);
+  synth_resampler_del(synth.resampler);
   if (synth.bufl) synth_free(synth.bufl);
   if (synth.bufr) synth_free(synth.bufr);
+  if (synth.outl) synth_free(synth.outl);
+  if (synth.outr) synth_free(synth.outr);
   if (synth.rom) synth_free(synth.rom);
   if (synth.songv) {
     while (synth.songc-->0) synth_song_del(synth.songv[synth.songc]);
     synth_free(synth.songv);
   }
+  synth_profile_quit();
   if (synth.pcmplayv) {
     while (synth.pcmplayc-->0) synth_pcmplay_cleanup(synth.pcmplayv+synth.pcmplayc);
     synth_free(synth.pcmplayv);
@@ -34,7 +40,8 @@ void synth_quit() {
   }
   if (synth.wp_serial) synth_free(synth.wp_serial);
   if (synth.wp_pcm) synth_free(synth.wp_pcm);
-  __builtin_memset(&synth,0,sizeof(struct synth));
+  if (synth.cmdv) synth_free(synth.cmdv);
+  __builtin_memset(&synth,0,sizeof(struct synth_context));
 }
 
 /* Generate rate tables.
@@ -104,12 +111,77 @@ int synth_init(int rate,int chanc,int buffer_frames) {
   return 0;
 }
 
+/* Change internal rate.
+ * Everything rate-dependent that exists at this point is the rate tables and main buffers.
+ * That's why we insist on being called before the ROM and threads.
+ */
+ 
+int synth_set_internal_rate(int rate) {
+  if (!synth.rate) return -1;
+  if (synth.framec_in_progress) return -1;
+  if (synth.rom||synth.threads) return -1;
+  int outrate=synth.resampler?synth.outrate:synth.rate;
+  int outframes=synth.resampler?synth.outframes:synth.buffer_frames;
+  if ((rate<=0)||(rate>=outrate)) rate=outrate;
+  else if (rate<SYNTH_INTERNAL_RATE_MIN) return -1;
+  
+  struct synth_resampler *resampler=0;
+  float *bufl=0,*bufr=0,*outl=0,*outr=0;
+  int buffer_frames=outframes;
+  if (rate<outrate) {
+    if (!(resampler=synth_resampler_new(rate,outrate,synth.chanc,outframes))) return -1;
+    buffer_frames=synth_resampler_get_input_needed(resampler,outframes);
+    if (
+      !(bufl=synth_malloc(sizeof(float)*buffer_frames))||
+      ((synth.chanc>=2)&&!(bufr=synth_malloc(sizeof(float)*buffer_frames)))||
+      !(outl=synth_malloc(sizeof(float)*outframes))||
+      ((synth.chanc>=2)&&!(outr=synth_malloc(sizeof(float)*outframes)))
+    ) {
+      synth_resampler_del(resampler);
+      if (bufl) synth_free(bufl);
+      if (bufr) synth_free(bufr);
+      if (outl) synth_free(outl);
+      return -1;
+    }
+  } else {
+    // Back to direct output. Reuse the old output buffers as main.
+    if (!synth.resampler) return rate;
+    bufl=synth.outl; synth.outl=0;
+    bufr=synth.outr; synth.outr=0;
+  }
+  
+  synth_resampler_del(synth.resampler);
+  if (synth.bufl) synth_free(synth.bufl);
+  if (synth.bufr) synth_free(synth.bufr);
+  if (synth.outl) synth_free(synth.outl);
+  if (synth.outr) synth_free(synth.outr);
+  synth.resampler=resampler;
+  synth.bufl=bufl;
+  synth.bufr=bufr;
+  synth.outl=outl;
+  synth.outr=outr;
+  synth.outrate=outrate;
+  synth.outframes=outframes;
+  synth.rate=rate;
+  synth.buffer_frames=buffer_frames;
+  synth_generate_rate_tables();
+  return rate;
+}
+
+int synth_get_output_rate() {
+  return synth.resampler?synth.outrate:synth.rate;
+}
+
 /* Drop everything immediately, in preparation for replacing the ROM.
  * Keep rate tables, sine table, and buffers.
  */
  
 static void synth_drop_everything() {
   
+  synth_cmdq_drain(); // Queued sounds point into resources we're about to drop.
+  synth_preprint_del(synth.preprint);
+  synth.preprint=0;
+  
   while (synth.songc>0) {
     synth.songc--;
     synth_song_del(synth.songv[synth.songc]);
@@ -158,10 +230,15 @@ int synth_get_chanc() {
 }
 
 int synth_get_buffer_size_frames() {
+  if (synth.resampler) return synth.outframes;
   return synth.buffer_frames;
 }
 
 float *synth_get_buffer(int chan) {
+  if (synth.resampler) switch (chan) {
+    case 0: return synth.outl;
+    case 1: return synth.outr;
+  }
   switch (chan) {
     case 0: return synth.bufl;
     case 1: return synth.bufr;
@@ -169,59 +246,106 @@ float *synth_get_buffer(int chan) {
   return 0;
 }
 
-/* Update, public entry point.
+/* Update at the internal rate, into (bufl,bufr).
  */
  
-void synth_update(int framec) {
-  if (framec<1) return;
-  if (framec>synth.buffer_frames) return;
-  if (synth.framec_in_progress) return; // Reentry! Something is horribly amiss.
-  synth.framec_in_progress=framec;
-  __builtin_memset(synth.bufl,0,sizeof(float)*framec);
-  if (synth.bufr) __builtin_memset(synth.bufr,0,sizeof(float)*framec);
+static void synth_update_internal(struct synth_context *ctx,int framec) {
+  ctx->framec_in_progress=framec;
+  __builtin_memset(ctx->bufl,0,sizeof(float)*framec);
+  if (ctx->bufr) __builtin_memset(ctx->bufr,0,sizeof(float)*framec);
+  int64_t then=ctx->profiling?synth_profile_now():0;
   
   { // Printers.
-    int i=synth.printerc;
-    struct synth_printer **p=synth.printerv+i-1;
+    int i=ctx->printerc;
+    struct synth_printer **p=ctx->printerv+i-1;
     for (;i-->0;p--) {
       struct synth_printer *printer=*p;
       int err=synth_printer_update(printer,framec);
       if (err<=0) {
-        synth.printerc--;
-        __builtin_memmove(p,p+1,sizeof(void*)*(synth.printerc-i));
+        ctx->printerc--;
+        __builtin_memmove(p,p+1,sizeof(void*)*(ctx->printerc-i));
         synth_printer_del(printer);
       }
     }
   }
+  if (ctx->profiling) {
+    int64_t now=synth_profile_now();
+    ctx->profile.printer_ns+=now-then;
+    then=now;
+  }
   
-  { // Songs.
-    int i=synth.songc;
-    struct synth_song **p=synth.songv+i-1;
+  if (ctx->threads&&(synth_threads_update_songs(ctx->threads,framec)>=0)) {
+    // Threaded songs. All done.
+  } else { // Songs.
+    int i=ctx->songc;
+    struct synth_song **p=ctx->songv+i-1;
     for (;i-->0;p--) {
       struct synth_song *song=*p;
-      int err=synth_song_update(synth.bufl,synth.bufr,song,framec);
+      int err=synth_song_update(ctx->bufl,ctx->bufr,song,framec);
+      if (ctx->threads) { // Threads enabled but they failed. Channels are capturing, so mix them now.
+        float *dstr=((song->chanc>=2)&&ctx->bufr)?ctx->bufr:0;
+        struct synth_channel **chp=song->channelv;
+        int chi=song->channelc;
+        for (;chi-->0;chp++) synth_channel_mix_capture(ctx->bufl,dstr,*chp);
+      }
       if (err<=0) {
-        synth.songc--;
-        __builtin_memmove(p,p+1,sizeof(void*)*(synth.songc-i));
+        ctx->songc--;
+        __builtin_memmove(p,p+1,sizeof(void*)*(ctx->songc-i));
         synth_song_del(song);
       }
     }
   }
   
+  if (ctx->profiling) then=synth_profile_now();
   { // PCM players.
-    int i=synth.pcmplayc;
-    struct synth_pcmplay *pcmplay=synth.pcmplayv+i-1;
+    int i=ctx->pcmplayc;
+    struct synth_pcmplay *pcmplay=ctx->pcmplayv+i-1;
     for (;i-->0;pcmplay--) {
-      int err=synth_pcmplay_update(synth.bufl,synth.bufr,pcmplay,framec);
+      int err=synth_pcmplay_update(ctx->bufl,ctx->bufr,pcmplay,framec);
       if (err<=0) {
         synth_pcmplay_cleanup(pcmplay);
-        synth.pcmplayc--;
-        __builtin_memmove(pcmplay,pcmplay+1,sizeof(struct synth_pcmplay)*(synth.pcmplayc-i));
+        ctx->pcmplayc--;
+        __builtin_memmove(pcmplay,pcmplay+1,sizeof(struct synth_pcmplay)*(ctx->pcmplayc-i));
       }
     }
   }
+  if (ctx->profiling) ctx->profile.pcmplay_ns+=synth_profile_now()-then;
   
-  synth.framec_in_progress=0;
+  ctx->clock+=framec;
+  ctx->framec_in_progress=0;
+}
+
+/* Update, public entry point.
+ * When resampling, we usually render one internal run per update, but could be two when a chunk of history falls on the boundary.
+ */
+ 
+void synth_update(int framec) {
+  if (framec<1) return;
+  struct synth_context *ctx=&synth;
+  if (ctx->framec_in_progress) return; // Reentry! Something is horribly amiss.
+  int64_t then=(ctx->profiling||(ctx->quality_degrade>0.0f))?synth_profile_now():0;
+  if (ctx->resampler) {
+    if (framec>ctx->outframes) return;
+    if (ctx->cmdv) synth_cmdq_drain();
+    int needc=synth_resampler_get_input_needed(ctx->resampler,framec);
+    while (needc>0) {
+      int updc=(needc>ctx->buffer_frames)?ctx->buffer_frames:needc;
+      synth_update_internal(ctx,updc);
+      synth_resampler_input(ctx->resampler,ctx->bufl,ctx->bufr,updc);
+      needc-=updc;
+    }
+    synth_resampler_output(ctx->outl,ctx->outr,ctx->resampler,framec);
+  } else {
+    if (framec>ctx->buffer_frames) return;
+    if (ctx->cmdv) synth_cmdq_drain();
+    synth_update_internal(ctx,framec);
+  }
+  int64_t ns=then?(synth_profile_now()-then):0;
+  if (ctx->profiling) {
+    ctx->profile.update_ns+=ns;
+    ctx->profile.framec+=framec;
+  }
+  synth_quality_update(ns,framec);
 }
 
 /* ROM reader, with an extra quirk:
@@ -286,12 +410,27 @@ static int synth_rom_reader_next(struct synth_rom_entry *entry,struct synth_rom_
   }
 }
 
+/* Search resources, without building the TOC.
+ */
+ 
+static struct synth_res *synth_res_search(int rid) {
+  int lo=0,hi=synth.resc;
+  while (lo<hi) {
+    int ck=(lo+hi)>>1;
+    struct synth_res *q=synth.resv+ck;
+         if (rid<q->rid) hi=ck;
+    else if (rid>q->rid) lo=ck+1;
+    else return q;
+  }
+  return 0;
+}
+
 /* Get resource.
  * If we haven't yet, read the ROM TOC.
  * (rid) may have SYNTH_RID_SOUND set.
  */
  
-static struct synth_res *synth_res_get(int rid) {
+struct synth_res *synth_res_get(int rid) {
   
   // Build up TOC if we don't have it.
   if (synth.romc&&!synth.resc) {
@@ -302,7 +441,17 @@ static struct synth_res *synth_res_get(int rid) {
       struct synth_rom_entry entry;
       while (synth_rom_reader_next(&entry,&reader)>0) {
         if (entry.tid<EGG_TID_song) continue;
-        if (entry.tid>EGG_TID_sound) break;
+        if (entry.tid==EGG_TID_songpcm) {
+          // Songs come first in (resv), and they're sorted. Attach to one if it exists, otherwise ignore.
+          struct synth_res *res=synth_res_search(entry.rid);
+          if (res) {
+            res->songpcm=entry.v;
+            res->songpcmc=entry.c;
+          }
+          continue;
+        }
+        if (entry.tid>EGG_TID_songpcm) break;
+        if (entry.tid>EGG_TID_sound) continue;
         int rid=entry.rid;
         if (entry.tid==EGG_TID_sound) rid|=SYNTH_RID_SOUND;
         if (synth.resc>=synth.resa) {
@@ -322,30 +471,14 @@ static struct synth_res *synth_res_get(int rid) {
     }
   }
   
-  // Search resources.
-  int lo=0,hi=synth.resc;
-  while (lo<hi) {
-    int ck=(lo+hi)>>1;
-    struct synth_res *q=synth.resv+ck;
-         if (rid<q->rid) hi=ck;
-    else if (rid>q->rid) lo=ck+1;
-    else return q;
-  }
-  return 0;
+  return synth_res_search(rid);
 }
 
 /* Spawn a printer and return its output PCM (STRONG).
  */
  
 struct synth_pcm *synth_begin_print(const void *src,int srcc) {
-  if (synth.printerc>=synth.printera) {
-    int na=synth.printera+8;
-    if (na>INT_MAX/sizeof(void*)) return 0;
-    void *nv=synth_realloc(synth.printerv,sizeof(void*)*na);
-    if (!nv) return 0;
-    synth.printerv=nv;
-    synth.printera=na;
-  }
+  if (synth_print_immediate) return synth_print_now(src,srcc,0);
   struct synth_printer *printer=synth_printer_new(src,srcc);
   if (!printer) return 0;
   if (synth_pcm_ref(printer->pcm)<0) {
@@ -356,7 +489,23 @@ struct synth_pcm *synth_begin_print(const void *src,int srcc) {
     synth_printer_update(printer,synth.framec_in_progress);
     // If it fails or completes, whatever, leave it on the pile until the next update cleans it up.
   }
+  // We might be on a worker thread, if a drum started it. List order doesn't matter, printers are independent.
+  synth_threads_lock(synth.threads);
+  if (synth.printerc>=synth.printera) {
+    int na=synth.printera+8;
+    void *nv=0;
+    if (na<=INT_MAX/sizeof(void*)) nv=synth_realloc(synth.printerv,sizeof(void*)*na);
+    if (!nv) {
+      synth_threads_unlock(synth.threads);
+      synth_pcm_del(printer->pcm);
+      synth_printer_del(printer);
+      return 0;
+    }
+    synth.printerv=nv;
+    synth.printera=na;
+  }
   synth.printerv[synth.printerc++]=printer;
+  synth_threads_unlock(synth.threads);
   return printer->pcm;
 }
 
@@ -364,24 +513,24 @@ struct synth_pcm *synth_begin_print(const void *src,int srcc) {
  * Begins print if necessary.
  */
 
-void synth_play_sound(int rid,float trim,float pan) {
-  if (synth.framec_in_progress) return;
-  if ((rid<1)||(rid>0xffff)) return;
+struct synth_pcm *synth_sound_prepare(int rid) {
+  if ((rid<1)||(rid>0xffff)) return 0;
   struct synth_res *res=synth_res_get(SYNTH_RID_SOUND|rid);
-  if (!res) return;
-  float trim0=trim;
-  trim*=synth.sound_trim;
+  if (!res) return 0;
+  if (synth.preprint) synth_preprint_adopt();
   
   // Start printing if we need to.
   // If it fails to start, eg malformed data, try to create a single-sample pcm as a marker, so we don't try to decode again next time.
   if (!res->pcm) {
     if (!(res->pcm=synth_begin_print(res->serial,res->serialc))) {
-      if (!(res->pcm=synth_pcm_new(1))) return;
+      if (!(res->pcm=synth_pcm_new(1))) return 0;
     }
   }
-  if (res->pcm->c<=1) return; // Not worth playing.
-  
-  // Install a new pcmplay.
+  if (res->pcm->c<=1) return 0; // Not worth playing.
+  return res->pcm;
+}
+
+void synth_sound_start(struct synth_pcm *pcm,float trim,float pan) {
   if (synth.pcmplayc>=synth.pcmplaya) {
     int na=synth.pcmplaya+16;
     if (na>INT_MAX/sizeof(struct synth_pcmplay)) return;
@@ -391,57 +540,119 @@ void synth_play_sound(int rid,float trim,float pan) {
     synth.pcmplaya=na;
   }
   struct synth_pcmplay *pcmplay=synth.pcmplayv+synth.pcmplayc++;
-  if (synth_pcmplay_init(pcmplay,res->pcm,trim,pan)<0) {
+  if (synth_pcmplay_init(pcmplay,pcm,trim*synth.sound_trim,pan)<0) {
     synth.pcmplayc--;
     return;
   }
-  pcmplay->trim0=trim0;
+  pcmplay->trim0=trim;
   pcmplay->pan0=pan;
 }
 
+void synth_play_sound(int rid,float trim,float pan) {
+  if (synth.framec_in_progress) return;
+  struct synth_pcm *pcm=synth_sound_prepare(rid);
+  if (!pcm) return;
+  synth_sound_start(pcm,trim,pan);
+}
+
+/* Access to printed sounds, eg for a disk cache.
+ */
+ 
+int synth_set_sound_pcm(int rid,const float *v,int c) {
+  if (synth.framec_in_progress) return -1;
+  if ((rid<1)||(rid>0xffff)) return -1;
+  struct synth_res *res=synth_res_get(SYNTH_RID_SOUND|rid);
+  if (!res) return -1;
+  if (res->pcm) return -1;
+  if (!(res->pcm=synth_pcm_new_borrowed(v,c))) return -1;
+  return 0;
+}
+
+const float *synth_get_sound_pcm(int *c,int rid) {
+  if ((rid<1)||(rid>0xffff)) return 0;
+  if (synth.preprint) synth_preprint_adopt();
+  struct synth_res *res=synth_res_get(SYNTH_RID_SOUND|rid);
+  if (!res||!res->pcm||(res->pcm->c<=1)) return 0;
+  struct synth_printer **p=synth.printerv;
+  int i=synth.printerc;
+  for (;i-->0;p++) {
+    if ((*p)->pcm==res->pcm) return 0; // Still printing.
+  }
+  *c=res->pcm->c;
+  return res->pcm->v;
+}
+
 /* Begin song.
  */
 
-int synth_play_song(int songid,int rid,int repeat,float trim,float pan) {
-  if (synth.framec_in_progress) return -1;
-  if (songid<=0) return -1;
-  float trim0=trim;
-  trim*=synth.music_trim;
+int synth_song_prepare(struct synth_song **dst,int songid,int rid,int repeat,float trim,float pan) {
+  *dst=0;
   
+  // Find the resource. Not found is a zero, not a hard error.
+  if ((rid<1)||(rid>0xffff)) return 0;
+  struct synth_res *res=synth_res_get(rid);
+  if (!res) return 0;
+  
+  // Prefer the prerendered PCM if there is one. If it's no good, synthesize as usual.
+  struct synth_song *song=0;
+  if (res->songpcm) song=synth_song_new_prerendered(synth.chanc,res->serial,res->serialc,res->songpcm,res->songpcmc,trim,pan,repeat);
+  if (!song&&!(song=synth_song_new(synth.chanc,res->serial,res->serialc,rid,trim,pan))) return -1;
+  if (synth.threads&&(synth_song_require_capture(song)<0)) {
+    synth_song_del(song);
+    return -1;
+  }
+  // With a queue, synth_event_at() may run on the audio thread, and it mustn't allocate there.
+  if (synth.cmdv&&(synth_song_reserve_schedule(song)<0)) {
+    synth_song_del(song);
+    return -1;
+  }
+  song->songid=songid;
+  song->repeat=repeat;
+  song->rid=rid;
+  song->trim0=trim;
+  *dst=song;
+  return 1;
+}
+
+int synth_song_start(struct synth_song *song,int songid) {
+
   // Stop any song already using this songid.
   struct synth_song **p=synth.songv;
   int i=synth.songc;
   for (;i-->0;p++) {
-    struct synth_song *song=*p;
-    if (song->songid==songid) {
-      synth_song_stop(song);
+    struct synth_song *other=*p;
+    if (other->songid==songid) {
+      synth_song_stop(other);
     }
   }
-  
-  // Find the resource. Not found is a zero, not a hard error.
-  if ((rid<1)||(rid>0xffff)) rid=0;
-  struct synth_res *res=synth_res_get(rid);
-  if (!res) return 0;
+  if (!song) return 0;
   
   if (synth.songc>=synth.songa) {
     int na=synth.songa+4;
-    if (na>INT_MAX/sizeof(void*)) return -1;
-    void *nv=synth_realloc(synth.songv,sizeof(void*)*na);
-    if (!nv) return -1;
+    void *nv=0;
+    if (na<=INT_MAX/sizeof(void*)) nv=synth_realloc(synth.songv,sizeof(void*)*na);
+    if (!nv) {
+      synth_song_del(song);
+      return -1;
+    }
     synth.songv=nv;
     synth.songa=na;
   }
-  struct synth_song *song=synth_song_new(synth.chanc,res->serial,res->serialc,trim,pan);
-  if (!song) return -1;
-  song->songid=songid;
-  song->repeat=repeat;
-  song->rid=rid;
+  if (synth.music_trim<1.0f) synth_song_set_trim(song,song->trim0*synth.music_trim);
   synth.songv[synth.songc++]=song;
-  song->trim0=trim0;
-
   return song->songid;
 }
 
+int synth_play_song(int songid,int rid,int repeat,float trim,float pan) {
+  if (synth.framec_in_progress) return -1;
+  if (songid<=0) return -1;
+  struct synth_song *song=0;
+  int err=synth_song_prepare(&song,songid,rid,repeat,trim,pan);
+  int result=synth_song_start(song,songid); // Even if it failed; the old song stops regardless.
+  if (err<0) return -1;
+  return result;
+}
+
 /* Stop all songs.
  */
 
@@ -449,7 +660,7 @@ void synth_stop_all_songs() {
   if (synth.framec_in_progress) return;
   int i=synth.songc;
   while (i-->0) {
-    synth_song_stop(synth.songv[synth.songc]);
+    synth_song_stop(synth.songv[i]);
   }
 }
 
@@ -500,6 +711,20 @@ float synth_get(int songid,int chid,int prop) {
   return 0.0f;
 }
 
+/* Exact playhead, for offline renderers.
+ */
+ 
+int synth_get_song_frames(int songid,int *loopframe) {
+  struct synth_song *song=synth_song_by_songid(songid);
+  if (!song) return -1;
+  if (song->songpcm) {
+    if (loopframe) *loopframe=song->songpcm->loopframe-(song->songpcm->framec-song->songpcm->endframe);
+    return synth_songpcm_get_playhead(song->songpcm);
+  }
+  if (loopframe) *loopframe=song->loopframes;
+  return song->phframes;
+}
+
 /* Set enumerated property.
  */
  
@@ -593,6 +818,41 @@ void synth_event_note_once(int songid,uint8_t chid,uint8_t noteid,uint8_t veloci
   synth_channel_note_once(channel,noteid,velocity,durms);
 }
 
+int synth_event_at(int songid,uint8_t chid,int event,uint8_t noteid,uint8_t velocity,int durms,int timebase,double when) {
+  if (synth.framec_in_progress) return -1;
+  struct synth_song *song=synth_song_by_songid(songid);
+  if (!song) return -1;
+  double delay;
+  switch (timebase) {
+    case SYNTH_TIME_PLAYHEAD: delay=when*(double)synth.rate-(double)song->phframes; break;
+    case SYNTH_TIME_CLOCK: delay=when-(double)synth.clock; break;
+    default: return -1;
+  }
+  if (delay<=0.0) delay=0.0;
+  else if (delay>=(double)(INT_MAX-1)) return -1;
+  return synth_song_schedule(song,(int)(delay+0.5),event,chid,noteid,velocity,durms);
+}
+
+/* Voice stealing policy.
+ */
+ 
+void synth_set_voice_stealing(int policy) {
+  switch (policy) {
+    case SYNTH_STEAL_OLDEST:
+    case SYNTH_STEAL_QUIETEST:
+    case SYNTH_STEAL_RETRIGGER:
+      synth.voice_steal=policy;
+      break;
+  }
+}
+
+/* Clock.
+ */
+ 
+double synth_get_clock() {
+  return (double)synth.clock;
+}
+
 /* Frames from milliseconds.
  * Negative or zero returns zero; anything positive guarantees to return positive.
  */
@@ -608,16 +868,5 @@ int synth_frames_from_ms(int ms) {
  */
  
 float synth_bend_from_cents(int cents) {
-  float bend=1.0f;
-  if (cents>0) {
-    if (cents>SYNTH_BEND_LIMIT_CENTS) cents=SYNTH_BEND_LIMIT_CENTS;
-    while (cents>=1200) { cents-=1200; bend*=2.0f; }
-    bend*=synth.cents_octave[cents/100]*synth.cents_halfstep[cents%100];
-  } else {
-    if (cents<-SYNTH_BEND_LIMIT_CENTS) cents=-SYNTH_BEND_LIMIT_CENTS;
-    cents=-cents;
-    while (cents>=1200) { cents-=1200; bend*=0.5f; }
-    bend*=synth.invcents_octave[cents/100]*synth.invcents_halfstep[cents%100];
-  }
-  return bend;
+  return synth_bend_from_cents_ctx(&synth,cents);
 }
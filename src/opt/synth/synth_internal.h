@@ -24,11 +24,14 @@ struct synth_channel;
 struct synth_channel_type;
 struct synth_pipe;
 struct synth_pcmplay;
+struct synth_songpcm;
 struct synth_printer;
 struct synth_pcm;
 struct synth_wave;
 struct synth_env;
 struct synth_iir3;
+struct synth_cmd;
+struct synth_seek;
 
 #define SYNTH_WAVE_SIZE_BITS 10
 #define SYNTH_WAVE_SIZE_SAMPLES (1<<SYNTH_WAVE_SIZE_BITS)
@@ -100,46 +103,81 @@ void synth_env_add(struct synth_env *env,float add);
  */
 void synth_env_apply(struct synth_env *runner,const struct synth_env *config,float velocity,int durframes);
 
+/* Total length of a config in frames, taking the longer time of each point, and sustain as zero.
+ */
+int synth_env_get_duration(const struct synth_env *config);
+
 /* If this runner sustains and hasn't finished sustaining yet, drop the sustain to zero.
  */
 void synth_env_release(struct synth_env *env);
 
-/* Advance runner by one frame; evaluates to the next level.
+/* Advance runner by (framec) frames, writing each level to (dst).
+ * We run whole legs at a time, so there's no per-frame branching except at leg boundaries.
  */
-#define synth_env_update(env) ({ \
-  float _v=(env).v; \
-  if ((env).c>0) { \
-    (env).c--; \
-    (env).v+=(env).dv; \
-  } else { \
-    synth_env_advance(&(env)); \
-  } \
-  (_v); \
-})
+void synth_env_fill(float *dst,struct synth_env *env,int framec);
 
-// Should only be invoked by synth_env_update().
+// Should only be invoked by synth_env_fill().
 void synth_env_advance(struct synth_env *env);
 
+/* Block arithmetic.
+ * Four-lane float vectors via the GCC/Clang vector extension.
+ * These lower to SSE on x86, NEON on ARM, SIMD128 in wasm with -msimd128, and plain scalar code elsewhere.
+ * Alignment is relaxed to one float, so any buffer offset is fine.
+ *****************************************************************************/
+ 
+typedef float synth_v4f __attribute__((vector_size(16),aligned(4)));
+
+// dst+=a*b
+static inline void synth_block_mlt_add(float *dst,const float *a,const float *b,int framec) {
+  for (;framec>=4;framec-=4,dst+=4,a+=4,b+=4) {
+    *(synth_v4f*)dst+=(*(const synth_v4f*)a)*(*(const synth_v4f*)b);
+  }
+  for (;framec-->0;dst++,a++,b++) (*dst)+=(*a)*(*b);
+}
+
+// a=a*(1-mix)+b*mix
+static inline void synth_block_mix(float *a,const float *b,const float *mix,int framec) {
+  const synth_v4f one={1.0f,1.0f,1.0f,1.0f};
+  for (;framec>=4;framec-=4,a+=4,b+=4,mix+=4) {
+    synth_v4f m=*(const synth_v4f*)mix;
+    *(synth_v4f*)a=(*(synth_v4f*)a)*(one-m)+(*(const synth_v4f*)b)*m;
+  }
+  for (;framec-->0;a++,b++,mix++) *a=(*a)*(1.0f-*mix)+(*b)*(*mix);
+}
+
+// a*=b
+static inline void synth_block_mlt(float *a,const float *b,int framec) {
+  for (;framec>=4;framec-=4,a+=4,b+=4) *(synth_v4f*)a*=*(const synth_v4f*)b;
+  for (;framec-->0;a++,b++) (*a)*=(*b);
+}
+
 /* Post-process pipe.
  *****************************************************************************/
  
 struct synth_pipe_stage {
   uint8_t type;
+  int tail; // Frames of signal this stage can hold onto, eg a delay's ring.
   void (*del)(struct synth_pipe_stage *stage);
   void (*update_mono)(float *dst,struct synth_pipe_stage *stage,int framec);
   void (*update_stereo)(float *dstl,float *dstr,struct synth_pipe_stage *stage,int framec);
+  void (*skip)(struct synth_pipe_stage *stage,int framec); // OPTIONAL. Advance oscillators without processing, while the channel sleeps.
+  void (*clear)(struct synth_pipe_stage *stage); // OPTIONAL. Drop held signal, as the channel falls asleep. Required if (tail) nonzero.
+  int expendable; // Nonzero to bypass at reduced quality. We call (skip) instead of update, so the stage passes its input through untouched.
 };
  
 struct synth_pipe {
   struct synth_pipe_stage **stagev;
   int stagec,stagea;
   struct synth_song *song; // WEAK
+  int tail; // Sum of stages' (tail).
 };
 
 void synth_pipe_del(struct synth_pipe *pipe);
 struct synth_pipe *synth_pipe_new(struct synth_song *owner,const uint8_t *src,int srcc);
 void synth_pipe_update_mono(float *dst,struct synth_pipe *pipe,int framec);
 void synth_pipe_update_stereo(float *dstl,float *dstr,struct synth_pipe *pipe,int framec);
+void synth_pipe_skip(struct synth_pipe *pipe,int framec);
+void synth_pipe_clear(struct synth_pipe *pipe);
 
 /* Song channel.
  *******************************************************************************/
@@ -158,6 +196,11 @@ struct synth_channel {
   int defunct; // Nonzero after a fadeout completes; nothing more can happen on the channel.
   float fadeout; // 1=>0
   float fadeoutd;
+  float *capl,*capr; // Threaded mode only. Untrimmed output accumulates here during update, and the main thread mixes it after.
+  int capc; // Frames captured so far this update.
+  int steal; // SYNTH_STEAL_*, copied from the global at init.
+  int asleep; // Nonzero if no voices and post has gone quiet. We skip all processing until the next note. Post is cleared on the way down.
+  int quietc; // Frames of quiet output since the type went idle.
   
   /* (update_mono) is required, stereo optional. It's normal to implement only mono.
    * Channels that update in stereo generally ignore the song and channel level pan. Your update hook may choose to respect them.
@@ -197,8 +240,27 @@ struct synth_channel_type {
   void (*note_once)(struct synth_channel *channel,uint8_t noteid,float velocity,int durframes);
   void (*note_on)(struct synth_channel *channel,uint8_t noteid,float velocity);
   void (*note_off)(struct synth_channel *channel,uint8_t noteid);
+  
+  /* OPTIONAL. Return nonzero if no voices are running, ie update would add nothing.
+   * Without this, the channel never sleeps.
+   * Only new notes wake a sleeping channel. So idle means idle: Nothing but a note may start sound again.
+   */
+  int (*is_idle)(struct synth_channel *channel);
+  
+  // OPTIONAL. Advance LFOs and such by (framec) without producing output, while the channel sleeps.
+  void (*skip)(struct synth_channel *channel,int framec);
+  
+  // OPTIONAL. Count of voices currently running. Only for profiling.
+  int (*get_voicec)(struct synth_channel *channel);
+  
+  // OPTIONAL. synth.quality changed. Reselect kernels per synth_channel_quality(). Called on the main thread between updates.
+  void (*quality_changed)(struct synth_channel *channel);
 };
 
+/* Channels that are idle and whose output stays below this level long enough to flush their post, go to sleep.
+ */
+#define SYNTH_SLEEP_LEVEL 0.00001f
+
 const struct synth_channel_type *synth_channel_type_for_mode(uint8_t mode);
 extern const struct synth_channel_type synth_channel_type_trivial; // mode 1
 extern const struct synth_channel_type synth_channel_type_fm; // mode 2
@@ -230,6 +292,21 @@ void synth_channel_release_all(struct synth_channel *channel);
 void synth_channel_update_stereo(float *dstl,float *dstr,struct synth_channel *channel,int framec);
 void synth_channel_update_mono(float *dst,struct synth_channel *channel,int framec);
 
+/* Channel types with voices allocate them all at init, and steal when they run out.
+ * synth_channel_count_voices() returns the arena size for a channel whose notes linger (tailframes) after release.
+ * synth_channel_steal_score() rates a busy voice for replacement by (noteid). Lowest score goes.
+ * (age) is how many notes have started on the channel since this voice, and (level) is its current output level, roughly.
+ */
+#define SYNTH_VOICE_MIN 8 /* Even channels with no notes of their own leave room for injected events. */
+#define SYNTH_VOICE_LIMIT 32
+int synth_channel_count_voices(const struct synth_channel *channel,int tailframes);
+float synth_channel_steal_score(const struct synth_channel *channel,uint8_t noteid,uint8_t voicenoteid,int age,float level);
+
+/* If the channel is capturing, add its capture to (dstl,dstr) and reset it.
+ * Noop if not capturing.
+ */
+void synth_channel_mix_capture(float *dstl,float *dstr,struct synth_channel *channel);
+
 /* Song player.
  *****************************************************************************/
  
@@ -255,13 +332,28 @@ struct synth_song {
   int phframes; // Playhead. Total output since beginning of song, but it wraps around at loop.
   int loopframes; // Playhead at loop point.
   float trim0; // For adjusting the global. synth_global manages it.
+  struct synth_song_timed {
+    int delay; // Frames after the previous one, or after now for the first.
+    uint8_t event,chid,noteid,velocity; // (event) is SYNTH_EVENT_*, which is also the EAU lead nybble.
+    int durms;
+  } *timedv; // Scheduled by the client, in order. Consumed alongside (evtv).
+  int timedc,timeda;
+  struct synth_profile_song *prof; // Only while profiling, and never for printers. See synth_profile.c.
+  struct synth_songpcm *songpcm; // If present, we stream it instead of running events and channels, and we have no channels.
 };
 
 void synth_song_del(struct synth_song *song);
 
 /* (src) is borrowed; caller must keep it alive as long as the song is playing.
+ * (rid) is the song resource it came from, or zero if none, eg printers.
  */
-struct synth_song *synth_song_new(int chanc,const void *src,int srcc,float trim,float pan);
+struct synth_song *synth_song_new(int chanc,const void *src,int srcc,int rid,float trim,float pan);
+
+/* Song that streams prerendered PCM (songpcm) instead of synthesizing.
+ * (src) is still the EAU song, for tempo and duration. Both serials are borrowed.
+ * Null if the songpcm is unusable; caller should fall back to synth_song_new().
+ */
+struct synth_song *synth_song_new_prerendered(int chanc,const void *src,int srcc,const void *pcm,int pcmc,float trim,float pan,int repeat);
 
 /* <0 for errors, 0 if complete, >0 if still running.
  * (dstr) optional.
@@ -278,6 +370,21 @@ void synth_song_stop(struct synth_song *song);
  */
 int synth_song_get_duration_frames(struct synth_song *song);
 
+/* The most notes sounding at once on one channel, if each lasts (tailms) beyond its Note Off or duration.
+ * Only the song's own events. Stops counting at (limit).
+ * For songs from the ROM, we measure once per channel and cache it on the resource.
+ */
+int synth_song_measure_polyphony(const struct synth_song *song,uint8_t chid,int tailms,int limit);
+
+/* Schedule a client event (delay) frames from now.
+ * Events at the same time dispatch in the order you schedule them.
+ */
+int synth_song_schedule(struct synth_song *song,int delay,uint8_t event,uint8_t chid,uint8_t noteid,uint8_t velocity,int durms);
+
+/* Allocate the whole schedule up front, so synth_song_schedule() never has to.
+ */
+int synth_song_reserve_schedule(struct synth_song *song);
+
 float synth_song_get_playhead(const struct synth_song *song);
 void synth_song_set_playhead(struct synth_song *song,float s);
 void synth_song_set_trim(struct synth_song *song,float trim);
@@ -287,6 +394,24 @@ void synth_song_set_pan(struct synth_song *song,float pan);
 uint32_t synth_song_get_tempo_step(const struct synth_song *song,float qnotes);
 int synth_song_get_tempo_frames(const struct synth_song *song,float qnotes);
 
+/* Allocate or free capture buffers for each channel, for threaded mode. synth_thread.c.
+ * Every song in (synth.songv) must have them while threads are in play, and printers' songs must not.
+ */
+int synth_song_require_capture(struct synth_song *song);
+void synth_song_drop_capture(struct synth_song *song);
+
+/* Seek index, see synth_seek.c.
+ * Fails if the stream is malformed.
+ */
+void synth_seek_del(struct synth_seek *seek);
+struct synth_seek *synth_seek_new(const uint8_t *evtv,int evtc);
+int synth_seek_get_duration_ms(const struct synth_seek *seek);
+
+/* Move (song) to (ms), and restart the notes and wheels that would be in play there.
+ * (seek) must be built from (song)'s own event stream.
+ */
+void synth_seek_apply(struct synth_song *song,const struct synth_seek *seek,int ms);
+
 /* General-purpose ring buffer.
  ************************************************************************/
  
@@ -300,6 +425,7 @@ struct synth_ring {
 };
 
 void synth_ring_cleanup(struct synth_ring *ring);
+void synth_ring_clear(struct synth_ring *ring); // Zero content, keep position.
 int synth_ring_resize(struct synth_ring *ring,int framec);
 
 #define synth_ring_read(ring) ((ring).v[(ring).p])
@@ -353,13 +479,56 @@ int synth_wave_decode(struct synth_wave *wave,const void *src,int srcc);
 struct synth_pcm {
   int refc;
   int c;
-  float v[];
+  float *v; // Normally points just past this struct, in the same allocation. Borrowed ones point elsewhere.
 };
 
 void synth_pcm_del(struct synth_pcm *pcm);
 struct synth_pcm *synth_pcm_new(int c);
+
+/* New PCM pointing to someone else's samples, eg a memory-mapped cache file.
+ * Caller must keep (v) alive until the last reference drops.
+ * We never write to borrowed PCM; nothing prints into it.
+ */
+struct synth_pcm *synth_pcm_new_borrowed(const float *v,int c);
 int synth_pcm_ref(struct synth_pcm *pcm);
 
+/* Prerendered song player. synth_songpcm.c.
+ * Decodes the IMA ADPCM blocks of a songpcm resource as it goes, and resamples linearly to the internal rate.
+ * See etc/doc/songpcm-format.md.
+ *****************************************************************************/
+
+struct synth_songpcm {
+  const uint8_t *src; // WEAK, from the ROM.
+  int srcc;
+  int rate,chanc;
+  int blockframes,blocklen; // Full blocks' length in frames and bytes.
+  int framec,endframe,loopframe;
+  int repeat;
+  int framep; // Source frame, and (phase) is the fraction past it, in 1/65536.
+  uint32_t phase,step;
+  float *buf; // One decoded block, interleaved.
+  int bufblock; // Block index in (buf), or -1.
+  int bufc; // Frames in (buf).
+  float next[2]; // The frame after (buf), for interpolating across the boundary.
+  float trim,triml,trimr;
+  int fadec,fadep; // Fading out if (fadec) nonzero.
+};
+
+void synth_songpcm_del(struct synth_songpcm *songpcm);
+struct synth_songpcm *synth_songpcm_new(const void *src,int srcc,int repeat);
+void synth_songpcm_set_gain(struct synth_songpcm *songpcm,float trim,float pan);
+void synth_songpcm_fade_out(struct synth_songpcm *songpcm,int framec);
+
+/* Adds to (dstl,dstr). (dstr) optional; without it, we mix down to mono.
+ * Returns the count of frames produced, less than (framec) if we've reached the end frame without repeat.
+ * After synth_songpcm_fade_out(), we always produce all (framec), silence once the fade or the stream runs out.
+ */
+int synth_songpcm_update(float *dstl,float *dstr,struct synth_songpcm *songpcm,int framec);
+
+// Playhead in frames at the source rate, on the song's timeline, ie after the loop point the second time thru.
+int synth_songpcm_get_playhead(const struct synth_songpcm *songpcm);
+void synth_songpcm_set_playhead(struct synth_songpcm *songpcm,int framep);
+
 /* PCM player.
  *****************************************************************************/
  
@@ -404,14 +573,65 @@ struct synth_printer *synth_printer_new(const void *src,int srcc);
  */
 int synth_printer_update(struct synth_printer *printer,int framec);
 
-/* Global context.
+#define SYNTH_INTERNAL_RATE_MIN 2000
+
+/* Resampler, from the internal rate up to the output rate.
+ * Windowed sinc, interpolating between a table of fractional phases.
+ * Feed it input as it asks, then pull output. It retains enough history to run seamlessly across updates.
+ ******************************************************************************/
+ 
+#define SYNTH_RESAMPLE_TAPS 16
+#define SYNTH_RESAMPLE_PHASE_BITS 7
+#define SYNTH_RESAMPLE_PHASES (1<<SYNTH_RESAMPLE_PHASE_BITS)
+
+struct synth_resampler {
+  uint64_t step; // Input frames per output frame, 32.32 fixed point.
+  uint64_t pos; // Position of the next output frame in (v), ''
+  float *v[2]; // Input, including history. (v[1]) only if stereo.
+  int c,a;
+  float kernel[(SYNTH_RESAMPLE_PHASES+1)*SYNTH_RESAMPLE_TAPS];
+};
+
+void synth_resampler_del(struct synth_resampler *resampler);
+
+/* (chanc) 1 or 2. (outframes) is the most you'll ask for at once.
+ */
+struct synth_resampler *synth_resampler_new(int inrate,int outrate,int chanc,int outframes);
+
+/* How many more input frames do I need before producing (framec) output frames?
+ */
+int synth_resampler_get_input_needed(const struct synth_resampler *resampler,int framec);
+
+/* Append input, and then once you've provided enough, overwrite (dstl,dstr) with output.
+ */
+void synth_resampler_input(struct synth_resampler *resampler,const float *srcl,const float *srcr,int framec);
+void synth_resampler_output(float *dstl,float *dstr,struct synth_resampler *resampler,int framec);
+
+/* Context.
+ * Internally, we always work on the current context through the name (synth), as if it were a global.
+ * In web builds it is one: There's only the default context, accessed directly.
+ * In native builds with the real allocator, (synth) is the calling thread's current context, see synth_context.c.
  *****************************************************************************/
+
+#define SYNTH_THREADS_AVAILABLE (USE_native && !USE_FAKE_MALLOC && !USE_mswin)
+#define SYNTH_CONTEXTS_AVAILABLE (USE_native && !USE_FAKE_MALLOC) /* Our fake heap is one per process. */
+
+#if SYNTH_THREADS_AVAILABLE
+  #define SYNTH_THREAD_LOCAL __thread
+#else
+  #define SYNTH_THREAD_LOCAL
+#endif
  
-extern struct synth {
-  int rate,chanc,buffer_frames;
+struct synth_context {
+  int rate,chanc,buffer_frames; // (rate,buffer_frames) are internal, may differ from the caller's if resampling.
   
   float *bufl,*bufr; // (bufr) only exists if (chanc>=2)
   
+  // Only when synthesizing below the output rate. (outl,outr) are what the caller sees.
+  struct synth_resampler *resampler;
+  int outrate,outframes;
+  float *outl,*outr;
+  
   uint8_t *rom;
   int romc;
   
@@ -423,12 +643,18 @@ extern struct synth {
   int printerc,printera;
   
   int framec_in_progress;
+  int64_t clock; // Total frames output since init.
   
   struct synth_res {
     int rid;
     struct synth_pcm *pcm; // only if sound
     const void *serial; // WEAK, points into (rom)
     int serialc;
+    struct synth_seek *seek; // only if song, and only after someone seeks or asks for duration
+    const void *songpcm; // WEAK, points into (rom). Only if song, and the ROM has a songpcm for it.
+    int songpcmc;
+    struct synth_polyphony { int tailms,voicec; } polyv[16]; // Only if song. By chid, valid where (polymask) has bit (1<<chid).
+    int polymask;
   } *resv;
   int resc,resa;
   
@@ -448,20 +674,171 @@ extern struct synth {
   // Mostly as a convenience, we provide extra global trims for music and sound, above the per-unit trim.
   float music_trim,sound_trim;
   
-} synth;
+  int voice_steal; // SYNTH_STEAL_*, for channels created from now on.
+  int sleep_disable; // Nonzero to keep idle channels awake, see synth_channel.c. For comparing output in tests.
+  int seek_disable; // Nonzero to seek by replaying from the start, ignoring the index's later points. For comparing output in tests.
+  
+  struct synth_threads *threads; // Null unless synth_set_threads() enabled them.
+  struct synth_preprint *preprint; // Null unless synth_preprint_sounds() is in progress.
+  
+  // Command queue, see synth_cmdq.c. (cmdv) null if disabled.
+  struct synth_cmd *cmdv;
+  int cmdmask; // Length minus one; length is a power of two.
+  int cmdhead,cmdtail; // Accessed atomically.
+  int cmd_overflowc; // ''
+  
+  // Profiling, see synth_profile.c. (profsongv) is sorted by rid and doesn't include live songs.
+  int profiling;
+  struct synth_profile profile;
+  struct synth_profile_song *profsongv;
+  int profsongc,profsonga;
+  
+  // Adaptive quality, see synth_quality.c. (quality) is SYNTH_QUALITY_*, the rest are only used when (quality_degrade>0).
+  // Everything from (quality_load) down is written only by the audio thread, or by the main thread while holding the driver's lock.
+  int quality;
+  float quality_degrade,quality_restore;
+  float quality_load; // Smoothed fraction of real time spent in synth_update().
+  int quality_overc; // Consecutive updates with load over (quality_degrade).
+  int quality_holdc; // Frames before we may change quality again.
+  int quality_calmc; // Frames we've been under (quality_restore).
+  int quality_calm_need; // Frames under (quality_restore) before restoring. Grows when a restore doesn't stick.
+  int64_t quality_clock; // Output frames since init. Not (clock), which counts at the internal rate.
+  int64_t quality_restored_at; // (quality_clock) at the last restore, or zero if never.
+  
+};
+
+extern struct synth_context synth_default;
+#if SYNTH_CONTEXTS_AVAILABLE
+  extern SYNTH_THREAD_LOCAL struct synth_context *synth_current;
+  #define synth (*synth_current)
+#else
+  #define synth synth_default
+#endif
 
 int synth_frames_from_ms(int ms);
 
 /* These are constant. If libm were in play, or in pure math, it's just `pow(2.0f,cents/1200.0f)`.
  * We're not using libm, so we do a kind of complex lookup-table dance.
+ * Per-frame callers should take (ctx) once per block and use synth_bend_from_cents_ctx, to skip the thread-local lookup.
  */
 float synth_bend_from_cents(int cents);
 
+static inline float synth_bend_from_cents_ctx(const struct synth_context *ctx,int cents) {
+  float bend=1.0f;
+  if (cents>0) {
+    if (cents>SYNTH_BEND_LIMIT_CENTS) cents=SYNTH_BEND_LIMIT_CENTS;
+    while (cents>=1200) { cents-=1200; bend*=2.0f; }
+    bend*=ctx->cents_octave[cents/100]*ctx->cents_halfstep[cents%100];
+  } else {
+    if (cents<-SYNTH_BEND_LIMIT_CENTS) cents=-SYNTH_BEND_LIMIT_CENTS;
+    cents=-cents;
+    while (cents>=1200) { cents-=1200; bend*=0.5f; }
+    bend*=ctx->invcents_octave[cents/100]*ctx->invcents_halfstep[cents%100];
+  }
+  return bend;
+}
+
 /* Install a printer and return its PCM (not yet printed).
  * Returns STRONG.
  */
 struct synth_pcm *synth_begin_print(const void *src,int srcc);
 
+/* Find a song or sound resource, building the TOC first if needed.
+ * (rid) may have SYNTH_RID_SOUND set.
+ */
+struct synth_res *synth_res_get(int rid);
+
+/* synth_play_sound() and synth_play_song() in two parts, so the command queue can do the expensive part on the producer's thread.
+ * "prepare" finds the resource and does any printing or decoding. It doesn't touch anything synth_update() looks at.
+ * synth_sound_prepare() returns a WEAK PCM, held by its resource until the ROM changes, or null if there's nothing to play.
+ * synth_song_prepare() puts a new STRONG song in (*dst), or null if not found (returns 0) or failed (<0).
+ * "start" installs it. synth_song_start() takes ownership of (song), which may be null just to stop (songid).
+ */
+struct synth_pcm *synth_sound_prepare(int rid);
+void synth_sound_start(struct synth_pcm *pcm,float trim,float pan);
+int synth_song_prepare(struct synth_song **dst,int songid,int rid,int repeat,float trim,float pan);
+int synth_song_start(struct synth_song *song,int songid);
+
+/* Worker threads for rendering songs in parallel. synth_thread.c.
+ * Only available in native builds with the real libc allocator; our fake one is not thread-safe.
+ * Everywhere else, synth_threads_new() fails and the rest are noops.
+ ****************************************************************************************/
+
+#define SYNTH_THREAD_LIMIT 16
+
+struct synth_threads;
+
+void synth_threads_del(struct synth_threads *threads);
+struct synth_threads *synth_threads_new(int thdc);
+
+/* Song updates may touch the printer list, via drum channels.
+ * Anything doing that must hold this lock. Safe to call with null (threads).
+ */
+void synth_threads_lock(struct synth_threads *threads);
+void synth_threads_unlock(struct synth_threads *threads);
+
+/* Update and mix all songs, and remove the finished ones.
+ * <0 only if we didn't do anything, and caller should fall back to the serial path.
+ */
+int synth_threads_update_songs(struct synth_threads *threads,int framec);
+
+/* Printing sounds ahead of time. synth_preprint.c.
+ ****************************************************************************************/
+
+struct synth_preprint;
+
+void synth_preprint_del(struct synth_preprint *preprint);
+
+/* Collect any sounds finished by the background thread, and drop (synth.preprint) if they're all done.
+ * Noop in incremental mode.
+ */
+void synth_preprint_adopt();
+
+/* Nonzero while printing a sound off the normal update path.
+ * When set, synth_begin_print() delegates to synth_print_now() instead of installing a printer.
+ */
+extern SYNTH_THREAD_LOCAL int synth_print_immediate;
+
+/* Print an EAU file to completion, right now, returning STRONG PCM or null.
+ * If (cancel) not null and becomes nonzero, we stop early and return null.
+ */
+struct synth_pcm *synth_print_now(const void *src,int srcc,const int *cancel);
+
+/* Run all queued commands. Call at the start of each update, before (framec_in_progress) is set.
+ */
+void synth_cmdq_drain();
+
+/* CPU profiling. synth_profile.c.
+ ****************************************************************************************/
+
+#define SYNTH_PROFILE_AVAILABLE (USE_native && !USE_mswin)
+
+// Nanoseconds, monotonic. Always zero if profiling is unavailable.
+int64_t synth_profile_now();
+
+/* Add (song->prof) to the tally, and zero it.
+ * Main thread only. synth_song_del() does this for you.
+ */
+void synth_profile_song_fold(struct synth_song *song);
+
+void synth_profile_quit();
+
+/* Adaptive quality. synth_quality.c.
+ * Only live songs degrade. Printers always run at full quality, since their output gets cached.
+ ****************************************************************************************/
+
+int synth_song_quality(const struct synth_song *song);
+int synth_channel_quality(const struct synth_channel *channel);
+
+/* How many voices a channel with (voicea) allocated may use right now.
+ * Channel types use this in place of (voicea) when deciding whether to steal.
+ */
+int synth_channel_voice_limit(const struct synth_channel *channel,int voicea);
+
+/* Call at the end of synth_update() with the time it took (zero if unknown) and output frame count.
+ */
+void synth_quality_update(int64_t ns,int framec);
+
 /* synth_stdlib.c
  * A few things that either come from real stdlib, or our own fake implementation.
  * Build with -DUSE_native=1 to use standard malloc, or -DUSE_web=1 to use ours, taking advantage of some wasm intrinsics.
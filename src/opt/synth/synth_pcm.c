@@ -10,6 +10,10 @@ void synth_ring_cleanup(struct synth_ring *ring) {
   ring->p=0;
 }
 
+void synth_ring_clear(struct synth_ring *ring) {
+  if (ring->v) __builtin_memset(ring->v,0,sizeof(float)*ring->c);
+}
+
 int synth_ring_resize(struct synth_ring *ring,int framec) {
   if (framec<SYNTH_RING_MIN) framec=SYNTH_RING_MIN;
   else if (framec>SYNTH_RING_MAX) framec=SYNTH_RING_MAX;
@@ -441,6 +445,17 @@ struct synth_pcm *synth_pcm_new(int c) {
   if (!pcm) return 0;
   pcm->refc=1;
   pcm->c=c;
+  pcm->v=(float*)(pcm+1);
+  return pcm;
+}
+
+struct synth_pcm *synth_pcm_new_borrowed(const float *v,int c) {
+  if (!v||(c<1)) return 0;
+  struct synth_pcm *pcm=synth_calloc(1,sizeof(struct synth_pcm));
+  if (!pcm) return 0;
+  pcm->refc=1;
+  pcm->c=c;
+  pcm->v=(float*)v;
   return pcm;
 }
 
@@ -526,7 +541,7 @@ void synth_printer_del(struct synth_printer *printer) {
  */
  
 struct synth_printer *synth_printer_new(const void *src,int srcc) {
-  struct synth_song *song=synth_song_new(1,src,srcc,1.0f,0.0f);
+  struct synth_song *song=synth_song_new(1,src,srcc,0,1.0f,0.0f);
   if (!song) return 0;
   int framec=synth_song_get_duration_frames(song);
   if (framec<1) framec=1;
@@ -1,5 +1,7 @@
 #include "synth_internal.h"
 
+#define SYNTH_PIPE_BLOCK_FRAMES 256
+
 /* 0x00 NOOP
  */
  
@@ -24,18 +26,19 @@ struct synth_stage_gain {
 };
 
 #define STAGE ((struct synth_stage_gain*)stage)
+
+// One sample. Also used by fused stages.
+static inline float synth_gain_1(const struct synth_stage_gain *gain,float v) {
+  v*=gain->mlt;
+  if (v<-gain->clip) return -gain->clip;
+  if (v<-gain->gate) return v;
+  if (v<gain->gate) return 0.0f;
+  if (v<gain->clip) return v;
+  return gain->clip;
+}
  
 static void _gain_update_mono(float *dst,struct synth_pipe_stage *stage,int framec) {
-  float nclip=-STAGE->clip;
-  float ngate=-STAGE->gate;
-  for (;framec-->0;dst++) {
-    (*dst)*=STAGE->mlt;
-    if (*dst<nclip) *dst=nclip;
-    else if (*dst<ngate) ;
-    else if (*dst<STAGE->gate) *dst=0.0f;
-    else if (*dst<STAGE->clip) ;
-    else *dst=STAGE->clip;
-  }
+  for (;framec-->0;dst++) *dst=synth_gain_1(STAGE,*dst);
 }
 
 static void _gain_update_stereo(float *dstl,float *dstr,struct synth_pipe_stage *stage,int framec) {
@@ -79,6 +82,11 @@ static void _delay_del(struct synth_pipe_stage *stage) {
   synth_ring_cleanup(&STAGE->ringr);
 }
 
+static void _delay_clear(struct synth_pipe_stage *stage) {
+  synth_ring_clear(&STAGE->ringl);
+  synth_ring_clear(&STAGE->ringr);
+}
+
 static void _delay_update_mono(float *dst,struct synth_pipe_stage *stage,int framec) {
   for (;framec-->0;dst++) {
     float pv=synth_ring_read(STAGE->ringl);
@@ -112,6 +120,7 @@ static struct synth_pipe_stage *synth_pipe_delay_new(struct synth_song *song,con
   stage->type=0x02;
   stage->del=_delay_del;
   stage->update_mono=_delay_update_mono;
+  stage->clear=_delay_clear;
   stage->update_stereo=_delay_update_stereo;
   
   STAGE->dry=(srcc>=3)?(src[2]/255.0f):0.5f;
@@ -139,6 +148,7 @@ static struct synth_pipe_stage *synth_pipe_delay_new(struct synth_song *song,con
       return 0;
     }
   }
+  stage->tail=(STAGE->ringr.c>STAGE->ringl.c)?STAGE->ringr.c:STAGE->ringl.c;
   
   return stage;
 }
@@ -157,22 +167,29 @@ struct synth_stage_tremolo {
 #define STAGE ((struct synth_stage_tremolo*)stage)
 
 static void _tremolo_update_mono(float *dst,struct synth_pipe_stage *stage,int framec) {
+  const float *sine=synth.sine.v;
   for (;framec-->0;dst++) {
     STAGE->lp+=STAGE->dp;
-    float trem=synth.sine.v[STAGE->lp>>SYNTH_WAVE_SHIFT]*STAGE->mlt+STAGE->add;
+    float trem=sine[STAGE->lp>>SYNTH_WAVE_SHIFT]*STAGE->mlt+STAGE->add;
     (*dst)*=trem;
   }
 }
 
 static void _tremolo_update_stereo(float *dstl,float *dstr,struct synth_pipe_stage *stage,int framec) {
+  const float *sine=synth.sine.v;
   for (;framec-->0;dstl++,dstr++) {
     STAGE->lp+=STAGE->dp;
     STAGE->rp+=STAGE->dp;
-    (*dstl)*=synth.sine.v[STAGE->lp>>SYNTH_WAVE_SHIFT]*STAGE->mlt+STAGE->add;
-    (*dstr)*=synth.sine.v[STAGE->rp>>SYNTH_WAVE_SHIFT]*STAGE->mlt+STAGE->add;
+    (*dstl)*=sine[STAGE->lp>>SYNTH_WAVE_SHIFT]*STAGE->mlt+STAGE->add;
+    (*dstr)*=sine[STAGE->rp>>SYNTH_WAVE_SHIFT]*STAGE->mlt+STAGE->add;
   }
 }
 
+static void _tremolo_skip(struct synth_pipe_stage *stage,int framec) {
+  STAGE->lp+=STAGE->dp*(uint32_t)framec;
+  STAGE->rp+=STAGE->dp*(uint32_t)framec;
+}
+
 static struct synth_pipe_stage *synth_pipe_tremolo_new(struct synth_song *song,const uint8_t *src,int srcc) {
   // 0x03 TREMOLO [u8.8 qnotes, u0.8 depth=1, u0.8 phase=0, u0.8 sparkle=0.5]
   if (srcc<2) return 0;
@@ -181,6 +198,7 @@ static struct synth_pipe_stage *synth_pipe_tremolo_new(struct synth_song *song,c
   stage->type=0x03;
   stage->update_mono=_tremolo_update_mono;
   stage->update_stereo=_tremolo_update_stereo;
+  stage->skip=_tremolo_skip;
   
   float period=src[0]+src[1]/256.0f;
   float depth=1.0f;
@@ -233,11 +251,17 @@ static void _detune_del(struct synth_pipe_stage *stage) {
   synth_ring_cleanup(&STAGE->ringr);
 }
 
+static void _detune_clear(struct synth_pipe_stage *stage) {
+  synth_ring_clear(&STAGE->ringl);
+  synth_ring_clear(&STAGE->ringr);
+}
+
 static void _detune_update_mono(float *dst,struct synth_pipe_stage *stage,int framec) {
+  const float *sine=synth.sine.v;
   for (;framec-->0;dst++) {
     synth_ring_write(STAGE->ringl,*dst);
     STAGE->lp+=STAGE->dp;
-    int p=(int)((synth.sine.v[STAGE->lp>>SYNTH_WAVE_SHIFT]+1.0f)*STAGE->sinemlt);
+    int p=(int)((sine[STAGE->lp>>SYNTH_WAVE_SHIFT]+1.0f)*STAGE->sinemlt);
     p=STAGE->ringl.p-p;
     if (p<0) p+=STAGE->ringl.c;
     if (p>=STAGE->ringl.c) p-=STAGE->ringl.c;
@@ -247,6 +271,7 @@ static void _detune_update_mono(float *dst,struct synth_pipe_stage *stage,int fr
 }
 
 static void _detune_update_stereo(float *dstl,float *dstr,struct synth_pipe_stage *stage,int framec) {
+  const float *sine=synth.sine.v;
   if (!STAGE->ringr.c) {
     _detune_update_mono(dstl,stage,framec);
     return;
@@ -255,7 +280,7 @@ static void _detune_update_stereo(float *dstl,float *dstr,struct synth_pipe_stag
   
     synth_ring_write(STAGE->ringl,*dstl);
     STAGE->lp+=STAGE->dp;
-    int p=(int)((synth.sine.v[STAGE->lp>>SYNTH_WAVE_SHIFT]+1.0f)*STAGE->sinemlt);
+    int p=(int)((sine[STAGE->lp>>SYNTH_WAVE_SHIFT]+1.0f)*STAGE->sinemlt);
     p=STAGE->ringl.p-p;
     if (p<0) p+=STAGE->ringl.c;
     if (p>=STAGE->ringl.c) p-=STAGE->ringl.c;
@@ -264,7 +289,7 @@ static void _detune_update_stereo(float *dstl,float *dstr,struct synth_pipe_stag
   
     synth_ring_write(STAGE->ringr,*dstr);
     STAGE->rp+=STAGE->dp;
-    p=(int)((synth.sine.v[STAGE->rp>>SYNTH_WAVE_SHIFT]+1.0f)*STAGE->sinemlt);
+    p=(int)((sine[STAGE->rp>>SYNTH_WAVE_SHIFT]+1.0f)*STAGE->sinemlt);
     p=STAGE->ringr.p-p;
     if (p<0) p+=STAGE->ringr.c;
     if (p>=STAGE->ringr.c) p-=STAGE->ringr.c;
@@ -273,15 +298,23 @@ static void _detune_update_stereo(float *dstl,float *dstr,struct synth_pipe_stag
   }
 }
 
+static void _detune_skip(struct synth_pipe_stage *stage,int framec) {
+  STAGE->lp+=STAGE->dp*(uint32_t)framec;
+  STAGE->rp+=STAGE->dp*(uint32_t)framec;
+}
+
 static struct synth_pipe_stage *synth_pipe_detune_new(struct synth_song *song,const uint8_t *src,int srcc) {
   // 0x04 DETUNE [u8.8 qnotes, u0.8 mix=0.5, u0.8 depth=0.5, u0.8 phase=0, u0.8 rightphase=0]. Detune by pingponging back and forth in time.
   if (srcc<2) return 0;
   struct synth_pipe_stage *stage=synth_calloc(1,sizeof(struct synth_stage_detune));
   if (!stage) return 0;
   stage->type=0x04;
+  stage->expendable=1;
   stage->del=_detune_del;
   stage->update_mono=_detune_update_mono;
+  stage->clear=_detune_clear;
   stage->update_stereo=_detune_update_stereo;
+  stage->skip=_detune_skip;
   
   float period=src[0]+src[1]/256.0f;
   uint8_t depth=0x80,phase=0,rphase=0;
@@ -317,6 +350,7 @@ static struct synth_pipe_stage *synth_pipe_detune_new(struct synth_song *song,co
   STAGE->rp=rphase; STAGE->rp|=STAGE->rp<<8; STAGE->rp|=STAGE->rp<<16;
   
   STAGE->sinemlt=((float)STAGE->ringl.c-1.0f)*0.5f;
+  stage->tail=STAGE->ringl.c;
   
   return stage;
 }
@@ -330,7 +364,7 @@ struct synth_stage_waveshaper {
   struct synth_pipe_stage hdr;
   int ptc;
   float *ptv;
-  float scaleup;
+  float scale; // (ptc/2), to map -1..1 onto 0..ptc.
 };
 
 #define STAGE ((struct synth_stage_waveshaper*)stage)
@@ -339,24 +373,21 @@ static void _waveshaper_del(struct synth_pipe_stage *stage) {
   if (STAGE->ptv) synth_free(STAGE->ptv);
 }
 
+// One sample. Also used by fused stages.
+static inline float synth_waveshaper_1(const struct synth_stage_waveshaper *waveshaper,float v) {
+  float vup=(v+1.0f)*waveshaper->scale;
+  int plo=(int)vup;
+  if (plo<0) return waveshaper->ptv[0];
+  if (plo>=waveshaper->ptc-1) return waveshaper->ptv[waveshaper->ptc-1];
+  float lo=waveshaper->ptv[plo];
+  float hi=waveshaper->ptv[plo+1];
+  float n=vup-(float)plo;
+  if (n<0.0f) n=0.0f; else if (n>1.0f) n=1.0f;
+  return lo*(1.0f-n)+hi*n;
+}
+
 static void _waveshaper_update_mono(float *dst,struct synth_pipe_stage *stage,int framec) {
-  float scale=STAGE->ptc*0.5f;
-  int lastp=STAGE->ptc-1;
-  for (;framec-->0;dst++) {
-    float vup=((*dst)+1.0f)*scale;
-    int plo=(int)vup;
-    if (plo<0) {
-      *dst=STAGE->ptv[0];
-    } else if (plo>=lastp) {
-      *dst=STAGE->ptv[lastp];
-    } else {
-      float lo=STAGE->ptv[plo];
-      float hi=STAGE->ptv[plo+1];
-      float n=vup-(float)plo;
-      if (n<0.0f) n=0.0f; else if (n>1.0f) n=1.0f;
-      *dst=lo*(1.0f-n)+hi*n;
-    }
-  }
+  for (;framec-->0;dst++) *dst=synth_waveshaper_1(STAGE,*dst);
 }
 
 static void _waveshaper_update_stereo(float *dstl,float *dstr,struct synth_pipe_stage *stage,int framec) {
@@ -377,6 +408,7 @@ static struct synth_pipe_stage *synth_pipe_waveshaper_new(struct synth_song *son
   int explicitc=srcc>>1;
   if (explicitc) STAGE->ptc=1+(explicitc<<1);
   else STAGE->ptc=3;
+  STAGE->scale=STAGE->ptc*0.5f;
   if (!(STAGE->ptv=synth_malloc(sizeof(float)*STAGE->ptc))) {
     synth_free(stage);
     return 0;
@@ -436,6 +468,75 @@ static struct synth_pipe_stage *synth_pipe_notch_new(struct synth_song *song,con
 
 #undef STAGE
 
+/* Fused pairs of memoryless stages, GAIN and WAVESHAPER in any combination.
+ * synth_pipe_new() builds these after decoding, so a gain-into-waveshaper distortion makes one pass over the buffer instead of two.
+ * Each sample goes through both stages back to back; output is exactly the same as running them separately.
+ * We keep the original stages and own them. Profiling counts the pair under the first one's opcode.
+ */
+ 
+struct synth_stage_fused {
+  struct synth_pipe_stage hdr;
+  struct synth_pipe_stage *a,*b;
+};
+
+#define STAGE ((struct synth_stage_fused*)stage)
+
+static void _fused_del(struct synth_pipe_stage *stage) {
+  if (STAGE->a->del) STAGE->a->del(STAGE->a);
+  synth_free(STAGE->a);
+  if (STAGE->b->del) STAGE->b->del(STAGE->b);
+  synth_free(STAGE->b);
+}
+
+#define FUSED_KERNEL(na,ta,fa,nb,tb,fb) \
+  static void _fused_##na##_##nb##_update_mono(float *dst,struct synth_pipe_stage *stage,int framec) { \
+    const struct ta *a=(struct ta*)STAGE->a; \
+    const struct tb *b=(struct tb*)STAGE->b; \
+    for (;framec-->0;dst++) *dst=fb(b,fa(a,*dst)); \
+  } \
+  static void _fused_##na##_##nb##_update_stereo(float *dstl,float *dstr,struct synth_pipe_stage *stage,int framec) { \
+    _fused_##na##_##nb##_update_mono(dstl,stage,framec); \
+    _fused_##na##_##nb##_update_mono(dstr,stage,framec); \
+  }
+FUSED_KERNEL(gain,synth_stage_gain,synth_gain_1,gain,synth_stage_gain,synth_gain_1)
+FUSED_KERNEL(gain,synth_stage_gain,synth_gain_1,waveshaper,synth_stage_waveshaper,synth_waveshaper_1)
+FUSED_KERNEL(waveshaper,synth_stage_waveshaper,synth_waveshaper_1,gain,synth_stage_gain,synth_gain_1)
+FUSED_KERNEL(waveshaper,synth_stage_waveshaper,synth_waveshaper_1,waveshaper,synth_stage_waveshaper,synth_waveshaper_1)
+#undef FUSED_KERNEL
+
+/* Null if (a,b) can't fuse, and then they're still yours.
+ * Otherwise the new stage owns them.
+ */
+static struct synth_pipe_stage *synth_pipe_fused_new(struct synth_pipe_stage *a,struct synth_pipe_stage *b) {
+  void (*update_mono)(float*,struct synth_pipe_stage*,int)=0;
+  void (*update_stereo)(float*,float*,struct synth_pipe_stage*,int)=0;
+  #define PAIR(ta,na,tb,nb) if ((a->type==ta)&&(b->type==tb)) { \
+    update_mono=_fused_##na##_##nb##_update_mono; \
+    update_stereo=_fused_##na##_##nb##_update_stereo; \
+  }
+  PAIR(0x01,gain,0x01,gain)
+  else PAIR(0x01,gain,0x05,waveshaper)
+  else PAIR(0x05,waveshaper,0x01,gain)
+  else PAIR(0x05,waveshaper,0x05,waveshaper)
+  else return 0;
+  #undef PAIR
+  // Both halves must still be their original selves, not already fused or bypassable.
+  if (a->expendable||b->expendable) return 0;
+  if ((a->update_mono!=_gain_update_mono)&&(a->update_mono!=_waveshaper_update_mono)) return 0;
+  if ((b->update_mono!=_gain_update_mono)&&(b->update_mono!=_waveshaper_update_mono)) return 0;
+  struct synth_pipe_stage *stage=synth_calloc(1,sizeof(struct synth_stage_fused));
+  if (!stage) return 0;
+  stage->type=a->type;
+  stage->del=_fused_del;
+  stage->update_mono=update_mono;
+  stage->update_stereo=update_stereo;
+  STAGE->a=a;
+  STAGE->b=b;
+  return stage;
+}
+
+#undef STAGE
+
 /* New stage.
  */
  
@@ -487,7 +588,25 @@ static int synth_pipe_add_stage(struct synth_pipe *pipe,uint8_t type,const uint8
   }
   struct synth_pipe_stage *stage=synth_pipe_stage_new(pipe->song,type,src,srcc);
   if (!stage) return -1;
+  
+  // Noops, including the filters we haven't implemented yet, needn't cost anything.
+  if (stage->update_mono==_noop_update_mono) {
+    if (stage->del) stage->del(stage);
+    synth_free(stage);
+    return 0;
+  }
+  
+  // Fuse with the previous stage if we can.
+  if (pipe->stagec) {
+    struct synth_pipe_stage *fused=synth_pipe_fused_new(pipe->stagev[pipe->stagec-1],stage);
+    if (fused) {
+      pipe->stagev[pipe->stagec-1]=fused;
+      return 0;
+    }
+  }
+  
   pipe->stagev[pipe->stagec++]=stage;
+  pipe->tail+=stage->tail;
   return 0;
 }
 
@@ -518,22 +637,90 @@ struct synth_pipe *synth_pipe_new(struct synth_song *owner,const uint8_t *src,in
 }
 
 /* Update.
+ * We run every stage over one block before moving to the next, so the block stays in L1 between stages.
+ * Stereo blocks are 2 KB. Delay and detune rings are touched once per frame either way.
+ * At reduced quality, expendable stages pass their input through, and advance oscillators so they resume in phase.
+ * The profiled path runs whole buffers, so per-stage timing isn't dominated by clock reads.
  */
+ 
+static void synth_pipe_stage_bypass(struct synth_pipe_stage *stage,int framec) {
+  if (stage->skip) stage->skip(stage,framec);
+}
 
-void synth_pipe_update_mono(float *dst,struct synth_pipe *pipe,int framec) {
+static void synth_pipe_update_profiled(float *dstl,float *dstr,struct synth_pipe *pipe,int framec,struct synth_profile_song *prof) {
   struct synth_pipe_stage **p=pipe->stagev;
   int i=pipe->stagec;
+  int64_t then=synth_profile_now();
+  int bypass=synth_song_quality(pipe->song)>SYNTH_QUALITY_FULL;
   for (;i-->0;p++) {
     struct synth_pipe_stage *stage=*p;
-    stage->update_mono(dst,stage,framec);
+    if (bypass&&stage->expendable) synth_pipe_stage_bypass(stage,framec);
+    else if (dstr) stage->update_stereo(dstl,dstr,stage,framec);
+    else stage->update_mono(dstl,stage,framec);
+    int64_t now=synth_profile_now();
+    prof->stage_ns[(stage->type<SYNTH_PROFILE_STAGE_LIMIT)?stage->type:(SYNTH_PROFILE_STAGE_LIMIT-1)]+=now-then;
+    then=now;
+  }
+}
+
+void synth_pipe_update_mono(float *dst,struct synth_pipe *pipe,int framec) {
+  if (pipe->song&&pipe->song->prof) {
+    synth_pipe_update_profiled(dst,0,pipe,framec,pipe->song->prof);
+    return;
+  }
+  int bypass=synth_song_quality(pipe->song)>SYNTH_QUALITY_FULL;
+  while (framec>0) {
+    int blockc=(framec>SYNTH_PIPE_BLOCK_FRAMES)?SYNTH_PIPE_BLOCK_FRAMES:framec;
+    struct synth_pipe_stage **p=pipe->stagev;
+    int i=pipe->stagec;
+    for (;i-->0;p++) {
+      struct synth_pipe_stage *stage=*p;
+      if (bypass&&stage->expendable) synth_pipe_stage_bypass(stage,blockc);
+      else stage->update_mono(dst,stage,blockc);
+    }
+    dst+=blockc;
+    framec-=blockc;
   }
 }
 
 void synth_pipe_update_stereo(float *dstl,float *dstr,struct synth_pipe *pipe,int framec) {
+  if (pipe->song&&pipe->song->prof) {
+    synth_pipe_update_profiled(dstl,dstr,pipe,framec,pipe->song->prof);
+    return;
+  }
+  int bypass=synth_song_quality(pipe->song)>SYNTH_QUALITY_FULL;
+  while (framec>0) {
+    int blockc=(framec>SYNTH_PIPE_BLOCK_FRAMES)?SYNTH_PIPE_BLOCK_FRAMES:framec;
+    struct synth_pipe_stage **p=pipe->stagev;
+    int i=pipe->stagec;
+    for (;i-->0;p++) {
+      struct synth_pipe_stage *stage=*p;
+      if (bypass&&stage->expendable) synth_pipe_stage_bypass(stage,blockc);
+      else stage->update_stereo(dstl,dstr,stage,blockc);
+    }
+    dstl+=blockc;
+    dstr+=blockc;
+    framec-=blockc;
+  }
+}
+
+/* Skip and clear, while the channel sleeps.
+ */
+ 
+void synth_pipe_skip(struct synth_pipe *pipe,int framec) {
+  struct synth_pipe_stage **p=pipe->stagev;
+  int i=pipe->stagec;
+  for (;i-->0;p++) {
+    struct synth_pipe_stage *stage=*p;
+    if (stage->skip) stage->skip(stage,framec);
+  }
+}
+
+void synth_pipe_clear(struct synth_pipe *pipe) {
   struct synth_pipe_stage **p=pipe->stagev;
   int i=pipe->stagec;
   for (;i-->0;p++) {
     struct synth_pipe_stage *stage=*p;
-    stage->update_stereo(dstl,dstr,stage,framec);
+    if (stage->clear) stage->clear(stage);
   }
 }
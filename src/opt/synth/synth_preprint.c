@@ -0,0 +1,241 @@
+/* synth_preprint.c
+ * Optional printing of every sound resource up front, so the first play of each costs nothing.
+ * Where threads are available, one background thread prints them all in ROM order, to private PCM objects.
+ * The main thread adopts each finished PCM into its resource the next time it looks, ie in synth_play_sound() or synth_preprint_update().
+ * Otherwise (web, fake malloc), caller drives it incrementally with synth_preprint_update(), between updates.
+ * Either way, drums inside sounds print completely and immediately, instead of joining the global printer list.
+ */
+
+#include "synth_internal.h"
+
+#if SYNTH_THREADS_AVAILABLE
+  #include <pthread.h>
+#endif
+
+SYNTH_THREAD_LOCAL int synth_print_immediate=0;
+
+struct synth_preprint {
+  struct synth_preprint_job {
+    int rid; // Including SYNTH_RID_SOUND.
+    const void *serial; // WEAK, points into (synth.rom).
+    int serialc;
+    struct synth_pcm *pcm; // STRONG, until adopted.
+  } *jobv;
+  int jobc;
+  int adoptp; // Jobs below this have been adopted or discarded.
+  // Incremental mode only:
+  struct synth_printer *printer;
+  // Background mode only:
+  int background;
+  int donec; // Jobs below this are printed. Written by the background thread, accessed atomically.
+  int cancel; // Accessed atomically.
+  #if SYNTH_THREADS_AVAILABLE
+    pthread_t thread;
+    struct synth_context *context; // WEAK. The thread adopts it as current.
+  #endif
+};
+
+/* Print an entire EAU file right now.
+ */
+
+struct synth_pcm *synth_print_now(const void *src,int srcc,const int *cancel) {
+  struct synth_printer *printer=synth_printer_new(src,srcc);
+  if (!printer) return 0;
+  synth_print_immediate++;
+  while (synth_printer_update(printer,synth.buffer_frames)>0) {
+    if (cancel&&__atomic_load_n(cancel,__ATOMIC_ACQUIRE)) break;
+  }
+  synth_print_immediate--;
+  struct synth_pcm *pcm=0;
+  if (printer->p>=printer->pcm->c) {
+    if (synth_pcm_ref(printer->pcm)>=0) pcm=printer->pcm;
+  }
+  synth_printer_del(printer);
+  return pcm;
+}
+
+/* Background thread.
+ */
+
+#if SYNTH_THREADS_AVAILABLE
+
+static void *synth_preprint_main(void *arg) {
+  struct synth_preprint *preprint=arg;
+  synth_current=preprint->context;
+  struct synth_preprint_job *job=preprint->jobv;
+  int i=0;
+  for (;i<preprint->jobc;i++,job++) {
+    if (__atomic_load_n(&preprint->cancel,__ATOMIC_ACQUIRE)) break;
+    job->pcm=synth_print_now(job->serial,job->serialc,&preprint->cancel);
+    __atomic_store_n(&preprint->donec,i+1,__ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+#endif
+
+/* Delete.
+ */
+
+void synth_preprint_del(struct synth_preprint *preprint) {
+  if (!preprint) return;
+  #if SYNTH_THREADS_AVAILABLE
+    if (preprint->background) {
+      __atomic_store_n(&preprint->cancel,1,__ATOMIC_RELEASE);
+      pthread_join(preprint->thread,0);
+    }
+  #endif
+  synth_printer_del(preprint->printer);
+  if (preprint->jobv) {
+    struct synth_preprint_job *job=preprint->jobv;
+    int i=preprint->jobc;
+    for (;i-->0;job++) synth_pcm_del(job->pcm);
+    synth_free(preprint->jobv);
+  }
+  synth_free(preprint);
+}
+
+/* New.
+ * Lists every sound that hasn't been printed yet.
+ * Returns null if there aren't any, so check (synth.resc) to tell errors apart.
+ */
+
+static struct synth_preprint *synth_preprint_new() {
+  synth_res_get(0); // Forces the TOC to build.
+  int jobc=0,i=synth.resc;
+  struct synth_res *res=synth.resv;
+  for (;i-->0;res++) {
+    if ((res->rid&SYNTH_RID_SOUND)&&!res->pcm) jobc++;
+  }
+  if (!jobc) return 0;
+  struct synth_preprint *preprint=synth_calloc(1,sizeof(struct synth_preprint));
+  if (!preprint) return 0;
+  if (!(preprint->jobv=synth_calloc(jobc,sizeof(struct synth_preprint_job)))) {
+    synth_free(preprint);
+    return 0;
+  }
+  for (i=synth.resc,res=synth.resv;i-->0;res++) {
+    if (!(res->rid&SYNTH_RID_SOUND)||res->pcm) continue;
+    struct synth_preprint_job *job=preprint->jobv+preprint->jobc++;
+    job->rid=res->rid;
+    job->serial=res->serial;
+    job->serialc=res->serialc;
+  }
+  return preprint;
+}
+
+/* Install a finished job into its resource, or drop it if the resource got printed on demand meanwhile.
+ */
+
+static void synth_preprint_adopt_job(struct synth_preprint_job *job) {
+  struct synth_res *res=synth_res_get(job->rid);
+  if (res&&!res->pcm) {
+    if (job->pcm) {
+      res->pcm=job->pcm;
+      job->pcm=0;
+    } else {
+      res->pcm=synth_pcm_new(1); // Malformed. Same marker synth_play_sound() would make.
+    }
+  }
+  synth_pcm_del(job->pcm);
+  job->pcm=0;
+}
+
+/* Adopt whatever the background thread has finished.
+ * Drops the preprint if it's complete.
+ */
+
+void synth_preprint_adopt() {
+  struct synth_preprint *preprint=synth.preprint;
+  if (!preprint||!preprint->background) return;
+  int donec=__atomic_load_n(&preprint->donec,__ATOMIC_ACQUIRE);
+  while (preprint->adoptp<donec) {
+    synth_preprint_adopt_job(preprint->jobv+preprint->adoptp++);
+  }
+  if (preprint->adoptp>=preprint->jobc) {
+    synth_preprint_del(preprint);
+    synth.preprint=0;
+  }
+}
+
+/* Begin, public entry point.
+ */
+
+int synth_preprint_sounds() {
+  if (synth.framec_in_progress) return -1;
+  if (!synth.rate) return -1;
+  if (synth.preprint) return 1;
+  if (!(synth.preprint=synth_preprint_new())) {
+    return synth.resc?-1:0;
+  }
+  #if SYNTH_THREADS_AVAILABLE
+    synth.preprint->context=synth_current;
+    if (!pthread_create(&synth.preprint->thread,0,synth_preprint_main,synth.preprint)) {
+      synth.preprint->background=1;
+    }
+  #endif
+  return 1;
+}
+
+/* Advance, public entry point.
+ */
+
+int synth_preprint_update(int framec) {
+  if (synth.framec_in_progress) return synth.preprint?1:0;
+  struct synth_preprint *preprint=synth.preprint;
+  if (!preprint) return 0;
+  if (preprint->background) {
+    synth_preprint_adopt();
+    return synth.preprint?1:0;
+  }
+  while ((framec>0)&&(preprint->adoptp<preprint->jobc)) {
+    struct synth_preprint_job *job=preprint->jobv+preprint->adoptp;
+    if (!preprint->printer) {
+      struct synth_res *res=synth_res_get(job->rid);
+      if (!res||res->pcm) { // Played and printed on demand before we got here.
+        preprint->adoptp++;
+        continue;
+      }
+      if (!(preprint->printer=synth_printer_new(job->serial,job->serialc))) {
+        synth_preprint_adopt_job(job);
+        preprint->adoptp++;
+        continue;
+      }
+    }
+    int updc=(framec<synth.buffer_frames)?framec:synth.buffer_frames;
+    synth_print_immediate++;
+    int err=synth_printer_update(preprint->printer,updc);
+    synth_print_immediate--;
+    framec-=updc;
+    if ((err<=0)||(preprint->printer->p>=preprint->printer->pcm->c)) {
+      if (synth_pcm_ref(preprint->printer->pcm)>=0) job->pcm=preprint->printer->pcm;
+      synth_printer_del(preprint->printer);
+      preprint->printer=0;
+      synth_preprint_adopt_job(job);
+      preprint->adoptp++;
+    }
+  }
+  if (preprint->adoptp>=preprint->jobc) {
+    synth_preprint_del(preprint);
+    synth.preprint=0;
+    return 0;
+  }
+  return 1;
+}
+
+/* Report PCM size.
+ */
+
+int synth_get_pcm_size(int *soundc) {
+  int size=0,count=0,i=synth.resc;
+  const struct synth_res *res=synth.resv;
+  for (;i-->0;res++) {
+    if (!res->pcm||(res->pcm->c<=1)) continue;
+    count++;
+    int len=sizeof(struct synth_pcm)+sizeof(float)*res->pcm->c;
+    if (size>INT_MAX-len) size=INT_MAX;
+    else size+=len;
+  }
+  if (soundc) *soundc=count;
+  return size;
+}
@@ -0,0 +1,140 @@
+/* synth_profile.c
+ * CPU profiling counters, native only.
+ * The hot paths check (synth.profiling) or (song->prof) and call synth_profile_now() around their work.
+ * Live songs accumulate on their own (prof), so worker threads never touch shared counters.
+ * The main thread folds them into (synth.profsongv) when a song ends or someone asks.
+ */
+
+#include "synth_internal.h"
+
+#if SYNTH_PROFILE_AVAILABLE
+  #include <time.h>
+#endif
+
+/* Current time.
+ */
+
+int64_t synth_profile_now() {
+  #if SYNTH_PROFILE_AVAILABLE
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (int64_t)ts.tv_sec*1000000000ll+ts.tv_nsec;
+  #else
+    return 0;
+  #endif
+}
+
+/* Search the tally.
+ */
+
+static int synth_profile_song_search(int rid) {
+  int lo=0,hi=synth.profsongc;
+  while (lo<hi) {
+    int ck=(lo+hi)>>1;
+    int q=synth.profsongv[ck].rid;
+         if (rid<q) hi=ck;
+    else if (rid>q) lo=ck+1;
+    else return ck;
+  }
+  return -lo-1;
+}
+
+/* Fold one song into the tally.
+ */
+
+void synth_profile_song_fold(struct synth_song *song) {
+  struct synth_profile_song *src=song->prof;
+  if (!src) return;
+  int p=synth_profile_song_search(src->rid);
+  if (p<0) {
+    p=-p-1;
+    if (synth.profsongc>=synth.profsonga) {
+      int na=synth.profsonga+8;
+      if (na>INT_MAX/sizeof(struct synth_profile_song)) return;
+      void *nv=synth_realloc(synth.profsongv,sizeof(struct synth_profile_song)*na);
+      if (!nv) return;
+      synth.profsongv=nv;
+      synth.profsonga=na;
+    }
+    struct synth_profile_song *dst=synth.profsongv+p;
+    __builtin_memmove(dst+1,dst,sizeof(struct synth_profile_song)*(synth.profsongc-p));
+    synth.profsongc++;
+    __builtin_memset(dst,0,sizeof(struct synth_profile_song));
+    dst->rid=src->rid;
+  }
+  struct synth_profile_song *dst=synth.profsongv+p;
+  dst->framec+=src->framec;
+  dst->ns+=src->ns;
+  int i=0;
+  for (;i<16;i++) {
+    dst->channelv[i].ns+=src->channelv[i].ns;
+    dst->channelv[i].post_ns+=src->channelv[i].post_ns;
+    if (src->channelv[i].voicec_max>dst->channelv[i].voicec_max) dst->channelv[i].voicec_max=src->channelv[i].voicec_max;
+  }
+  for (i=0;i<SYNTH_PROFILE_STAGE_LIMIT;i++) dst->stage_ns[i]+=src->stage_ns[i];
+  int rid=src->rid;
+  __builtin_memset(src,0,sizeof(struct synth_profile_song));
+  src->rid=rid;
+}
+
+static void synth_profile_fold_live() {
+  int i=synth.songc;
+  while (i-->0) synth_profile_song_fold(synth.songv[i]);
+}
+
+/* Cleanup.
+ */
+
+void synth_profile_quit() {
+  if (synth.profsongv) synth_free(synth.profsongv);
+  synth.profsongv=0;
+  synth.profsongc=synth.profsonga=0;
+}
+
+/* Enable or disable, and reset.
+ */
+
+int synth_set_profiling(int enable) {
+  #if SYNTH_PROFILE_AVAILABLE
+    int i=synth.songc;
+    while (i-->0) {
+      struct synth_song *song=synth.songv[i];
+      if (song->prof) {
+        synth_free(song->prof);
+        song->prof=0;
+      }
+    }
+    synth.profsongc=0;
+    __builtin_memset(&synth.profile,0,sizeof(struct synth_profile));
+    synth.profiling=enable?1:0;
+    return 0;
+  #else
+    return -1;
+  #endif
+}
+
+/* Queries.
+ */
+
+int synth_get_profile(struct synth_profile *dst) {
+  if (!dst) return -1;
+  if (!synth.profiling) return -1;
+  synth_profile_fold_live();
+  *dst=synth.profile;
+  const struct synth_profile_song *song=synth.profsongv;
+  int i=synth.profsongc;
+  for (;i-->0;song++) {
+    int si=0;
+    for (;si<SYNTH_PROFILE_STAGE_LIMIT;si++) dst->stage_ns[si]+=song->stage_ns[si];
+  }
+  return 0;
+}
+
+int synth_get_song_profiles(struct synth_profile_song *dst,int dsta) {
+  if (!synth.profiling) return 0;
+  synth_profile_fold_live();
+  int cpc=synth.profsongc;
+  if (cpc>dsta) cpc=dsta;
+  if (cpc>0) __builtin_memcpy(dst,synth.profsongv,sizeof(struct synth_profile_song)*cpc);
+  return synth.profsongc;
+}
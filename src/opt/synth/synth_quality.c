@@ -0,0 +1,144 @@
+/* synth_quality.c
+ * Adaptive quality: Trade timbre for CPU when the host can't keep up.
+ * synth_quality_update() runs at the end of every synth_update(), on the audio thread.
+ * synth_report_underrun() comes from the audio driver, also on the audio thread, with the driver's lock held.
+ * synth_set_adaptive_quality() and synth_get_quality() run on the main thread, and the caller must hold that lock.
+ * So the counters below (quality_load thru quality_restored_at) belong to the audio thread, except while locked.
+ */
+
+#include "synth_internal.h"
+
+#define SYNTH_QUALITY_HOLD_S 0.5 /* Minimum time between changes. */
+#define SYNTH_QUALITY_CALM_S 2.0 /* Time under (restore) before stepping back up, initially. */
+#define SYNTH_QUALITY_CALM_LIMIT_S 32.0 /* ...it doubles each time a restore doesn't stick, up to this. */
+#define SYNTH_QUALITY_SMOOTH 0.25f /* Weight of the newest measurement. */
+#define SYNTH_QUALITY_OVER_BUFFERS 4 /* Consecutive buffers over (degrade) before stepping down. One preemption shouldn't cost the music. */
+
+// Polyphony per channel at each quality. Channels that allocated fewer keep what they have.
+static const int synth_quality_voice_limit[3]={SYNTH_VOICE_LIMIT,8,4};
+
+/* Accessors for channels and stages.
+ */
+
+int synth_song_quality(const struct synth_song *song) {
+  if (!song||!song->rid) return SYNTH_QUALITY_FULL;
+  return synth.quality;
+}
+
+int synth_channel_quality(const struct synth_channel *channel) {
+  return synth_song_quality(channel->song);
+}
+
+int synth_channel_voice_limit(const struct synth_channel *channel,int voicea) {
+  int limit=synth_quality_voice_limit[synth_channel_quality(channel)];
+  if (voicea<limit) return voicea;
+  return limit;
+}
+
+/* Change quality and notify channels.
+ */
+
+static int synth_quality_frames(double s) {
+  int rate=synth.outrate?synth.outrate:synth.rate;
+  return (int)(s*rate);
+}
+
+static void synth_quality_set(int quality) {
+  if (quality<SYNTH_QUALITY_FULL) quality=SYNTH_QUALITY_FULL;
+  else if (quality>SYNTH_QUALITY_MINIMAL) quality=SYNTH_QUALITY_MINIMAL;
+  if (quality==synth.quality) return;
+  synth.quality=quality;
+  synth.quality_holdc=synth_quality_frames(SYNTH_QUALITY_HOLD_S);
+  synth.quality_calmc=0;
+  int si=synth.songc;
+  while (si-->0) {
+    struct synth_song *song=synth.songv[si];
+    struct synth_channel **p=song->channelv;
+    int ci=song->channelc;
+    for (;ci-->0;p++) {
+      struct synth_channel *channel=*p;
+      if (channel->type->quality_changed) channel->type->quality_changed(channel);
+    }
+  }
+}
+
+static int synth_quality_calm_need() {
+  if (!synth.quality_calm_need) synth.quality_calm_need=synth_quality_frames(SYNTH_QUALITY_CALM_S);
+  return synth.quality_calm_need;
+}
+
+static void synth_quality_degrade() {
+  if (synth.quality>=SYNTH_QUALITY_MINIMAL) return;
+  // Degrading soon after a restore means the restore was premature. Wait longer next time.
+  if (synth.quality_restored_at&&(synth.quality_clock-synth.quality_restored_at<synth_quality_calm_need())) {
+    int limit=synth_quality_frames(SYNTH_QUALITY_CALM_LIMIT_S);
+    if (synth.quality_calm_need<limit/2) synth.quality_calm_need<<=1;
+    else synth.quality_calm_need=limit;
+  }
+  synth_quality_set(synth.quality+1);
+}
+
+/* Public API.
+ */
+
+void synth_set_adaptive_quality(float degrade,float restore) {
+  if (degrade>0.0f) {
+    if (restore>degrade) restore=degrade;
+    synth.quality_degrade=degrade;
+    synth.quality_restore=restore;
+  } else {
+    synth.quality_degrade=0.0f;
+    synth.quality_restore=0.0f;
+    synth_quality_set(SYNTH_QUALITY_FULL);
+  }
+  synth.quality_load=0.0f;
+  synth.quality_overc=0;
+  synth.quality_calmc=0;
+  synth.quality_calm_need=0;
+  synth.quality_restored_at=0;
+}
+
+int synth_get_quality() {
+  return synth.quality;
+}
+
+void synth_report_underrun() {
+  if (synth.quality_holdc>0) return; // One glitch often gets reported more than once.
+  synth_quality_degrade();
+}
+
+/* Measure one update.
+ */
+
+void synth_quality_update(int64_t ns,int framec) {
+  synth.quality_clock+=framec;
+  if (synth.quality_holdc>0) synth.quality_holdc-=framec;
+  
+  /* If we're measuring, load over (degrade) for several buffers in a row steps down.
+   * A lone spike, eg the OS preempting us once, doesn't count; only sustained pressure does.
+   * The smoothed load decides when it's calm enough to step back up.
+   * Without measurement, only synth_report_underrun() steps down, and we step back up after a quiet spell.
+   */
+  if ((synth.quality_degrade>0.0f)&&(ns>0)) {
+    int rate=synth.outrate?synth.outrate:synth.rate;
+    float load=(float)((double)ns*rate/((double)framec*1000000000.0));
+    synth.quality_load+=(load-synth.quality_load)*SYNTH_QUALITY_SMOOTH;
+    if (load>synth.quality_degrade) synth.quality_overc++;
+    else synth.quality_overc=0;
+    if (synth.quality_holdc>0) return;
+    if (synth.quality_overc>=SYNTH_QUALITY_OVER_BUFFERS) {
+      synth.quality_overc=0;
+      synth_quality_degrade();
+      return;
+    }
+    if (synth.quality_load<synth.quality_restore) synth.quality_calmc+=framec;
+    else synth.quality_calmc=0;
+  } else if (synth.quality_calmc<INT_MAX-framec) {
+    synth.quality_calmc+=framec;
+  }
+  
+  if ((synth.quality>SYNTH_QUALITY_FULL)&&(synth.quality_holdc<=0)&&(synth.quality_calmc>=synth_quality_calm_need())) {
+    synth_quality_set(synth.quality-1);
+    synth.quality_restored_at=synth.quality_clock;
+  }
+}
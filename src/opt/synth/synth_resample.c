@@ -0,0 +1,163 @@
+/* synth_resample.c
+ * Upsampling from our internal rate to the output rate, when the caller asks us to synthesize lower.
+ * Our music has little above 10 kHz, so rendering at 22 or 24 kHz and resampling once after the mix saves most of the synth's work.
+ * Windowed sinc with SYNTH_RESAMPLE_TAPS taps, cut off a little below the input's Nyquist.
+ * The kernel is tabulated at SYNTH_RESAMPLE_PHASES fractional offsets, and we interpolate linearly between them.
+ */
+
+#include "synth_internal.h"
+
+#define SYNTH_RESAMPLE_CUTOFF 0.9 /* Relative to input Nyquist. */
+#define SYNTH_RESAMPLE_HALF (SYNTH_RESAMPLE_TAPS>>1)
+
+/* Delete.
+ */
+
+void synth_resampler_del(struct synth_resampler *resampler) {
+  if (!resampler) return;
+  if (resampler->v[0]) synth_free(resampler->v[0]);
+  if (resampler->v[1]) synth_free(resampler->v[1]);
+  synth_free(resampler);
+}
+
+/* sin(2*pi*turns) from our sine table, interpolated. No libm.
+ */
+
+static double synth_resample_sin(double turns) {
+  turns-=(double)(int64_t)turns;
+  if (turns<0.0) turns+=1.0;
+  if (turns>=1.0) turns=0.0;
+  uint32_t norm=(uint32_t)(turns*4294967296.0);
+  int p=norm>>SYNTH_WAVE_SHIFT;
+  int np=(p+1)&(SYNTH_WAVE_SIZE_SAMPLES-1);
+  double hi=(double)(norm&((1<<SYNTH_WAVE_SHIFT)-1))/(double)(1<<SYNTH_WAVE_SHIFT);
+  return synth.sine.v[p]*(1.0-hi)+synth.sine.v[np]*hi;
+}
+
+/* Tabulate the kernel.
+ * Phase (p) is for an output frame (p/PHASES) of the way past input frame (i).
+ * Tap (k) applies to input frame (i-HALF+1+k).
+ */
+
+static void synth_resampler_generate_kernel(struct synth_resampler *resampler) {
+  const double PI=3.141592653589793;
+  float *dst=resampler->kernel;
+  int p=0;
+  for (;p<=SYNTH_RESAMPLE_PHASES;p++,dst+=SYNTH_RESAMPLE_TAPS) {
+    double frac=(double)p/(double)SYNTH_RESAMPLE_PHASES;
+    double sum=0.0;
+    int k=0;
+    for (;k<SYNTH_RESAMPLE_TAPS;k++) {
+      double x=(double)(k-SYNTH_RESAMPLE_HALF+1)-frac;
+      double y=x*SYNTH_RESAMPLE_CUTOFF;
+      double sinc=((y>-0.000001)&&(y<0.000001))?1.0:synth_resample_sin(y*0.5)/(PI*y);
+      double u=x/(double)SYNTH_RESAMPLE_HALF; // Blackman window over -1..1.
+      double w=0.42+0.5*synth_resample_sin(u*0.5+0.25)+0.08*synth_resample_sin(u+0.25);
+      if ((u<=-1.0)||(u>=1.0)) w=0.0;
+      double h=sinc*w;
+      dst[k]=(float)h;
+      sum+=h;
+    }
+    // Normalize each phase to unity gain, so DC passes exactly.
+    if (sum>0.0) for (k=0;k<SYNTH_RESAMPLE_TAPS;k++) dst[k]=(float)(dst[k]/sum);
+  }
+}
+
+/* New.
+ */
+
+struct synth_resampler *synth_resampler_new(int inrate,int outrate,int chanc,int outframes) {
+  if ((inrate<1)||(outrate<1)||(outframes<1)) return 0;
+  struct synth_resampler *resampler=synth_calloc(1,sizeof(struct synth_resampler));
+  if (!resampler) return 0;
+  resampler->step=((uint64_t)inrate<<32)/(uint64_t)outrate;
+  int64_t inframes=(((int64_t)outframes*resampler->step)>>32)+1;
+  if (inframes>INT_MAX-SYNTH_RESAMPLE_TAPS*2) {
+    synth_resampler_del(resampler);
+    return 0;
+  }
+  resampler->a=(int)inframes+SYNTH_RESAMPLE_TAPS*2;
+  if (!(resampler->v[0]=synth_calloc(resampler->a,sizeof(float)))) {
+    synth_resampler_del(resampler);
+    return 0;
+  }
+  if (chanc>=2) {
+    if (!(resampler->v[1]=synth_calloc(resampler->a,sizeof(float)))) {
+      synth_resampler_del(resampler);
+      return 0;
+    }
+  }
+  // Start with silent history, enough that the first output frame has all its taps.
+  resampler->c=SYNTH_RESAMPLE_HALF-1;
+  resampler->pos=(uint64_t)(SYNTH_RESAMPLE_HALF-1)<<32;
+  synth_resampler_generate_kernel(resampler);
+  return resampler;
+}
+
+/* Input.
+ */
+
+int synth_resampler_get_input_needed(const struct synth_resampler *resampler,int framec) {
+  if (framec<1) return 0;
+  int last=(int)((resampler->pos+(uint64_t)(framec-1)*resampler->step)>>32);
+  int need=last+SYNTH_RESAMPLE_HALF+1-resampler->c;
+  return (need>0)?need:0;
+}
+
+void synth_resampler_input(struct synth_resampler *resampler,const float *srcl,const float *srcr,int framec) {
+  if (framec>resampler->a-resampler->c) framec=resampler->a-resampler->c;
+  if (framec<1) return;
+  __builtin_memcpy(resampler->v[0]+resampler->c,srcl,sizeof(float)*framec);
+  if (resampler->v[1]) __builtin_memcpy(resampler->v[1]+resampler->c,srcr?srcr:srcl,sizeof(float)*framec);
+  resampler->c+=framec;
+}
+
+/* One output sample.
+ */
+
+static inline float synth_resampler_dot(const float *src,const float *k0,const float *k1,float t) {
+  synth_v4f sum={0.0f,0.0f,0.0f,0.0f};
+  synth_v4f tv={t,t,t,t};
+  int i=SYNTH_RESAMPLE_TAPS>>2;
+  for (;i-->0;src+=4,k0+=4,k1+=4) {
+    synth_v4f a=*(const synth_v4f*)k0;
+    synth_v4f b=*(const synth_v4f*)k1;
+    sum+=(*(const synth_v4f*)src)*(a+(b-a)*tv);
+  }
+  return sum[0]+sum[1]+sum[2]+sum[3];
+}
+
+/* Output.
+ */
+
+void synth_resampler_output(float *dstl,float *dstr,struct synth_resampler *resampler,int framec) {
+  const uint32_t PHASE_SHIFT=32-SYNTH_RESAMPLE_PHASE_BITS;
+  const float TSCALE=1.0f/(float)(1<<PHASE_SHIFT);
+  for (;framec-->0;dstl++) {
+    int i=(int)(resampler->pos>>32);
+    if (i+SYNTH_RESAMPLE_HALF>=resampler->c) break; // Caller didn't provide enough input. Leave the rest alone.
+    uint32_t frac=(uint32_t)resampler->pos;
+    int phase=frac>>PHASE_SHIFT;
+    float t=(float)(frac&((1<<PHASE_SHIFT)-1))*TSCALE;
+    const float *k0=resampler->kernel+phase*SYNTH_RESAMPLE_TAPS;
+    const float *k1=k0+SYNTH_RESAMPLE_TAPS;
+    int srcp=i-SYNTH_RESAMPLE_HALF+1;
+    *dstl=synth_resampler_dot(resampler->v[0]+srcp,k0,k1,t);
+    if (dstr) {
+      if (resampler->v[1]) *dstr=synth_resampler_dot(resampler->v[1]+srcp,k0,k1,t);
+      else *dstr=*dstl;
+      dstr++;
+    }
+    resampler->pos+=resampler->step;
+  }
+
+  // Drop input we won't need again.
+  int drop=(int)(resampler->pos>>32)-SYNTH_RESAMPLE_HALF+1;
+  if (drop>resampler->c) drop=resampler->c;
+  if (drop>0) {
+    resampler->c-=drop;
+    __builtin_memmove(resampler->v[0],resampler->v[0]+drop,sizeof(float)*resampler->c);
+    if (resampler->v[1]) __builtin_memmove(resampler->v[1],resampler->v[1]+drop,sizeof(float)*resampler->c);
+    resampler->pos-=(uint64_t)drop<<32;
+  }
+}
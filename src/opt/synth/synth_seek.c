@@ -0,0 +1,303 @@
+/* synth_seek.c
+ * Index of a song's event stream, so we can seek without replaying from the start.
+ * Built the first time anyone seeks or asks for duration, and cached on the song's synth_res.
+ * Each point is a position right before a delay, the time there, and the state of notes and wheels at that moment.
+ * Seeking is a binary search for the last point before the target, then a replay of at most SYNTH_SEEK_INTERVAL_MS.
+ */
+
+#include "synth_internal.h"
+
+#define SYNTH_SEEK_INTERVAL_MS 1000
+#define SYNTH_SEEK_HELD_LIMIT 64 /* Notes held at once beyond this, we forget. */
+#define SYNTH_SEEK_WHEEL_UNSET 0xffff
+
+struct synth_seek_note {
+  uint8_t chid,noteid,velocity;
+  int endms; // INT_MAX for a Note On still awaiting its Note Off.
+};
+
+struct synth_seek_point {
+  int evtp;
+  int ms;
+  int notep,notec; // Into (notev).
+  uint16_t wheel[16];
+};
+
+struct synth_seek {
+  int durms;
+  int loopp,loopms; // (loopp) zero if there's no Loop Point, same as song.
+  struct synth_seek_point *pointv;
+  int pointc,pointa;
+  struct synth_seek_note *notev;
+  int notec,notea;
+};
+
+/* Replay state, for both building and seeking.
+ */
+
+struct synth_seek_state {
+  const uint8_t *evtv;
+  int evtc;
+  int evtp;
+  int ms;
+  struct synth_seek_note heldv[SYNTH_SEEK_HELD_LIMIT];
+  int heldc;
+  uint16_t wheel[16];
+  int loopp,loopms;
+};
+
+/* Delete.
+ */
+
+void synth_seek_del(struct synth_seek *seek) {
+  if (!seek) return;
+  if (seek->pointv) synth_free(seek->pointv);
+  if (seek->notev) synth_free(seek->notev);
+  synth_free(seek);
+}
+
+/* Drop Note Once entries that have ended.
+ */
+
+static void synth_seek_state_expire(struct synth_seek_state *state) {
+  int i=state->heldc;
+  struct synth_seek_note *note=state->heldv+i-1;
+  for (;i-->0;note--) {
+    if (note->endms>state->ms) continue;
+    state->heldc--;
+    __builtin_memmove(note,note+1,sizeof(struct synth_seek_note)*(state->heldc-i));
+  }
+}
+
+static void synth_seek_state_hold(struct synth_seek_state *state,uint8_t chid,uint8_t noteid,uint8_t velocity,int endms) {
+  if (state->heldc>=SYNTH_SEEK_HELD_LIMIT) {
+    synth_seek_state_expire(state);
+    if (state->heldc>=SYNTH_SEEK_HELD_LIMIT) return;
+  }
+  struct synth_seek_note *note=state->heldv+state->heldc++;
+  note->chid=chid;
+  note->noteid=noteid;
+  note->velocity=velocity;
+  note->endms=endms;
+}
+
+static void synth_seek_state_release(struct synth_seek_state *state,uint8_t chid,uint8_t noteid) {
+  int i=state->heldc;
+  struct synth_seek_note *note=state->heldv+i-1;
+  for (;i-->0;note--) {
+    if (note->chid!=chid) continue;
+    if (note->noteid!=noteid) continue;
+    if (note->endms!=INT_MAX) continue;
+    state->heldc--;
+    __builtin_memmove(note,note+1,sizeof(struct synth_seek_note)*(state->heldc-i));
+  }
+}
+
+/* If a delay run starts at the state's position, return its length in bytes and put its duration in (*ms).
+ * Zero if the next thing is an event or EOF.
+ * Consecutive delays collect into one run, same as synth_song_update_stream.
+ */
+
+static int synth_seek_measure_delay(int *ms,const struct synth_seek_state *state) {
+  int p=state->evtp;
+  *ms=0;
+  while ((p<state->evtc)&&!(state->evtv[p]&0x80)) {
+    int d1=state->evtv[p++];
+    if (d1&0x40) d1=((d1&0x3f)+1)<<6;
+    (*ms)+=d1;
+  }
+  return p-state->evtp;
+}
+
+/* Apply one non-delay event and advance past it.
+ */
+
+static int synth_seek_state_event(struct synth_seek_state *state) {
+  if (state->evtp>=state->evtc) return -1;
+  uint8_t lead=state->evtv[state->evtp++];
+  const uint8_t *v=state->evtv+state->evtp;
+  int remaining=state->evtc-state->evtp;
+  uint8_t chid=lead&0x0f;
+  switch (lead&0xf0) {
+    case 0x80: {
+        if (remaining<2) return -1;
+        synth_seek_state_release(state,chid,v[0]);
+        state->evtp+=2;
+      } break;
+    case 0x90: {
+        if (remaining<2) return -1;
+        synth_seek_state_hold(state,chid,v[0],v[1],INT_MAX);
+        state->evtp+=2;
+      } break;
+    case 0xa0: {
+        if (remaining<3) return -1;
+        uint8_t noteid=v[0]>>1;
+        uint8_t velocity=((v[0]&1)<<6)|(v[1]>>2);
+        int durms=(((v[1]&3)<<8)|v[2])<<4;
+        if (durms>0) synth_seek_state_hold(state,chid,noteid,velocity,state->ms+durms);
+        state->evtp+=3;
+      } break;
+    case 0xe0: {
+        if (remaining<2) return -1;
+        state->wheel[chid]=v[0]|(v[1]<<7);
+        state->evtp+=2;
+      } break;
+    case 0xf0: switch (lead&0x0f) {
+        case 0x00: state->loopp=state->evtp; state->loopms=state->ms; break;
+        default: return -1;
+      } break;
+    default: return -1;
+  }
+  return 0;
+}
+
+/* Record a point at the state's current position.
+ */
+
+static int synth_seek_add_point(struct synth_seek *seek,struct synth_seek_state *state) {
+  synth_seek_state_expire(state);
+  if (seek->pointc>=seek->pointa) {
+    int na=seek->pointa+32;
+    if (na>INT_MAX/sizeof(struct synth_seek_point)) return -1;
+    void *nv=synth_realloc(seek->pointv,sizeof(struct synth_seek_point)*na);
+    if (!nv) return -1;
+    seek->pointv=nv;
+    seek->pointa=na;
+  }
+  if (seek->notec>seek->notea-state->heldc) {
+    int na=seek->notec+state->heldc+64;
+    if (na>INT_MAX/sizeof(struct synth_seek_note)) return -1;
+    void *nv=synth_realloc(seek->notev,sizeof(struct synth_seek_note)*na);
+    if (!nv) return -1;
+    seek->notev=nv;
+    seek->notea=na;
+  }
+  struct synth_seek_point *point=seek->pointv+seek->pointc++;
+  point->evtp=state->evtp;
+  point->ms=state->ms;
+  point->notep=seek->notec;
+  point->notec=state->heldc;
+  __builtin_memcpy(seek->notev+seek->notec,state->heldv,sizeof(struct synth_seek_note)*state->heldc);
+  seek->notec+=state->heldc;
+  __builtin_memcpy(point->wheel,state->wheel,sizeof(point->wheel));
+  return 0;
+}
+
+/* New.
+ */
+
+struct synth_seek *synth_seek_new(const uint8_t *evtv,int evtc) {
+  struct synth_seek *seek=synth_calloc(1,sizeof(struct synth_seek));
+  if (!seek) return 0;
+  struct synth_seek_state state={.evtv=evtv,.evtc=evtc};
+  __builtin_memset(state.wheel,0xff,sizeof(state.wheel));
+  if (synth_seek_add_point(seek,&state)<0) {
+    synth_seek_del(seek);
+    return 0;
+  }
+  while (state.evtp<state.evtc) {
+    int ms;
+    int len=synth_seek_measure_delay(&ms,&state);
+    if (len) {
+      if (state.ms-seek->pointv[seek->pointc-1].ms>=SYNTH_SEEK_INTERVAL_MS) {
+        if (synth_seek_add_point(seek,&state)<0) {
+          synth_seek_del(seek);
+          return 0;
+        }
+      }
+      state.evtp+=len;
+      state.ms+=ms;
+    } else if (synth_seek_state_event(&state)<0) {
+      synth_seek_del(seek);
+      return 0;
+    }
+  }
+  seek->durms=state.ms;
+  seek->loopp=state.loopp;
+  seek->loopms=state.loopms;
+  return seek;
+}
+
+/* Trivial accessors.
+ */
+
+int synth_seek_get_duration_ms(const struct synth_seek *seek) {
+  return seek->durms;
+}
+
+/* Apply to song.
+ */
+
+void synth_seek_apply(struct synth_song *song,const struct synth_seek *seek,int ms) {
+  if (ms<0) ms=0;
+
+  // Find the last point at or before (ms). There's always one at zero.
+  int lo=0,hi=synth.seek_disable?1:seek->pointc;
+  while (hi-lo>1) {
+    int ck=(lo+hi)>>1;
+    if (seek->pointv[ck].ms<=ms) lo=ck;
+    else hi=ck;
+  }
+  const struct synth_seek_point *point=seek->pointv+lo;
+  struct synth_seek_state state={
+    .evtv=song->evtv,
+    .evtc=song->evtc,
+    .evtp=point->evtp,
+    .ms=point->ms,
+    .heldc=point->notec,
+  };
+  __builtin_memcpy(state.heldv,seek->notev+point->notep,sizeof(struct synth_seek_note)*point->notec);
+  __builtin_memcpy(state.wheel,point->wheel,sizeof(state.wheel));
+
+  /* Replay from there.
+   * If (ms) lands inside a delay, we consume the whole delay and leave the remainder pending on the song.
+   */
+  int remainder=0;
+  while (state.evtp<state.evtc) {
+    int d;
+    int len=synth_seek_measure_delay(&d,&state);
+    if (len) {
+      if (state.ms>=ms) break;
+      state.evtp+=len;
+      if (state.ms+d>ms) {
+        remainder=state.ms+d-ms;
+        state.ms=ms;
+        break;
+      }
+      state.ms+=d;
+    } else if (synth_seek_state_event(&state)<0) {
+      break; // Can't happen, we validated at build.
+    }
+  }
+  synth_seek_state_expire(&state);
+
+  // Position the song.
+  struct synth_channel **p=song->channelv;
+  int i=song->channelc;
+  for (;i-->0;p++) synth_channel_release_all(*p);
+  song->evtp=state.evtp;
+  song->delay=synth_frames_from_ms(remainder);
+  song->phframes=synth_frames_from_ms(state.ms);
+  if (seek->loopp&&(seek->loopp<=state.evtp)) {
+    song->loopp=seek->loopp;
+    song->loopframes=synth_frames_from_ms(seek->loopms);
+  } else {
+    song->loopp=0;
+    song->loopframes=0;
+  }
+
+  // Restore wheels and held notes.
+  for (i=0;i<16;i++) {
+    if (state.wheel[i]==SYNTH_SEEK_WHEEL_UNSET) continue;
+    struct synth_channel *channel=song->channel_by_chid[i];
+    if (!channel) continue;
+    synth_channel_set_wheel(channel,(state.wheel[i]-0x2000)/8192.0f);
+  }
+  const struct synth_seek_note *note=state.heldv;
+  for (i=state.heldc;i-->0;note++) {
+    struct synth_channel *channel=song->channel_by_chid[note->chid];
+    if (!channel) continue;
+    if (note->endms==INT_MAX) synth_channel_note_on(channel,note->noteid,note->velocity);
+    else synth_channel_note_once(channel,note->noteid,note->velocity,note->endms-state.ms);
+  }
+}
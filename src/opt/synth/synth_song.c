@@ -9,6 +9,12 @@ void synth_song_del(struct synth_song *song) {
     while (song->channelc-->0) synth_channel_del(song->channelv[song->channelc]);
     synth_free(song->channelv);
   }
+  if (song->timedv) synth_free(song->timedv);
+  synth_songpcm_del(song->songpcm);
+  if (song->prof) {
+    synth_profile_song_fold(song);
+    synth_free(song->prof);
+  }
   synth_free(song);
 }
 
@@ -69,14 +75,13 @@ static int synth_song_decode_chhdr(struct synth_song *song,const uint8_t *src,in
 /* Decode fresh song.
  */
  
-static int synth_song_decode(struct synth_song *song,const uint8_t *src,int srcc) {
+static int synth_song_decode(struct synth_song *song,const uint8_t *src,int srcc,int live) {
   if (!src||(srcc<10)||__builtin_memcmp(src,"\0EAU",4)) return -1;
   int tempo=(src[4]<<8)|src[5];
   if (tempo<1) tempo=1;
   song->tempo=(float)tempo/1000.0f;
   int hdrlen=(src[6]<<24)|(src[7]<<16)|(src[8]<<8)|src[9];
   if ((hdrlen<0)||(10>srcc-hdrlen)) return -1;
-  if (synth_song_decode_chhdr(song,src+10,hdrlen)<0) return -1;
   int srcp=10+hdrlen;
   if (srcp>srcc-4) return -1;
   int evtlen=(src[srcp]<<24)|(src[srcp+1]<<16)|(src[srcp+2]<<8)|src[srcp+3];
@@ -84,23 +89,46 @@ static int synth_song_decode(struct synth_song *song,const uint8_t *src,int srcc
   if ((evtlen<1)||(srcp>srcc-evtlen)) return -1;
   song->evtv=src+srcp;
   song->evtc=evtlen;
+  // Channels look at the events during init, to size their voice pools.
+  // Prerendered songs don't get channels at all.
+  if (live&&(synth_song_decode_chhdr(song,src+10,hdrlen)<0)) return -1;
   return 0;
 }
 
 /* New.
  */
  
-struct synth_song *synth_song_new(int chanc,const void *src,int srcc,float trim,float pan) {
+struct synth_song *synth_song_new(int chanc,const void *src,int srcc,int rid,float trim,float pan) {
+  if (chanc<1) return 0;
+  struct synth_song *song=synth_calloc(1,sizeof(struct synth_song));
+  if (!song) return 0;
+  song->chanc=chanc;
+  song->rid=rid; // Before decoding; channels measure polyphony against the resource.
+  song->trim=(trim<0.0f)?0.0f:(trim>1.0f)?1.0f:trim;
+  song->pan=(pan<-1.0f)?-1.0f:(pan>1.0f)?1.0f:pan;
+  if (synth_song_decode(song,src,srcc,1)<0) {
+    synth_song_del(song);
+    return 0;
+  }
+  return song;
+}
+
+struct synth_song *synth_song_new_prerendered(int chanc,const void *src,int srcc,const void *pcm,int pcmc,float trim,float pan,int repeat) {
   if (chanc<1) return 0;
   struct synth_song *song=synth_calloc(1,sizeof(struct synth_song));
   if (!song) return 0;
   song->chanc=chanc;
+  song->repeat=repeat;
   song->trim=(trim<0.0f)?0.0f:(trim>1.0f)?1.0f:trim;
   song->pan=(pan<-1.0f)?-1.0f:(pan>1.0f)?1.0f:pan;
-  if (synth_song_decode(song,src,srcc)<0) {
+  if (
+    (synth_song_decode(song,src,srcc,0)<0)||
+    !(song->songpcm=synth_songpcm_new(pcm,pcmc,repeat))
+  ) {
     synth_song_del(song);
     return 0;
   }
+  synth_songpcm_set_gain(song->songpcm,song->trim,song->pan);
   return song;
 }
 
@@ -133,13 +161,13 @@ static void synth_song_wheel(struct synth_song *song,uint8_t chid,int v/*0..8192
   synth_channel_set_wheel(channel,fv);
 }
 
-/* Dispatch any events if ready, and pay out delays.
+/* Dispatch events from the song's own stream if ready, and pay out delays.
  * Returns the frame count until the next event but never more than (limit).
  * Whatever we return we will have just dropped from the delay.
  * Returns <=0 on errors or EOF.
  */
  
-static int synth_song_update_events(struct synth_song *song,int limit) {
+static int synth_song_update_stream(struct synth_song *song,int limit) {
   for (;;) {
   
     // If we have a delay in progress, that trumps all.
@@ -222,25 +250,115 @@ static int synth_song_update_events(struct synth_song *song,int limit) {
   }
 }
 
+/* Dispatch any scheduled events that are due.
+ */
+ 
+static void synth_song_dispatch_timed(struct synth_song *song) {
+  int dispc=0;
+  const struct synth_song_timed *timed=song->timedv;
+  for (;(dispc<song->timedc)&&!timed->delay;dispc++,timed++) {
+    switch (timed->event) {
+      case SYNTH_EVENT_NOTE_OFF: synth_song_note_off(song,timed->chid,timed->noteid,timed->velocity); break;
+      case SYNTH_EVENT_NOTE_ON: synth_song_note_on(song,timed->chid,timed->noteid,timed->velocity); break;
+      case SYNTH_EVENT_NOTE_ONCE: synth_song_note_once(song,timed->chid,timed->noteid,timed->velocity,timed->durms); break;
+    }
+  }
+  if (!dispc) return;
+  song->timedc-=dispc;
+  __builtin_memmove(song->timedv,song->timedv+dispc,sizeof(struct synth_song_timed)*song->timedc);
+}
+
+/* Merge scheduled events with the stream.
+ * Same contract as synth_song_update_stream, and we never step over a scheduled event.
+ */
+ 
+static int synth_song_update_events(struct synth_song *song,int limit) {
+  if (!song->timedc) return synth_song_update_stream(song,limit);
+  synth_song_dispatch_timed(song);
+  if (song->timedc&&(song->timedv[0].delay<limit)) limit=song->timedv[0].delay;
+  int updc=synth_song_update_stream(song,limit);
+  if ((updc>0)&&song->timedc) song->timedv[0].delay-=updc;
+  return updc;
+}
+
+/* Schedule event.
+ */
+ 
+int synth_song_schedule(struct synth_song *song,int delay,uint8_t event,uint8_t chid,uint8_t noteid,uint8_t velocity,int durms) {
+  if ((event!=SYNTH_EVENT_NOTE_OFF)&&(event!=SYNTH_EVENT_NOTE_ON)&&(event!=SYNTH_EVENT_NOTE_ONCE)) return -1;
+  if (chid>=0x10) return -1;
+  if (delay<0) delay=0;
+  if (song->timedc>=song->timeda) {
+    if (song->timeda>=SYNTH_SCHEDULE_LIMIT) return -1;
+    int na=song->timeda+16;
+    if (na>INT_MAX/sizeof(struct synth_song_timed)) return -1;
+    void *nv=synth_realloc(song->timedv,sizeof(struct synth_song_timed)*na);
+    if (!nv) return -1;
+    song->timedv=nv;
+    song->timeda=na;
+  }
+  /* Walk the list accumulating delays, and insert after everything at or before our time.
+   * Then our delay is relative to the one before us, and the one after us is relative to us.
+   */
+  int p=0;
+  for (;p<song->timedc;p++) {
+    struct synth_song_timed *next=song->timedv+p;
+    if (next->delay>delay) {
+      next->delay-=delay;
+      break;
+    }
+    delay-=next->delay;
+  }
+  struct synth_song_timed *timed=song->timedv+p;
+  __builtin_memmove(timed+1,timed,sizeof(struct synth_song_timed)*(song->timedc-p));
+  song->timedc++;
+  timed->delay=delay;
+  timed->event=event;
+  timed->chid=chid;
+  timed->noteid=noteid;
+  timed->velocity=velocity;
+  timed->durms=durms;
+  return 0;
+}
+
+int synth_song_reserve_schedule(struct synth_song *song) {
+  if (song->timeda>=SYNTH_SCHEDULE_LIMIT) return 0;
+  void *nv=synth_realloc(song->timedv,sizeof(struct synth_song_timed)*SYNTH_SCHEDULE_LIMIT);
+  if (!nv) return -1;
+  song->timedv=nv;
+  song->timeda=SYNTH_SCHEDULE_LIMIT;
+  return 0;
+}
+
 /* Update.
  */
  
-int synth_song_update(float *dstl,float *dstr,struct synth_song *song,int framec) {
+static int synth_song_update_inner(float *dstl,float *dstr,struct synth_song *song,int framec) {
   if (song->terminated) return 0;
+  if (dstr&&(song->chanc<2)) dstr=0;
   while (framec>0) {
-  
-    // Process ready events and capture time to next one.
-    int updc=synth_song_update_events(song,framec);
-    if (updc<=0) return updc;
+    int updc;
     
-    // Generate signal.
-    struct synth_channel **p=song->channelv;
-    int i=song->channelc;
-    if (dstr&&(song->chanc>=2)) {
-      for (;i-->0;p++) synth_channel_update_stereo(dstl,dstr,*p,updc);
-      dstr+=updc;
+    if (song->songpcm) {
+      // Prerendered. It stops short at the end frame if not repeating, and then we stop as if at the end of events.
+      if ((updc=synth_songpcm_update(dstl,dstr,song->songpcm,framec))<0) return -1;
+      if (updc<framec) synth_song_stop(song);
+      if (!updc) continue;
+      if (dstr) dstr+=updc;
     } else {
-      for (;i-->0;p++) synth_channel_update_mono(dstl,*p,updc);
+    
+      // Process ready events and capture time to next one.
+      if ((updc=synth_song_update_events(song,framec))<=0) return updc;
+      
+      // Generate signal.
+      struct synth_channel **p=song->channelv;
+      int i=song->channelc;
+      if (dstr) {
+        for (;i-->0;p++) synth_channel_update_stereo(dstl,dstr,*p,updc);
+        dstr+=updc;
+      } else {
+        for (;i-->0;p++) synth_channel_update_mono(dstl,*p,updc);
+      }
     }
     
     // Advance clocks.
@@ -258,6 +376,19 @@ int synth_song_update(float *dstl,float *dstr,struct synth_song *song,int framec
   return song->terminated?0:1;
 }
 
+int synth_song_update(float *dstl,float *dstr,struct synth_song *song,int framec) {
+  if (!synth.profiling||!song->rid) return synth_song_update_inner(dstl,dstr,song,framec);
+  if (!song->prof) {
+    if (!(song->prof=synth_calloc(1,sizeof(struct synth_profile_song)))) return synth_song_update_inner(dstl,dstr,song,framec);
+    song->prof->rid=song->rid;
+  }
+  int64_t then=synth_profile_now();
+  int err=synth_song_update_inner(dstl,dstr,song,framec);
+  song->prof->ns+=synth_profile_now()-then;
+  song->prof->framec+=framec;
+  return err;
+}
+
 /* End playback gently.
  */
  
@@ -265,19 +396,38 @@ void synth_song_stop(struct synth_song *song) {
   if (song->terminated) return;
   if (song->deathclock) return;
   song->songid=0;
+  song->timedc=0;
   int framec=(int)(SYNTH_FADEOUT_TIME_S*(float)synth.rate);
   if (framec<1) framec=1;
   song->deathclock=framec;
+  if (song->songpcm) synth_songpcm_fade_out(song->songpcm,framec);
   int i=song->channelc;
   struct synth_channel **p=song->channelv;
   for (;i-->0;p++) synth_channel_fade_out(*p,framec);
 }
 
+/* Seek index, shared by every song playing the same resource.
+ * Null if we don't have a resource, eg printers.
+ */
+ 
+static struct synth_seek *synth_song_get_seek(struct synth_song *song) {
+  if (!song->rid) return 0;
+  struct synth_res *res=synth_res_get(song->rid);
+  if (!res) return 0;
+  if (!res->seek) res->seek=synth_seek_new(song->evtv,song->evtc);
+  return res->seek;
+}
+
 /* Calculate duration.
  */
  
 int synth_song_get_duration_frames(struct synth_song *song) {
   if (!song->durframes) {
+    const struct synth_seek *seek=synth_song_get_seek(song);
+    if (seek) {
+      song->durframes=synth_frames_from_ms(synth_seek_get_duration_ms(seek));
+      return song->durframes;
+    }
     int p=0,ms=0;
     for (;p<song->evtc;) {
       uint8_t lead=song->evtv[p++];
@@ -298,51 +448,95 @@ int synth_song_get_duration_frames(struct synth_song *song) {
   return song->durframes;
 }
 
+/* Measure polyphony.
+ */
+ 
+static int synth_song_measure_polyphony_inner(const struct synth_song *song,uint8_t chid,int tailms,int limit) {
+  struct { uint8_t noteid; int endms; } notev[SYNTH_VOICE_LIMIT];
+  int notec=0,max=0,p=0,ms=0;
+  while (p<song->evtc) {
+    uint8_t lead=song->evtv[p++];
+    if (!(lead&0x80)) {
+      if (lead&0x40) ms+=((lead&0x3f)+1)<<6;
+      else ms+=lead;
+      continue;
+    }
+    const uint8_t *v=song->evtv+p;
+    int len=0;
+    switch (lead&0xf0) {
+      case 0x80: case 0x90: case 0xe0: len=2; break;
+      case 0xa0: len=3; break;
+    }
+    if (p>song->evtc-len) break;
+    p+=len;
+    if ((lead&0x0f)!=chid) continue;
+    int noteid,endms;
+    switch (lead&0xf0) {
+      case 0x80: {
+          int i=notec; while (i-->0) {
+            if ((notev[i].noteid==v[0])&&(notev[i].endms==INT_MAX)) {
+              notev[i].endms=ms+tailms;
+              break;
+            }
+          }
+        } continue;
+      case 0x90: noteid=v[0]; endms=INT_MAX; break;
+      case 0xa0: noteid=v[0]>>1; endms=ms+((((v[1]&3)<<8)|v[2])<<4)+tailms; break;
+      default: continue;
+    }
+    int i=notec; while (i-->0) {
+      if (notev[i].endms>ms) continue;
+      notec--;
+      notev[i]=notev[notec];
+    }
+    if (notec>=limit) return limit;
+    notev[notec].noteid=noteid;
+    notev[notec].endms=endms;
+    notec++;
+    if (notec>max) max=notec;
+  }
+  return max;
+}
+
+int synth_song_measure_polyphony(const struct synth_song *song,uint8_t chid,int tailms,int limit) {
+  if (limit<1) return 0;
+  if (limit>SYNTH_VOICE_LIMIT) limit=SYNTH_VOICE_LIMIT;
+  struct synth_res *res=(song->rid&&(chid<16))?synth_res_get(song->rid):0;
+  if (!res) return synth_song_measure_polyphony_inner(song,chid,tailms,limit);
+  struct synth_polyphony *poly=res->polyv+chid;
+  if (!(res->polymask&(1<<chid))||(poly->tailms!=tailms)) {
+    poly->tailms=tailms;
+    poly->voicec=synth_song_measure_polyphony_inner(song,chid,tailms,SYNTH_VOICE_LIMIT);
+    res->polymask|=1<<chid;
+  }
+  return (poly->voicec<limit)?poly->voicec:limit;
+}
+
 /* Get playhead.
  */
 
 float synth_song_get_playhead(const struct synth_song *song) {
+  if (song->songpcm) return (float)synth_songpcm_get_playhead(song->songpcm)/(float)song->songpcm->rate;
   return (float)song->phframes/(float)synth.rate;
 }
 
 /* Set playhead.
+ * Songs from a resource share an index. Otherwise we build one just for this and throw it away.
  */
 
 void synth_song_set_playhead(struct synth_song *song,float s) {
-
-  // Release held notes.
-  struct synth_channel **p=song->channelv;
-  int i=song->channelc;
-  for (;i-->0;p++) synth_channel_release_all(*p);
-  
-  /* Take target position in ms, reset song's position to the start, and consume delays until we reach the target.
-   * We will always land either at the very end, or right after a delay event, and we don't try to slice those delays to hit (s) exactly.
-   * As our docs say, setting playhead is noticeably messy and should only be used coarsely, eg resume playback where you left off, not for quick precise movements.
-   */
-  int targetms=(int)(s*1000.0f);
-  song->evtp=0;
-  song->delay=0;
-  song->phframes=0;
-  int delaysum=0;
-  while ((delaysum<targetms)&&(song->evtp<song->evtc)) {
-    uint8_t lead=song->evtv[song->evtp++];
-    if (!(lead&0x80)) {
-      if (lead&0x40) delaysum+=((lead&0x3f)+1)<<6;
-      else delaysum+=lead;
-    } else switch (lead&0xf0) {
-      case 0x80: song->evtp+=2; break;
-      case 0x90: song->evtp+=2; break;
-      case 0xa0: song->evtp+=3; break;
-      case 0xe0: song->evtp+=2; break;
-      case 0xf0: switch (lead&0x0f) {
-          // Record the loop position, in case we haven't got it yet.
-          case 0x00: song->loopp=song->evtp; song->loopframes=synth_frames_from_ms(delaysum); break;
-        } break;
-      default: return;
-    }
+  if (song->songpcm) {
+    synth_songpcm_set_playhead(song->songpcm,(int)(s*(float)song->songpcm->rate));
+    return;
+  }
+  int ms=(int)(s*1000.0f);
+  struct synth_seek *seek=synth_song_get_seek(song);
+  if (seek) {
+    synth_seek_apply(song,seek,ms);
+  } else if ((seek=synth_seek_new(song->evtv,song->evtc))) {
+    synth_seek_apply(song,seek,ms);
+    synth_seek_del(seek);
   }
-  // Granularity of frames calculation is different than when playing. I don't think it will matter.
-  song->phframes=synth_frames_from_ms(delaysum);
 }
 
 /* Set trim or pan.
@@ -352,6 +546,7 @@ void synth_song_set_trim(struct synth_song *song,float trim) {
   if (trim<=0.0f) song->trim=0.0f;
   else if (trim>=1.0f) song->trim=1.0f;
   else song->trim=trim;
+  if (song->songpcm) synth_songpcm_set_gain(song->songpcm,song->trim,song->pan);
   struct synth_channel **p=song->channelv;
   int i=song->channelc;
   for (;i-->0;p++) synth_channel_set_trim(*p,(*p)->trim0*song->trim);
@@ -361,6 +556,7 @@ void synth_song_set_pan(struct synth_song *song,float pan) {
   if (pan<=-1.0f) song->pan=-1.0f;
   else if (pan>=1.0f) song->pan=1.0f;
   else song->pan=pan;
+  if (song->songpcm) synth_songpcm_set_gain(song->songpcm,song->trim,song->pan);
   struct synth_channel **p=song->channelv;
   int i=song->channelc;
   for (;i-->0;p++) synth_channel_set_pan(*p,(*p)->pan0);
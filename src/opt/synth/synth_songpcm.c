@@ -0,0 +1,255 @@
+/* synth_songpcm.c
+ * Stream a prerendered song: IMA ADPCM in independent blocks, decoded one block at a time.
+ * See etc/doc/songpcm-format.md.
+ */
+
+#include "synth_internal.h"
+
+#define SYNTH_SONGPCM_HEADER_LEN 24
+
+static const int synth_adpcm_stepv[89]={
+  7,8,9,10,11,12,13,14,16,17,19,21,23,25,28,31,34,37,41,45,50,55,60,66,73,80,88,97,107,118,130,143,
+  157,173,190,209,230,253,279,307,337,371,408,449,494,544,598,658,724,796,876,963,1060,1166,1282,1411,1552,
+  1707,1878,2066,2272,2499,2749,3024,3327,3660,4026,4428,4871,5358,5894,6484,7132,7845,8630,9493,10442,11487,
+  12635,13899,15289,16818,18500,20350,22385,24623,27086,29794,32767,
+};
+
+static const int synth_adpcm_indexv[16]={-1,-1,-1,-1,2,4,6,8,-1,-1,-1,-1,2,4,6,8};
+
+/* Decode one nybble, updating (pred,index).
+ */
+
+static inline int synth_adpcm_decode(int *pred,int *index,int nybble) {
+  int step=synth_adpcm_stepv[*index];
+  int diff=step>>3;
+  if (nybble&4) diff+=step;
+  if (nybble&2) diff+=step>>1;
+  if (nybble&1) diff+=step>>2;
+  if (nybble&8) { if ((*pred-=diff)<-32768) *pred=-32768; }
+  else { if ((*pred+=diff)>32767) *pred=32767; }
+  if ((*index+=synth_adpcm_indexv[nybble])<0) *index=0;
+  else if (*index>88) *index=88;
+  return *pred;
+}
+
+/* Decode the first (framec) frames of one block into (dst), interleaved.
+ * With (only) nonzero, write just the last frame, at (dst).
+ */
+
+static void synth_songpcm_decode_block(float *dst,const uint8_t *src,int chanc,int framec,int only) {
+  int predv[2],indexv[2],c=0;
+  for (;c<chanc;c++,src+=4) {
+    predv[c]=(int16_t)((src[0]<<8)|src[1]);
+    indexv[c]=src[2];
+    if (indexv[c]>88) indexv[c]=88;
+  }
+  if (!only||(framec==1)) {
+    for (c=0;c<chanc;c++) dst[c]=(float)predv[c]*(1.0f/32768.0f);
+    if (!only) dst+=chanc;
+  }
+  int nybblec=(framec-1)*chanc,k=0;
+  int emitp=only?(nybblec-chanc):0;
+  for (c=0;k<nybblec;k++) {
+    int nybble=(k&1)?(src[k>>1]&15):(src[k>>1]>>4);
+    int sample=synth_adpcm_decode(predv+c,indexv+c,nybble);
+    if (k>=emitp) *(dst++)=(float)sample*(1.0f/32768.0f);
+    if (++c>=chanc) c=0;
+  }
+}
+
+/* Length in bytes and frames of block (blockp).
+ */
+
+static int synth_songpcm_block_frames(const struct synth_songpcm *songpcm,int blockp) {
+  int framec=songpcm->framec-blockp*songpcm->blockframes;
+  if (framec>songpcm->blockframes) framec=songpcm->blockframes;
+  return framec;
+}
+
+static const uint8_t *synth_songpcm_block_src(const struct synth_songpcm *songpcm,int blockp) {
+  return songpcm->src+SYNTH_SONGPCM_HEADER_LEN+blockp*songpcm->blocklen;
+}
+
+/* Decode a single frame anywhere in the stream, into (dst).
+ */
+
+static void synth_songpcm_decode_frame(float *dst,const struct synth_songpcm *songpcm,int framep) {
+  int blockp=framep/songpcm->blockframes;
+  synth_songpcm_decode_block(dst,synth_songpcm_block_src(songpcm,blockp),songpcm->chanc,framep-blockp*songpcm->blockframes+1,1);
+}
+
+/* Decode block (blockp) into (buf), and the frame after it into (next).
+ */
+
+static void synth_songpcm_load_block(struct synth_songpcm *songpcm,int blockp) {
+  songpcm->bufblock=blockp;
+  songpcm->bufc=synth_songpcm_block_frames(songpcm,blockp);
+  synth_songpcm_decode_block(songpcm->buf,synth_songpcm_block_src(songpcm,blockp),songpcm->chanc,songpcm->bufc,0);
+  int nextp=blockp*songpcm->blockframes+songpcm->bufc;
+  if (nextp>=songpcm->framec) nextp=songpcm->repeat?songpcm->loopframe:-1;
+  if (nextp>=0) {
+    synth_songpcm_decode_frame(songpcm->next,songpcm,nextp);
+  } else {
+    songpcm->next[0]=songpcm->next[1]=0.0f;
+  }
+}
+
+/* Delete.
+ */
+
+void synth_songpcm_del(struct synth_songpcm *songpcm) {
+  if (!songpcm) return;
+  if (songpcm->buf) synth_free(songpcm->buf);
+  synth_free(songpcm);
+}
+
+/* Decode header and validate lengths.
+ */
+
+static int synth_songpcm_decode_header(struct synth_songpcm *songpcm) {
+  const uint8_t *src=songpcm->src;
+  if (!src||(songpcm->srcc<SYNTH_SONGPCM_HEADER_LEN)||__builtin_memcmp(src,"\0EPC",4)) return -1;
+  songpcm->rate=(src[4]<<24)|(src[5]<<16)|(src[6]<<8)|src[7];
+  songpcm->chanc=src[8];
+  songpcm->blockframes=(src[10]<<8)|src[11];
+  songpcm->framec=(src[12]<<24)|(src[13]<<16)|(src[14]<<8)|src[15];
+  songpcm->endframe=(src[16]<<24)|(src[17]<<16)|(src[18]<<8)|src[19];
+  songpcm->loopframe=(src[20]<<24)|(src[21]<<16)|(src[22]<<8)|src[23];
+  if ((songpcm->rate<200)||(songpcm->rate>200000)) return -1;
+  if ((songpcm->chanc<1)||(songpcm->chanc>2)) return -1;
+  if (songpcm->blockframes<2) return -1;
+  if (songpcm->framec<1) return -1;
+  if ((songpcm->endframe<1)||(songpcm->endframe>songpcm->framec)) return -1;
+  if ((songpcm->loopframe<0)||(songpcm->loopframe>=songpcm->framec)) return -1;
+  if (songpcm->loopframe<songpcm->framec-songpcm->endframe) return -1; // Loop point would land before the start.
+  songpcm->blocklen=4*songpcm->chanc+((songpcm->blockframes-1)*songpcm->chanc+1)/2;
+  int blockc=(songpcm->framec+songpcm->blockframes-1)/songpcm->blockframes;
+  int lastframec=synth_songpcm_block_frames(songpcm,blockc-1);
+  int lastlen=4*songpcm->chanc+((lastframec-1)*songpcm->chanc+1)/2;
+  if (blockc-1>(INT_MAX-SYNTH_SONGPCM_HEADER_LEN-lastlen)/songpcm->blocklen) return -1;
+  if (SYNTH_SONGPCM_HEADER_LEN+(blockc-1)*songpcm->blocklen+lastlen>songpcm->srcc) return -1;
+  return 0;
+}
+
+/* New.
+ */
+
+struct synth_songpcm *synth_songpcm_new(const void *src,int srcc,int repeat) {
+  struct synth_songpcm *songpcm=synth_calloc(1,sizeof(struct synth_songpcm));
+  if (!songpcm) return 0;
+  songpcm->src=src;
+  songpcm->srcc=srcc;
+  songpcm->repeat=repeat;
+  songpcm->bufblock=-1;
+  if (synth_songpcm_decode_header(songpcm)<0) {
+    synth_songpcm_del(songpcm);
+    return 0;
+  }
+  if (!(songpcm->buf=synth_malloc(sizeof(float)*songpcm->blockframes*songpcm->chanc))) {
+    synth_songpcm_del(songpcm);
+    return 0;
+  }
+  songpcm->step=(uint32_t)(((int64_t)songpcm->rate<<16)/synth.rate);
+  if (!songpcm->step) songpcm->step=1;
+  synth_songpcm_set_gain(songpcm,1.0f,0.0f);
+  return songpcm;
+}
+
+/* Trim, pan, fade.
+ */
+
+void synth_songpcm_set_gain(struct synth_songpcm *songpcm,float trim,float pan) {
+  if (trim<0.0f) trim=0.0f; else if (trim>1.0f) trim=1.0f;
+  songpcm->trim=trim;
+  if (pan<=-1.0f) {
+    songpcm->triml=trim;
+    songpcm->trimr=0.0f;
+  } else if (pan>=1.0f) {
+    songpcm->triml=0.0f;
+    songpcm->trimr=trim;
+  } else if (pan<0.0f) {
+    songpcm->triml=trim;
+    songpcm->trimr=(pan+1.0f)*trim;
+  } else if (pan>0.0f) {
+    songpcm->triml=(1.0f-pan)*trim;
+    songpcm->trimr=trim;
+  } else {
+    songpcm->triml=trim;
+    songpcm->trimr=trim;
+  }
+}
+
+void synth_songpcm_fade_out(struct synth_songpcm *songpcm,int framec) {
+  if (songpcm->fadec) return;
+  if (framec<1) framec=1;
+  songpcm->fadec=songpcm->fadep=framec;
+}
+
+/* Update.
+ */
+
+int synth_songpcm_update(float *dstl,float *dstr,struct synth_songpcm *songpcm,int framec) {
+  const int chanc=songpcm->chanc;
+  int i=0;
+  for (;i<framec;i++) {
+    if (songpcm->fadec) {
+      if (songpcm->fadep<=0) return framec;
+      if (!songpcm->repeat&&(songpcm->framep>=songpcm->endframe)) return framec; // Past the end is the second pass; not ours to play.
+    } else if (!songpcm->repeat&&(songpcm->framep>=songpcm->endframe)) {
+      return i;
+    }
+    int p=songpcm->framep-songpcm->bufblock*songpcm->blockframes;
+    if ((songpcm->bufblock<0)||(p<0)||(p>=songpcm->bufc)) {
+      synth_songpcm_load_block(songpcm,songpcm->framep/songpcm->blockframes);
+      p=songpcm->framep-songpcm->bufblock*songpcm->blockframes;
+    }
+    const float *a=songpcm->buf+p*chanc;
+    const float *b=(p<songpcm->bufc-1)?(a+chanc):songpcm->next;
+    float t=(float)songpcm->phase*(1.0f/65536.0f);
+    float l=a[0]+(b[0]-a[0])*t;
+    float r=(chanc>=2)?(a[1]+(b[1]-a[1])*t):l;
+    if (songpcm->fadec) {
+      float gain=(float)songpcm->fadep/(float)songpcm->fadec;
+      l*=gain;
+      r*=gain;
+      songpcm->fadep--;
+    }
+    if (dstr) {
+      dstl[i]+=l*songpcm->triml;
+      dstr[i]+=r*songpcm->trimr;
+    } else {
+      dstl[i]+=(l+r)*0.5f*songpcm->trim;
+    }
+    songpcm->phase+=songpcm->step;
+    songpcm->framep+=songpcm->phase>>16;
+    songpcm->phase&=0xffff;
+    if (songpcm->repeat) {
+      while (songpcm->framep>=songpcm->framec) songpcm->framep-=songpcm->framec-songpcm->loopframe;
+    }
+  }
+  return framec;
+}
+
+/* Playhead.
+ * The stream runs past (endframe) into a second pass from the loop point, so map that back onto the song's timeline.
+ */
+
+int synth_songpcm_get_playhead(const struct synth_songpcm *songpcm) {
+  if (songpcm->framep<songpcm->endframe) return songpcm->framep;
+  return songpcm->framep-songpcm->endframe+songpcm->loopframe-(songpcm->framec-songpcm->endframe);
+}
+
+void synth_songpcm_set_playhead(struct synth_songpcm *songpcm,int framep) {
+  if (framep<0) framep=0;
+  if (framep>=songpcm->endframe) {
+    int loopp=songpcm->loopframe-(songpcm->framec-songpcm->endframe);
+    if (songpcm->repeat&&(loopp<songpcm->endframe)) {
+      framep=loopp+(framep-loopp)%(songpcm->endframe-loopp);
+    } else {
+      framep=songpcm->endframe;
+    }
+    if (framep<0) framep=0;
+  }
+  songpcm->framep=framep;
+  songpcm->phase=0;
+}
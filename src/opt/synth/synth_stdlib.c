@@ -20,11 +20,32 @@ uint32_t synth_rand(float *v,int c,uint32_t state) {
  * All addresses and sizes are in 32-bit ints, not bytes.
  * (v) is the linear memory. First slot holds the block length, or negative block length if free.
  * Callers will always reference blocks by the index of their first block length: NB! Not the actual start of payload.
+ *
+ * Small blocks, up to SYNTH_MEM_SMALL_LIMIT words, come from size-class slabs instead, in constant time.
+ * A slab is one large block, carved into small blocks that each keep a length word too.
+ * Small length words are SYNTH_MEM_SMALL|class, plus SYNTH_MEM_IDLE while on the class's free list.
+ * The first payload word of an idle small block is the next idle one, or -1.
+ * Slabs are never returned to the large heap; the classes only grow to the most you've used at once.
  */
  
+#define SYNTH_MEM_SMALL 0x40000000
+#define SYNTH_MEM_IDLE  0x20000000
+#define SYNTH_MEM_CLASS_MASK 0xff
+#define SYNTH_MEM_SMALL_LIMIT 256
+#define SYNTH_MEM_SLAB_WORDS 1024
+#define SYNTH_MEM_SLAB_MIN_BLOCKS 8
+#define SYNTH_MEM_CLASSC 16
+
+static const int synth_mem_class_size[SYNTH_MEM_CLASSC]={
+  1,2,3,4,6,8,12,16,24,32,48,64,96,128,192,256,
+};
+ 
 struct synth_mem {
   int32_t *v;
   int c;
+  int idlev[SYNTH_MEM_CLASSC]; // Head of each class's free list, or -1.
+  int livec,peakc; // Payload words in use, and the most there's ever been.
+  int allocc; // Blocks handed out, including reallocs that had to move.
 };
 
 /* Convert between the length-word (p) we prefer and payload addresses you should expose to the public.
@@ -43,13 +64,25 @@ static void *synth_mem_pointer_from_index(const struct synth_mem *mem,int p) {
 
 static void synth_mem_free(struct synth_mem *mem,int p) {
   if ((p<0)||(p>=mem->c)) return;
-  if (mem->v[p]<0) return; // Double free!
-  mem->v[p]=-mem->v[p];
+  int len=mem->v[p];
+  if (len<0) return; // Double free!
+  if (len&SYNTH_MEM_SMALL) {
+    if (len&SYNTH_MEM_IDLE) return; // Double free!
+    int clsid=len&SYNTH_MEM_CLASS_MASK;
+    mem->v[p]=len|SYNTH_MEM_IDLE;
+    mem->v[p+1]=mem->idlev[clsid];
+    mem->idlev[clsid]=p;
+    mem->livec-=synth_mem_class_size[clsid];
+    return;
+  }
+  mem->v[p]=-len;
+  mem->livec-=len;
 }
 
 // Size of an allocated block in words.
 static int synth_mem_get_block_size(const struct synth_mem *mem,int p) {
   if ((p<0)||(p>=mem->c)) return -1;
+  if (mem->v[p]&SYNTH_MEM_SMALL) return synth_mem_class_size[mem->v[p]&SYNTH_MEM_CLASS_MASK];
   return mem->v[p];
 }
 
@@ -74,6 +107,11 @@ static int synth_mem_get_free_size(const struct synth_mem *mem,int p) {
 static int synth_mem_grow_block(struct synth_mem *mem,int p,int na) {
   if ((p<0)||(p>=mem->c)) return -1;
   int len=mem->v[p];
+  if (len&SYNTH_MEM_SMALL) { // Small blocks can't grow, but may already be big enough.
+    len=synth_mem_class_size[len&SYNTH_MEM_CLASS_MASK];
+    if (len>=na) return len;
+    return -1;
+  }
   if (len>=na) return len; // Already big enough.
   int nextp=p+1+len;
   int available=synth_mem_get_free_size(mem,nextp);
@@ -81,6 +119,7 @@ static int synth_mem_grow_block(struct synth_mem *mem,int p,int na) {
   if (len+1+available<na) return -1; // Not enough room here.
   // Consume blocks until we're big enough, not necessarily all of (available).
   int p0=p;
+  int len0=len;
   while (len<na) {
     p=nextp;
     int nextlen=mem->v[p];
@@ -96,6 +135,8 @@ static int synth_mem_grow_block(struct synth_mem *mem,int p,int na) {
     len=na;
   }
   mem->v[p0]=len;
+  mem->livec+=len-len0;
+  if (mem->livec>mem->peakc) mem->peakc=mem->livec;
   return len;
 }
 
@@ -104,21 +145,22 @@ static int synth_mem_shrink_block(struct synth_mem *mem,int p,int na) {
   if ((p<0)||(p>=mem->c)) return -1;
   int len=mem->v[p];
   if (len<0) return -1; // Not an allocated block.
+  if (len&SYNTH_MEM_SMALL) return -1; // Small blocks are what they are.
   if (len<na) return -1; // That's not what "shrink" means.
   mem->v[p]=na;
   mem->v[p+1+na]=-(len-na-1);
+  mem->livec-=len-na;
   return na;
 }
 
-// Allocate a block of at least (c) words and return its "p".
-static int synth_mem_allocate(struct synth_mem *mem,int c) {
+// Allocate a block of at least (c) words from the large heap and return its "p".
+static int synth_mem_allocate_large(struct synth_mem *mem,int c) {
   if (c<0) return -1;
   int p=0;
   while (p<mem->c) {
     if (mem->v[p]<0) {
       int available=synth_mem_get_free_size(mem,p);
       if (available>=c) {
-        //if ((mem->v[p]<0)&&(p+1-mem->v[p]>=mem->c)) logint(p+1+c); // XXX TEMP Log the high-water mark.
         mem->v[p]=c;
         if (c<available) { // Mark the remainder free.
           mem->v[p+1+c]=-(available-c)+1;
@@ -126,6 +168,8 @@ static int synth_mem_allocate(struct synth_mem *mem,int c) {
         return p;
       }
       p+=1+available;
+    } else if (mem->v[p]&SYNTH_MEM_SMALL) {
+      return -1; // Corrupt. Small blocks only exist inside slabs.
     } else {
       p+=1+mem->v[p];
     }
@@ -133,6 +177,44 @@ static int synth_mem_allocate(struct synth_mem *mem,int c) {
   return -1;
 }
 
+// Carve a new slab into idle blocks of class (clsid).
+static int synth_mem_add_slab(struct synth_mem *mem,int clsid) {
+  int blocklen=1+synth_mem_class_size[clsid];
+  int slablen=SYNTH_MEM_SLAB_WORDS;
+  if (slablen<blocklen*SYNTH_MEM_SLAB_MIN_BLOCKS) slablen=blocklen*SYNTH_MEM_SLAB_MIN_BLOCKS;
+  int slabp=synth_mem_allocate_large(mem,slablen);
+  if (slabp<0) return -1;
+  int blockc=slablen/blocklen;
+  int p=slabp+1+blocklen*(blockc-1);
+  for (;blockc-->0;p-=blocklen) {
+    mem->v[p]=SYNTH_MEM_SMALL|SYNTH_MEM_IDLE|clsid;
+    mem->v[p+1]=mem->idlev[clsid];
+    mem->idlev[clsid]=p;
+  }
+  return 0;
+}
+
+// Allocate a block of at least (c) words and return its "p".
+static int synth_mem_allocate(struct synth_mem *mem,int c) {
+  if (c<0) return -1;
+  int p;
+  if (c<=SYNTH_MEM_SMALL_LIMIT) {
+    int clsid=0;
+    while (synth_mem_class_size[clsid]<c) clsid++;
+    if ((mem->idlev[clsid]<0)&&(synth_mem_add_slab(mem,clsid)<0)) return -1;
+    p=mem->idlev[clsid];
+    mem->idlev[clsid]=mem->v[p+1];
+    mem->v[p]=SYNTH_MEM_SMALL|clsid;
+    mem->livec+=synth_mem_class_size[clsid];
+  } else {
+    if ((p=synth_mem_allocate_large(mem,c))<0) return -1;
+    mem->livec+=c;
+  }
+  if (mem->livec>mem->peakc) mem->peakc=mem->livec;
+  mem->allocc++;
+  return p;
+}
+
 // Notify that you've reallocated (mem->v) to now allow (nc) words. (mem->c) must be the old count, and we'll update it.
 static int synth_mem_master_grown(struct synth_mem *mem,int nc) {
   int addc=nc-mem->c;
@@ -144,19 +226,150 @@ static int synth_mem_master_grown(struct synth_mem *mem,int nc) {
   return 0;
 }
 
+// Reset to one free block of (c) words at (v).
+static void synth_mem_reset(struct synth_mem *mem,int32_t *v,int c) {
+  mem->v=v;
+  mem->c=c;
+  mem->v[0]=-(mem->c-1);
+  int i=SYNTH_MEM_CLASSC;
+  while (i-->0) mem->idlev[i]=-1;
+  mem->livec=0;
+  mem->peakc=0;
+  mem->allocc=0;
+}
+
+/* Measure fragmentation, as percentage of the used extent that is neither in use nor available for large blocks.
+ * Walks the whole heap; only call for debugging.
+ */
+static int synth_mem_get_fragmentation(const struct synth_mem *mem) {
+  int extent=0,holec=0,pendingc=0,p=0;
+  while (p<mem->c) {
+    int len=mem->v[p];
+    if (len<0) {
+      pendingc+=1-len;
+      p+=1-len;
+    } else { // Free space only counts as a hole if something allocated follows it.
+      holec+=pendingc;
+      pendingc=0;
+      p+=1+len;
+      extent=p;
+    }
+  }
+  int i=SYNTH_MEM_CLASSC;
+  while (i-->0) {
+    for (p=mem->idlev[i];p>=0;p=mem->v[p+1]) holec+=1+synth_mem_class_size[i];
+  }
+  if (extent<1) return 0;
+  return (int)(((int64_t)holec*100)/extent);
+}
+
 /* synth_malloc, public* interface.
  * [*] Only reachable from within synth of course.
  */
 
-// Native builds should normally use their own libc. We can map to that trivially.
-#if USE_native && !USE_FAKE_MALLOC
+// Native builds should normally use their own libc.
+// With SYNTH_HEAP_STATS (eggstra sets it, for benchmarks), we keep each block's length in a header ahead of it, so the stats still work.
+// That's the only reason for the header, and production builds go straight to libc and report no stats.
+// Counts are process-wide, since contexts share the heap, and several threads may allocate at once.
+// Peak and allocation count restart at each synth_init(), peak from whatever is live at the time.
+#if USE_native && !USE_FAKE_MALLOC && SYNTH_HEAP_STATS
+  #include <stdlib.h>
+  #define SYNTH_HEAP_HEADER 16 /* Keeps the caller's block aligned like malloc's own. */
+  
+  static int synth_heap_live=0;
+  static int synth_heap_peak=0;
+  static int synth_heap_allocc=0;
+  
+  static void synth_heap_count(int d) {
+    int live=__atomic_add_fetch(&synth_heap_live,d,__ATOMIC_RELAXED);
+    int peak=__atomic_load_n(&synth_heap_peak,__ATOMIC_RELAXED);
+    while ((live>peak)&&!__atomic_compare_exchange_n(&synth_heap_peak,&peak,live,1,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) ;
+  }
+  
+  void synth_malloc_quit() {}
+  
+  int synth_malloc_init() {
+    __atomic_store_n(&synth_heap_peak,__atomic_load_n(&synth_heap_live,__ATOMIC_RELAXED),__ATOMIC_RELAXED);
+    __atomic_store_n(&synth_heap_allocc,0,__ATOMIC_RELAXED);
+    return 0;
+  }
+  
+  int synth_get_heap_stats(int *live,int *peak,int *fragmentation,int *allocc) {
+    if (live) *live=__atomic_load_n(&synth_heap_live,__ATOMIC_RELAXED);
+    if (peak) *peak=__atomic_load_n(&synth_heap_peak,__ATOMIC_RELAXED);
+    if (fragmentation) *fragmentation=-1; // libc doesn't tell us.
+    if (allocc) *allocc=__atomic_load_n(&synth_heap_allocc,__ATOMIC_RELAXED);
+    return 0;
+  }
+  
+  void synth_free(void *p) {
+    if (!p) return;
+    uint8_t *block=(uint8_t*)p-SYNTH_HEAP_HEADER;
+    synth_heap_count(-*(int*)block);
+    free(block);
+  }
+  
+  void *synth_malloc(int len) {
+    if (len<0) return 0;
+    if (len>INT_MAX-SYNTH_HEAP_HEADER) return 0;
+    uint8_t *block=malloc(SYNTH_HEAP_HEADER+len);
+    if (!block) return 0;
+    *(int*)block=len;
+    synth_heap_count(len);
+    __atomic_add_fetch(&synth_heap_allocc,1,__ATOMIC_RELAXED);
+    return block+SYNTH_HEAP_HEADER;
+  }
+  
+  void *synth_calloc(int a,int b) {
+    if ((a<0)||(b<0)) return 0;
+    if (a&&(b>(INT_MAX-SYNTH_HEAP_HEADER)/a)) return 0;
+    int len=a*b;
+    uint8_t *block=calloc(1,SYNTH_HEAP_HEADER+len);
+    if (!block) return 0;
+    *(int*)block=len;
+    synth_heap_count(len);
+    __atomic_add_fetch(&synth_heap_allocc,1,__ATOMIC_RELAXED);
+    return block+SYNTH_HEAP_HEADER;
+  }
+  
+  void *synth_realloc(void *p,int len) {
+    if (!p) return synth_malloc(len);
+    if (len<0) return 0;
+    if (len>INT_MAX-SYNTH_HEAP_HEADER) return 0;
+    uint8_t *block0=(uint8_t*)p-SYNTH_HEAP_HEADER;
+    int pvlen=*(int*)block0;
+    uint8_t *block=realloc(block0,SYNTH_HEAP_HEADER+len);
+    if (!block) return 0;
+    *(int*)block=len;
+    synth_heap_count(len-pvlen);
+    if (block!=block0) __atomic_add_fetch(&synth_heap_allocc,1,__ATOMIC_RELAXED);
+    return block+SYNTH_HEAP_HEADER;
+  }
+  
+// Production native builds: Plain libc, no stats.
+#elif USE_native && !USE_FAKE_MALLOC
   #include <stdlib.h>
+  
   void synth_malloc_quit() {}
   int synth_malloc_init() { return 0; }
+  int synth_get_heap_stats(int *live,int *peak,int *fragmentation,int *allocc) { return -1; }
   void synth_free(void *p) { free(p); }
-  void *synth_malloc(int len) { return malloc(len); }
-  void *synth_calloc(int a,int b) { return calloc(a,b); }
-  void *synth_realloc(void *p,int len) { return realloc(p,len); }
+  
+  void *synth_malloc(int len) {
+    if (len<0) return 0;
+    return malloc(len);
+  }
+  
+  void *synth_calloc(int a,int b) {
+    if ((a<0)||(b<0)) return 0;
+    if (a&&(b>INT_MAX/a)) return 0;
+    return calloc(a,b);
+  }
+  
+  void *synth_realloc(void *p,int len) {
+    if (len<0) return 0;
+    return realloc(p,len);
+  }
   
 // Otherwise, synth_mem is in play.
 // We do allow USE_native here, and will use libc in that case. But we only use real malloc to create the master block.
@@ -184,8 +397,9 @@ static int synth_mem_master_grown(struct synth_mem *mem,int nc) {
     // When running native, we will never resize (mem.v). So initialize it with a huge block.
     #if USE_native
       int wordc=0xf00000; // <64 MB.
-      if (!(mem.v=malloc(wordc<<2))) return -1;
-      mem.c=wordc;
+      int32_t *v=malloc(wordc<<2);
+      if (!v) return -1;
+      synth_mem_reset(&mem,v,wordc);
     // When running in WebAssembly, use intrinsics to query the initial memory size, then grow it to something huge.
     #else
       if (!synth_pagec0) {
@@ -194,10 +408,18 @@ static int synth_mem_master_grown(struct synth_mem *mem,int nc) {
         __builtin_wasm_memory_grow(0,na);
         synth_pagea=na;
       }
-      mem.v=(int32_t*)(((uint8_t*)&__heap_base)+(synth_pagec0*0x10000));
-      mem.c=(synth_pagea-synth_pagec0)*(0x10000>>2); // words from pages
+      int32_t *v=(int32_t*)(((uint8_t*)&__heap_base)+(synth_pagec0*0x10000));
+      synth_mem_reset(&mem,v,(synth_pagea-synth_pagec0)*(0x10000>>2)); // words from pages
     #endif
-    mem.v[0]=-(mem.c-1);
+    return 0;
+  }
+  
+  int synth_get_heap_stats(int *live,int *peak,int *fragmentation,int *allocc) {
+    if (!mem.c) return -1;
+    if (live) *live=mem.livec<<2;
+    if (peak) *peak=mem.peakc<<2;
+    if (fragmentation) *fragmentation=synth_mem_get_fragmentation(&mem);
+    if (allocc) *allocc=mem.allocc;
     return 0;
   }
   
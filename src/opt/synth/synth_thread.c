@@ -0,0 +1,257 @@
+/* synth_thread.c
+ * Optional parallel song rendering, native only.
+ * When enabled, every song renders on whichever thread grabs it first, with each channel capturing its untrimmed output.
+ * Once all songs are done, the calling thread mixes the captures in exactly the order the serial path would have.
+ * So output is identical to the serial path, bit for bit, regardless of thread count or scheduling.
+ * Printers, PCM players, and prerendered songs always run serially on the calling thread.
+ */
+
+#include "synth_internal.h"
+
+#if SYNTH_THREADS_AVAILABLE
+
+#include <pthread.h>
+
+struct synth_threads {
+  struct synth_context *context; // WEAK. Workers adopt it as current.
+  pthread_t thdv[SYNTH_THREAD_LIMIT];
+  int thdc;
+  pthread_mutex_t mtx; // Guards everything below.
+  pthread_cond_t cond_work; // Main => workers: (generation) changed or (quit) set.
+  pthread_cond_t cond_done; // Workers => main: (busyc) reached zero.
+  pthread_mutex_t globalmtx; // Guards global state that song updates are allowed to touch, ie printer list.
+  int generation;
+  int quit;
+  int busyc; // Workers that haven't finished the current generation yet.
+  int framec;
+  int jobc;
+  int jobp; // Next job index. Accessed atomically.
+  int *resultv; // Indexed like (synth.songv).
+  int resulta;
+};
+
+/* Run jobs until there aren't any.
+ */
+
+static void synth_threads_run_jobs(struct synth_threads *threads) {
+  struct synth_context *ctx=&synth;
+  for (;;) {
+    int p=__atomic_fetch_add(&threads->jobp,1,__ATOMIC_ACQ_REL);
+    if (p>=threads->jobc) return;
+    if (ctx->songv[p]->songpcm) continue; // Prerendered songs mix directly, so they run during the mix.
+    threads->resultv[p]=synth_song_update(ctx->bufl,ctx->bufr,ctx->songv[p],threads->framec);
+  }
+}
+
+/* Worker thread.
+ */
+
+static void *synth_thread_main(void *arg) {
+  struct synth_threads *threads=arg;
+  synth_current=threads->context;
+  int generation=0;
+  pthread_mutex_lock(&threads->mtx);
+  for (;;) {
+    while (!threads->quit&&(threads->generation==generation)) {
+      pthread_cond_wait(&threads->cond_work,&threads->mtx);
+    }
+    if (threads->quit) break;
+    generation=threads->generation;
+    pthread_mutex_unlock(&threads->mtx);
+    synth_threads_run_jobs(threads);
+    pthread_mutex_lock(&threads->mtx);
+    if (!--(threads->busyc)) pthread_cond_signal(&threads->cond_done);
+  }
+  pthread_mutex_unlock(&threads->mtx);
+  return 0;
+}
+
+/* Delete.
+ */
+
+void synth_threads_del(struct synth_threads *threads) {
+  if (!threads) return;
+  pthread_mutex_lock(&threads->mtx);
+  threads->quit=1;
+  pthread_cond_broadcast(&threads->cond_work);
+  pthread_mutex_unlock(&threads->mtx);
+  while (threads->thdc>0) {
+    threads->thdc--;
+    pthread_join(threads->thdv[threads->thdc],0);
+  }
+  pthread_cond_destroy(&threads->cond_work);
+  pthread_cond_destroy(&threads->cond_done);
+  pthread_mutex_destroy(&threads->mtx);
+  pthread_mutex_destroy(&threads->globalmtx);
+  if (threads->resultv) synth_free(threads->resultv);
+  synth_free(threads);
+}
+
+/* New.
+ */
+
+struct synth_threads *synth_threads_new(int thdc) {
+  if ((thdc<1)||(thdc>SYNTH_THREAD_LIMIT)) return 0;
+  struct synth_threads *threads=synth_calloc(1,sizeof(struct synth_threads));
+  if (!threads) return 0;
+  threads->context=synth_current;
+  if (
+    pthread_mutex_init(&threads->mtx,0)||
+    pthread_mutex_init(&threads->globalmtx,0)||
+    pthread_cond_init(&threads->cond_work,0)||
+    pthread_cond_init(&threads->cond_done,0)
+  ) {
+    synth_free(threads);
+    return 0;
+  }
+  while (threads->thdc<thdc) {
+    if (pthread_create(threads->thdv+threads->thdc,0,synth_thread_main,threads)) {
+      synth_threads_del(threads);
+      return 0;
+    }
+    threads->thdc++;
+  }
+  return threads;
+}
+
+/* Guard global state.
+ */
+
+void synth_threads_lock(struct synth_threads *threads) {
+  if (threads) pthread_mutex_lock(&threads->globalmtx);
+}
+
+void synth_threads_unlock(struct synth_threads *threads) {
+  if (threads) pthread_mutex_unlock(&threads->globalmtx);
+}
+
+/* Update songs.
+ */
+
+int synth_threads_update_songs(struct synth_threads *threads,int framec) {
+  struct synth_context *ctx=&synth;
+  if (ctx->songc<1) return 0;
+
+  if (ctx->songc>threads->resulta) {
+    int na=(ctx->songc+8)&~7;
+    if (na>INT_MAX/sizeof(int)) return -1;
+    void *nv=synth_realloc(threads->resultv,sizeof(int)*na);
+    if (!nv) return -1;
+    threads->resultv=nv;
+    threads->resulta=na;
+  }
+  threads->framec=framec;
+  threads->jobc=ctx->songc;
+  threads->jobp=0;
+
+  /* A single song doesn't need the workers.
+   * Run it on this thread and mix the same way; the result must not depend on how many songs are playing.
+   */
+  if (ctx->songc==1) {
+    synth_threads_run_jobs(threads);
+  } else {
+    pthread_mutex_lock(&threads->mtx);
+    threads->busyc=threads->thdc;
+    threads->generation++;
+    pthread_cond_broadcast(&threads->cond_work);
+    pthread_mutex_unlock(&threads->mtx);
+    synth_threads_run_jobs(threads);
+    pthread_mutex_lock(&threads->mtx);
+    while (threads->busyc>0) pthread_cond_wait(&threads->cond_done,&threads->mtx);
+    pthread_mutex_unlock(&threads->mtx);
+  }
+
+  /* Mix and reap, in the serial path's order: Songs last to first, channels first to last.
+   */
+  int i=ctx->songc;
+  struct synth_song **p=ctx->songv+i-1;
+  for (;i-->0;p--) {
+    struct synth_song *song=*p;
+    if (song->songpcm) {
+      threads->resultv[i]=synth_song_update(ctx->bufl,ctx->bufr,song,framec);
+    } else {
+      float *dstr=((song->chanc>=2)&&ctx->bufr)?ctx->bufr:0;
+      struct synth_channel **chp=song->channelv;
+      int chi=song->channelc;
+      for (;chi-->0;chp++) synth_channel_mix_capture(ctx->bufl,dstr,*chp);
+    }
+    if (threads->resultv[i]<=0) {
+      ctx->songc--;
+      __builtin_memmove(p,p+1,sizeof(void*)*(ctx->songc-i));
+      synth_song_del(song);
+    }
+  }
+  return 0;
+}
+
+/* Stubs for builds without threads.
+ */
+#else
+
+void synth_threads_del(struct synth_threads *threads) {}
+struct synth_threads *synth_threads_new(int thdc) { return 0; }
+void synth_threads_lock(struct synth_threads *threads) {}
+void synth_threads_unlock(struct synth_threads *threads) {}
+int synth_threads_update_songs(struct synth_threads *threads,int framec) { return -1; }
+
+#endif
+
+/* Capture buffers for one song's channels.
+ * These apply to both sides of the ifdef, but only matter when threads are available.
+ */
+
+int synth_song_require_capture(struct synth_song *song) {
+  struct synth_channel **p=song->channelv;
+  int i=song->channelc;
+  for (;i-->0;p++) {
+    struct synth_channel *channel=*p;
+    if (!channel->capl) {
+      if (!(channel->capl=synth_malloc(sizeof(float)*synth.buffer_frames))) return -1;
+    }
+    if (channel->bufr&&!channel->capr) {
+      if (!(channel->capr=synth_malloc(sizeof(float)*synth.buffer_frames))) return -1;
+    }
+    channel->capc=0;
+  }
+  return 0;
+}
+
+void synth_song_drop_capture(struct synth_song *song) {
+  struct synth_channel **p=song->channelv;
+  int i=song->channelc;
+  for (;i-->0;p++) {
+    struct synth_channel *channel=*p;
+    if (channel->capl) { synth_free(channel->capl); channel->capl=0; }
+    if (channel->capr) { synth_free(channel->capr); channel->capr=0; }
+    channel->capc=0;
+  }
+}
+
+/* Enable or disable threads, public entry point.
+ */
+
+int synth_set_threads(int threadc) {
+  if (synth.framec_in_progress) return -1;
+  if (!synth.rate) return -1;
+  if (threadc<0) threadc=0;
+  if (synth.threads) {
+    synth_threads_del(synth.threads);
+    synth.threads=0;
+  }
+  int i;
+  if (!threadc) {
+    for (i=synth.songc;i-->0;) synth_song_drop_capture(synth.songv[i]);
+    return 0;
+  }
+  if (!(synth.threads=synth_threads_new(threadc))) {
+    for (i=synth.songc;i-->0;) synth_song_drop_capture(synth.songv[i]);
+    return -1;
+  }
+  for (i=synth.songc;i-->0;) {
+    if (synth_song_require_capture(synth.songv[i])<0) {
+      synth_set_threads(0);
+      return -1;
+    }
+  }
+  return threadc;
+}
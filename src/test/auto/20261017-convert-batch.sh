@@ -0,0 +1,76 @@
+#!/bin/bash
+
+EGGDEV=$EGG_SDK/out/eggdev
+SONGS=$EGG_SDK/src/demo/src/data/song
+ROM=$EGG_SDK/src/demo/mid/data.egg
+
+if [ -n "$EGG_TEST_FILTER" ] ; then
+  if ! grep -q 20261017-convert-batch <<<"$EGG_TEST_FILTER" ; then
+    echo "EGG_TEST SKIP 20261017-convert-batch"
+    exit 0
+  fi
+fi
+
+TMPDIR=$(mktemp -d)
+trap "rm -rf $TMPDIR" EXIT
+
+# The demo songs one at a time, and four at a time. Output must be the same bytes either way.
+SONGC=$(ls $SONGS/*.mid | wc -l)
+if ! $EGGDEV convert -o$TMPDIR/serial $SONGS --jobs=1 2>$TMPDIR/serial.err ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Serial batch failed: $(cat $TMPDIR/serial.err)"
+elif ! $EGGDEV convert -o$TMPDIR/parallel $SONGS --jobs=4 2>$TMPDIR/parallel.err ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Parallel batch failed: $(cat $TMPDIR/parallel.err)"
+elif [ "$(ls $TMPDIR/serial/*.wav | wc -l)" -ne "$SONGC" ] ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Expected $SONGC WAV files, found $(ls $TMPDIR/serial | wc -l)."
+elif ! diff -r $TMPDIR/serial $TMPDIR/parallel >$TMPDIR/diff.out ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Parallel output differs from serial: $(head -n1 $TMPDIR/diff.out)"
+else
+  echo "EGG_TEST PASS 20261017-convert-batch.sh: Parallel directory batch matches serial, $SONGC files."
+fi
+
+# And batch output is what you'd get converting each file alone.
+ONE=$(ls $SONGS/*.mid | head -n1)
+ONEWAV=$(basename "$ONE" .mid).wav
+if ! $EGGDEV convert -o$TMPDIR/one.wav "$ONE" 2>$TMPDIR/one.err ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Single-file conversion failed: $(cat $TMPDIR/one.err)"
+elif ! cmp -s $TMPDIR/one.wav "$TMPDIR/parallel/$ONEWAV" ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Batch output for $ONEWAV differs from single-file conversion."
+else
+  echo "EGG_TEST PASS 20261017-convert-batch.sh: Batch output matches single-file conversion."
+fi
+
+# One bad file fails the batch, but everything else still gets written.
+mkdir $TMPDIR/broken
+cp $SONGS/*.mid $TMPDIR/broken
+echo "not a song" >$TMPDIR/broken/0-broken.mid
+if $EGGDEV convert -o$TMPDIR/brokenout $TMPDIR/broken --jobs=4 2>$TMPDIR/broken.err ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Batch with a malformed song reported success."
+elif [ "$(ls $TMPDIR/brokenout/*.wav | wc -l)" -ne "$SONGC" ] ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Expected $SONGC WAV files alongside the failure, found $(ls $TMPDIR/brokenout | wc -l)."
+elif ! diff -r $TMPDIR/serial $TMPDIR/brokenout >/dev/null ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Output alongside the failure differs from the clean batch."
+else
+  echo "EGG_TEST PASS 20261017-convert-batch.sh: Malformed song fails the batch without stopping the others."
+fi
+
+# Every song and sound in the demo ROM, same comparison.
+# Some demo sounds don't render even alone, so the batch may fail. Serial and parallel must fail the same way.
+if [ ! -f "$ROM" ] ; then
+  echo "EGG_TEST SKIP 20261017-convert-batch.sh: $ROM not found. Build the demo first."
+  exit 0
+fi
+$EGGDEV convert -o$TMPDIR/romserial $ROM --dstfmt=wav --jobs=1 2>$TMPDIR/romserial.err
+SERIALSTATUS=$?
+$EGGDEV convert -o$TMPDIR/romparallel $ROM --dstfmt=wav --jobs=4 2>$TMPDIR/romparallel.err
+PARALLELSTATUS=$?
+if [ "$SERIALSTATUS" -ne "$PARALLELSTATUS" ] ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: ROM batch exit status $SERIALSTATUS serial, $PARALLELSTATUS parallel."
+elif ! ls $TMPDIR/romserial/song-*.wav $TMPDIR/romserial/sound-*.wav >/dev/null 2>&1 ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Expected both songs and sounds from the ROM: $(tail -n1 $TMPDIR/romserial.err)"
+elif [ "$(tail -n1 $TMPDIR/romserial.err | sed 's/ to .*//')" != "$(tail -n1 $TMPDIR/romparallel.err | sed 's/ to .*//')" ] ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: ROM batch summary differs. Serial: $(tail -n1 $TMPDIR/romserial.err) Parallel: $(tail -n1 $TMPDIR/romparallel.err)"
+elif ! diff -r $TMPDIR/romserial $TMPDIR/romparallel >$TMPDIR/diff.out ; then
+  echo "EGG_TEST FAIL 20261017-convert-batch.sh: Parallel ROM output differs from serial: $(head -n1 $TMPDIR/diff.out)"
+else
+  echo "EGG_TEST PASS 20261017-convert-batch.sh: Parallel ROM batch matches serial, $(ls $TMPDIR/romserial | wc -l) files."
+fi
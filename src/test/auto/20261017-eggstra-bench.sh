@@ -0,0 +1,62 @@
+#!/bin/bash
+
+EGGSTRA=$EGG_SDK/out/eggstra
+ROM=$EGG_SDK/src/demo/mid/data.egg
+
+if [ -n "$EGG_TEST_FILTER" ] ; then
+  if ! grep -q 20261017-eggstra-bench <<<"$EGG_TEST_FILTER" ; then
+    echo "EGG_TEST SKIP 20261017-eggstra-bench"
+    exit 0
+  fi
+fi
+
+if [ ! -f "$ROM" ] ; then
+  echo "EGG_TEST SKIP 20261017-eggstra-bench.sh: $ROM not found. Build the demo first."
+  exit 0
+fi
+
+TMPDIR=$(mktemp -d)
+trap "rm -rf $TMPDIR" EXIT
+
+# Two seconds of everything in the demo, one line of JSON.
+# Every result has its identity, a real heap peak, and an allocation count (eggstra builds synth with SYNTH_HEAP_STATS).
+if ! $EGGSTRA bench "$ROM" --limit=2 >$TMPDIR/run.json 2>$TMPDIR/run.err ; then
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: Bench failed: $(cat $TMPDIR/run.err)"
+  exit 0
+fi
+RESULTC=$(grep -o '{"type":"\(song\|sound\)","rid":[0-9]*,"rate":44100,"buffer":1024,"frames":[0-9]*,' $TMPDIR/run.json | wc -l)
+HEAPC=$(grep -o '"heap_peak":[1-9][0-9]*,"allocs":[1-9][0-9]*,"render_allocs":[0-9]*}' $TMPDIR/run.json | wc -l)
+AUDIBLEC=$(grep -o '"frames":[1-9][0-9]*,' $TMPDIR/run.json | wc -l)
+if ! grep -q '^{"rom":"[^"]*","chanc":2,"results":\[{.*}\]}$' $TMPDIR/run.json ; then
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: Unexpected output: $(head -c 200 $TMPDIR/run.json)"
+elif [ "$RESULTC" -lt 1 ] || [ "$RESULTC" -ne "$HEAPC" ] ; then
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: $RESULTC results, $HEAPC with heap stats. Expected at least one, and all."
+else
+  echo "EGG_TEST PASS 20261017-eggstra-bench.sh: JSON output, $RESULTC results."
+fi
+
+# Baseline that took a thousand seconds for everything: We're faster, so pass.
+sed -E 's/"render_s":[0-9.e+-]+/"render_s":1000/g' $TMPDIR/run.json >$TMPDIR/slow.json
+if $EGGSTRA bench "$ROM" --limit=2 --baseline=$TMPDIR/slow.json >/dev/null 2>$TMPDIR/slow.err ; then
+  echo "EGG_TEST PASS 20261017-eggstra-bench.sh: Baseline gate passes when nothing got slower."
+else
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: Baseline gate failed against a slower baseline: $(cat $TMPDIR/slow.err)"
+fi
+
+# Baseline that took no time at all, and no floor: Everything regressed, so fail and say how many.
+# Results with no audio, eg empty sounds, can't be compared, so don't count those.
+sed -E 's/"render_s":[0-9.e+-]+/"render_s":1.0e-9/g' $TMPDIR/run.json >$TMPDIR/fast.json
+if $EGGSTRA bench "$ROM" --limit=2 --baseline=$TMPDIR/fast.json --floor-ms=0 >/dev/null 2>$TMPDIR/fast.err ; then
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: Baseline gate passed against an impossibly fast baseline."
+elif ! grep -q "$AUDIBLEC results more than 20% slower than baseline" $TMPDIR/fast.err ; then
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: Baseline gate failed but didn't report all $AUDIBLEC regressions: $(tail -n1 $TMPDIR/fast.err)"
+else
+  echo "EGG_TEST PASS 20261017-eggstra-bench.sh: Baseline gate fails when everything got slower."
+fi
+
+# Same impossible baseline, but every result is under the floor: Too quick to judge, so pass.
+if $EGGSTRA bench "$ROM" --limit=2 --baseline=$TMPDIR/fast.json --floor-ms=1000000 >/dev/null 2>$TMPDIR/floor.err ; then
+  echo "EGG_TEST PASS 20261017-eggstra-bench.sh: Baseline gate ignores results under the floor."
+else
+  echo "EGG_TEST FAIL 20261017-eggstra-bench.sh: Baseline gate judged results under the floor: $(cat $TMPDIR/floor.err)"
+fi
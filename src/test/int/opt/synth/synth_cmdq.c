@@ -0,0 +1,76 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+/* Queued commands apply at the next update, in order, and a full queue drops and counts.
+ * Seeking is refused. synth_flush_queue() applies pending commands immediately.
+ */
+
+EGG_ITEST(synth_cmdq_defers_and_counts_overflow) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,2,512))
+
+  EGG_ASSERT(synth_set_queue_depth(3)==4,"Depth should round up to a power of two.")
+  EGG_ASSERT_CALL(synth_play_song(1,1,1,1.0f,0.0f))
+  EGG_ASSERT_CALL(synth_queue_set(1,0xff,SYNTH_PROP_TRIM,0.5f))
+  EGG_ASSERT_CALL(synth_queue_set(1,0xff,SYNTH_PROP_TRIM,0.75f))
+  EGG_ASSERT_CALL(synth_queue_note_on(1,0,0x40,0x60))
+  EGG_ASSERT(synth_queue_note_off(1,0,0x40,0x40)<0,"Fourth command should overflow.")
+  EGG_ASSERT(synth_get_queue_overflow()==1)
+  EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_TRIM)==1.0f,"Trim should not change until the next update.")
+
+  synth_update(512);
+  EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_TRIM)==0.75f,"Commands must apply in order.")
+  EGG_ASSERT_CALL(synth_queue_note_off(1,0,0x40,0x40),"Queue should have room again after draining.")
+
+  // Seeking can build the seek index, so it's refused. That's not an overflow.
+  EGG_ASSERT(synth_queue_set(1,0xff,SYNTH_PROP_PLAYHEAD,1.0f)<0)
+  EGG_ASSERT(synth_get_queue_overflow()==1)
+
+  // Flush applies immediately, eg for a reader that must observe queued commands.
+  EGG_ASSERT_CALL(synth_queue_set(1,0xff,SYNTH_PROP_TRIM,0.25f))
+  synth_flush_queue();
+  EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_TRIM)==0.25f)
+
+  synth_quit();
+  return 0;
+}
+
+/* Songs, sounds and timed events started thru the queue sound exactly like the same calls made directly.
+ * Nothing is playing until the next update, and the sound is already printed when its command is queued.
+ */
+
+#define CMDQ_FRAMES 512
+#define CMDQ_UPDATES 40
+
+static int cmdq_render(float *dst,int queued) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,1,CMDQ_FRAMES))
+  EGG_ASSERT(synth_set_queue_depth(16)>0)
+  if (queued) {
+    EGG_ASSERT_CALL(synth_queue_play_song(1,6,1,0.8f,0.0f))
+    EGG_ASSERT_CALL(synth_queue_play_sound(2,0.6f,0.0f))
+    EGG_ASSERT_CALL(synth_queue_event_at(1,0,SYNTH_EVENT_NOTE_ONCE,0x40,0x60,200,SYNTH_TIME_PLAYHEAD,0.1))
+    EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_EXISTENCE)==0.0f,"Song should not exist until the next update.")
+    int pcmc=0;
+    EGG_ASSERT(synth_get_sound_pcm(&pcmc,2),"Sound should print before queueing.")
+  } else {
+    EGG_ASSERT(synth_play_song(1,6,1,0.8f,0.0f)==1)
+    synth_play_sound(2,0.6f,0.0f);
+    EGG_ASSERT_CALL(synth_event_at(1,0,SYNTH_EVENT_NOTE_ONCE,0x40,0x60,200,SYNTH_TIME_PLAYHEAD,0.1))
+  }
+  int i=0; for (;i<CMDQ_UPDATES;i++) {
+    synth_update(CMDQ_FRAMES);
+    memcpy(dst+i*CMDQ_FRAMES,synth_get_buffer(0),sizeof(float)*CMDQ_FRAMES);
+  }
+  EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_EXISTENCE)==1.0f)
+  synth_quit();
+  return 0;
+}
+
+EGG_ITEST(synth_cmdq_play_matches_direct) {
+  static float direct[CMDQ_FRAMES*CMDQ_UPDATES],queued[CMDQ_FRAMES*CMDQ_UPDATES];
+  EGG_ASSERT_CALL(cmdq_render(direct,0))
+  EGG_ASSERT_CALL(cmdq_render(queued,1))
+  int i=0; for (;i<CMDQ_FRAMES*CMDQ_UPDATES;i++) {
+    if (direct[i]!=queued[i]) EGG_FAIL("Frame %d: direct %.9f, queued %.9f",i,direct[i],queued[i])
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Two contexts playing the same song, updated alternately, produce the same output.
+ * And they don't disturb the default context or each other.
+ */
+
+static struct synth_context *context_with_song(const void *rom,int romc) {
+  struct synth_context *context=synth_context_new(44100,2,BUFFER_FRAMES);
+  if (!context) return 0;
+  struct synth_context *prev=synth_context_use(context);
+  if (synth_test_set_rom(rom,romc)>=0) {
+    synth_play_song(1,1,1,1.0f,0.0f);
+  }
+  synth_context_use(prev);
+  return context;
+}
+
+EGG_ITEST(synth_context_independent_instances) {
+  void *rom=0;
+  int romc=synth_test_read_demo(&rom);
+  EGG_ASSERT_CALL(romc)
+  EGG_ASSERT_CALL(synth_init(22050,1,BUFFER_FRAMES))
+
+  struct synth_context *a=context_with_song(rom,romc);
+  EGG_ASSERT(a)
+  struct synth_context *b=context_with_song(rom,romc);
+  EGG_ASSERT(b)
+  EGG_ASSERT(a!=b)
+  const float *al=synth_context_get_buffer(a,0),*bl=synth_context_get_buffer(b,0);
+  const float *ar=synth_context_get_buffer(a,1),*br=synth_context_get_buffer(b,1);
+  EGG_ASSERT(al&&bl&&ar&&br)
+  EGG_ASSERT(al!=bl)
+
+  int loud=0,i=50;
+  while (i-->0) {
+    synth_context_update(a,BUFFER_FRAMES);
+    synth_context_update(b,BUFFER_FRAMES);
+    if (memcmp(al,bl,sizeof(float)*BUFFER_FRAMES)) EGG_FAIL("Left channels differ, update %d",50-i)
+    if (memcmp(ar,br,sizeof(float)*BUFFER_FRAMES)) EGG_FAIL("Right channels differ, update %d",50-i)
+    int f=0; for (;f<BUFFER_FRAMES;f++) if (al[f]!=0.0f) { loud=1; break; }
+  }
+  EGG_ASSERT(loud)
+
+  // The default context is still as we left it.
+  EGG_ASSERT_INTS(synth_get_output_rate(),22050)
+  EGG_ASSERT_INTS(synth_get_chanc(),1)
+  EGG_ASSERT(!synth_get_buffer(1))
+
+  synth_context_del(a);
+  synth_context_del(b);
+  synth_quit();
+  free(rom);
+  return 0;
+}
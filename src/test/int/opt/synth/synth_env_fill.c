@@ -0,0 +1,121 @@
+#include "test/egg_test.h"
+#include "opt/synth/synth_internal.h"
+
+/* synth_env_fill() replaced the per-frame synth_env_update() macro.
+ * Run one runner each way from the same config, and the levels must agree exactly, frame for frame.
+ * The macro is reproduced here as it was.
+ */
+
+#define REF_ENV(env) ({ \
+  float _v=(env).v; \
+  if ((env).c>0) { \
+    (env).c--; \
+    (env).v+=(env).dv; \
+  } else { \
+    synth_env_advance(&(env)); \
+  } \
+  (_v); \
+})
+
+#define FRAME_LIMIT 1024
+
+/* (releasep) is the frame to release at, or <0 never.
+ */
+
+static int env_fill_compare(const char *name,const struct synth_env *config,float velocity,int durframes,int releasep,int framec) {
+  struct synth_env a={0},b={0};
+  synth_env_apply(&a,config,velocity,durframes);
+  synth_env_apply(&b,config,velocity,durframes);
+  static const int updcv[]={1,2,3,100,7,FRAME_LIMIT,4,511,13,64};
+  const int updcc=sizeof(updcv)/sizeof(updcv[0]);
+  float fill[FRAME_LIMIT];
+  int framep=0,updp=0;
+  while (framep<framec) {
+    int updc=updcv[updp++%updcc];
+    if ((releasep>=framep)&&(releasep<framep+updc)) updc=releasep-framep;
+    if (framep+updc>framec) updc=framec-framep;
+    if (updc>0) {
+      synth_env_fill(fill,&a,updc);
+      int i=0; for (;i<updc;i++) {
+        float expect=REF_ENV(b);
+        if (fill[i]!=expect) EGG_FAIL("%s, velocity %f, dur %d: Frame %d, block %.9f, per-frame %.9f",name,velocity,durframes,framep+i,fill[i],expect)
+      }
+      framep+=updc;
+    }
+    if (framep==releasep) {
+      synth_env_release(&a);
+      synth_env_release(&b);
+      releasep=-1;
+    }
+  }
+  EGG_ASSERT_INTS(a.finished,b.finished,"%s",name)
+  EGG_ASSERT_INTS(a.pointp,b.pointp,"%s",name)
+  EGG_ASSERT_INTS(a.c,b.c,"%s",name)
+  EGG_ASSERT(a.v==b.v,"%s",name)
+  return 0;
+}
+
+/* Every config at several velocities and durations, with and without an early release.
+ */
+
+static int env_fill_compare_all(const char *name,const struct synth_env *config) {
+  static const float velv[]={0.0f,0.25f,0.7f,1.0f};
+  static const int durv[]={0,1,500,20000};
+  int vi=0; for (;vi<sizeof(velv)/sizeof(velv[0]);vi++) {
+    int di=0; for (;di<sizeof(durv)/sizeof(durv[0]);di++) {
+      EGG_ASSERT_CALL(env_fill_compare(name,config,velv[vi],durv[di],-1,60000))
+      EGG_ASSERT_CALL(env_fill_compare(name,config,velv[vi],durv[di],10,60000))
+      EGG_ASSERT_CALL(env_fill_compare(name,config,velv[vi],durv[di],1500,60000))
+    }
+  }
+  return 0;
+}
+
+EGG_ITEST(synth_env_fill_matches_per_frame) {
+  EGG_ASSERT_CALL(synth_init(44100,1,FRAME_LIMIT))
+  struct synth_env config;
+
+  // Fallbacks: Level has velocity, sustain, and four legs. The others are constant.
+  synth_env_decode(&config,0,0,SYNTH_ENV_FALLBACK_LEVEL);
+  EGG_ASSERT_CALL(env_fill_compare_all("level",&config))
+  synth_env_decode(&config,0,0,SYNTH_ENV_FALLBACK_ONE);
+  EGG_ASSERT_CALL(env_fill_compare_all("one",&config))
+  synth_env_decode(&config,0,0,SYNTH_ENV_FALLBACK_ZERO);
+  EGG_ASSERT_CALL(env_fill_compare_all("zero",&config))
+
+  // The level envelope scaled and biased, as FM does to pitch.
+  synth_env_decode(&config,0,0,SYNTH_ENV_FALLBACK_LEVEL);
+  synth_env_add(&config,-0.5f);
+  synth_env_mlt(&config,32767.0f);
+  EGG_ASSERT_CALL(env_fill_compare_all("pitch",&config))
+
+  // Initials, velocity, one-frame legs, a flat leg, sustain on the first point, and legs that go up and down.
+  config=(struct synth_env){
+    .flags=SYNTH_ENV_INITIALS|SYNTH_ENV_VELOCITY|SYNTH_ENV_SUSTAIN|SYNTH_ENV_PRESENT,
+    .initlo=0.1f,.inithi=0.9f,
+    .susp=0,
+    .pointc=6,
+    .pointv={
+      {1,1,1.0f,0.5f},
+      {1,3,0.3f,0.3f},
+      {40,40,0.3f,0.3f},
+      {7,2000,-0.6f,0.77f},
+      {1,1,0.0f,1.0f},
+      {333,97,0.0f,0.0f},
+    },
+  };
+  EGG_ASSERT_CALL(env_fill_compare_all("mixed",&config))
+
+  // No sustain, no velocity, and the longest possible point list.
+  memset(&config,0,sizeof(config));
+  config.flags=SYNTH_ENV_PRESENT;
+  config.pointc=SYNTH_ENV_POINT_LIMIT;
+  int i=0; for (;i<SYNTH_ENV_POINT_LIMIT;i++) {
+    config.pointv[i].tlo=config.pointv[i].thi=1+i*i*3;
+    config.pointv[i].vlo=config.pointv[i].vhi=(i&1)?1.0f/(i+1):0.0f;
+  }
+  EGG_ASSERT_CALL(env_fill_compare_all("long",&config))
+
+  synth_quit();
+  return 0;
+}
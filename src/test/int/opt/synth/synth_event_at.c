@@ -0,0 +1,79 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 512
+#define UPDATEC 40
+#define TARGET_FRAME 5000 /* Deliberately not on a buffer boundary. */
+
+/* Play song 1 and render a fixed length of mono output.
+ * (mode) 0: No injection.
+ * (mode) 1: Schedule a note at TARGET_FRAME before starting, then update in uniform buffers.
+ * (mode) 2: Split the buffer at TARGET_FRAME and inject the note untimed there.
+ */
+
+static float *synth_event_at_render(const void *rom,int romc,int mode) {
+  if (synth_init(44100,1,BUFFER_FRAMES)<0) return 0;
+  if (synth_test_set_rom(rom,romc)<0) {
+    synth_quit();
+    return 0;
+  }
+  float *pcm=0;
+  if (synth_play_song(1,1,0,1.0f,0.0f)<0) goto _done_;
+  int chid=0;
+  while ((chid<16)&&(synth_get(1,chid,SYNTH_PROP_EXISTENCE)<=0.0f)) chid++;
+  if (chid>=16) goto _done_;
+  if (mode==1) {
+    if (synth_event_at(1,chid,SYNTH_EVENT_NOTE_ONCE,0x50,0x60,200,SYNTH_TIME_PLAYHEAD,(double)TARGET_FRAME/44100.0)<0) goto _done_;
+  }
+  if (!(pcm=malloc(sizeof(float)*BUFFER_FRAMES*UPDATEC))) goto _done_;
+  float *p=pcm;
+  int i=0;
+  for (;i<UPDATEC;i++,p+=BUFFER_FRAMES) {
+    int bufp=i*BUFFER_FRAMES;
+    if ((mode==2)&&(bufp<TARGET_FRAME)&&(bufp+BUFFER_FRAMES>TARGET_FRAME)) {
+      int headc=TARGET_FRAME-bufp;
+      synth_update(headc);
+      memcpy(p,synth_get_buffer(0),sizeof(float)*headc);
+      synth_event_note_once(1,chid,0x50,0x60,200);
+      synth_update(BUFFER_FRAMES-headc);
+      memcpy(p+headc,synth_get_buffer(0),sizeof(float)*(BUFFER_FRAMES-headc));
+    } else {
+      synth_update(BUFFER_FRAMES);
+      memcpy(p,synth_get_buffer(0),sizeof(float)*BUFFER_FRAMES);
+    }
+  }
+  if (synth_get_clock()!=(double)(BUFFER_FRAMES*UPDATEC)) {
+    free(pcm);
+    pcm=0;
+  }
+ _done_:;
+  synth_quit();
+  return pcm;
+}
+
+/* A scheduled note must land on its exact frame, the same as if we had cut the buffer there.
+ */
+
+EGG_ITEST(synth_event_at_is_sample_accurate) {
+  void *rom=0;
+  int romc=synth_test_read_demo(&rom);
+  EGG_ASSERT_CALL(romc)
+  float *plain=synth_event_at_render(rom,romc,0);
+  float *timed=synth_event_at_render(rom,romc,1);
+  float *split=synth_event_at_render(rom,romc,2);
+  EGG_ASSERT(plain&&timed&&split,"Render failed.")
+  int i=0,diffc=0;
+  for (;i<BUFFER_FRAMES*UPDATEC;i++) {
+    if (timed[i]!=split[i]) EGG_FAIL("Mismatch at frame %d: %f vs %f",i,timed[i],split[i])
+    if (timed[i]!=plain[i]) {
+      if (i<TARGET_FRAME) EGG_FAIL("Scheduled note leaked in early, at frame %d.",i)
+      diffc++;
+    }
+  }
+  EGG_ASSERT(diffc,"Scheduled note made no difference, test is meaningless.")
+  free(plain);
+  free(timed);
+  free(split);
+  free(rom);
+  return 0;
+}
@@ -0,0 +1,280 @@
+#include "test/egg_test.h"
+#define synth_channel_type_fm synth_channel_type_fm_under_test /* Our copy of the kernels, so we don't collide with the real one. */
+#include "opt/synth/synth_channel_type_fm.c"
+#undef synth_channel_type_fm
+
+#define BUFFER_FRAMES 1024
+
+/* Reference: The per-frame FM loops as they were before block processing.
+ * Envelopes step per frame too, the way the retired synth_env_update() did.
+ * The block kernels must produce exactly the same samples.
+ */
+
+#define REF_ENV(env) ({ \
+  float _v=(env).v; \
+  if ((env).c>0) { \
+    (env).c--; \
+    (env).v+=(env).dv; \
+  } else { \
+    synth_env_advance(&(env)); \
+  } \
+  (_v); \
+})
+
+static void ref_voice_waveaonly(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  for (;framec-->0;dst++) {
+    voice->carp+=voice->cardp;
+    float sample=CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT];
+    float level=REF_ENV(voice->levelenv);
+    (*dst)+=sample*level;
+  }
+}
+
+static void ref_voice_waveonly(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  for (;framec-->0;dst++) {
+    voice->carp+=voice->cardp;
+    float mix=REF_ENV(voice->mixenv);
+    float sample=
+      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
+      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
+    float level=REF_ENV(voice->levelenv);
+    (*dst)+=sample*level;
+  }
+}
+
+static void ref_voice_fmonly(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  for (;framec-->0;dst++) {
+    float fdp=(float)voice->cardp;
+    voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
+    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
+    float range=REF_ENV(voice->rangeenv);
+    mod*=range;
+    int32_t dp=voice->cardp+(fdp*mod);
+    voice->carp+=dp;
+    float sample=CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT];
+    float level=REF_ENV(voice->levelenv);
+    (*dst)+=sample*level;
+  }
+}
+
+static void ref_voice_nobend(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  for (;framec-->0;dst++) {
+    float fdp=(float)voice->cardp;
+    voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
+    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
+    float range=REF_ENV(voice->rangeenv);
+    mod*=range;
+    int32_t dp=voice->cardp+(fdp*mod);
+    voice->carp+=dp;
+    float mix=REF_ENV(voice->mixenv);
+    float sample=
+      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
+      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
+    float level=REF_ENV(voice->levelenv);
+    (*dst)+=sample*level;
+  }
+}
+
+static void ref_voice_nolfo(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  for (;framec-->0;dst++) {
+    float fdp=(float)voice->cardp;
+    int cents=(int)REF_ENV(voice->pitchenv);
+    fdp*=synth_bend_from_cents(cents);
+    // The old "nolfo" ignored (modabs). The kernel takes it into account, so the reference does too.
+    if (CHANNEL->modabs) voice->modp+=CHANNEL->modabs;
+    else voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
+    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
+    float range=REF_ENV(voice->rangeenv);
+    mod*=range;
+    int32_t dp=(int32_t)(fdp+(fdp*mod));
+    voice->carp+=dp;
+    float mix=REF_ENV(voice->mixenv);
+    float sample=
+      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
+      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
+    float level=REF_ENV(voice->levelenv);
+    (*dst)+=sample*level;
+  }
+}
+
+static void ref_voice_full(float *dst,struct synth_voice_fm *voice,struct synth_channel *channel,int framec) {
+  const float *rangelfo=CHANNEL->rangelfo;
+  const float *mixlfo=CHANNEL->mixlfo;
+  for (;framec-->0;dst++) {
+    float fdp=(float)voice->cardp;
+    int cents=(int)REF_ENV(voice->pitchenv);
+    fdp*=synth_bend_from_cents(cents);
+    if (CHANNEL->modabs) voice->modp+=CHANNEL->modabs;
+    else voice->modp+=(int32_t)(fdp*CHANNEL->modrate);
+    float mod=CHANNEL->modulator->v[voice->modp>>SYNTH_WAVE_SHIFT];
+    float range=REF_ENV(voice->rangeenv);
+    if (rangelfo) {
+      range*=*rangelfo;
+      rangelfo++;
+    }
+    mod*=range;
+    int32_t dp=voice->cardp+(fdp*mod);
+    voice->carp+=dp;
+    float mix=REF_ENV(voice->mixenv);
+    if (mixlfo) {
+      mix+=*mixlfo;
+      if (mix<0.0f) mix=0.0f; else if (mix>1.0f) mix=1.0f;
+      mixlfo++;
+    }
+    float sample=
+      CHANNEL->wavea->v[voice->carp>>SYNTH_WAVE_SHIFT]*(1.0f-mix)+
+      CHANNEL->waveb->v[voice->carp>>SYNTH_WAVE_SHIFT]*mix;
+    float level=REF_ENV(voice->levelenv);
+    (*dst)+=sample*level;
+  }
+}
+
+/* Reference channel update. LFOs the same as the real thing; that part wasn't touched.
+ */
+
+static void ref_update(float *dst,struct synth_channel *channel,int framec,void (*voice_update)(float*,struct synth_voice_fm*,struct synth_channel*,int)) {
+  if (voice_update==ref_voice_full) {
+    if (CHANNEL->rangelfo) {
+      const float *lfosrc=CHANNEL->rangelfowave->v;
+      float *lfodst=CHANNEL->rangelfo;
+      float mlt=0.5f*CHANNEL->rangelfodepth;
+      float add=1.0f-CHANNEL->rangelfodepth;
+      int i=framec; for (;i-->0;lfodst++) {
+        CHANNEL->rangelfop+=CHANNEL->rangelfodp;
+        *lfodst=(lfosrc[CHANNEL->rangelfop>>SYNTH_WAVE_SHIFT]+1.0f)*mlt+add;
+      }
+    }
+    if (CHANNEL->mixlfo) {
+      const float *lfosrc=CHANNEL->mixlfowave->v;
+      float *lfodst=CHANNEL->mixlfo;
+      int i=framec; for (;i-->0;lfodst++) {
+        CHANNEL->mixlfop+=CHANNEL->mixlfodp;
+        *lfodst=lfosrc[CHANNEL->mixlfop>>SYNTH_WAVE_SHIFT]*CHANNEL->mixlfodepth;
+      }
+    }
+  }
+  struct synth_voice_fm *voice=CHANNEL->voicev;
+  int i=CHANNEL->voicec;
+  for (;i-->0;voice++) voice_update(dst,voice,channel,framec);
+  while (CHANNEL->voicec&&CHANNEL->voicev[CHANNEL->voicec-1].levelenv.finished) CHANNEL->voicec--;
+}
+
+/* Build a channel with every feature the variant uses, and nothing it doesn't.
+ * Start from the empty config, then fill in fields by hand: Envelopes all derive from the default level envelope, which has velocity, sustain, and several legs.
+ */
+
+#define FEATURE_MIX     0x01
+#define FEATURE_FM      0x02
+#define FEATURE_PITCH   0x04
+#define FEATURE_ABSMOD  0x08
+#define FEATURE_LFO     0x10
+
+static struct synth_wave *fm_test_wave(int shape) {
+  struct synth_wave *wave=synth_wave_new();
+  if (!wave) return 0;
+  int i=0; for (;i<SYNTH_WAVE_SIZE_SAMPLES;i++) {
+    float t=(float)i/(float)SYNTH_WAVE_SIZE_SAMPLES;
+    if (shape) wave->v[i]=(t<0.5f)?1.0f:-1.0f; // Square.
+    else wave->v[i]=t*2.0f-1.0f; // Saw.
+  }
+  return wave;
+}
+
+static struct synth_channel *fm_test_channel(struct synth_song *song,int features) {
+  struct synth_channel *channel=synth_channel_new(song,0,0xff,0x80,0x02/*fm*/,0,0,0,0);
+  if (!channel) return 0;
+  if (features&FEATURE_MIX) {
+    if (!(CHANNEL->waveb=fm_test_wave(0))) return 0;
+    CHANNEL->mixenv=CHANNEL->levelenv;
+    CHANNEL->mixenv.flags|=SYNTH_ENV_PRESENT;
+  }
+  if (features&(FEATURE_FM|FEATURE_ABSMOD)) {
+    if (!(CHANNEL->modulator=fm_test_wave(1))) return 0;
+    CHANNEL->modrate=1.5f;
+    CHANNEL->rangeenv=CHANNEL->levelenv;
+    synth_env_mlt(&CHANNEL->rangeenv,2.0f);
+    if (features&FEATURE_ABSMOD) CHANNEL->modabs=synth_song_get_tempo_step(song,0.25f);
+  }
+  if (features&FEATURE_PITCH) {
+    CHANNEL->pitchenv=CHANNEL->levelenv;
+    synth_env_mlt(&CHANNEL->pitchenv,-700.0f);
+    CHANNEL->pitchenv.flags|=SYNTH_ENV_PRESENT;
+  }
+  if (features&FEATURE_LFO) {
+    CHANNEL->rangelfowave=&synth.sine;
+    CHANNEL->rangelfodepth=0.5f;
+    CHANNEL->rangelfodp=synth_song_get_tempo_step(song,0.5f);
+    CHANNEL->mixlfowave=&synth.sine;
+    CHANNEL->mixlfodepth=0.3f;
+    CHANNEL->mixlfodp=synth_song_get_tempo_step(song,0.75f);
+    if (!(CHANNEL->rangelfo=synth_malloc(sizeof(float)*synth.buffer_frames))) return 0;
+    if (!(CHANNEL->mixlfo=synth_malloc(sizeof(float)*synth.buffer_frames))) return 0;
+  }
+  return channel;
+}
+
+/* Run one variant against its reference: A few notes, one released early, then the rest, in odd-sized updates.
+ */
+
+static int fm_test_variant(
+  const char *name,
+  int features,
+  void (*kernel)(float*,struct synth_channel*,int),
+  void (*reference)(float*,struct synth_voice_fm*,struct synth_channel*,int)
+) {
+  struct synth_song song={.trim=1.0f,.chanc=1,.tempo=0.5f};
+  struct synth_channel *a=fm_test_channel(&song,features);
+  struct synth_channel *b=fm_test_channel(&song,features);
+  EGG_ASSERT(a&&b,"%s",name)
+  static const uint8_t notev[]={0x30,0x3c,0x43,0x48};
+  static const float velv[]={0.3f,0.8f,0.5f,1.0f};
+  int i=0; for (;i<4;i++) {
+    a->type->note_on(a,notev[i],velv[i]);
+    b->type->note_on(b,notev[i],velv[i]);
+  }
+  float bufa[BUFFER_FRAMES],bufb[BUFFER_FRAMES];
+  static const int updcv[]={1000,1,37,512,3,BUFFER_FRAMES,255,4,7,640};
+  const int updcc=sizeof(updcv)/sizeof(updcv[0]);
+  int framep=0,updp=0,releasec=0,loud=0;
+  while (framep<synth.rate*3) {
+    if ((releasec==0)&&(framep>=synth.rate/2)) {
+      a->type->note_off(a,notev[1]);
+      b->type->note_off(b,notev[1]);
+      releasec=1;
+    } else if ((releasec==1)&&(framep>=synth.rate)) {
+      a->type->release_all(a);
+      b->type->release_all(b);
+      releasec=2;
+    }
+    int updc=updcv[updp++%updcc];
+    memset(bufa,0,sizeof(bufa));
+    memset(bufb,0,sizeof(bufb));
+    kernel(bufa,a,updc);
+    ref_update(bufb,b,updc,reference);
+    for (i=0;i<updc;i++) {
+      if (bufa[i]!=bufb[i]) EGG_FAIL("%s: Frame %d, kernel %.9f, reference %.9f",name,framep+i,bufa[i],bufb[i])
+      if (bufa[i]!=0.0f) loud=1;
+    }
+    EGG_ASSERT_INTS(((struct synth_channel_fm*)a)->voicec,((struct synth_channel_fm*)b)->voicec,"%s at frame %d",name,framep)
+    framep+=updc;
+  }
+  EGG_ASSERT(loud,"%s: Expected some output.",name)
+  EGG_ASSERT_INTS(((struct synth_channel_fm*)a)->voicec,0,"%s: Voices should have finished.",name)
+  synth_channel_del(a);
+  synth_channel_del(b);
+  return 0;
+}
+
+EGG_ITEST(synth_fm_kernels_match_scalar) {
+  EGG_ASSERT_CALL(synth_init(44100,1,BUFFER_FRAMES))
+  EGG_ASSERT_CALL(fm_test_variant("waveaonly",0,_fm_update_mono_waveaonly,ref_voice_waveaonly))
+  EGG_ASSERT_CALL(fm_test_variant("waveonly",FEATURE_MIX,_fm_update_mono_waveonly,ref_voice_waveonly))
+  EGG_ASSERT_CALL(fm_test_variant("fmonly",FEATURE_FM,_fm_update_mono_fmonly,ref_voice_fmonly))
+  EGG_ASSERT_CALL(fm_test_variant("nobend",FEATURE_MIX|FEATURE_FM,_fm_update_mono_nobend,ref_voice_nobend))
+  EGG_ASSERT_CALL(fm_test_variant("nolfo",FEATURE_MIX|FEATURE_FM|FEATURE_PITCH,_fm_update_mono_nolfo,ref_voice_nolfo))
+  EGG_ASSERT_CALL(fm_test_variant("nolfo absmod",FEATURE_MIX|FEATURE_ABSMOD|FEATURE_PITCH,_fm_update_mono_nolfo,ref_voice_nolfo))
+  EGG_ASSERT_CALL(fm_test_variant("full",FEATURE_MIX|FEATURE_FM|FEATURE_PITCH|FEATURE_LFO,_fm_update_mono_full,ref_voice_full))
+  EGG_ASSERT_CALL(fm_test_variant("full absmod",FEATURE_MIX|FEATURE_ABSMOD|FEATURE_PITCH|FEATURE_LFO,_fm_update_mono_full,ref_voice_full))
+  synth_quit();
+  return 0;
+}
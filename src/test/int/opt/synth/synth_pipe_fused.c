@@ -0,0 +1,101 @@
+#include "test/egg_test.h"
+/* Our own copy of the pipe, so we can reach its stage constructors without colliding with the real one. */
+#define synth_pipe_del synth_pipe_del_under_test
+#define synth_pipe_new synth_pipe_new_under_test
+#define synth_pipe_update_mono synth_pipe_update_mono_under_test
+#define synth_pipe_update_stereo synth_pipe_update_stereo_under_test
+#define synth_pipe_skip synth_pipe_skip_under_test
+#define synth_pipe_clear synth_pipe_clear_under_test
+#include "opt/synth/synth_pipe.c"
+
+#define FRAMEC 3000
+#define STAGE_LIMIT 16
+
+/* synth_pipe_new() drops noops and fuses gain and waveshaper pairs, and update runs the stages in blocks.
+ * Reference: Each stage decoded on its own, unfused, and run over the whole buffer before the next.
+ * Output must match exactly, mono and stereo, at any update size.
+ */
+
+static void pipe_signal(float *dst,int framec,float rate) {
+  int i=0; for (;i<framec;i++) dst[i]=1.25f*sinf(i*rate)*((i%97)/96.0f);
+}
+
+static int pipe_compare(const char *name,const uint8_t *src,int srcc,int chanc,int expectstagec) {
+  struct synth_song song={.trim=1.0f,.chanc=chanc,.tempo=0.5f};
+  struct synth_pipe *pipe=synth_pipe_new(&song,src,srcc);
+  EGG_ASSERT(pipe,"%s",name)
+  EGG_ASSERT_INTS(pipe->stagec,expectstagec,"%s",name)
+
+  struct synth_pipe_stage *refv[STAGE_LIMIT];
+  int refc=0,srcp=0;
+  while (srcp<srcc) {
+    uint8_t type=src[srcp++];
+    uint8_t len=src[srcp++];
+    EGG_ASSERT(refc<STAGE_LIMIT)
+    EGG_ASSERT(refv[refc++]=synth_pipe_stage_new(&song,type,src+srcp,len),"%s",name)
+    srcp+=len;
+  }
+
+  static float al[FRAMEC],ar[FRAMEC],bl[FRAMEC],br[FRAMEC];
+  pipe_signal(al,FRAMEC,0.01f);
+  pipe_signal(ar,FRAMEC,0.023f);
+  memcpy(bl,al,sizeof(al));
+  memcpy(br,ar,sizeof(ar));
+
+  static const int updcv[]={1,255,256,257,1000,3,512,SYNTH_PIPE_BLOCK_FRAMES*3+1};
+  const int updcc=sizeof(updcv)/sizeof(updcv[0]);
+  int framep=0,updp=0;
+  while (framep<FRAMEC) {
+    int updc=updcv[updp++%updcc];
+    if (framep+updc>FRAMEC) updc=FRAMEC-framep;
+    if (chanc>=2) synth_pipe_update_stereo(al+framep,ar+framep,pipe,updc);
+    else synth_pipe_update_mono(al+framep,pipe,updc);
+    framep+=updc;
+  }
+  int i=0; for (;i<refc;i++) {
+    if (chanc>=2) refv[i]->update_stereo(bl,br,refv[i],FRAMEC);
+    else refv[i]->update_mono(bl,refv[i],FRAMEC);
+  }
+
+  for (i=0;i<FRAMEC;i++) {
+    if (al[i]!=bl[i]) EGG_FAIL("%s, chanc=%d: Frame %d left, pipe %.9f, unfused %.9f",name,chanc,i,al[i],bl[i])
+    if ((chanc>=2)&&(ar[i]!=br[i])) EGG_FAIL("%s, chanc=%d: Frame %d right, pipe %.9f, unfused %.9f",name,chanc,i,ar[i],br[i])
+  }
+
+  for (i=0;i<refc;i++) {
+    if (refv[i]->del) refv[i]->del(refv[i]);
+    synth_free(refv[i]);
+  }
+  synth_pipe_del(pipe);
+  return 0;
+}
+
+#define GAIN 0x01,0x04,0x01,0x80,0xe0,0x10 /* mlt 1.5, clip 0.88, gate 0.06 */
+#define GAIN_QUIET 0x01,0x02,0x00,0xc0 /* mlt 0.75 */
+#define DELAY 0x02,0x04,0x00,0x08,0x80,0x80 /* 1/32 qnote */
+#define TREMOLO 0x03,0x03,0x00,0x80,0xc0
+#define DETUNE 0x04,0x04,0x01,0x00,0x80,0x80
+#define WAVESHAPER 0x05,0x06,0x40,0x00,0xa0,0x00,0xff,0xff
+#define WAVESHAPER_EMPTY 0x05,0x00
+#define LOPASS 0x06,0x00
+#define NOOP 0x00,0x00
+
+#define PIPE(name,stagec,...) { \
+  static const uint8_t src[]={__VA_ARGS__}; \
+  EGG_ASSERT_CALL(pipe_compare(name,src,sizeof(src),1,stagec)) \
+  EGG_ASSERT_CALL(pipe_compare(name,src,sizeof(src),2,stagec)) \
+}
+
+EGG_ITEST(synth_pipe_fused_matches_unfused) {
+  EGG_ASSERT_CALL(synth_init(44100,2,1024))
+  PIPE("gain,waveshaper",1,GAIN,WAVESHAPER)
+  PIPE("waveshaper,gain",1,WAVESHAPER,GAIN)
+  PIPE("gain,gain,gain",2,GAIN,GAIN_QUIET,GAIN) // Fused stages don't fuse again.
+  PIPE("waveshaper,waveshaper",1,WAVESHAPER,WAVESHAPER_EMPTY)
+  PIPE("gain,lopass,waveshaper",1,GAIN,LOPASS,WAVESHAPER) // Noops vanish, and their neighbors fuse across them.
+  PIPE("gain,delay,gain,waveshaper",3,GAIN,DELAY,GAIN_QUIET,WAVESHAPER)
+  PIPE("lopass,gain,tremolo,noop,waveshaper,detune",4,LOPASS,GAIN,TREMOLO,NOOP,WAVESHAPER,DETUNE)
+  PIPE("delay,tremolo,detune",3,DELAY,TREMOLO,DETUNE)
+  synth_quit();
+  return 0;
+}
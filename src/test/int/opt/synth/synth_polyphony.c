@@ -0,0 +1,49 @@
+#include "test/egg_test.h"
+#include "opt/synth/synth_internal.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Starting a song measures each channel's polyphony once and caches it on the resource.
+ * The cached count must match a fresh scan, be reused for the same tail, and be measured again for a different tail.
+ */
+
+EGG_ITEST(synth_polyphony_cached_per_resource) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,2,BUFFER_FRAMES))
+  EGG_ASSERT_CALL(synth_play_song(1,2,1,1.0f,0.0f))
+  EGG_ASSERT_INTS(synth.songc,1)
+  struct synth_song *song=synth.songv[0];
+  struct synth_res *res=synth_res_get(2);
+  EGG_ASSERT(res)
+  EGG_ASSERT(res->polymask,"Expected channel polyphony cached on the resource after starting the song.")
+
+  // Every cached count agrees with a fresh scan. A song without a resource always scans.
+  struct synth_song fresh=*song;
+  fresh.rid=0;
+  int chid=0,busychid=-1;
+  for (;chid<16;chid++) {
+    if (!(res->polymask&(1<<chid))) continue;
+    const struct synth_polyphony *poly=res->polyv+chid;
+    int expect=synth_song_measure_polyphony(&fresh,chid,poly->tailms,SYNTH_VOICE_LIMIT);
+    EGG_ASSERT_INTS(poly->voicec,expect,"chid %d",chid)
+    if ((busychid<0)&&(expect>1)) busychid=chid;
+  }
+  EGG_ASSERT(busychid>=0,"Expected some channel in song 2 to play chords.")
+
+  // Hit: Same tail reads the cache, even a poisoned one. (limit) still applies.
+  struct synth_polyphony *poly=res->polyv+busychid;
+  int tailms=poly->tailms,real=poly->voicec;
+  poly->voicec=SYNTH_VOICE_LIMIT-1;
+  EGG_ASSERT_INTS(synth_song_measure_polyphony(song,busychid,tailms,SYNTH_VOICE_LIMIT),SYNTH_VOICE_LIMIT-1)
+  EGG_ASSERT_INTS(synth_song_measure_polyphony(song,busychid,tailms,1),1)
+
+  // Miss: Different tail scans again and replaces the entry.
+  int longer=synth_song_measure_polyphony(&fresh,busychid,tailms+1000,SYNTH_VOICE_LIMIT);
+  EGG_ASSERT_INTS(synth_song_measure_polyphony(song,busychid,tailms+1000,SYNTH_VOICE_LIMIT),longer)
+  EGG_ASSERT_INTS(poly->tailms,tailms+1000)
+  EGG_ASSERT_INTS(poly->voicec,longer)
+  EGG_ASSERT(longer>=real)
+
+  synth_quit();
+  return 0;
+}
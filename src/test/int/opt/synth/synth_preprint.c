@@ -0,0 +1,66 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+/* Play every sound in the demo ROM at once, optionally preprinting first, and capture the output.
+ * Returns a new buffer of interleaved stereo samples.
+ */
+
+static float *synth_preprint_render(int *dstc,int *pcmsize,const void *rom,int romc,int preprint) {
+  const int rate=44100,buffer_frames=1024,updatec=100;
+  if (synth_init(rate,2,buffer_frames)<0) return 0;
+  if (synth_test_set_rom(rom,romc)<0) {
+    synth_quit();
+    return 0;
+  }
+  if (preprint) {
+    if (synth_preprint_sounds()<=0) {
+      synth_quit();
+      return 0;
+    }
+    while (synth_preprint_update(buffer_frames)>0) ;
+  }
+  int rid=1;
+  for (;rid<=16;rid++) synth_play_sound(rid,0.5f,0.0f);
+  float *pcm=malloc(sizeof(float)*2*buffer_frames*updatec);
+  if (!pcm) {
+    synth_quit();
+    return 0;
+  }
+  float *p=pcm;
+  int i=updatec;
+  for (;i-->0;p+=buffer_frames*2) {
+    synth_update(buffer_frames);
+    memcpy(p,synth_get_buffer(0),sizeof(float)*buffer_frames);
+    memcpy(p+buffer_frames,synth_get_buffer(1),sizeof(float)*buffer_frames);
+  }
+  *pcmsize=synth_get_pcm_size(0);
+  synth_quit();
+  *dstc=buffer_frames*2*updatec;
+  return pcm;
+}
+
+/* Preprinted sounds must sound exactly like ones printed on demand.
+ */
+
+EGG_ITEST(synth_preprint_matches_on_demand) {
+  void *rom=0;
+  int romc=synth_test_read_demo(&rom);
+  EGG_ASSERT_CALL(romc)
+  int lazyc=0,prec=0,lazysize=0,presize=0;
+  float *lazy=synth_preprint_render(&lazyc,&lazysize,rom,romc,0);
+  EGG_ASSERT(lazy,"On-demand render failed.")
+  float *pre=synth_preprint_render(&prec,&presize,rom,romc,1);
+  EGG_ASSERT(pre,"Preprinted render failed.")
+  EGG_ASSERT(lazyc==prec)
+  EGG_ASSERT(presize>0)
+  EGG_ASSERT(presize==lazysize,"presize=%d lazysize=%d",presize,lazysize)
+  int i=0,loudc=0; for (;i<lazyc;i++) {
+    if (lazy[i]!=pre[i]) EGG_FAIL("Mismatch at sample %d: %f vs %f",i,lazy[i],pre[i])
+    if (lazy[i]!=0.0f) loudc++;
+  }
+  EGG_ASSERT(loudc,"Output is silent, test is meaningless.")
+  free(lazy);
+  free(pre);
+  free(rom);
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Play a song with profiling enabled, and every counter should land somewhere sensible.
+ */
+
+EGG_ITEST(synth_profile_counts_song_and_channels) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,2,BUFFER_FRAMES))
+
+  EGG_ASSERT_CALL(synth_set_profiling(1))
+  EGG_ASSERT_CALL(synth_play_song(1,1,1,1.0f,0.0f))
+  int i=100; while (i-->0) synth_update(BUFFER_FRAMES);
+
+  struct synth_profile profile={0};
+  EGG_ASSERT_CALL(synth_get_profile(&profile))
+  EGG_ASSERT_INTS(profile.framec,100*BUFFER_FRAMES)
+  EGG_ASSERT(profile.update_ns>0)
+  struct synth_profile_song songv[4];
+  int songc=synth_get_song_profiles(songv,4);
+  EGG_ASSERT_INTS(songc,1)
+  EGG_ASSERT_INTS(songv[0].rid,1)
+  EGG_ASSERT_INTS(songv[0].framec,100*BUFFER_FRAMES)
+  EGG_ASSERT(songv[0].ns>0)
+  EGG_ASSERT(songv[0].ns<=profile.update_ns)
+  int64_t chns=0;
+  int voicec=0;
+  for (i=0;i<16;i++) {
+    chns+=songv[0].channelv[i].ns+songv[0].channelv[i].post_ns;
+    voicec+=songv[0].channelv[i].voicec_max;
+  }
+  EGG_ASSERT(chns>0)
+  EGG_ASSERT(chns<=songv[0].ns)
+  EGG_ASSERT(voicec>0)
+
+  // Stopping the song folds it into the tally; nothing is lost.
+  EGG_ASSERT_CALL(synth_play_song(1,0,0,1.0f,0.0f))
+  i=20; while (i-->0) synth_update(BUFFER_FRAMES);
+  EGG_ASSERT_INTS(synth_get_song_profiles(songv,4),1)
+  EGG_ASSERT(songv[0].framec>=100*BUFFER_FRAMES)
+
+  // Enabling again resets.
+  EGG_ASSERT_CALL(synth_set_profiling(1))
+  EGG_ASSERT_INTS(synth_get_song_profiles(songv,4),0)
+
+  synth_quit();
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "test/egg_test.h"
+#include "opt/synth/synth_internal.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Underrun reports step quality down, one step per hold period, and quiet time steps it back up.
+ */
+
+EGG_ITEST(synth_quality_underrun_and_recovery) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,2,BUFFER_FRAMES))
+  EGG_ASSERT_CALL(synth_play_song(1,1,1,1.0f,0.0f))
+
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_FULL)
+  synth_report_underrun();
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_REDUCED)
+  synth_report_underrun(); // Same glitch reported twice; ignored.
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_REDUCED)
+  int i=30; while (i-->0) synth_update(BUFFER_FRAMES);
+  synth_report_underrun();
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_MINIMAL)
+
+  // Song keeps playing at minimal quality, then recovers about two seconds after each step.
+  i=200; while (i-->0) synth_update(BUFFER_FRAMES);
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_FULL)
+
+  synth_quit();
+  return 0;
+}
+
+/* Measured load steps down only when it stays over the threshold for several buffers in a row.
+ * A single spike, even well over real time, is ignored.
+ */
+
+EGG_ITEST(synth_quality_ignores_single_spike) {
+  EGG_ASSERT_CALL(synth_init(44100,2,BUFFER_FRAMES))
+  synth_set_adaptive_quality(0.7f,0.35f);
+  int64_t budget=(int64_t)BUFFER_FRAMES*1000000000ll/44100; // ns of real time per buffer.
+  int64_t calm=budget/10,spike=budget*3;
+  
+  int i=10; while (i-->0) synth_quality_update(calm,BUFFER_FRAMES);
+  synth_quality_update(spike,BUFFER_FRAMES);
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_FULL,"One spike must not degrade.")
+  synth_quality_update(spike,BUFFER_FRAMES);
+  synth_quality_update(spike,BUFFER_FRAMES);
+  synth_quality_update(calm,BUFFER_FRAMES);
+  synth_quality_update(spike,BUFFER_FRAMES);
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_FULL,"A calm buffer resets the streak.")
+  
+  i=4; while (i-->0) synth_quality_update(spike,BUFFER_FRAMES);
+  EGG_ASSERT_INTS(synth_get_quality(),SYNTH_QUALITY_REDUCED,"Sustained load degrades.")
+  
+  synth_quit();
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+#include "opt/synth/synth_internal.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Seek song (rid) on (songid) to (s), and render one buffer of mono output into (dst).
+ * Returns the playhead immediately after seeking.
+ */
+
+static float synth_seek_render(float *dst,int songid,int rid,float s) {
+  if (synth_play_song(songid,rid,0,1.0f,0.0f)<0) return -1.0f;
+  synth_set(songid,0xff,SYNTH_PROP_PLAYHEAD,s);
+  float ph=synth_get(songid,0xff,SYNTH_PROP_PLAYHEAD);
+  synth_update(BUFFER_FRAMES);
+  memcpy(dst,synth_get_buffer(0),sizeof(float)*BUFFER_FRAMES);
+  synth_set(songid,0xff,SYNTH_PROP_EXISTENCE,0.0f);
+  int i=20; while (i-->0) synth_update(BUFFER_FRAMES); // Let it fade out.
+  return ph;
+}
+
+/* Seeking lands on the requested time, not the next event, and picks up the notes held there.
+ * Reference: The same seek with the index off, replaying every event from the start of the song.
+ */
+
+EGG_ITEST(synth_seek_lands_exactly_and_restores_notes) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,1,BUFFER_FRAMES))
+  float a[BUFFER_FRAMES],b[BUFFER_FRAMES];
+  int rid=1,loudc=0;
+  for (;rid<=12;rid++) {
+    const float target=12.345f;
+    float pha=synth_seek_render(a,1,rid,target);
+    synth.seek_disable=1;
+    float phb=synth_seek_render(b,2,rid,target);
+    synth.seek_disable=0;
+    if (pha<0.0f) continue;
+    EGG_ASSERT(pha==phb,"song:%d indexed=%f replayed=%f",rid,pha,phb)
+    if (pha<target-0.001f) continue; // Song is shorter than target; we land at the end.
+    EGG_ASSERT(pha<=target+0.001f,"song:%d target=%f playhead=%f",rid,target,pha)
+    int i=0,loud=0; for (;i<BUFFER_FRAMES;i++) {
+      if (a[i]!=b[i]) EGG_FAIL("song:%d frame %d: indexed %.9f, replayed %.9f",rid,i,a[i],b[i])
+      if (a[i]!=0.0f) loud=1;
+    }
+    if (loud) loudc++;
+  }
+  EGG_ASSERT(loudc,"Every seek was silent, test is meaningless.")
+  synth_quit();
+  return 0;
+}
+
+/* Voice count and wheel position on one channel of a playing song.
+ */
+
+static int synth_seek_channel_state(int *voicec,float *wheel,int songid,int chid) {
+  struct synth_song **p=synth.songv;
+  int i=synth.songc;
+  for (;i-->0;p++) {
+    if ((*p)->songid!=songid) continue;
+    struct synth_channel *channel=(*p)->channel_by_chid[chid];
+    if (!channel) EGG_FAIL("song %d has no channel %d",songid,chid)
+    EGG_ASSERT(channel->type->get_voicec)
+    *voicec=channel->type->get_voicec(channel);
+    *wheel=synth_get(songid,chid,SYNTH_PROP_WHEEL);
+    return 0;
+  }
+  EGG_FAIL("song %d not found",songid)
+}
+
+/* Song 6 of the demo holds one note on channels 0 and 1 for its first 240 ms while it sweeps channel 0's wheel,
+ * then does the same from 680 to 920 ms sweeping channel 1's.
+ * Seeking into either of those must land with the same voices and wheels as playing there from the start.
+ */
+
+EGG_ITEST(synth_seek_matches_linear_voices_and_wheel) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,1,BUFFER_FRAMES))
+  static const int targetv[]={130,750};
+  int ti=0; for (;ti<sizeof(targetv)/sizeof(targetv[0]);ti++) {
+    int ms=targetv[ti];
+    EGG_ASSERT(synth_play_song(1,6,0,1.0f,0.0f)==1)
+    int framec=synth_frames_from_ms(ms);
+    while (framec>0) {
+      int updc=(framec>BUFFER_FRAMES)?BUFFER_FRAMES:framec;
+      synth_update(updc);
+      framec-=updc;
+    }
+    EGG_ASSERT(synth_play_song(2,6,0,1.0f,0.0f)==2)
+    synth_set(2,0xff,SYNTH_PROP_PLAYHEAD,ms/1000.0f);
+    EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_PLAYHEAD)==synth_get(2,0xff,SYNTH_PROP_PLAYHEAD),"ms=%d",ms)
+    int bent=0,chid=0; for (;chid<2;chid++) {
+      int linearc=0,seekc=0;
+      float linearw=0.0f,seekw=0.0f;
+      EGG_ASSERT_CALL(synth_seek_channel_state(&linearc,&linearw,1,chid))
+      EGG_ASSERT_CALL(synth_seek_channel_state(&seekc,&seekw,2,chid))
+      EGG_ASSERT_INTS(linearc,1,"ms=%d chid=%d, linear",ms,chid)
+      EGG_ASSERT_INTS(seekc,1,"ms=%d chid=%d, after seek",ms,chid)
+      EGG_ASSERT(linearw==seekw,"ms=%d chid=%d wheel: linear %f, after seek %f",ms,chid,linearw,seekw)
+      if (seekw!=0.0f) bent=1;
+    }
+    EGG_ASSERT(bent,"ms=%d: Expected a wheel in motion.",ms)
+    synth_stop_all_songs();
+    int i=20; while (i-->0) synth_update(BUFFER_FRAMES);
+  }
+  synth_quit();
+  return 0;
+}
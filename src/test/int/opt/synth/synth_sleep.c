@@ -0,0 +1,152 @@
+#include "test/egg_test.h"
+#include "opt/synth/synth_internal.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Song 12 of the demo has a channel 0 with no events, so it falls asleep right away.
+ * A note must wake it, from the very next update.
+ */
+
+EGG_ITEST(synth_sleeping_channel_wakes_on_note) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,2,BUFFER_FRAMES))
+
+  EGG_ASSERT_CALL(synth_play_song(1,12,1,1.0f,0.0f))
+  EGG_ASSERT(synth_get(1,0,SYNTH_PROP_EXISTENCE)==1.0f,"Expected song 12 to have a channel 0.")
+  int chid=1; for (;chid<16;chid++) synth_set(1,chid,SYNTH_PROP_TRIM,0.0f);
+  int i=10; while (i-->0) synth_update(BUFFER_FRAMES);
+  const float *l=synth_get_buffer(0),*r=synth_get_buffer(1);
+  for (i=0;i<BUFFER_FRAMES;i++) {
+    if ((l[i]!=0.0f)||(r[i]!=0.0f)) EGG_FAIL("Expected silence before the note, frame %d = %f,%f",i,l[i],r[i])
+  }
+
+  synth_event_note_on(1,0,0x40,0x60);
+  synth_update(BUFFER_FRAMES);
+  int loud=0;
+  for (i=0;i<BUFFER_FRAMES;i++) if ((l[i]!=0.0f)&&(r[i]!=0.0f)) { loud=1; break; }
+  EGG_ASSERT(loud,"Note on a sleeping channel should be heard at the next update.")
+
+  synth_quit();
+  return 0;
+}
+
+/* Song 8 channel 5 has a delay in its post, and goes idle early on.
+ * Count calls into its type and post. Once asleep, neither may run, until a note wakes it.
+ */
+
+static int sleep_typec=0,sleep_postc=0;
+static void (*sleep_type_mono)(float*,struct synth_channel*,int)=0;
+static void (*sleep_type_stereo)(float*,float*,struct synth_channel*,int)=0;
+static void (*sleep_post_mono)(float*,struct synth_pipe_stage*,int)=0;
+static void (*sleep_post_stereo)(float*,float*,struct synth_pipe_stage*,int)=0;
+
+static void sleep_count_type_mono(float *v,struct synth_channel *channel,int framec) {
+  sleep_typec++;
+  sleep_type_mono(v,channel,framec);
+}
+static void sleep_count_type_stereo(float *l,float *r,struct synth_channel *channel,int framec) {
+  sleep_typec++;
+  sleep_type_stereo(l,r,channel,framec);
+}
+static void sleep_count_post_mono(float *v,struct synth_pipe_stage *stage,int framec) {
+  sleep_postc++;
+  sleep_post_mono(v,stage,framec);
+}
+static void sleep_count_post_stereo(float *l,float *r,struct synth_pipe_stage *stage,int framec) {
+  sleep_postc++;
+  sleep_post_stereo(l,r,stage,framec);
+}
+
+static struct synth_channel *sleep_get_channel(int chid) {
+  if (synth.songc<1) return 0;
+  struct synth_song *song=synth.songv[0];
+  if ((chid<0)||(chid>=0x10)) return 0;
+  return song->channel_by_chid[chid];
+}
+
+static int sleep_begin_song_8(int sleep_disable) {
+  if (synth_test_init_demo(44100,2,BUFFER_FRAMES)<0) return -1;
+  synth.sleep_disable=sleep_disable;
+  if (synth_play_song(1,8,0,1.0f,0.0f)<0) return -1;
+  int chid=0; for (;chid<16;chid++) if (chid!=5) synth_set(1,chid,SYNTH_PROP_TRIM,0.0f);
+  return 0;
+}
+
+EGG_ITEST(synth_sleeping_channel_does_no_work) {
+  EGG_ASSERT_CALL(sleep_begin_song_8(0))
+  struct synth_channel *channel=sleep_get_channel(5);
+  EGG_ASSERT(channel,"Expected song 8 to have a channel 5.")
+  EGG_ASSERT(channel->post&&(channel->post->stagec>0)&&channel->post->tail,"Expected a post with tail on song 8 channel 5.")
+  sleep_type_mono=channel->update_mono;
+  sleep_type_stereo=channel->update_stereo;
+  channel->update_mono=sleep_count_type_mono;
+  if (sleep_type_stereo) channel->update_stereo=sleep_count_type_stereo;
+  struct synth_pipe_stage *stage=channel->post->stagev[0];
+  sleep_post_mono=stage->update_mono;
+  sleep_post_stereo=stage->update_stereo;
+  stage->update_mono=sleep_count_post_mono;
+  if (sleep_post_stereo) stage->update_stereo=sleep_count_post_stereo;
+
+  int i=0; for (;i<200;i++) {
+    synth_update(BUFFER_FRAMES);
+    if (channel->asleep) break;
+  }
+  EGG_ASSERT(channel->asleep,"Song 8 channel 5 should fall asleep within 200 updates.")
+  EGG_ASSERT(sleep_typec&&sleep_postc,"Type and post should have run before sleeping.")
+
+  int typec0=sleep_typec,postc0=sleep_postc;
+  for (i=0;i<50;i++) synth_update(BUFFER_FRAMES);
+  EGG_ASSERT(channel->asleep)
+  EGG_ASSERT_INTS(sleep_typec,typec0,"Type updated while asleep.")
+  EGG_ASSERT_INTS(sleep_postc,postc0,"Post updated while asleep.")
+
+  synth_event_note_on(1,5,0x40,0x60);
+  synth_update(BUFFER_FRAMES);
+  EGG_ASSERT(!channel->asleep)
+  EGG_ASSERT(sleep_typec>typec0,"Type should run again once awake.")
+  EGG_ASSERT(sleep_postc>postc0,"Post should run again once awake.")
+
+  synth_quit();
+  return 0;
+}
+
+/* Sleeping drops whatever post still holds below SYNTH_SLEEP_LEVEL, so it's not bit-identical in general.
+ * Render song 8 channel 5, waking it with a note after it sleeps, with sleep enabled and disabled.
+ * Output must agree within ten times SYNTH_SLEEP_LEVEL, which leaves room for delay feedback on the dropped residue.
+ */
+
+static float *sleep_render_song_8(int sleep_disable,int wakeat,int bufc) {
+  if (sleep_begin_song_8(sleep_disable)<0) return 0;
+  float *dst=malloc(sizeof(float)*BUFFER_FRAMES*2*bufc);
+  if (!dst) return 0;
+  float *p=dst;
+  int i=0; for (;i<bufc;i++,p+=BUFFER_FRAMES*2) {
+    if (i==wakeat) synth_event_note_on(1,5,0x40,0x60);
+    synth_update(BUFFER_FRAMES);
+    memcpy(p,synth_get_buffer(0),sizeof(float)*BUFFER_FRAMES);
+    memcpy(p+BUFFER_FRAMES,synth_get_buffer(1),sizeof(float)*BUFFER_FRAMES);
+  }
+  synth_quit();
+  return dst;
+}
+
+EGG_ITEST(synth_sleep_matches_awake_within_tolerance) {
+  const int wakeat=100,bufc=300; // Channel 5 is asleep well before 100; see synth_sleeping_channel_does_no_work.
+  float *slept=sleep_render_song_8(0,wakeat,bufc);
+  EGG_ASSERT(slept)
+  float *awake=sleep_render_song_8(1,wakeat,bufc);
+  EGG_ASSERT(awake)
+  float worst=0.0f,peak=0.0f;
+  int i=BUFFER_FRAMES*2*bufc; while (i-->0) {
+    float d=slept[i]-awake[i];
+    if (d<0.0f) d=-d;
+    if (d>worst) worst=d;
+    float a=(awake[i]<0.0f)?-awake[i]:awake[i];
+    if (a>peak) peak=a;
+  }
+  free(slept);
+  free(awake);
+  EGG_ASSERT(peak>0.01f,"Expected channel 5 to be audible after waking.")
+  EGG_ASSERT(worst<=SYNTH_SLEEP_LEVEL*10.0f,"Sleep changed the output by %g.",worst)
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+#include "opt/serial/serial.h"
+#include "eggdev/convert/eggdev_convert.h"
+#include "eggdev/convert/eggdev_rom.h"
+
+#define RATE 22050
+#define BUFFER_FRAMES 1024
+#define SONG_RID 6
+
+/* Pluck song (rid) out of the demo ROM.
+ */
+
+static int songpcm_get_song(void *dstpp,const void *rom,int romc,int rid) {
+  struct eggdev_rom_reader reader;
+  if (eggdev_rom_reader_init(&reader,rom,romc)<0) return -1;
+  struct eggdev_res res;
+  while (eggdev_rom_reader_next(&res,&reader)>0) {
+    if ((res.tid==EGG_TID_song)&&(res.rid==rid)) {
+      *(const void**)dstpp=res.v;
+      return res.c;
+    }
+  }
+  return -1;
+}
+
+/* Make a ROM with just song (rid), and songpcm if provided, and load it into a fresh synthesizer.
+ */
+
+static int songpcm_init_synth(const void *eau,int eauc,const void *pcm,int pcmc) {
+  struct eggdev_rom_writer writer={0};
+  struct eggdev_rw_res *res=eggdev_rom_writer_insert(&writer,0,EGG_TID_song,SONG_RID);
+  if (!res||(eggdev_rw_res_set_serial(res,eau,eauc)<0)) return -1;
+  if (pcm) {
+    if (!(res=eggdev_rom_writer_insert(&writer,1,EGG_TID_songpcm,SONG_RID))) return -1;
+    if (eggdev_rw_res_set_serial(res,pcm,pcmc)<0) return -1;
+  }
+  struct sr_encoder rom={0};
+  int err=eggdev_rom_writer_encode(&rom,&writer);
+  eggdev_rom_writer_cleanup(&writer);
+  if ((err<0)||(synth_init(RATE,2,BUFFER_FRAMES)<0)) {
+    sr_encoder_cleanup(&rom);
+    return -1;
+  }
+  err=synth_test_set_rom(rom.v,rom.c);
+  sr_encoder_cleanup(&rom);
+  return err;
+}
+
+/* Play the song without repeat until it ends, into (dst) interleaved. Returns frame count.
+ */
+
+static int songpcm_render(float *dst,int dsta) {
+  if (synth_play_song(1,SONG_RID,0,1.0f,0.0f)<1) return -1;
+  int dstc=0;
+  while (synth_get(1,0xff,SYNTH_PROP_EXISTENCE)>0.0f) {
+    if (dstc>dsta-BUFFER_FRAMES) return -1;
+    synth_update(BUFFER_FRAMES);
+    const float *l=synth_get_buffer(0),*r=synth_get_buffer(1);
+    int i=0; for (;i<BUFFER_FRAMES;i++,dstc++) {
+      dst[dstc*2]=l[i];
+      dst[dstc*2+1]=r[i];
+    }
+  }
+  return dstc;
+}
+
+/* Prerender a song with eggdev, and it should stream close enough to live synthesis, and loop forever when asked.
+ * A broken or malformed songpcm falls back to live synthesis.
+ */
+
+EGG_ITEST(synth_songpcm_streams_prerendered_song) {
+  void *rom=0;
+  int romc=synth_test_read_demo(&rom);
+  EGG_ASSERT_CALL(romc)
+  const void *eau=0;
+  int eauc=songpcm_get_song(&eau,rom,romc,SONG_RID);
+  EGG_ASSERT_CALL(eauc)
+
+  struct sr_encoder pcm={0};
+  struct sr_convert_context ctx={.dst=&pcm,.src=eau,.srcc=eauc,.refname="songpcm"};
+  EGG_ASSERT_CALL(eggdev_songpcm_from_eau(&ctx))
+  EGG_ASSERT(pcm.c>24)
+  EGG_ASSERT(!memcmp(pcm.v,"\0EPC",4))
+
+  const int a=RATE*10;
+  float *live=calloc(a*2,sizeof(float));
+  float *stream=calloc(a*2,sizeof(float));
+  EGG_ASSERT(live&&stream)
+  EGG_ASSERT_CALL(songpcm_init_synth(eau,eauc,0,0))
+  int livec=songpcm_render(live,a);
+  synth_quit();
+  EGG_ASSERT_CALL(songpcm_init_synth(eau,eauc,pcm.v,pcm.c))
+  int streamc=songpcm_render(stream,a);
+  synth_quit();
+  EGG_ASSERT(livec>RATE)
+  EGG_ASSERT_INTS(streamc,livec)
+
+  // ADPCM is lossy. Only require it to be close.
+  double sig=0.0,err=0.0;
+  int i=livec*2; while (i-->0) {
+    double d=stream[i]-live[i];
+    sig+=live[i]*live[i];
+    err+=d*d;
+  }
+  EGG_ASSERT(sig>0.0)
+  EGG_ASSERT(err<sig*0.01,"err=%f sig=%f",err,sig)
+
+  // Repeating, it keeps going well past the end, and the playhead stays within the song.
+  EGG_ASSERT_CALL(songpcm_init_synth(eau,eauc,pcm.v,pcm.c))
+  EGG_ASSERT_INTS(synth_play_song(1,SONG_RID,1,1.0f,0.0f),1)
+  EGG_ASSERT(synth_get(1,0,SYNTH_PROP_EXISTENCE)<1.0f,"Prerendered songs have no channels.")
+  for (i=livec*3/BUFFER_FRAMES;i-->0;) synth_update(BUFFER_FRAMES);
+  EGG_ASSERT(synth_get(1,0xff,SYNTH_PROP_EXISTENCE)>0.0f)
+  int loopframe=-1;
+  int playhead=synth_get_song_frames(1,&loopframe);
+  EGG_ASSERT(loopframe>=0)
+  EGG_ASSERT(playhead>=loopframe)
+  EGG_ASSERT(playhead<livec)
+  synth_quit();
+
+  // Corrupt the signature, and it plays live instead.
+  ((uint8_t*)pcm.v)[1]='X';
+  EGG_ASSERT_CALL(songpcm_init_synth(eau,eauc,pcm.v,pcm.c))
+  streamc=songpcm_render(stream,a);
+  synth_quit();
+  EGG_ASSERT_INTS(streamc,livec)
+  EGG_ASSERT(!memcmp(stream,live,sizeof(float)*livec*2))
+  
+  // Loop frame earlier than the second pass's length would put the loop point before zero. Must reject, and play live.
+  uint8_t bad[24+2*12]={
+    0,'E','P','C',
+    0,0,0x56,0x22, // 22050 hz
+    1,0, // mono
+    0,16, // block length
+    0,0,0,32, // frame count
+    0,0,0,16, // end frame
+    0,0,0,4, // loop frame: <32-16
+  };
+  EGG_ASSERT_CALL(songpcm_init_synth(eau,eauc,bad,sizeof(bad)))
+  streamc=songpcm_render(stream,a);
+  synth_quit();
+  EGG_ASSERT_INTS(streamc,livec)
+  EGG_ASSERT(!memcmp(stream,live,sizeof(float)*livec*2))
+
+  free(live);
+  free(stream);
+  sr_encoder_cleanup(&pcm);
+  free(rom);
+  return 0;
+}
@@ -0,0 +1,53 @@
+/* synth_test.h
+ * Fixtures shared by the synth integration tests.
+ * Most of them play songs from the demo ROM, which must be built first.
+ */
+
+#ifndef SYNTH_TEST_H
+#define SYNTH_TEST_H
+
+#include "test/egg_test.h"
+#include "opt/synth/synth.h"
+#include "opt/fs/fs.h"
+
+#define SYNTH_TEST_DEMO_ROM "src/demo/mid/data.egg"
+
+/* Read the demo ROM into a new buffer and return its length.
+ * Fails, with a message saying why, if it hasn't been built.
+ */
+static int synth_test_read_demo(void *dstpp) {
+  int romc=file_read(dstpp,SYNTH_TEST_DEMO_ROM);
+  if (romc<0) EGG_FAIL("%s not found. Build the demo first.",SYNTH_TEST_DEMO_ROM)
+  return romc;
+}
+
+/* Copy a ROM into the current synth context.
+ */
+static int synth_test_set_rom(const void *rom,int romc) {
+  void *dst=synth_get_rom(romc);
+  if (!dst) return -1;
+  memcpy(dst,rom,romc);
+  return 0;
+}
+
+/* synth_init() and load the demo ROM, for tests that need nothing else.
+ * On success, the caller must synth_quit().
+ */
+static int synth_test_init_demo(int rate,int chanc,int buffer_frames) {
+  void *rom=0;
+  int romc=synth_test_read_demo(&rom);
+  if (romc<0) return -1;
+  if (synth_init(rate,chanc,buffer_frames)<0) {
+    free(rom);
+    EGG_FAIL("synth_init(%d,%d,%d) failed",rate,chanc,buffer_frames)
+  }
+  int err=synth_test_set_rom(rom,romc);
+  free(rom);
+  if (err<0) {
+    synth_quit();
+    EGG_FAIL("Failed to load demo ROM into synth.")
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+/* Play every song in the demo ROM at once, and capture a few seconds of output.
+ * Returns a new buffer of interleaved stereo samples.
+ */
+
+static float *synth_threads_render(int *dstc,const void *rom,int romc,int threadc) {
+  const int rate=44100,buffer_frames=1024,updatec=200;
+  if (synth_init(rate,2,buffer_frames)<0) return 0;
+  if (threadc&&(synth_set_threads(threadc)<0)) {
+    synth_quit();
+    return 0;
+  }
+  if (synth_test_set_rom(rom,romc)<0) {
+    synth_quit();
+    return 0;
+  }
+  int rid=1;
+  for (;rid<=16;rid++) synth_play_song(rid,rid,1,0.25f,0.0f);
+  float *pcm=malloc(sizeof(float)*2*buffer_frames*updatec);
+  if (!pcm) {
+    synth_quit();
+    return 0;
+  }
+  float *p=pcm;
+  int i=updatec;
+  for (;i-->0;p+=buffer_frames*2) {
+    synth_update(buffer_frames);
+    memcpy(p,synth_get_buffer(0),sizeof(float)*buffer_frames);
+    memcpy(p+buffer_frames,synth_get_buffer(1),sizeof(float)*buffer_frames);
+  }
+  synth_quit();
+  *dstc=buffer_frames*2*updatec;
+  return pcm;
+}
+
+/* Threaded and serial output must match exactly.
+ */
+
+EGG_ITEST(synth_threads_match_serial) {
+  void *rom=0;
+  int romc=synth_test_read_demo(&rom);
+  EGG_ASSERT_CALL(romc)
+  int serialc=0,threadedc=0;
+  float *serial=synth_threads_render(&serialc,rom,romc,0);
+  EGG_ASSERT(serial,"Serial render failed.")
+  float *threaded=synth_threads_render(&threadedc,rom,romc,3);
+  EGG_ASSERT(threaded,"Threaded render failed.")
+  EGG_ASSERT(serialc==threadedc)
+  int i=0,loudc=0; for (;i<serialc;i++) {
+    if (serial[i]!=threaded[i]) EGG_FAIL("Mismatch at sample %d: %f vs %f",i,serial[i],threaded[i])
+    if (serial[i]!=0.0f) loudc++;
+  }
+  EGG_ASSERT(loudc,"Output is silent, test is meaningless.")
+  free(serial);
+  free(threaded);
+  free(rom);
+  return 0;
+}
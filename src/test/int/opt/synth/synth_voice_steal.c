@@ -0,0 +1,36 @@
+#include "test/egg_test.h"
+#include "test/int/opt/synth/synth_test.h"
+
+#define BUFFER_FRAMES 1024
+
+/* Song 12 of the demo has a channel 0 with no events of its own, so its voice pool is the minimum.
+ * Hold far more notes there than it can voice, then release only the newest ones.
+ * With oldest-first stealing, the newest are the only ones still sounding, so the channel must fall silent.
+ * (Before voice pools, we dropped the new notes instead, and the oldest would hang on).
+ */
+
+EGG_ITEST(synth_voice_steal_oldest_keeps_newest) {
+  EGG_ASSERT_CALL(synth_test_init_demo(44100,1,BUFFER_FRAMES))
+
+  synth_set_voice_stealing(SYNTH_STEAL_OLDEST);
+  EGG_ASSERT_CALL(synth_play_song(1,12,1,1.0f,0.0f))
+  EGG_ASSERT(synth_get(1,0,SYNTH_PROP_EXISTENCE)==1.0f,"Expected song 12 to have a channel 0.")
+  int chid=1; for (;chid<16;chid++) synth_set(1,chid,SYNTH_PROP_TRIM,0.0f);
+
+  const int notec=64,keepc=8;
+  int i=0; for (;i<notec;i++) synth_event_note_on(1,0,40+i,0x60);
+  synth_update(BUFFER_FRAMES);
+  const float *buf=synth_get_buffer(0);
+  int loud=0;
+  for (i=0;i<BUFFER_FRAMES;i++) if (buf[i]!=0.0f) { loud=1; break; }
+  EGG_ASSERT(loud,"Held notes should be audible.")
+
+  for (i=notec-keepc;i<notec;i++) synth_event_note_off(1,0,40+i,0x40);
+  for (i=0;i<200;i++) synth_update(BUFFER_FRAMES); // ~4.6 s, plenty for any release.
+  for (i=0;i<BUFFER_FRAMES;i++) {
+    if (buf[i]!=0.0f) EGG_FAIL("Frame %d = %f after releasing the newest notes. Old notes were not stolen?",i,buf[i])
+  }
+
+  synth_quit();
+  return 0;
+}
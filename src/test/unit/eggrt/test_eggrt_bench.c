@@ -0,0 +1,156 @@
+#include "test/egg_test.h"
+#include "eggrt/eggrt_bench.c"
+#include "eggrt/inmgr/inmgr_text.c"
+#include "opt/serial/sr_primitives.c"
+#include "opt/serial/sr_decoder.c"
+#include "opt/serial/sr_encoder.c"
+#include "opt/serial/sr_encodings.c"
+#include "opt/fs/fs.c"
+
+/* eggrt_bench.c wants the rest of eggrt, but the parts under test only need the globals.
+ * Artificial events go to a log instead of inmgr.
+ */
+
+struct eggrt eggrt={0};
+
+const void *render_get_output(int *w,int *h,int *stride,struct render *render) { return 0; }
+void render_get_stats(struct render_stats *stats,const struct render *render) { memset(stats,0,sizeof(struct render_stats)); }
+
+static struct eggrt_script_event deliveredv[64];
+static int deliveredc=0;
+
+void inmgr_artificial_event(int playerid,int btnid,int value) {
+  if (deliveredc>=sizeof(deliveredv)/sizeof(deliveredv[0])) return;
+  struct eggrt_script_event *event=deliveredv+deliveredc++;
+  event->frame=eggrt.updframec;
+  event->playerid=playerid;
+  event->btnid=btnid;
+  event->value=value;
+}
+
+static int decode_script(const char *src) {
+  eggrt_bench_quit();
+  deliveredc=0;
+  return eggrt_script_decode(src,strlen(src),"<test>");
+}
+
+#define ASSERT_EVENT(v,p,f,pid,btn,val) { \
+  const struct eggrt_script_event *_event=(v)+(p); \
+  if ((_event->frame!=(f))||(_event->playerid!=(pid))||(_event->btnid!=(btn))||(_event->value!=(val))) { \
+    EGG_FAIL( \
+      "Event %d: Expected frame=%d player=%d btnid=0x%x value=%d, got frame=%d player=%d btnid=0x%x value=%d", \
+      p,f,pid,btn,val,_event->frame,_event->playerid,_event->btnid,_event->value \
+    ) \
+  } \
+}
+
+/* Each line states the whole button state for one player, and we emit just the changes, in order.
+ * Players are independent. Comments, blank lines, and lowercase names are fine.
+ */
+
+static int eggrt_script_orders_changes() {
+  EGG_ASSERT_CALL(decode_script(
+    "# Comment line.\n"
+    "\n"
+    "1 1 LEFT south # Trailing comment.\n"
+    "1 2 UP\n"
+    "5 1 SOUTH WEST\n"
+    "5 2 UP\n"
+    "10 1\n"
+  ))
+  EGG_ASSERT_INTS(eggrt.scriptc,7)
+  ASSERT_EVENT(eggrt.scriptv,0,1,1,INMGR_BTN_LEFT,1)
+  ASSERT_EVENT(eggrt.scriptv,1,1,1,INMGR_BTN_SOUTH,1)
+  ASSERT_EVENT(eggrt.scriptv,2,1,2,INMGR_BTN_UP,1)
+  ASSERT_EVENT(eggrt.scriptv,3,5,1,INMGR_BTN_LEFT,0)
+  ASSERT_EVENT(eggrt.scriptv,4,5,1,INMGR_BTN_WEST,1)
+  ASSERT_EVENT(eggrt.scriptv,5,10,1,INMGR_BTN_SOUTH,0)
+  ASSERT_EVENT(eggrt.scriptv,6,10,1,INMGR_BTN_WEST,0)
+
+  // Delivery: Everything due by the current update, once, in order.
+  for (eggrt.updframec=0;eggrt.updframec<=12;eggrt.updframec++) eggrt_bench_input();
+  EGG_ASSERT_INTS(deliveredc,7)
+  int i=0; for (;i<7;i++) ASSERT_EVENT(deliveredv,i,eggrt.scriptv[i].frame,eggrt.scriptv[i].playerid,eggrt.scriptv[i].btnid,eggrt.scriptv[i].value)
+  eggrt_bench_quit();
+  return 0;
+}
+
+/* Signals fire once on the line that names them, and never release. They don't disturb the held state.
+ */
+
+static int eggrt_script_signals() {
+  EGG_ASSERT_CALL(decode_script(
+    "3 1 MENU LEFT\n"
+    "4 1 LEFT\n"
+    "6 1 LEFT MENU\n"
+  ))
+  EGG_ASSERT_INTS(eggrt.scriptc,3)
+  ASSERT_EVENT(eggrt.scriptv,0,3,1,INMGR_BTN_MENU,1)
+  ASSERT_EVENT(eggrt.scriptv,1,3,1,INMGR_BTN_LEFT,1)
+  ASSERT_EVENT(eggrt.scriptv,2,6,1,INMGR_BTN_MENU,1)
+  eggrt_bench_quit();
+  return 0;
+}
+
+/* Malformed scripts fail with -2, having logged the reason.
+ */
+
+static int eggrt_script_rejects() {
+  fprintf(stderr,"Expect some errors logged here...\n");
+  EGG_ASSERT_INTS(decode_script("1 1 JUMP\n"),-2,"Unknown button")
+  EGG_ASSERT_INTS(decode_script("1 1 LX\n"),-2,"Extended button")
+  EGG_ASSERT_INTS(decode_script("1 1 LP\n"),-2,"Extended button")
+  EGG_ASSERT_INTS(decode_script("5 1 LEFT\n4 1\n"),-2,"Frame out of order")
+  EGG_ASSERT_INTS(decode_script("1 0 LEFT\n"),-2,"Player zero")
+  EGG_ASSERT_INTS(decode_script("1 17 LEFT\n"),-2,"Player out of range")
+  EGG_ASSERT_INTS(decode_script("1\n"),-2,"Missing player")
+  EGG_ASSERT_INTS(decode_script("one 1 LEFT\n"),-2,"Malformed frame")
+  fprintf(stderr,"...end of expected errors.\n");
+  // And the same frame twice is fine.
+  EGG_ASSERT_CALL(decode_script("5 1 LEFT\n5 1 RIGHT\n"))
+  EGG_ASSERT_INTS(eggrt.scriptc,3)
+  eggrt_bench_quit();
+  return 0;
+}
+
+/* Summary of the frame report: Average, and median, 99th percentile, and max by rank.
+ */
+
+static int eggrt_bench_summary() {
+  struct eggrt_frame_record recordv[100]={0};
+  int i=0; for (;i<100;i++) {
+    recordv[i].update_us=1+(i*37)%100; // 1..100, scrambled.
+    recordv[i].render_us=7;
+  }
+  struct eggrt_bench_summary summary={0};
+  EGG_ASSERT_CALL(eggrt_bench_summarize(&summary,recordv,100,(int)offsetof(struct eggrt_frame_record,update_us)))
+  EGG_ASSERT(summary.average==50.5,"average %f",summary.average)
+  EGG_ASSERT_INTS(summary.median,51)
+  EGG_ASSERT_INTS(summary.p99,100)
+  EGG_ASSERT_INTS(summary.max,100)
+  EGG_ASSERT_CALL(eggrt_bench_summarize(&summary,recordv,100,(int)offsetof(struct eggrt_frame_record,render_us)))
+  EGG_ASSERT(summary.average==7.0)
+  EGG_ASSERT_INTS(summary.median,7)
+  EGG_ASSERT_INTS(summary.p99,7)
+  EGG_ASSERT_INTS(summary.max,7)
+  // One record, it's all of them.
+  EGG_ASSERT_CALL(eggrt_bench_summarize(&summary,recordv+1,1,(int)offsetof(struct eggrt_frame_record,update_us)))
+  EGG_ASSERT(summary.average==38.0)
+  EGG_ASSERT_INTS(summary.median,38)
+  EGG_ASSERT_INTS(summary.p99,38)
+  EGG_ASSERT_INTS(summary.max,38)
+  // None, no summary.
+  EGG_ASSERT(eggrt_bench_summarize(&summary,recordv,0,0)<0)
+  return 0;
+}
+
+/* TOC.
+ */
+
+int main(int argc,char **argv) {
+  EGG_UTEST(eggrt_script_orders_changes,bench)
+  EGG_UTEST(eggrt_script_signals,bench)
+  EGG_UTEST(eggrt_script_rejects,bench)
+  EGG_UTEST(eggrt_bench_summary,bench)
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include "test/egg_test.h"
+#include "eggrt/eggrt_pcm.c"
+
+/* The vectorized conversion runs 4 frames at a time with a scalar tail.
+ * Whatever the length and channel count, it must agree exactly with the plain per-sample reference.
+ */
+
+#define QSAMPLE(src) (((src)<=-1.0f)?-32768:((src)>=1.0f)?32767:(int)((src)*32767.0f))
+#define CSAMPLE(src) (((src)<-1.0f)?-1.0f:((src)>1.0f)?1.0f:(src))
+
+#define FRAME_LIMIT 32
+#define CHANC_LIMIT 4
+
+static void eggrt_pcm_reference(int16_t *qdst,float *fdst,const float *l,const float *r,int framec,int dstchanc) {
+  for (;framec-->0;l++) {
+    *qdst++=QSAMPLE(*l);
+    *fdst++=CSAMPLE(*l);
+    if (dstchanc>=2) {
+      *qdst++=r?QSAMPLE(*r):0;
+      *fdst++=r?CSAMPLE(*r):0.0f;
+      int i=dstchanc-2; for (;i-->0;) { *qdst++=0; *fdst++=0.0f; }
+    }
+    if (r) r++;
+  }
+}
+
+static int eggrt_pcm_matches_scalar() {
+  // Both rails and beyond, values just inside them, zero, and some ordinary signal.
+  float l[FRAME_LIMIT],r[FRAME_LIMIT];
+  static const float special[]={
+    -1.0f,1.0f,-1.5f,1.5f,-0.99999f,0.99999f,0.0f,-0.0f,
+    -1.0f/32767.0f,1.0f/32767.0f,0.5f,-0.5f,-100.0f,100.0f,
+  };
+  const int specialc=sizeof(special)/sizeof(special[0]);
+  int i=0; for (;i<FRAME_LIMIT;i++) {
+    l[i]=(i<specialc)?special[i]:((i*37)%200-100)/90.0f;
+    r[i]=(i<specialc)?special[specialc-i-1]:((i*53)%200-100)/-90.0f;
+  }
+
+  int dstchanc=1; for (;dstchanc<=CHANC_LIMIT;dstchanc++) {
+    int withr=0; for (;withr<2;withr++) {
+      const float *rp=withr?r:0;
+      int framec=0; for (;framec<=FRAME_LIMIT;framec++) {
+        int16_t qexpect[FRAME_LIMIT*CHANC_LIMIT+1],qactual[FRAME_LIMIT*CHANC_LIMIT+1];
+        float fexpect[FRAME_LIMIT*CHANC_LIMIT+1],factual[FRAME_LIMIT*CHANC_LIMIT+1];
+        int samplec=framec*dstchanc;
+        eggrt_pcm_reference(qexpect,fexpect,l,rp,framec,dstchanc);
+        qactual[samplec]=0x5555;
+        factual[samplec]=123.0f;
+        eggrt_quantize_pcm(qactual,l,rp,framec,dstchanc);
+        eggrt_interleave_pcm(factual,l,rp,framec,dstchanc);
+        EGG_ASSERT_INTS(qactual[samplec],0x5555,"Overran output. chanc=%d r=%d framec=%d",dstchanc,withr,framec)
+        EGG_ASSERT(factual[samplec]==123.0f,"Overran output. chanc=%d r=%d framec=%d",dstchanc,withr,framec)
+        for (i=0;i<samplec;i++) {
+          EGG_ASSERT_INTS(qactual[i],qexpect[i],"chanc=%d r=%d framec=%d sample=%d",dstchanc,withr,framec,i)
+          EGG_ASSERT(factual[i]==fexpect[i],"chanc=%d r=%d framec=%d sample=%d: %f, expected %f",dstchanc,withr,framec,i,factual[i],fexpect[i])
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/* The rails explicitly, thru both the vector path and the tail.
+ */
+
+static int eggrt_pcm_rails() {
+  const float src[5]={-1.0f,1.0f,-2.0f,2.0f,-1.0f};
+  int16_t dst[5];
+  eggrt_quantize_pcm(dst,src,0,5,1);
+  EGG_ASSERT_INTS(dst[0],-32768)
+  EGG_ASSERT_INTS(dst[1],32767)
+  EGG_ASSERT_INTS(dst[2],-32768)
+  EGG_ASSERT_INTS(dst[3],32767)
+  EGG_ASSERT_INTS(dst[4],-32768)
+  return 0;
+}
+
+/* TOC.
+ */
+
+int main(int argc,char **argv) {
+  EGG_UTEST(eggrt_pcm_matches_scalar,audio)
+  EGG_UTEST(eggrt_pcm_rails,audio)
+  return 0;
+}
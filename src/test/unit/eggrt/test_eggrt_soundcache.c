@@ -0,0 +1,206 @@
+#include "test/egg_test.h"
+#include "eggrt/eggrt_soundcache.c"
+#include "opt/fs/fs.c"
+
+/* The cache only talks to synth thru a few calls. Stub them:
+ * "Printed" PCM is a fixed ramp per rid, and anything the cache hands back to synth gets logged.
+ */
+
+struct eggrt eggrt={0};
+
+int hostio_audio_lock(struct hostio *hostio) { return 0; }
+void hostio_audio_unlock(struct hostio *hostio) {}
+
+static int test_rate=44100;
+int synth_get_rate() { return test_rate; }
+
+#define PRINTED_LIMIT 4
+#define PRINTED_SIZE 300
+static float printedv[PRINTED_LIMIT][PRINTED_SIZE];
+
+const float *synth_get_sound_pcm(int *c,int rid) {
+  if ((rid<1)||(rid>=PRINTED_LIMIT)) return 0;
+  *c=PRINTED_SIZE-rid;
+  return printedv[rid];
+}
+
+static struct delivered { int rid; const float *v; int c; } deliveredv[PRINTED_LIMIT];
+static int deliveredc=0;
+
+int synth_set_sound_pcm(int rid,const float *v,int c) {
+  if (deliveredc>=PRINTED_LIMIT) return -1;
+  deliveredv[deliveredc++]=(struct delivered){rid,v,c};
+  return 0;
+}
+
+/* A ROM with two sounds, and resources of other types on either side.
+ * Serials don't need to be valid sounds; the cache never decodes them.
+ */
+
+static char serial1[]="sound one";
+static char serial2[]="sound two";
+static char serialx[]="not a sound";
+
+static struct rom_entry resv[]={
+  {EGG_TID_sound-1,1,serialx,sizeof(serialx)},
+  {EGG_TID_sound,1,serial1,sizeof(serial1)},
+  {EGG_TID_sound,2,serial2,sizeof(serial2)},
+  {EGG_TID_sound+1,1,serialx,sizeof(serialx)},
+};
+
+static char cachedir[]="/tmp/egg-soundcache-XXXXXX";
+
+static int soundcache_setup() {
+  int rid=0; for (;rid<PRINTED_LIMIT;rid++) {
+    int i=0; for (;i<PRINTED_SIZE;i++) printedv[rid][i]=(float)(i-rid*7)/(float)PRINTED_SIZE;
+  }
+  if (!mkdtemp(cachedir)) return -1;
+  eggrt.exename="test_eggrt_soundcache";
+  eggrt.sound_cache=cachedir;
+  eggrt.resv=resv;
+  eggrt.resc=sizeof(resv)/sizeof(resv[0]);
+  return 0;
+}
+
+/* Each test starts with an empty cache.
+ */
+
+static int soundcache_fresh() {
+  eggrt_soundcache_quit();
+  serial2[0]='s';
+  test_rate=44100;
+  dir_rmrf(cachedir);
+  return dir_mkdir(cachedir);
+}
+
+static int count_files_cb(const char *path,const char *base,char type,void *userdata) {
+  (*(int*)userdata)++;
+  return 0;
+}
+
+static int count_files() {
+  int c=0;
+  dir_read(cachedir,count_files_cb,&c);
+  return c;
+}
+
+/* Init and confirm (hitv) are exactly the rids delivered to synth, each with the printed samples.
+ */
+
+static int init_expect_hits(const int *hitv,int hitc) {
+  deliveredc=0;
+  EGG_ASSERT_CALL(eggrt_soundcache_init())
+  EGG_ASSERT_INTS(deliveredc,hitc)
+  int i=0; for (;i<hitc;i++) {
+    const struct delivered *d=deliveredv+i;
+    EGG_ASSERT_INTS(d->rid,hitv[i])
+    EGG_ASSERT_INTS(d->c,PRINTED_SIZE-d->rid)
+    EGG_ASSERT(d->v!=printedv[d->rid],"Expected mapped samples, got synth's own buffer")
+    EGG_ASSERT(!memcmp(d->v,printedv[d->rid],sizeof(float)*d->c),"rid %d: Samples differ",d->rid)
+  }
+  return 0;
+}
+
+/* Cold cache misses everything, saves everything, then the next launch hits everything.
+ */
+
+static int eggrt_soundcache_miss_then_hit() {
+  EGG_ASSERT_CALL(soundcache_fresh())
+  EGG_ASSERT_CALL(init_expect_hits(0,0))
+  eggrt_soundcache_save();
+  EGG_ASSERT_INTS(count_files(),2)
+  eggrt_soundcache_quit();
+
+  static const int hitv[]={1,2};
+  EGG_ASSERT_CALL(init_expect_hits(hitv,2))
+  // Everything hit, so there's nothing to save.
+  eggrt_soundcache_save();
+  EGG_ASSERT_INTS(count_files(),2)
+  eggrt_soundcache_quit();
+  return 0;
+}
+
+/* Anything that goes into the hash misses when it changes: Serial, rate, and SYNTH_VERSION.
+ * Files that lie about themselves miss too.
+ */
+
+static int eggrt_soundcache_invalidates() {
+  static const int hit1[]={1};
+  static const int hit2[]={2};
+  static const int hitboth[]={1,2};
+  EGG_ASSERT_CALL(soundcache_fresh())
+  EGG_ASSERT_CALL(init_expect_hits(0,0))
+  eggrt_soundcache_save();
+  eggrt_soundcache_quit();
+
+  // Change sound 2's serial. Sound 1 still hits, and sound 2 saves under its new hash.
+  serial2[0]='S';
+  EGG_ASSERT_CALL(init_expect_hits(hit1,1))
+  eggrt_soundcache_save();
+  EGG_ASSERT_INTS(count_files(),3)
+  eggrt_soundcache_quit();
+  EGG_ASSERT_CALL(init_expect_hits(hitboth,2))
+  eggrt_soundcache_quit();
+
+  // Change the rate. Nothing hits.
+  test_rate=48000;
+  EGG_ASSERT_CALL(init_expect_hits(0,0))
+  eggrt_soundcache_quit();
+  test_rate=44100;
+
+  // A file from some other synth version, under the right name: Miss.
+  char path[1024];
+  eggrt.soundcache_dir=cachedir;
+  int pathc=eggrt_soundcache_path(path,sizeof(path),eggrt_soundcache_hash(serial1,sizeof(serial1),test_rate));
+  eggrt.soundcache_dir=0;
+  EGG_ASSERT(pathc>0)
+  char *file=0;
+  int filec=file_read(&file,path);
+  EGG_ASSERT(filec>EGGRT_SOUNDCACHE_HEADER_SIZE)
+  ((struct eggrt_soundcache_header*)file)->version=SYNTH_VERSION+1;
+  EGG_ASSERT_CALL(file_write(path,file,filec))
+  EGG_ASSERT_CALL(init_expect_hits(hit2,1))
+  eggrt_soundcache_quit();
+
+  // Truncated: Miss.
+  ((struct eggrt_soundcache_header*)file)->version=SYNTH_VERSION;
+  EGG_ASSERT_CALL(file_write(path,file,filec-sizeof(float)))
+  EGG_ASSERT_CALL(init_expect_hits(hit2,1))
+  // And save repairs it.
+  eggrt_soundcache_save();
+  eggrt_soundcache_quit();
+  EGG_ASSERT_CALL(init_expect_hits(hitboth,2))
+  eggrt_soundcache_quit();
+  free(file);
+  return 0;
+}
+
+/* "none" disables the cache entirely.
+ */
+
+static int eggrt_soundcache_none() {
+  EGG_ASSERT_CALL(soundcache_fresh())
+  eggrt.sound_cache="none";
+  EGG_ASSERT_CALL(init_expect_hits(0,0))
+  EGG_ASSERT(!eggrt.soundcache_dir)
+  eggrt_soundcache_quit();
+  eggrt.sound_cache=cachedir;
+  EGG_ASSERT_INTS(count_files(),0)
+  return 0;
+}
+
+/* TOC.
+ */
+
+int main(int argc,char **argv) {
+  if (soundcache_setup()<0) {
+    fprintf(stderr,"EGG_TEST FAIL soundcache_setup %s\n",__FILE__);
+    return 1;
+  }
+  EGG_UTEST(eggrt_soundcache_miss_then_hit,soundcache)
+  EGG_UTEST(eggrt_soundcache_invalidates,soundcache)
+  EGG_UTEST(eggrt_soundcache_none,soundcache)
+  eggrt_soundcache_quit();
+  dir_rmrf(cachedir);
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "test/egg_test.h"
+
+/* Force synth's own allocator, which native builds normally skip in favor of libc.
+ */
+#ifdef USE_FAKE_MALLOC
+  #undef USE_FAKE_MALLOC
+#endif
+#define USE_FAKE_MALLOC 1
+#include "opt/synth/synth_stdlib.c"
+
+/* Small blocks recycle by size class: Freeing one and allocating the same size gets the same block back.
+ * Blocks don't overlap, and the counters track what's live.
+ */
+ 
+static int synth_malloc_small_blocks() {
+  EGG_ASSERT_CALL(synth_malloc_init())
+  int live=-1,peak=-1,frag=-1,allocc=-1;
+  EGG_ASSERT_CALL(synth_get_heap_stats(&live,&peak,&frag,&allocc))
+  EGG_ASSERT(!live&&!peak&&!frag&&!allocc)
+  
+  uint8_t *v[100];
+  int i=0;
+  for (;i<100;i++) {
+    int len=1+(i*37)%300;
+    EGG_ASSERT(v[i]=synth_malloc(len),"i=%d len=%d",i,len)
+    memset(v[i],i,len);
+  }
+  for (i=0;i<100;i++) {
+    int len=1+(i*37)%300,j=0;
+    for (;j<len;j++) EGG_ASSERT(v[i][j]==i,"Block %d clobbered at %d",i,j)
+  }
+  EGG_ASSERT_CALL(synth_get_heap_stats(&live,&peak,0,&allocc))
+  EGG_ASSERT(live>0)
+  EGG_ASSERT(peak==live)
+  EGG_ASSERT_INTS(allocc,100)
+  
+  void *recycled=v[50];
+  synth_free(v[50]);
+  synth_free(v[50]); // Double free is ignored.
+  EGG_ASSERT(synth_malloc(1+(50*37)%300)==recycled)
+  
+  for (i=0;i<100;i++) synth_free(v[i]);
+  EGG_ASSERT_CALL(synth_get_heap_stats(&live,&peak,&frag,0))
+  EGG_ASSERT(!live,"live=%d",live)
+  EGG_ASSERT(peak>0)
+  EGG_ASSERT(frag>0,"Everything is freed but slabs stay reserved, so some fragmentation is expected.")
+  
+  synth_malloc_quit();
+  return 0;
+}
+
+/* Realloc preserves content whether it stays in place, changes class, or moves between small and large.
+ */
+ 
+static int synth_malloc_realloc() {
+  EGG_ASSERT_CALL(synth_malloc_init())
+  uint8_t *v=synth_malloc(3);
+  EGG_ASSERT(v)
+  v[0]=1; v[1]=2; v[2]=3;
+  EGG_ASSERT(synth_realloc(v,4)==v,"Same class, should stay in place.")
+  int len=4;
+  for (;len<=20000;len*=3) {
+    EGG_ASSERT(v=synth_realloc(v,len))
+    EGG_ASSERT((v[0]==1)&&(v[1]==2)&&(v[2]==3),"len=%d",len)
+  }
+  int32_t *z=synth_calloc(5000,4);
+  EGG_ASSERT(z)
+  int i=5000; while (i-->0) EGG_ASSERT(!z[i])
+  synth_free(v);
+  synth_free(z);
+  int live=-1;
+  EGG_ASSERT_CALL(synth_get_heap_stats(&live,0,0,0))
+  EGG_ASSERT(!live,"live=%d",live)
+  synth_malloc_quit();
+  return 0;
+}
+
+/* TOC.
+ */
+ 
+int main(int argc,char **argv) {
+  EGG_UTEST(synth_malloc_small_blocks,synth)
+  EGG_UTEST(synth_malloc_realloc,synth)
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "test/egg_test.h"
+#include "opt/synth/synth_stdlib.c"
+#include "opt/synth/synth_resample.c"
+#include <math.h>
+
+struct synth_context synth_default={0};
+SYNTH_THREAD_LOCAL struct synth_context *synth_current=&synth_default;
+
+/* The resampler only needs the sine table from the global context.
+ */
+
+static void setup_sine() {
+  int i=0;
+  for (;i<SYNTH_WAVE_SIZE_SAMPLES;i++) synth.sine.v[i]=sinf((i*M_PI*2.0)/SYNTH_WAVE_SIZE_SAMPLES);
+}
+
+/* Feed (src) in awkward chunks and collect the output.
+ */
+
+static int resample_all(float *dst,int dstc,const float *src,int srcc,struct synth_resampler *resampler) {
+  int dstp=0,srcp=0;
+  while (dstp<dstc) {
+    int framec=37+dstp%200;
+    if (framec>dstc-dstp) framec=dstc-dstp;
+    int needc=synth_resampler_get_input_needed(resampler,framec);
+    if (needc>srcc-srcp) return -1;
+    synth_resampler_input(resampler,src+srcp,0,needc);
+    srcp+=needc;
+    synth_resampler_output(dst+dstp,0,resampler,framec);
+    dstp+=framec;
+  }
+  return 0;
+}
+
+/* A sine well below the input's Nyquist comes out the same sine at the output rate, in phase, across chunk boundaries.
+ * And DC stays DC.
+ */
+
+static int synth_resample_sine_and_dc() {
+  setup_sine();
+  const int inrate=24000,outrate=48000,hz=1000;
+  float src[4096],dst[4096];
+  int i;
+
+  struct synth_resampler *resampler=synth_resampler_new(inrate,outrate,1,256);
+  EGG_ASSERT(resampler)
+  for (i=0;i<4096;i++) src[i]=sinf((i*M_PI*2.0*hz)/inrate);
+  EGG_ASSERT_CALL(resample_all(dst,4096,src,4096,resampler))
+  for (i=64;i<4096;i++) {
+    float expect=sinf((i*M_PI*2.0*hz)/outrate);
+    if (fabsf(dst[i]-expect)>0.002f) EGG_FAIL("Frame %d: Expected %f, got %f",i,expect,dst[i])
+  }
+  synth_resampler_del(resampler);
+
+  EGG_ASSERT(resampler=synth_resampler_new(22050,44100,1,256))
+  for (i=0;i<4096;i++) src[i]=0.5f;
+  EGG_ASSERT_CALL(resample_all(dst,4096,src,4096,resampler))
+  for (i=64;i<4096;i++) {
+    if (fabsf(dst[i]-0.5f)>0.0001f) EGG_FAIL("Frame %d: Expected 0.5, got %f",i,dst[i])
+  }
+  synth_resampler_del(resampler);
+  return 0;
+}
+
+/* TOC.
+ */
+ 
+int main(int argc,char **argv) {
+  EGG_UTEST(synth_resample_sine_and_dc,synth)
+  return 0;
+}
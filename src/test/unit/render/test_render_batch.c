@@ -0,0 +1,247 @@
+#include "test/egg_test.h"
+#include "opt/render/render_render.c"
+
+/* render_render() records calls and merges neighbors that would draw the same; render_flush() draws them.
+ * We don't have a GL context here, and don't need one: GL is stubbed, and glDrawArrays logs each draw
+ * with its vertices and the uniforms in effect for its program.
+ * The render unit only builds for native targets, so this is where its batching gets checked.
+ */
+
+static struct render render={0};
+
+static struct render_texture texturev[]={
+  {.texid=1,.w=64,.h=64,.gltexid=11}, // Main output.
+  {.texid=2,.w=8,.h=8,.gltexid=12},
+  {.texid=3,.w=16,.h=16,.gltexid=13},
+  {.texid=4,.w=32,.h=32,.gltexid=14,.fbid=24},
+};
+
+int render_texturev_search(const struct render *render,int texid) {
+  int i=0; for (;i<render->texturec;i++) if (render->texturev[i].texid==texid) return i;
+  return -1;
+}
+
+int render_texture_require_fb(struct render *render,struct render_texture *texture) {
+  return 0;
+}
+
+/* GL.
+ */
+
+#define DRAW_LIMIT 32
+#define DRAW_VTX_LIMIT 32
+
+static struct draw {
+  GLenum glmode;
+  int vtxc;
+  int16_t xv[DRAW_VTX_LIMIT];
+  int dsttexid,srctexid;
+  GLfloat tint[4],alpha;
+} drawv[DRAW_LIMIT];
+static int drawc=0;
+static GLuint boundprogram=0;
+static const void *attrib0=0;
+static GLsizei attrib0stride=0;
+
+GL_APICALL void GL_APIENTRY glUseProgram(GLuint program) { boundprogram=program; }
+
+GL_APICALL void GL_APIENTRY glVertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const void *pointer) {
+  if (index) return;
+  attrib0=pointer;
+  attrib0stride=stride;
+}
+
+GL_APICALL void GL_APIENTRY glDrawArrays(GLenum mode,GLint first,GLsizei count) {
+  if (drawc>=DRAW_LIMIT) return;
+  struct draw *draw=drawv+drawc++;
+  draw->glmode=mode;
+  draw->vtxc=count;
+  int i=0; for (;(i<count)&&(i<DRAW_VTX_LIMIT);i++) draw->xv[i]=*(const int16_t*)((const uint8_t*)attrib0+i*attrib0stride);
+  draw->dsttexid=render.current_dsttexid;
+  draw->srctexid=render.current_srctexid;
+  // Uniforms belong to the program. render_draw() shadows them exactly, so the shadow is what GL has.
+  const struct render_program *program=render.programv;
+  for (i=RENDER_PROGRAM_COUNT;i-->0;program++) {
+    if (program->programid!=boundprogram) continue;
+    memcpy(draw->tint,program->tint,sizeof(draw->tint));
+    draw->alpha=program->alpha;
+    break;
+  }
+}
+
+GL_APICALL void GL_APIENTRY glAttachShader(GLuint program,GLuint shader) {}
+GL_APICALL void GL_APIENTRY glBindAttribLocation(GLuint program,GLuint index,const GLchar *name) {}
+GL_APICALL void GL_APIENTRY glBindBuffer(GLenum target,GLuint buffer) {}
+GL_APICALL void GL_APIENTRY glBindFramebuffer(GLenum target,GLuint framebuffer) {}
+GL_APICALL void GL_APIENTRY glBindTexture(GLenum target,GLuint texture) {}
+GL_APICALL void GL_APIENTRY glBufferData(GLenum target,GLsizeiptr size,const void *data,GLenum usage) {}
+GL_APICALL void GL_APIENTRY glBufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const void *data) {}
+GL_APICALL void GL_APIENTRY glCompileShader(GLuint shader) {}
+GL_APICALL GLuint GL_APIENTRY glCreateProgram(void) { return 0; }
+GL_APICALL GLuint GL_APIENTRY glCreateShader(GLenum type) { return 0; }
+GL_APICALL void GL_APIENTRY glDeleteProgram(GLuint program) {}
+GL_APICALL void GL_APIENTRY glDeleteShader(GLuint shader) {}
+GL_APICALL void GL_APIENTRY glDisableVertexAttribArray(GLuint index) {}
+GL_APICALL void GL_APIENTRY glEnableVertexAttribArray(GLuint index) {}
+GL_APICALL void GL_APIENTRY glGetProgramInfoLog(GLuint program,GLsizei bufSize,GLsizei *length,GLchar *infoLog) {}
+GL_APICALL void GL_APIENTRY glGetProgramiv(GLuint program,GLenum pname,GLint *params) {}
+GL_APICALL void GL_APIENTRY glGetShaderInfoLog(GLuint shader,GLsizei bufSize,GLsizei *length,GLchar *infoLog) {}
+GL_APICALL void GL_APIENTRY glGetShaderiv(GLuint shader,GLenum pname,GLint *params) {}
+GL_APICALL GLint GL_APIENTRY glGetUniformLocation(GLuint program,const GLchar *name) { return -1; }
+GL_APICALL void GL_APIENTRY glLinkProgram(GLuint program) {}
+GL_APICALL void GL_APIENTRY glShaderSource(GLuint shader,GLsizei count,const GLchar *const*string,const GLint *length) {}
+GL_APICALL void GL_APIENTRY glTexParameteri(GLenum target,GLenum pname,GLint param) {}
+GL_APICALL void GL_APIENTRY glUniform1f(GLint location,GLfloat v0) {}
+GL_APICALL void GL_APIENTRY glUniform1i(GLint location,GLint v0) {}
+GL_APICALL void GL_APIENTRY glUniform2f(GLint location,GLfloat v0,GLfloat v1) {}
+GL_APICALL void GL_APIENTRY glUniform4f(GLint location,GLfloat v0,GLfloat v1,GLfloat v2,GLfloat v3) {}
+GL_APICALL void GL_APIENTRY glViewport(GLint x,GLint y,GLsizei width,GLsizei height) {}
+
+/* Fresh context with nothing recorded or bound.
+ */
+
+static void render_batch_reset() {
+  render.texturev=texturev;
+  render.texturec=sizeof(texturev)/sizeof(texturev[0]);
+  render.winw=render.winh=64;
+  render.scale=1.0;
+  render.cmdc=0;
+  render.vtxc=0;
+  render.current_dsttexid=-1;
+  render.current_srctexid=0;
+  render.current_programid=0;
+  render.frame_drawc=0;
+  render.frame_vtxc=0;
+  int i=0; for (;i<RENDER_PROGRAM_COUNT;i++) {
+    render.programv[i].programid=1+i;
+    render_program_forget_uniforms(render.programv+i);
+  }
+  boundprogram=0;
+  drawc=0;
+}
+
+/* Record one call of (c) raw vertices, numbered in x from (x0).
+ */
+
+static void render_batch_call(int mode,int dsttexid,int srctexid,uint32_t tint,uint8_t alpha,uint8_t filter,int x0,int c) {
+  struct egg_render_uniform uniform={
+    .mode=mode,
+    .dsttexid=dsttexid,
+    .srctexid=srctexid,
+    .tint=tint,
+    .alpha=alpha,
+    .filter=filter,
+  };
+  struct egg_render_raw vtxv[DRAW_VTX_LIMIT]={0};
+  int i=0; for (;i<c;i++) {
+    vtxv[i].x=x0+i;
+    vtxv[i].y=i;
+    vtxv[i].a=0xff;
+  }
+  render_render(&render,&uniform,vtxv,sizeof(struct egg_render_raw)*c);
+}
+
+#define ASSERT_DRAW(p,mode,...) { \
+  static const int16_t _expect[]={__VA_ARGS__}; \
+  const int _expectc=sizeof(_expect)/sizeof(_expect[0]); \
+  EGG_ASSERT(drawc>(p),"Expected draw %d, have %d",p,drawc) \
+  const struct draw *_draw=drawv+(p); \
+  EGG_ASSERT_INTS(_draw->glmode,mode,"draw %d",p) \
+  EGG_ASSERT_INTS(_draw->vtxc,_expectc,"draw %d",p) \
+  int _i=0; for (;_i<_expectc;_i++) EGG_ASSERT_INTS(_draw->xv[_i],_expect[_i],"draw %d, vertex %d",p,_i) \
+}
+
+/* Consecutive calls with the same uniform draw once, in the order they were made.
+ * Lists concatenate, triangle strips join with a pair of degenerate triangles, and line strips never merge.
+ */
+
+static int render_batch_merges_matching_calls() {
+  render_batch_reset();
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0,0xff,0,0,3);
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0,0xff,0,10,3);
+  EGG_ASSERT_INTS(render.cmdc,1)
+  render_batch_call(EGG_RENDER_POINTS,1,0,0,0xff,0,20,2);
+  render_batch_call(EGG_RENDER_POINTS,1,0,0,0xff,0,30,1);
+  render_batch_call(EGG_RENDER_LINES,1,0,0,0xff,0,40,2);
+  render_batch_call(EGG_RENDER_LINES,1,0,0,0xff,0,50,2);
+  render_batch_call(EGG_RENDER_LINE_STRIP,1,0,0,0xff,0,60,3);
+  render_batch_call(EGG_RENDER_LINE_STRIP,1,0,0,0xff,0,70,3);
+  render_batch_call(EGG_RENDER_TRIANGLE_STRIP,1,0,0,0xff,0,80,4);
+  render_batch_call(EGG_RENDER_TRIANGLE_STRIP,1,0,0,0xff,0,90,3);
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0,0xff,0,100,3);
+  EGG_ASSERT_INTS(render.cmdc,7)
+  EGG_ASSERT_INTS(render.frame_vtxc,29,"Stats count vertices as submitted, not as merged.")
+
+  render_flush(&render);
+  EGG_ASSERT_INTS(render.cmdc,0)
+  EGG_ASSERT_INTS(render.vtxc,0)
+  EGG_ASSERT_INTS(drawc,7)
+  EGG_ASSERT_INTS(render.frame_drawc,7)
+  ASSERT_DRAW(0,GL_TRIANGLES,0,1,2,10,11,12)
+  ASSERT_DRAW(1,GL_POINTS,20,21,30)
+  ASSERT_DRAW(2,GL_LINES,40,41,50,51)
+  ASSERT_DRAW(3,GL_LINE_STRIP,60,61,62)
+  ASSERT_DRAW(4,GL_LINE_STRIP,70,71,72)
+  ASSERT_DRAW(5,GL_TRIANGLE_STRIP,80,81,82,83,83,90,90,91,92)
+  ASSERT_DRAW(6,GL_TRIANGLES,100,101,102)
+
+  // Flushing again draws nothing.
+  render_flush(&render);
+  EGG_ASSERT_INTS(drawc,7)
+  return 0;
+}
+
+/* Any difference in the uniform starts a new draw, and each draw gets its own uniforms.
+ * Only neighbors merge: A call matching an earlier one but not the last doesn't jump the queue.
+ * Filter only matters when there's a texture.
+ */
+
+static int render_batch_keeps_uniforms_apart() {
+  render_batch_reset();
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0x00000000,0xff,0,0,3);
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0xff000080,0xff,0,10,3); // tint
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0x00000000,0xff,0,20,3); // same as the first
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0x00000000,0x80,0,30,3); // alpha
+  render_batch_call(EGG_RENDER_TRIANGLES,4,0,0x00000000,0x80,0,40,3); // dsttexid
+  render_batch_call(EGG_RENDER_TRIANGLES,4,2,0x00000000,0x80,0,50,3); // srctexid
+  render_batch_call(EGG_RENDER_TRIANGLES,4,2,0x00000000,0x80,1,60,3); // filter, with a texture
+  render_batch_call(EGG_RENDER_TRIANGLES,4,3,0x00000000,0x80,1,70,3); // srctexid
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0x00000000,0xff,0,80,3);
+  render_batch_call(EGG_RENDER_TRIANGLES,1,0,0x00000000,0xff,1,90,3); // filter, no texture: merges
+  EGG_ASSERT_INTS(render.cmdc,9)
+
+  render_flush(&render);
+  EGG_ASSERT_INTS(drawc,9)
+  int i=0; for (;i<8;i++) {
+    EGG_ASSERT_INTS(drawv[i].vtxc,3,"draw %d",i)
+    EGG_ASSERT_INTS(drawv[i].xv[0],i*10,"draw %d",i)
+  }
+  ASSERT_DRAW(8,GL_TRIANGLES,80,81,82,90,91,92)
+
+  // Tint: Only the second draw. Alpha: Full until the fourth.
+  EGG_ASSERT(drawv[0].tint[3]==0.0f)
+  EGG_ASSERT(drawv[1].tint[0]==1.0f)
+  EGG_ASSERT(drawv[1].tint[3]==128.0f/255.0f)
+  EGG_ASSERT(drawv[2].tint[3]==0.0f)
+  EGG_ASSERT(drawv[2].alpha==1.0f)
+  EGG_ASSERT(drawv[3].alpha==128.0f/255.0f)
+  EGG_ASSERT(drawv[8].alpha==1.0f)
+
+  // Output and input textures, by GL id.
+  EGG_ASSERT_INTS(drawv[3].dsttexid,11)
+  EGG_ASSERT_INTS(drawv[4].dsttexid,14)
+  EGG_ASSERT_INTS(drawv[5].dsttexid,14)
+  EGG_ASSERT_INTS(drawv[5].srctexid,12)
+  EGG_ASSERT_INTS(drawv[7].srctexid,13)
+  EGG_ASSERT_INTS(drawv[8].dsttexid,11)
+  return 0;
+}
+
+/* TOC.
+ */
+
+int main(int argc,char **argv) {
+  EGG_UTEST(render_batch_merges_matching_calls,render)
+  EGG_UTEST(render_batch_keeps_uniforms_apart,render)
+  return 0;
+}
@@ -0,0 +1,183 @@
+#include "test/egg_test.h"
+#include "opt/softrender/softrender_context.c"
+#include "opt/softrender/softrender_texture.c"
+#include "opt/softrender/softrender_render.c"
+
+/* No build config enables softrender, so this is where it gets compiled and checked.
+ * We draw known primitives into a small framebuffer and compare individual pixels, worked out by hand,
+ * then hash the whole image so any other change in coverage or rounding shows up too.
+ */
+
+#define FBW 16
+#define FBH 16
+
+static uint32_t softrender_test_hash(const uint8_t *v,int c) {
+  uint32_t hash=0x811c9dc5;
+  for (;c-->0;v++) {
+    hash^=*v;
+    hash*=0x01000193;
+  }
+  return hash;
+}
+
+#define ASSERT_PIXEL(fb,x,y,expect) { \
+  const uint8_t *_p=(fb)+(((y)*FBW+(x))<<2); \
+  uint32_t _actual=(_p[0]<<24)|(_p[1]<<16)|(_p[2]<<8)|_p[3]; \
+  if (_actual!=(expect)) EGG_FAIL("Pixel (%d,%d): Expected %08x, got %08x",x,y,expect,_actual) \
+}
+
+/* 32x32 tilesheet, so tiles are 2x2. Tile 0 is four colors, tile 1 is gray for the FANCY primary-color trick.
+ */
+
+static int softrender_test_tilesheet(struct render *render) {
+  uint8_t v[32*32*4]={0};
+  static const uint8_t tile0[4][4]={
+    {0xff,0x00,0x00,0xff}, // (0,0) red
+    {0x00,0xff,0x00,0xff}, // (1,0) green
+    {0x00,0x00,0xff,0xff}, // (0,1) blue
+    {0xff,0xff,0xff,0xff}, // (1,1) white
+  };
+  memcpy(v,tile0[0],4);
+  memcpy(v+4,tile0[1],4);
+  memcpy(v+32*4,tile0[2],4);
+  memcpy(v+32*4+4,tile0[3],4);
+  int i=0; for (;i<4;i++) {
+    uint8_t *p=v+(((i>>1)*32+2+(i&1))<<2);
+    p[0]=p[1]=p[2]=0x40;
+    p[3]=0xff;
+  }
+  int texid=render_texture_new(render);
+  if (texid<1) return -1;
+  if (render_texture_load_raw(render,texid,32,32,32*4,v,sizeof(v))<0) return -1;
+  return texid;
+}
+
+static int softrender_known_draws() {
+  struct render *render=render_new();
+  EGG_ASSERT(render)
+  EGG_ASSERT_CALL(render_set_framebuffer_size(render,FBW,FBH))
+  render_set_size(render,FBW*2,FBH*2);
+  int sheet=softrender_test_tilesheet(render);
+  EGG_ASSERT(sheet>1)
+  render_begin(render);
+
+  // RAW: Opaque red square from two triangles, (0,0)..(8,8).
+  struct egg_render_uniform un={.mode=EGG_RENDER_TRIANGLE_STRIP,.dsttexid=1,.alpha=0xff};
+  struct egg_render_raw square[]={
+    {0,0,0,0,0xff,0x00,0x00,0xff},
+    {8,0,0,0,0xff,0x00,0x00,0xff},
+    {0,8,0,0,0xff,0x00,0x00,0xff},
+    {8,8,0,0,0xff,0x00,0x00,0xff},
+  };
+  render_render(render,&un,square,sizeof(square));
+
+  // Blend: Half-alpha blue over the right half of the square, (4,0)..(8,8).
+  struct egg_render_raw half[]={
+    {4,0,0,0,0x00,0x00,0xff,0x80},
+    {8,0,0,0,0x00,0x00,0xff,0x80},
+    {4,8,0,0,0x00,0x00,0xff,0x80},
+    {8,8,0,0,0x00,0x00,0xff,0x80},
+  };
+  render_render(render,&un,half,sizeof(half));
+
+  // Uniform alpha and tint: A white point at (12,1) with full green tint, and at (13,1) at uniform alpha 0x80.
+  struct egg_render_raw point={12,1,0,0,0xff,0xff,0xff,0xff};
+  un.mode=EGG_RENDER_POINTS;
+  un.tint=0x00ff00ff;
+  render_render(render,&un,&point,sizeof(point));
+  un.tint=0;
+  un.alpha=0x80;
+  point.x=13;
+  render_render(render,&un,&point,sizeof(point));
+  un.alpha=0xff;
+
+  // Line: Yellow, (10,4) to (14,4). The last pixel is not drawn.
+  struct egg_render_raw line[]={
+    {10,4,0,0,0xff,0xff,0x00,0xff},
+    {14,4,0,0,0xff,0xff,0x00,0xff},
+  };
+  un.mode=EGG_RENDER_LINES;
+  render_render(render,&un,line,sizeof(line));
+
+  // TILE: Tile 0 plain at (5,13), covering (4..5,12..13). And XREV at (9,13), covering (8..9,12..13).
+  struct egg_render_tile tilev[]={
+    {5,13,0,0},
+    {9,13,0,EGG_XFORM_XREV},
+  };
+  un.mode=EGG_RENDER_TILE;
+  un.srctexid=sheet;
+  render_render(render,&un,tilev,sizeof(tilev));
+
+  // FANCY: Tile 1 (gray 0x40) at (13,13) size 2, primary color red, so it comes out half red. And tile 0 at alpha 0x80.
+  struct egg_render_fancy fancyv[]={
+    {.x=13,.y=13,.tileid=1,.size=2,.pr=0xff,.pg=0x00,.pb=0x00,.a=0xff},
+    {.x=13,.y=9,.tileid=0,.size=2,.pr=0x80,.pg=0x80,.pb=0x80,.a=0x80},
+  };
+  un.mode=EGG_RENDER_FANCY;
+  render_render(render,&un,fancyv,sizeof(fancyv));
+
+  render_commit(render);
+  struct render_stats stats={0};
+  render_get_stats(&stats,render);
+  EGG_ASSERT_INTS(stats.drawc_last,7)
+
+  uint8_t fb[FBW*FBH*4];
+  EGG_ASSERT_INTS(render_texture_get_pixels(fb,sizeof(fb),render,1),sizeof(fb))
+
+  // Red square, and untouched beyond its right and bottom edges.
+  ASSERT_PIXEL(fb,0,0,0xff0000ff)
+  ASSERT_PIXEL(fb,3,7,0xff0000ff)
+  ASSERT_PIXEL(fb,8,0,0x00000000)
+  ASSERT_PIXEL(fb,0,8,0x00000000)
+  // Blue at 0x80 over red: Color is (src*a+dst*(255-a)+127)/255, and alpha blends the same way: (128*128+255*127+127)/255=191.
+  ASSERT_PIXEL(fb,4,0,0x7f0080bf)
+  ASSERT_PIXEL(fb,7,7,0x7f0080bf)
+  // Tinted point is green. The faded point is white at 0x80 over nothing.
+  ASSERT_PIXEL(fb,12,1,0x00ff00ff)
+  ASSERT_PIXEL(fb,13,1,0x80808040)
+  // Line covers 10..13 and not 14.
+  ASSERT_PIXEL(fb,10,4,0xffff00ff)
+  ASSERT_PIXEL(fb,13,4,0xffff00ff)
+  ASSERT_PIXEL(fb,14,4,0x00000000)
+  // Plain tile.
+  ASSERT_PIXEL(fb,4,12,0xff0000ff)
+  ASSERT_PIXEL(fb,5,12,0x00ff00ff)
+  ASSERT_PIXEL(fb,4,13,0x0000ffff)
+  ASSERT_PIXEL(fb,5,13,0xffffffff)
+  // XREV tile.
+  ASSERT_PIXEL(fb,8,12,0x00ff00ff)
+  ASSERT_PIXEL(fb,9,12,0xff0000ff)
+  ASSERT_PIXEL(fb,8,13,0xffffffff)
+  ASSERT_PIXEL(fb,9,13,0x0000ffff)
+  // Fancy gray 0x40 below the midpoint scales the primary: (0xff*0x40*2+127)/255=128.
+  ASSERT_PIXEL(fb,12,12,0x800000ff)
+  ASSERT_PIXEL(fb,13,13,0x800000ff)
+  // Fancy at 0x80 alpha over nothing: Red texel, unchanged color, alpha 0x40.
+  ASSERT_PIXEL(fb,12,8,0x80000040)
+
+  // Whole framebuffer. If this changes and the pixels above didn't, look closely before updating it.
+  EGG_ASSERT_INTS(softrender_test_hash(fb,sizeof(fb)),0x3236fa0d,"Framebuffer hash")
+
+  // Output is the framebuffer at 2x, nearest-neighbor.
+  int outw=0,outh=0,stride=0;
+  const uint8_t *output=render_get_output(&outw,&outh,&stride,render);
+  EGG_ASSERT(output)
+  EGG_ASSERT_INTS(outw,FBW*2)
+  EGG_ASSERT_INTS(outh,FBH*2)
+  int y=0; for (;y<outh;y++) {
+    int x=0; for (;x<outw;x++) {
+      if (memcmp(output+y*stride+(x<<2),fb+(((y>>1)*FBW+(x>>1))<<2),4)) EGG_FAIL("Output (%d,%d) doesn't match framebuffer (%d,%d)",x,y,x>>1,y>>1)
+    }
+  }
+
+  render_del(render);
+  return 0;
+}
+
+/* TOC.
+ */
+
+int main(int argc,char **argv) {
+  EGG_UTEST(softrender_known_draws,render)
+  return 0;
+}
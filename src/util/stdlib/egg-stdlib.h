@@ -50,6 +50,11 @@ void free(void *p);
 void *realloc(void *p,long unsigned int c);
 void *calloc(long unsigned int c,long unsigned int size);
 
+/* Nonstandard, for debugging. Live and peak allocation in bytes, and the percentage of the used heap that's idle.
+ * All optional. Returns <0 if malloc hasn't been used yet.
+ */
+int get_malloc_stats(int *live,int *peak,int *fragmentation);
+
 void *memcpy(void *dst,const void *src,unsigned long c);
 void *memmove(void *dst,const void *src,long unsigned int c);
 int memcmp(const void *a,const void *b,long unsigned int c);
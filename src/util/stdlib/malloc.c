@@ -4,13 +4,35 @@
 
 #include "egg-stdlib.h"
 
-/* Copied from synth.
+/* Copied from synth, see synth_stdlib.c for the original.
  * We're exporting the real stdlib symbols ("malloc" et al) so we can't fake it for native builds, the way synth does.
+ * All addresses and sizes are in 32-bit ints, not bytes.
+ * (v) is the linear memory. First slot holds the block length, or negative block length if free.
+ *
+ * Small blocks, up to MEM_SMALL_LIMIT words, come from size-class slabs instead, in constant time.
+ * A slab is one large block, carved into small blocks that each keep a length word too.
+ * Small length words are MEM_SMALL|class, plus MEM_IDLE while on the class's free list.
+ * The first payload word of an idle small block is the next idle one, or -1.
+ * Slabs are never returned to the large heap; the classes only grow to the most you've used at once.
  */
  
+#define MEM_SMALL 0x40000000
+#define MEM_IDLE  0x20000000
+#define MEM_CLASS_MASK 0xff
+#define MEM_SMALL_LIMIT 256
+#define MEM_SLAB_WORDS 1024
+#define MEM_SLAB_MIN_BLOCKS 8
+#define MEM_CLASSC 16
+
+static const int mem_class_size[MEM_CLASSC]={
+  1,2,3,4,6,8,12,16,24,32,48,64,96,128,192,256,
+};
+ 
 struct mem {
   int32_t *v;
   int c;
+  int idlev[MEM_CLASSC]; // Head of each class's free list, or -1.
+  int livec,peakc; // Payload words in use, and the most there's ever been.
 };
 
 /* Convert between the length-word (p) we prefer and payload addresses you should expose to the public.
@@ -29,13 +51,25 @@ static void *mem_pointer_from_index(const struct mem *mem,int p) {
 
 static void mem_free(struct mem *mem,int p) {
   if ((p<0)||(p>=mem->c)) return;
-  if (mem->v[p]<0) return; // Double free!
-  mem->v[p]=-mem->v[p];
+  int len=mem->v[p];
+  if (len<0) return; // Double free!
+  if (len&MEM_SMALL) {
+    if (len&MEM_IDLE) return; // Double free!
+    int clsid=len&MEM_CLASS_MASK;
+    mem->v[p]=len|MEM_IDLE;
+    mem->v[p+1]=mem->idlev[clsid];
+    mem->idlev[clsid]=p;
+    mem->livec-=mem_class_size[clsid];
+    return;
+  }
+  mem->v[p]=-len;
+  mem->livec-=len;
 }
 
 // Size of an allocated block in words.
 static int mem_get_block_size(const struct mem *mem,int p) {
   if ((p<0)||(p>=mem->c)) return -1;
+  if (mem->v[p]&MEM_SMALL) return mem_class_size[mem->v[p]&MEM_CLASS_MASK];
   return mem->v[p];
 }
 
@@ -60,6 +94,11 @@ static int mem_get_free_size(const struct mem *mem,int p) {
 static int mem_grow_block(struct mem *mem,int p,int na) {
   if ((p<0)||(p>=mem->c)) return -1;
   int len=mem->v[p];
+  if (len&MEM_SMALL) { // Small blocks can't grow, but may already be big enough.
+    len=mem_class_size[len&MEM_CLASS_MASK];
+    if (len>=na) return len;
+    return -1;
+  }
   if (len>=na) return len; // Already big enough.
   int nextp=p+1+len;
   int available=mem_get_free_size(mem,nextp);
@@ -67,6 +106,7 @@ static int mem_grow_block(struct mem *mem,int p,int na) {
   if (len+1+available<na) return -1; // Not enough room here.
   // Consume blocks until we're big enough, not necessarily all of (available).
   int p0=p;
+  int len0=len;
   while (len<na) {
     p=nextp;
     int nextlen=mem->v[p];
@@ -82,6 +122,8 @@ static int mem_grow_block(struct mem *mem,int p,int na) {
     len=na;
   }
   mem->v[p0]=len;
+  mem->livec+=len-len0;
+  if (mem->livec>mem->peakc) mem->peakc=mem->livec;
   return len;
 }
 
@@ -90,21 +132,22 @@ static int mem_shrink_block(struct mem *mem,int p,int na) {
   if ((p<0)||(p>=mem->c)) return -1;
   int len=mem->v[p];
   if (len<0) return -1; // Not an allocated block.
+  if (len&MEM_SMALL) return -1; // Small blocks are what they are.
   if (len<na) return -1; // That's not what "shrink" means.
   mem->v[p]=na;
   mem->v[p+1+na]=-(len-na-1);
+  mem->livec-=len-na;
   return na;
 }
 
-// Allocate a block of at least (c) words and return its "p".
-static int mem_allocate(struct mem *mem,int c) {
+// Allocate a block of at least (c) words from the large heap and return its "p".
+static int mem_allocate_large(struct mem *mem,int c) {
   if (c<0) return -1;
   int p=0;
   while (p<mem->c) {
     if (mem->v[p]<0) {
       int available=mem_get_free_size(mem,p);
       if (available>=c) {
-        //if ((mem->v[p]<0)&&(p+1-mem->v[p]>=mem->c)) logint(p+1+c); // XXX TEMP Log the high-water mark.
         mem->v[p]=c;
         if (c<available) { // Mark the remainder free.
           mem->v[p+1+c]=-(available-c)+1;
@@ -112,6 +155,8 @@ static int mem_allocate(struct mem *mem,int c) {
         return p;
       }
       p+=1+available;
+    } else if (mem->v[p]&MEM_SMALL) {
+      return -1; // Corrupt. Small blocks only exist inside slabs.
     } else {
       p+=1+mem->v[p];
     }
@@ -119,6 +164,43 @@ static int mem_allocate(struct mem *mem,int c) {
   return -1;
 }
 
+// Carve a new slab into idle blocks of class (clsid).
+static int mem_add_slab(struct mem *mem,int clsid) {
+  int blocklen=1+mem_class_size[clsid];
+  int slablen=MEM_SLAB_WORDS;
+  if (slablen<blocklen*MEM_SLAB_MIN_BLOCKS) slablen=blocklen*MEM_SLAB_MIN_BLOCKS;
+  int slabp=mem_allocate_large(mem,slablen);
+  if (slabp<0) return -1;
+  int blockc=slablen/blocklen;
+  int p=slabp+1+blocklen*(blockc-1);
+  for (;blockc-->0;p-=blocklen) {
+    mem->v[p]=MEM_SMALL|MEM_IDLE|clsid;
+    mem->v[p+1]=mem->idlev[clsid];
+    mem->idlev[clsid]=p;
+  }
+  return 0;
+}
+
+// Allocate a block of at least (c) words and return its "p".
+static int mem_allocate(struct mem *mem,int c) {
+  if (c<0) return -1;
+  int p;
+  if (c<=MEM_SMALL_LIMIT) {
+    int clsid=0;
+    while (mem_class_size[clsid]<c) clsid++;
+    if ((mem->idlev[clsid]<0)&&(mem_add_slab(mem,clsid)<0)) return -1;
+    p=mem->idlev[clsid];
+    mem->idlev[clsid]=mem->v[p+1];
+    mem->v[p]=MEM_SMALL|clsid;
+    mem->livec+=mem_class_size[clsid];
+  } else {
+    if ((p=mem_allocate_large(mem,c))<0) return -1;
+    mem->livec+=c;
+  }
+  if (mem->livec>mem->peakc) mem->peakc=mem->livec;
+  return p;
+}
+
 // Notify that you've reallocated (mem->v) to now allow (nc) words. (mem->c) must be the old count, and we'll update it.
 static int mem_master_grown(struct mem *mem,int nc) {
   int addc=nc-mem->c;
@@ -130,6 +212,42 @@ static int mem_master_grown(struct mem *mem,int nc) {
   return 0;
 }
 
+// Reset to one free block of (c) words at (v).
+static void mem_reset(struct mem *mem,int32_t *v,int c) {
+  mem->v=v;
+  mem->c=c;
+  mem->v[0]=-(mem->c-1);
+  int i=MEM_CLASSC;
+  while (i-->0) mem->idlev[i]=-1;
+  mem->livec=0;
+  mem->peakc=0;
+}
+
+/* Measure fragmentation, as percentage of the used extent that is neither in use nor available for large blocks.
+ * Walks the whole heap; only call for debugging.
+ */
+static int mem_get_fragmentation(const struct mem *mem) {
+  int extent=0,holec=0,pendingc=0,p=0;
+  while (p<mem->c) {
+    int len=mem->v[p];
+    if (len<0) {
+      pendingc+=1-len;
+      p+=1-len;
+    } else { // Free space only counts as a hole if something allocated follows it.
+      holec+=pendingc;
+      pendingc=0;
+      p+=1+len;
+      extent=p;
+    }
+  }
+  int i=MEM_CLASSC;
+  while (i-->0) {
+    for (p=mem->idlev[i];p>=0;p=mem->v[p+1]) holec+=1+mem_class_size[i];
+  }
+  if (extent<1) return 0;
+  return (int)(((int64_t)holec*100)/extent);
+}
+
 extern uint32_t __heap_base;
 static int pagec0=0;
 static int pagea=0;
@@ -149,9 +267,16 @@ static int malloc_init() {
     int pagecz=__builtin_wasm_memory_size(0);
     pagea=na;
   }
-  mem.v=(int32_t*)(((uint8_t*)&__heap_base)+(pagec0*0x10000));
-  mem.c=(pagea-pagec0)*(0x10000>>2); // words from pages
-  mem.v[0]=-(mem.c-1);
+  int32_t *v=(int32_t*)(((uint8_t*)&__heap_base)+(pagec0*0x10000));
+  mem_reset(&mem,v,(pagea-pagec0)*(0x10000>>2)); // words from pages
+  return 0;
+}
+
+int get_malloc_stats(int *live,int *peak,int *fragmentation) {
+  if (!mem.c) return -1;
+  if (live) *live=mem.livec<<2;
+  if (peak) *peak=mem.peakc<<2;
+  if (fragmentation) *fragmentation=mem_get_fragmentation(&mem);
   return 0;
 }
   
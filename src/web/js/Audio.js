@@ -5,7 +5,7 @@
  * We implement the audio portion of the Egg Platform API, and some extras for editor support.
  */
  
-import { EGG_TID_song, EGG_TID_sound } from "./Rom.js";
+import { EGG_TID_song, EGG_TID_sound, EGG_TID_songpcm } from "./Rom.js";
 
 /* Our AudioWorkletProcessor.
  * This is plain text that we trickfully load as a worklet.
@@ -19,6 +19,7 @@ const wsrc =
       "this.buffers = [];" + /* Float32Array */
       "this.bufferSize = 128;" + /* frames */
       "this.deferredCommands = [];" + /* m.data */
+      "this.preprinting = false;" + /* True until synth_preprint_update() reports all sounds printed. */
       "this.port.onmessage = m => {" +
         "if (!this.instance&&(m.data.cmd!=='init')) this.deferredCommands.push(m.data);" +
         "else this.cmdNow(m.data);" +
@@ -38,6 +39,7 @@ const wsrc =
         "case 'noteOff': this.noteOff(data); break;" +
         "case 'noteOnce': this.noteOnce(data); break;" +
         "case 'wheel': this.wheel(data); break;" +
+        "case 'eventAt': this.eventAt(data); break;" +
       "}" +
     "}" +
     
@@ -56,6 +58,7 @@ const wsrc =
           "throw new Error(`synth_init failed`);" +
         "}" +
         "this.transferRom(m.rom);" +
+        "if (m.preprint) this.preprinting = this.instance.exports.synth_preprint_sounds() > 0;" +
         "this.acquireBuffers();" +
         "for (const cmd of this.deferredCommands) this.cmdNow(cmd);" +
         "this.deferredCommands = [];" +
@@ -66,6 +69,7 @@ const wsrc =
     
     "reinit(m) {" +
       "if (!this.instance) return;" +
+      "this.preprinting = false;" +
       "this.transferRom(m.rom);" +
     "}" +
     
@@ -123,6 +127,11 @@ const wsrc =
       "this.instance.exports.synth_set(m.songid, m.chid, 6, m.v / 8192);" + // PROP 6 = WHEEL
     "}" +
     
+    "eventAt(m) {" +
+      "if (!this.instance) return;" +
+      "this.instance.exports.synth_event_at(m.songid, m.chid, m.event, m.noteid, m.velocity, m.durms, 1, m.playhead);" + /* 1=SYNTH_TIME_PLAYHEAD */
+    "}" +
+    
     "setPlayhead(m) {" +
       "if (!this.instance) return;" +
       "this.instance.exports.synth_set(m.songid, 0xff, 3, m.ph);" + /* 3=SYNTH_PROP_PLAYHEAD */
@@ -144,6 +153,8 @@ const wsrc =
       "for (let c=0; c<output.length; c++) {" +
         "output[c].set(this.buffers[c]);" +
       "}" +
+      /* Print a few sounds' worth of frames between quanta, until they're all done. Cheaper than printing on demand mid-game. */
+      "if (this.preprinting) this.preprinting = this.instance.exports.synth_preprint_update(this.bufferSize * 8) > 0;" +
       "return true;" +
     "}" +
   "}" +
@@ -191,7 +202,14 @@ export class Audio {
       this.node.port.onmessage = e => this.onWorkerMessage(e.data);
       return this.acquireWasm();
     }).then(wasm => {
-      this.node.port.postMessage({ cmd: "init", rom: this.sliceRom(this.rt?.rom?.serial), wasm, r: this.ctx.sampleRate, c: this.ctx.destination.channelCount });
+      this.node.port.postMessage({
+        cmd: "init",
+        rom: this.sliceRom(this.rt?.rom?.serial),
+        wasm,
+        r: this.ctx.sampleRate,
+        c: this.ctx.destination.channelCount,
+        preprint: this.rt ? this.preprintRequested() : false,
+      });
       this.ready = true;
     });
     this.ctx.audioWorklet.addModule(url).then(() => {
@@ -210,14 +228,26 @@ export class Audio {
     return promise;
   }
   
+  /* Query param "preprintSounds" prints all sounds at load, instead of each the first time it plays.
+   * Same as "--preprint-sounds" for native.
+   */
+  preprintRequested() {
+    const query = location?.search?.substring?.(1);
+    if (!query) return false;
+    const fld = query.split('&').find(fld => (fld === "preprintSounds") || fld.startsWith("preprintSounds="));
+    return !!fld && (fld !== "preprintSounds=0");
+  }
+  
   /* Given a full Egg ROM, return just the song and sound bits.
    * Tid (5,6), deliberately assigned next to each other.
+   * Plus prerendered songs (songpcm) if there are any, spliced on with a TID command.
    */
   sliceRom(src) {
     if (!src || (src.length < 4)) return src;
     if ((src[0] !== 0x00) || (src[1] !== 0x45) || (src[2] !== 0x52) || (src[3] !== 0x4d)) return src;
-    let startp=4, stopp=src.length, startTid=0;
+    let startp=4, stopp=src.length, startTid=0, stopTid=0, pcmp=0, pcmStopp=src.length;
     for (let srcp=4, tid=1; srcp<src.length; ) {
+      const cmdp = srcp;
       const lead = src[srcp++];
       if (!lead) break;
       switch (lead & 0xc0) {
@@ -228,8 +258,16 @@ export class Audio {
               startTid = nextTid;
             }
             if (nextTid > 6) {
-              stopp = srcp - 1;
-              srcp = src.length;
+              if (!stopTid) {
+                stopp = cmdp;
+                stopTid = tid;
+              }
+              if (nextTid === EGG_TID_songpcm) {
+                pcmp = srcp;
+              } else if (nextTid > EGG_TID_songpcm) {
+                if (pcmp) pcmStopp = cmdp;
+                srcp = src.length;
+              }
             }
             tid = nextTid;
           } break;
@@ -251,6 +289,14 @@ export class Audio {
       new Uint8Array(dst.buffer, dst.byteOffset + 1, len).set(new Uint8Array(src.buffer, src.byteOffset + startp, stopp - startp));
       return dst;
     }
+    if ((startTid === 5) && pcmp && (pcmStopp > pcmp)) {
+      const len = stopp - startp;
+      const dst = new Uint8Array(len + 1 + pcmStopp - pcmp);
+      dst.set(src.subarray(startp, stopp));
+      dst[len] = EGG_TID_songpcm - stopTid;
+      dst.set(src.subarray(pcmp, pcmStopp), len + 1);
+      return dst;
+    }
     return src.slice(startp, stopp);
   }
   
@@ -497,6 +543,11 @@ export class Audio {
     this.node.port.postMessage({ cmd: "wheel", songid, chid, v });
   }
   
+  egg_song_event_at(songid, chid, event, noteid, velocity, durms, playhead) {
+    if (!this.ready) return;
+    this.node.port.postMessage({ cmd: "eventAt", songid, chid, event, noteid, velocity, durms, playhead });
+  }
+  
   egg_song_get_playhead(songid) {
     const song = this.songsBySongid[songid];
     if (song) {
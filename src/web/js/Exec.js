@@ -41,6 +41,7 @@ export class Exec {
       egg_song_event_note_off: (s, c, n) => this.rt.audio.egg_song_event_note_off(s, c, n),
       egg_song_event_note_once: (s, c, n, v, d) => this.rt.audio.egg_song_event_note_once(s, c, n, v, d),
       egg_song_event_wheel: (s, c, v) => this.rt.audio.egg_song_event_wheel(s, c, v),
+      egg_song_event_at: (s, c, e, n, v, d, p) => this.rt.audio.egg_song_event_at(s, c, e, n, v, d, p),
       egg_song_get_playhead: (s) => this.rt.audio.egg_song_get_playhead(s),
       
       egg_texture_del: texid => this.rt.video.egg_texture_del(texid),
@@ -11,7 +11,8 @@ export const
   EGG_TID_tilesheet = 7,
   EGG_TID_decalsheet = 8,
   EGG_TID_map = 9,
-  EGG_TID_sprite = 10;
+  EGG_TID_sprite = 10,
+  EGG_TID_songpcm = 11;
  
 export class Rom {
   constructor(src) {